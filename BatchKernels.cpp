@@ -0,0 +1,110 @@
+#include "MatrixBatch.h"
+#include "BatchKernels.h"
+
+/* ---------------------- SCALAR (REFERENCE) ---------------------- */
+//One lane per vector, the plain C++ every other set must agree with
+
+template<typename T>
+struct ScalarLanes {
+    typedef T Element;
+    typedef T Vector;
+    typedef bool Mask;
+    static const uint32_t WIDTH = 1;
+    static Vector load(const T *values) { return *values; }
+    static void store(T *values, Vector v) { *values = v; }
+    static Vector broadcast(T value) { return value; }
+    static Vector add(Vector a, Vector b) { return a + b; }
+    static Vector sub(Vector a, Vector b) { return a - b; }
+    static Vector mul(Vector a, Vector b) { return a * b; }
+    static Vector div(Vector a, Vector b) { return a / b; }
+    static Vector neg(Vector a) { return -a; }
+    static Vector abs(Vector a) { return fixedAbs(a); }
+    static Mask greater(Vector a, Vector b) { return a > b; }
+    static Mask equal(Vector a, Vector b) { return a == b; }
+    static Mask notEqual(Vector a, Vector b) { return a != b; }
+    static Mask both(Mask a, Mask b) { return a && b; }
+    static Vector select(Mask mask, Vector a, Vector b) { return mask ? a : b; }
+};
+
+template<typename T>
+const BatchKernelTable<T> &scalarBatchKernels() {
+    static const BatchKernelTable<T> table = batchKernelTable<ScalarLanes<T>>();
+    return table;
+}
+
+/* ---------------------- DISPATCH ---------------------- */
+
+//REQUIRES: rowKernelsSupported(level)
+//MODIFIES: Nothing
+//EFFECTS: Returns the batch kernels compiled for level
+template<typename T>
+static const BatchKernelTable<T> &batchKernelsFor(RowKernelLevel level) {
+    switch(level) {
+#if defined(__x86_64__) || defined(__i386__)
+        case RowKernelLevel::Sse2: return sse2BatchKernels<T>();
+        case RowKernelLevel::Avx2: return avx2BatchKernels<T>();
+        case RowKernelLevel::Avx512: return avx512BatchKernels<T>();
+#endif
+        default: return scalarBatchKernels<T>();
+    }
+}
+
+template<typename T>
+void batchInverse(const MatrixBatch<T> &A, MatrixBatch<T> &inverses, vector<T> &determinants,
+                  vector<uint8_t> &singular, RowKernelLevel level) {
+    const uint32_t n = A.getRows();
+    assert(n >= 1 && n <= FIXED_MAX_SIZE && A.getCols() == n);
+    inverses = MatrixBatch<T>(n, n, A.size());
+    inverses.resize(A.size());
+    determinants.resize(A.size());
+    singular.resize(A.size());
+    batchKernelsFor<T>(level).inverse[n - 1](A, inverses, determinants.data(), singular.data());
+    countFlops(2 * (uint64_t)n * n * n * A.size()); //factor and solve, as counted for one inverse
+}
+
+template<typename T>
+void batchDeterminant(const MatrixBatch<T> &A, vector<T> &determinants, RowKernelLevel level) {
+    const uint32_t n = A.getRows();
+    assert(n >= 1 && n <= FIXED_MAX_SIZE && A.getCols() == n);
+    determinants.resize(A.size());
+    batchKernelsFor<T>(level).determinant[n - 1](A, determinants.data());
+    countFlops(2 * (uint64_t)n * n * n / 3 * A.size());
+}
+
+template<typename T>
+void batchSolve(const MatrixBatch<T> &systems, MatrixBatch<T> &solutions, vector<uint8_t> &singular,
+                RowKernelLevel level) {
+    const uint32_t n = systems.getRows();
+    assert(n >= 1 && n <= FIXED_MAX_SIZE && systems.getCols() == n + 1);
+    solutions = MatrixBatch<T>(n, 1, systems.size());
+    solutions.resize(systems.size());
+    singular.resize(systems.size());
+    batchKernelsFor<T>(level).solve[n - 1](systems, solutions, singular.data());
+    countFlops((2 * (uint64_t)n * n * n / 3 + 2 * (uint64_t)n * n) * systems.size());
+}
+
+template<typename T>
+void batchMultiply(const MatrixBatch<T> &A, const MatrixBatch<T> &B, MatrixBatch<T> &products,
+                   RowKernelLevel level) {
+    const uint32_t n = A.getRows();
+    assert(n >= 1 && n <= FIXED_MAX_SIZE && A.getCols() == n && B.getRows() == n && B.getCols() == n);
+    assert(A.size() == B.size());
+    products = MatrixBatch<T>(n, n, A.size());
+    products.resize(A.size());
+    batchKernelsFor<T>(level).multiply[n - 1](A, B, products);
+    countFlops(2 * (uint64_t)n * n * n * A.size());
+}
+
+template void batchInverse<float>(const MatrixBatch<float> &, MatrixBatch<float> &, vector<float> &,
+                                  vector<uint8_t> &, RowKernelLevel);
+template void batchInverse<double>(const MatrixBatch<double> &, MatrixBatch<double> &, vector<double> &,
+                                   vector<uint8_t> &, RowKernelLevel);
+template void batchDeterminant<float>(const MatrixBatch<float> &, vector<float> &, RowKernelLevel);
+template void batchDeterminant<double>(const MatrixBatch<double> &, vector<double> &, RowKernelLevel);
+template void batchSolve<float>(const MatrixBatch<float> &, MatrixBatch<float> &, vector<uint8_t> &, RowKernelLevel);
+template void batchSolve<double>(const MatrixBatch<double> &, MatrixBatch<double> &, vector<uint8_t> &,
+                                 RowKernelLevel);
+template void batchMultiply<float>(const MatrixBatch<float> &, const MatrixBatch<float> &, MatrixBatch<float> &,
+                                   RowKernelLevel);
+template void batchMultiply<double>(const MatrixBatch<double> &, const MatrixBatch<double> &, MatrixBatch<double> &,
+                                    RowKernelLevel);
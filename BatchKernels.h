@@ -0,0 +1,200 @@
+#ifndef BATCHKERNELS_H
+#define BATCHKERNELS_H
+
+#include "MatrixBatch.h"
+
+using namespace std;
+
+//The batch kernels of MatrixBatch.h, written once over a set of lane operations and compiled once per instruction
+//set: BatchKernels.cpp holds the scalar set and the dispatch, BatchKernelsSse2.cpp, BatchKernelsAvx2.cpp and
+//BatchKernelsAvx512.cpp each include this header after a #pragma GCC target for their set, so that the generic
+//code below is compiled for that set and the compiler keeps its vectors in registers
+//
+//A set of lane operations (see ScalarLanes in BatchKernels.cpp) is a struct with
+//  Element, Vector, Mask  the element type, WIDTH lanes of it and one condition per lane
+//  load, store, broadcast, add, sub, mul, div, neg, abs
+//  greater, equal, notEqual  the scalar C++ comparison lane by lane, NaN included (only != holds for NaN)
+//  both(a, b)  a && b
+//  select(mask, a, b)  mask ? a : b lane by lane
+//Each kernel applies exactly the operations of the FixedMatrix code to every lane, in the same order, with every
+//branch turned into a select, so results agree to the bit whichever set runs
+
+//One instruction set's kernels for element type T, entry n - 1 takes n x n matrices (n + 1 columns for solve)
+template<typename T>
+struct BatchKernelTable {
+    void (*inverse[FIXED_MAX_SIZE])(const MatrixBatch<T> &A, MatrixBatch<T> &inverses, T *determinants,
+                                    uint8_t *singular);
+    void (*determinant[FIXED_MAX_SIZE])(const MatrixBatch<T> &A, T *determinants);
+    void (*solve[FIXED_MAX_SIZE])(const MatrixBatch<T> &systems, MatrixBatch<T> &solutions, uint8_t *singular);
+    void (*multiply[FIXED_MAX_SIZE])(const MatrixBatch<T> &A, const MatrixBatch<T> &B, MatrixBatch<T> &products);
+};
+
+//REQUIRES: rowKernelsSupported of the level
+//MODIFIES: Nothing
+//EFFECTS: Returns the kernels compiled for that level
+template<typename T> const BatchKernelTable<T> &scalarBatchKernels();
+template<typename T> const BatchKernelTable<T> &sse2BatchKernels();
+template<typename T> const BatchKernelTable<T> &avx2BatchKernels();
+template<typename T> const BatchKernelTable<T> &avx512BatchKernels();
+
+//REQUIRES: systems holds N x (N + K) systems, or N x N matrices if IDENTITY (their right-hand side is the identity,
+//          K == N), solutions is N x K with a stride of at least systems.size() rounded up to CHUNK, or K == 0
+//MODIFIES: solutions, determinants, singular
+//EFFECTS: Factors every matrix like FixedLU, carrying the right-hand side through the same row interchanges and
+//         eliminations (the forward substitution of FixedLU::solve, in the same order), then back substitutes
+//         Writes the determinant and the singular flag of each matrix when determinants or singular is not nullptr
+template<typename Lanes, uint32_t N, uint32_t K, bool IDENTITY>
+static void eliminateBatch(const MatrixBatch<typename Lanes::Element> &systems,
+                           MatrixBatch<typename Lanes::Element> *solutions, typename Lanes::Element *determinants,
+                           uint8_t *singular) {
+    typedef typename Lanes::Element T;
+    typedef typename Lanes::Vector Vector;
+    typedef typename Lanes::Mask Mask;
+    const uint32_t W = Lanes::WIDTH;
+    const Vector zeros = Lanes::broadcast(0);
+    const Vector ones = Lanes::broadcast(1);
+    for(uint32_t first = 0; first < systems.size(); first += W) {
+        Vector a[N][N + K];
+        for(uint32_t r = 0; r < N; r++) {
+            for(uint32_t c = 0; c < N + K; c++) {
+                if(IDENTITY && c >= N) {
+                    a[r][c] = c - N == r ? ones : zeros;
+                }
+                else {
+                    a[r][c] = Lanes::load(systems.plane(r, c) + first);
+                }
+            }
+        }
+        Vector sign = ones;
+        Vector isSingular = zeros;
+        for(uint32_t k = 0; k < N; k++) {
+            Vector largest = Lanes::abs(a[k][k]);
+            Vector pivotRow = Lanes::broadcast((T)k); //row indices as T so that the masks are as wide as the data
+            for(uint32_t r = k + 1; r < N; r++) {
+                const Vector magnitude = Lanes::abs(a[r][k]);
+                const Mask larger = Lanes::greater(magnitude, largest);
+                largest = Lanes::select(larger, magnitude, largest);
+                pivotRow = Lanes::select(larger, Lanes::broadcast((T)r), pivotRow);
+            }
+            for(uint32_t r = k + 1; r < N; r++) { //the columns before k are not read again
+                const Mask swap = Lanes::equal(pivotRow, Lanes::broadcast((T)r));
+                for(uint32_t c = k; c < N + K; c++) {
+                    const Vector held = a[k][c];
+                    a[k][c] = Lanes::select(swap, a[r][c], held);
+                    a[r][c] = Lanes::select(swap, held, a[r][c]);
+                }
+            }
+            sign = Lanes::select(Lanes::notEqual(pivotRow, Lanes::broadcast((T)k)), Lanes::neg(sign), sign);
+            const Mask live = Lanes::notEqual(largest, zeros); //FixedLU skips a column without a nonzero pivot
+            isSingular = Lanes::select(live, isSingular, ones);
+            for(uint32_t r = k + 1; r < N; r++) {
+                const Vector multiplier = Lanes::div(a[r][k], a[k][k]);
+                const Mask update = Lanes::both(live, Lanes::notEqual(multiplier, zeros));
+                for(uint32_t c = k + 1; c < N + K; c++) {
+                    a[r][c] = Lanes::select(update, Lanes::sub(a[r][c], Lanes::mul(multiplier, a[k][c])), a[r][c]);
+                }
+            }
+        }
+        for(uint32_t i = N; K != 0 && i-- > 0;) {
+            for(uint32_t j = i + 1; j < N; j++) {
+                const Mask update = Lanes::notEqual(a[i][j], zeros);
+                for(uint32_t c = N; c < N + K; c++) {
+                    a[i][c] = Lanes::select(update, Lanes::sub(a[i][c], Lanes::mul(a[i][j], a[j][c])), a[i][c]);
+                }
+            }
+            for(uint32_t c = N; c < N + K; c++) {
+                a[i][c] = Lanes::div(a[i][c], a[i][i]);
+            }
+        }
+
+        for(uint32_t r = 0; K != 0 && r < N; r++) {
+            for(uint32_t c = 0; c < K; c++) {
+                Lanes::store(solutions->plane(r, c) + first, a[r][N + c]);
+            }
+        }
+        const uint32_t lanes = min(W, systems.size() - first); //the last vector may reach past the batch
+        T values[W];
+        if(determinants != nullptr) {
+            Vector det = sign;
+            for(uint32_t k = 0; k < N; k++) {
+                det = Lanes::mul(det, a[k][k]);
+            }
+            Lanes::store(values, det);
+            memcpy(determinants + first, values, lanes * sizeof(T));
+        }
+        if(singular != nullptr) {
+            Lanes::store(values, isSingular);
+            for(uint32_t l = 0; l < lanes; l++) {
+                singular[first + l] = values[l] != 0;
+            }
+        }
+    }
+}
+
+//REQUIRES: A and B hold N x N matrices, as many of them, products is N x N and as large
+//MODIFIES: products
+//EFFECTS: products[i] = A[i] * B[i], each row accumulated from zero in k order like FixedMatrix's operator*
+template<typename Lanes, uint32_t N>
+static void multiplyBatch(const MatrixBatch<typename Lanes::Element> &A, const MatrixBatch<typename Lanes::Element> &B,
+                          MatrixBatch<typename Lanes::Element> &products) {
+    typedef typename Lanes::Vector Vector;
+    for(uint32_t first = 0; first < A.size(); first += Lanes::WIDTH) {
+        Vector b[N][N];
+        for(uint32_t k = 0; k < N; k++) {
+            for(uint32_t c = 0; c < N; c++) {
+                b[k][c] = Lanes::load(B.plane(k, c) + first);
+            }
+        }
+        for(uint32_t r = 0; r < N; r++) {
+            Vector row[N];
+            for(uint32_t c = 0; c < N; c++) {
+                row[c] = Lanes::broadcast(0);
+            }
+            for(uint32_t k = 0; k < N; k++) {
+                const Vector coef = Lanes::load(A.plane(r, k) + first);
+                for(uint32_t c = 0; c < N; c++) {
+                    row[c] = Lanes::add(row[c], Lanes::mul(coef, b[k][c]));
+                }
+            }
+            for(uint32_t c = 0; c < N; c++) {
+                Lanes::store(products.plane(r, c) + first, row[c]);
+            }
+        }
+    }
+}
+
+template<typename Lanes, uint32_t N>
+static void inverseBatch(const MatrixBatch<typename Lanes::Element> &A, MatrixBatch<typename Lanes::Element> &inverses,
+                         typename Lanes::Element *determinants, uint8_t *singular) {
+    eliminateBatch<Lanes, N, N, true>(A, &inverses, determinants, singular);
+}
+
+template<typename Lanes, uint32_t N>
+static void determinantBatch(const MatrixBatch<typename Lanes::Element> &A, typename Lanes::Element *determinants) {
+    eliminateBatch<Lanes, N, 0, false>(A, nullptr, determinants, nullptr);
+}
+
+template<typename Lanes, uint32_t N>
+static void solveBatch(const MatrixBatch<typename Lanes::Element> &systems,
+                       MatrixBatch<typename Lanes::Element> &solutions, uint8_t *singular) {
+    eliminateBatch<Lanes, N, 1, false>(systems, &solutions, nullptr, singular);
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the kernels of every size over the lane operations Lanes
+template<typename Lanes>
+static BatchKernelTable<typename Lanes::Element> batchKernelTable() {
+    BatchKernelTable<typename Lanes::Element> table;
+    for(uint32_t n = 1; n <= FIXED_MAX_SIZE; n++) {
+        dispatchFixedSize(n, [&](auto size) {
+            table.inverse[n - 1] = inverseBatch<Lanes, size()>;
+            table.determinant[n - 1] = determinantBatch<Lanes, size()>;
+            table.solve[n - 1] = solveBatch<Lanes, size()>;
+            table.multiply[n - 1] = multiplyBatch<Lanes, size()>;
+        });
+    }
+    return table;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "MatrixBatch.h"
+
+//A fused multiply-add rounds once where the scalar kernels round twice, so none may be formed
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//Everything defined from here on, the batch kernels included, is compiled for AVX2
+#pragma GCC target("avx2")
+#include "BatchKernels.h"
+
+/* ---------------------- AVX2, 4 DOUBLES OR 8 FLOATS ---------------------- */
+
+template<typename T> struct Avx2Lanes;
+
+template<>
+struct Avx2Lanes<double> {
+    typedef double Element;
+    typedef __m256d Vector;
+    typedef __m256d Mask;
+    static const uint32_t WIDTH = 4;
+    static Vector load(const double *values) { return _mm256_loadu_pd(values); }
+    static void store(double *values, Vector v) { _mm256_storeu_pd(values, v); }
+    static Vector broadcast(double value) { return _mm256_set1_pd(value); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm256_div_pd(a, b); }
+    static Vector neg(Vector a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+    static Vector abs(Vector a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static Mask greater(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Mask equal(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static Mask notEqual(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+    static Vector select(Mask mask, Vector a, Vector b) { return _mm256_blendv_pd(b, a, mask); }
+};
+
+template<>
+struct Avx2Lanes<float> {
+    typedef float Element;
+    typedef __m256 Vector;
+    typedef __m256 Mask;
+    static const uint32_t WIDTH = 8;
+    static Vector load(const float *values) { return _mm256_loadu_ps(values); }
+    static void store(float *values, Vector v) { _mm256_storeu_ps(values, v); }
+    static Vector broadcast(float value) { return _mm256_set1_ps(value); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm256_div_ps(a, b); }
+    static Vector neg(Vector a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    static Vector abs(Vector a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Mask greater(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask equal(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static Mask notEqual(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Vector select(Mask mask, Vector a, Vector b) { return _mm256_blendv_ps(b, a, mask); }
+};
+
+template<typename T>
+const BatchKernelTable<T> &avx2BatchKernels() {
+    static const BatchKernelTable<T> table = batchKernelTable<Avx2Lanes<T>>();
+    return table;
+}
+
+template const BatchKernelTable<float> &avx2BatchKernels<float>();
+template const BatchKernelTable<double> &avx2BatchKernels<double>();
+
+#endif
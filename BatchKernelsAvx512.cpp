@@ -0,0 +1,78 @@
+#include "MatrixBatch.h"
+
+//A fused multiply-add rounds once where the scalar kernels round twice, so none may be formed
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//Everything defined from here on, the batch kernels included, is compiled for AVX-512
+#pragma GCC target("avx512f")
+#include "BatchKernels.h"
+
+/* ---------------------- AVX-512, 8 DOUBLES OR 16 FLOATS ---------------------- */
+
+template<typename T> struct Avx512Lanes;
+
+template<>
+struct Avx512Lanes<double> {
+    typedef double Element;
+    typedef __m512d Vector;
+    typedef __mmask8 Mask;
+    static const uint32_t WIDTH = 8;
+    static Vector load(const double *values) { return _mm512_loadu_pd(values); }
+    static void store(double *values, Vector v) { _mm512_storeu_pd(values, v); }
+    static Vector broadcast(double value) { return _mm512_set1_pd(value); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm512_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm512_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm512_div_pd(a, b); }
+    static Vector neg(Vector a) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(INT64_MIN)));
+    }
+    static Vector abs(Vector a) { return _mm512_abs_pd(a); }
+    static Mask greater(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static Mask equal(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static Mask notEqual(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ); }
+    static Mask both(Mask a, Mask b) { return (Mask)(a & b); }
+    static Vector select(Mask mask, Vector a, Vector b) { return _mm512_mask_blend_pd(mask, b, a); }
+};
+
+template<>
+struct Avx512Lanes<float> {
+    typedef float Element;
+    typedef __m512 Vector;
+    typedef __mmask16 Mask;
+    static const uint32_t WIDTH = 16;
+    static Vector load(const float *values) { return _mm512_loadu_ps(values); }
+    static void store(float *values, Vector v) { _mm512_storeu_ps(values, v); }
+    static Vector broadcast(float value) { return _mm512_set1_ps(value); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm512_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm512_div_ps(a, b); }
+    static Vector neg(Vector a) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(INT32_MIN)));
+    }
+    static Vector abs(Vector a) { return _mm512_abs_ps(a); }
+    static Mask greater(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Mask equal(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static Mask notEqual(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+    static Mask both(Mask a, Mask b) { return (Mask)(a & b); }
+    static Vector select(Mask mask, Vector a, Vector b) { return _mm512_mask_blend_ps(mask, b, a); }
+};
+
+template<typename T>
+const BatchKernelTable<T> &avx512BatchKernels() {
+    static const BatchKernelTable<T> table = batchKernelTable<Avx512Lanes<T>>();
+    return table;
+}
+
+template const BatchKernelTable<float> &avx512BatchKernels<float>();
+template const BatchKernelTable<double> &avx512BatchKernels<double>();
+
+#endif
@@ -0,0 +1,78 @@
+#include "MatrixBatch.h"
+
+//A fused multiply-add rounds once where the scalar kernels round twice, so none may be formed
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//Everything defined from here on, the batch kernels included, is compiled for SSE2
+#pragma GCC target("sse2")
+#include "BatchKernels.h"
+
+/* ---------------------- SSE2, 2 DOUBLES OR 4 FLOATS ---------------------- */
+
+template<typename T> struct Sse2Lanes;
+
+template<>
+struct Sse2Lanes<double> {
+    typedef double Element;
+    typedef __m128d Vector;
+    typedef __m128d Mask;
+    static const uint32_t WIDTH = 2;
+    static Vector load(const double *values) { return _mm_loadu_pd(values); }
+    static void store(double *values, Vector v) { _mm_storeu_pd(values, v); }
+    static Vector broadcast(double value) { return _mm_set1_pd(value); }
+    static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm_div_pd(a, b); }
+    static Vector neg(Vector a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+    static Vector abs(Vector a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static Mask greater(Vector a, Vector b) { return _mm_cmpgt_pd(a, b); }
+    static Mask equal(Vector a, Vector b) { return _mm_cmpeq_pd(a, b); }
+    static Mask notEqual(Vector a, Vector b) { return _mm_cmpneq_pd(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_pd(a, b); }
+    static Vector select(Mask mask, Vector a, Vector b) {
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+};
+
+template<>
+struct Sse2Lanes<float> {
+    typedef float Element;
+    typedef __m128 Vector;
+    typedef __m128 Mask;
+    static const uint32_t WIDTH = 4;
+    static Vector load(const float *values) { return _mm_loadu_ps(values); }
+    static void store(float *values, Vector v) { _mm_storeu_ps(values, v); }
+    static Vector broadcast(float value) { return _mm_set1_ps(value); }
+    static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm_div_ps(a, b); }
+    static Vector neg(Vector a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    static Vector abs(Vector a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Mask greater(Vector a, Vector b) { return _mm_cmpgt_ps(a, b); }
+    static Mask equal(Vector a, Vector b) { return _mm_cmpeq_ps(a, b); }
+    static Mask notEqual(Vector a, Vector b) { return _mm_cmpneq_ps(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Vector select(Mask mask, Vector a, Vector b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+};
+
+template<typename T>
+const BatchKernelTable<T> &sse2BatchKernels() {
+    static const BatchKernelTable<T> table = batchKernelTable<Sse2Lanes<T>>();
+    return table;
+}
+
+template const BatchKernelTable<float> &sse2BatchKernels<float>();
+template const BatchKernelTable<double> &sse2BatchKernels<double>();
+
+#endif
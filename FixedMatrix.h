@@ -0,0 +1,333 @@
+#ifndef FIXEDMATRIX_H
+#define FIXEDMATRIX_H
+
+#include "Matrix.h"
+#include <type_traits>
+
+using namespace std;
+
+//Largest dimension that the dynamic code hands to the fixed size kernels (see dispatchFixedSize)
+const uint32_t FIXED_MAX_SIZE = 8;
+
+//Matrix whose dimensions are part of its type, for the 2x2 to 8x8 transforms and systems that make up most batches
+//The elements live inline (on the stack or inside the owner), nothing is allocated, every loop has a compile-time
+//trip count that the compiler unrolls completely and every operation is constexpr
+//A FixedMatrix is a MatrixExpr, so a Matrix<T> can be built from it, assigned from it or combined with it
+template<typename T, uint32_t R, uint32_t C>
+class FixedMatrix : public MatrixExpr<FixedMatrix<T, R, C>> {
+public:
+    typedef T value_type;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Creates a matrix with all values set to zero
+    constexpr FixedMatrix() : values{} {}
+
+    //REQUIRES: mat is R x C
+    //MODIFIES: this
+    //EFFECTS: Copies mat in logical row order
+    explicit FixedMatrix(const Matrix<T> &mat) : values{} {
+        assert(mat.rows == R && mat.columns == C);
+        for(uint32_t r = 0; r < R; r++) {
+            const T *matRow = mat.rowPtr(r);
+            for(uint32_t c = 0; c < C; c++) {
+                values[r][c] = matRow[c];
+            }
+        }
+    }
+
+    //REQUIRES: R == C
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the identity matrix
+    static constexpr FixedMatrix identity() {
+        static_assert(R == C, "Only a square matrix has an identity");
+        FixedMatrix result;
+        for(uint32_t d = 0; d < R; d++) {
+            result.values[d][d] = 1;
+        }
+        return result;
+    }
+
+    constexpr uint32_t getRows() const {
+        return R;
+    }
+    constexpr uint32_t getCols() const {
+        return C;
+    }
+
+    constexpr T &operator()(uint32_t row, uint32_t col) {
+        return values[row][col];
+    }
+    constexpr const T &operator()(uint32_t row, uint32_t col) const {
+        return values[row][col];
+    }
+
+    //One row for a MatrixExpr evaluation
+    const T *exprRow(uint32_t row) const {
+        return values[row];
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns a dynamic copy for the code that works on Matrix<T>
+    Matrix<T> toMatrix() const {
+        return Matrix<T>(*this);
+    }
+
+    constexpr FixedMatrix &operator+=(const FixedMatrix &rhs) {
+        for(uint32_t r = 0; r < R; r++) {
+            for(uint32_t c = 0; c < C; c++) {
+                values[r][c] += rhs.values[r][c];
+            }
+        }
+        return *this;
+    }
+    constexpr FixedMatrix &operator-=(const FixedMatrix &rhs) {
+        for(uint32_t r = 0; r < R; r++) {
+            for(uint32_t c = 0; c < C; c++) {
+                values[r][c] -= rhs.values[r][c];
+            }
+        }
+        return *this;
+    }
+    constexpr FixedMatrix &operator*=(T coefficient) {
+        for(uint32_t r = 0; r < R; r++) {
+            for(uint32_t c = 0; c < C; c++) {
+                values[r][c] *= coefficient;
+            }
+        }
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the C x R transpose
+    constexpr FixedMatrix<T, C, R> transpose() const {
+        FixedMatrix<T, C, R> result;
+        for(uint32_t r = 0; r < R; r++) {
+            for(uint32_t c = 0; c < C; c++) {
+                result(c,r) = values[r][c];
+            }
+        }
+        return result;
+    }
+
+private:
+    T values[R][C];
+};
+
+template<typename T, uint32_t R, uint32_t C>
+constexpr FixedMatrix<T, R, C> operator+(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C> &rhs) {
+    return lhs += rhs;
+}
+template<typename T, uint32_t R, uint32_t C>
+constexpr FixedMatrix<T, R, C> operator-(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C> &rhs) {
+    return lhs -= rhs;
+}
+template<typename T, uint32_t R, uint32_t C>
+constexpr FixedMatrix<T, R, C> operator*(T coefficient, FixedMatrix<T, R, C> operand) {
+    return operand *= coefficient;
+}
+template<typename T, uint32_t R, uint32_t C>
+constexpr FixedMatrix<T, R, C> operator*(FixedMatrix<T, R, C> operand, T coefficient) {
+    return operand *= coefficient;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns A * B, accumulated in the same order as gemmSmall so both give the same bits
+template<typename T, uint32_t R, uint32_t K, uint32_t C>
+constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, K> &A, const FixedMatrix<T, K, C> &B) {
+    FixedMatrix<T, R, C> product;
+    for(uint32_t r = 0; r < R; r++) {
+        T row[C] = {}; //one row of the product stays in registers
+        for(uint32_t k = 0; k < K; k++) {
+            const T coef = A(r,k);
+            for(uint32_t c = 0; c < C; c++) {
+                row[c] += coef * B(k,c);
+            }
+        }
+        for(uint32_t c = 0; c < C; c++) {
+            product(r,c) = row[c];
+        }
+    }
+    return product;
+}
+
+template<typename T>
+constexpr T fixedAbs(T value) {
+    return value < 0 ? -value : value;
+}
+
+//LU factorization with partial pivoting of a FixedMatrix, P * A = L * U
+//Performs exactly the operations of an unblocked LUFactorization, in the same order, so results agree to the bit
+template<typename T, uint32_t N>
+class FixedLU {
+public:
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Factors A, at step k the row with the largest magnitude entry in column k becomes the pivot
+    constexpr explicit FixedLU(const FixedMatrix<T, N, N> &A) : lu(A) {
+        for(uint32_t k = 0; k < N; k++) {
+            uint32_t pivotRow = k;
+            T largest = fixedAbs(lu(k,k));
+            for(uint32_t r = k + 1; r < N; r++) {
+                if(fixedAbs(lu(r,k)) > largest) {
+                    largest = fixedAbs(lu(r,k));
+                    pivotRow = r;
+                }
+            }
+            pivots[k] = pivotRow;
+            if(pivotRow != k) {
+                swapRows(lu, k, pivotRow);
+                sign = -sign;
+            }
+            if(largest == 0) {
+                singular = true;
+                continue;
+            }
+            const T pivot = lu(k,k);
+            for(uint32_t r = k + 1; r < N; r++) {
+                const T multiplier = lu(r,k) / pivot;
+                lu(r,k) = multiplier;
+                if(multiplier != 0) {
+                    for(uint32_t c = k + 1; c < N; c++) {
+                        lu(r,c) -= multiplier * lu(k,c);
+                    }
+                }
+            }
+        }
+    }
+
+    //REQUIRES: factors, pivotRows, detSign and isSingular describe a factorization with this pivoting
+    //          (e.g. an LUFactorization of an N x N matrix)
+    //MODIFIES: this
+    //EFFECTS: Takes over the factorization without factoring again
+    constexpr FixedLU(const FixedMatrix<T, N, N> &factors, const uint32_t *pivotRows, int detSign, bool isSingular)
+        : lu(factors), sign(detSign), singular(isSingular) {
+        for(uint32_t k = 0; k < N; k++) {
+            pivots[k] = pivotRows[k];
+        }
+    }
+
+    constexpr bool isSingular() const {
+        return singular;
+    }
+    constexpr const FixedMatrix<T, N, N> &getLU() const {
+        return lu;
+    }
+    //getPivots()[k] is the row interchanged with row k at step k
+    constexpr const uint32_t *getPivots() const {
+        return pivots;
+    }
+    constexpr int getSign() const {
+        return sign;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns det(A), the product of U's diagonal with the sign of the row permutation
+    constexpr T determinant() const {
+        T det = (T)sign;
+        for(uint32_t k = 0; k < N; k++) {
+            det *= lu(k,k);
+        }
+        return det;
+    }
+
+    //REQUIRES: the factorization is not singular
+    //MODIFIES: Nothing
+    //EFFECTS: Returns X such that A * X = B, in the order of LUFactorization::solveInPlace
+    template<uint32_t K>
+    constexpr FixedMatrix<T, N, K> solve(FixedMatrix<T, N, K> B) const {
+        for(uint32_t k = 0; k + 1 < N; k++) { //the last row is always its own pivot
+            if(pivots[k] != k) {
+                swapRows(B, k, pivots[k]);
+            }
+        }
+        for(uint32_t i = 0; i < N; i++) {
+            for(uint32_t j = 0; j < i; j++) {
+                const T coef = lu(i,j);
+                if(coef != 0) {
+                    for(uint32_t c = 0; c < K; c++) {
+                        B(i,c) -= coef * B(j,c);
+                    }
+                }
+            }
+        }
+        for(uint32_t i = N; i-- > 0;) {
+            for(uint32_t j = i + 1; j < N; j++) {
+                const T coef = lu(i,j);
+                if(coef != 0) {
+                    for(uint32_t c = 0; c < K; c++) {
+                        B(i,c) -= coef * B(j,c);
+                    }
+                }
+            }
+            const T diag = lu(i,i);
+            for(uint32_t c = 0; c < K; c++) {
+                B(i,c) /= diag;
+            }
+        }
+        return B;
+    }
+
+    //REQUIRES: the factorization is not singular
+    //MODIFIES: Nothing
+    //EFFECTS: Returns A^-1 by solving against the identity
+    constexpr FixedMatrix<T, N, N> inverse() const {
+        return solve(FixedMatrix<T, N, N>::identity());
+    }
+
+private:
+    FixedMatrix<T, N, N> lu;
+    uint32_t pivots[N] = {};
+    int sign = 1;
+    bool singular = false;
+
+    template<uint32_t K>
+    static constexpr void swapRows(FixedMatrix<T, N, K> &mat, uint32_t row1, uint32_t row2) {
+        for(uint32_t c = 0; c < K; c++) {
+            const T held = mat(row1,c);
+            mat(row1,c) = mat(row2,c);
+            mat(row2,c) = held;
+        }
+    }
+};
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns det(A)
+template<typename T, uint32_t N>
+constexpr T determinant(const FixedMatrix<T, N, N> &A) {
+    return FixedLU<T, N>(A).determinant();
+}
+
+//REQUIRES: A is not singular
+//MODIFIES: Nothing
+//EFFECTS: Returns A^-1
+template<typename T, uint32_t N>
+constexpr FixedMatrix<T, N, N> inverse(const FixedMatrix<T, N, N> &A) {
+    return FixedLU<T, N>(A).inverse();
+}
+
+//REQUIRES: 1 <= n <= FIXED_MAX_SIZE
+//MODIFIES: Nothing
+//EFFECTS: Calls work(integral_constant<uint32_t, n>()), which is how code with a run time size n picks the
+//         FixedMatrix instantiation for it, e.g. work = [&](auto size) { FixedMatrix<T, size(), size()> ... }
+template<typename Work>
+void dispatchFixedSize(uint32_t n, Work &&work) {
+    assert(n >= 1 && n <= FIXED_MAX_SIZE);
+    switch(n) {
+        case 1: work(integral_constant<uint32_t, 1>()); break;
+        case 2: work(integral_constant<uint32_t, 2>()); break;
+        case 3: work(integral_constant<uint32_t, 3>()); break;
+        case 4: work(integral_constant<uint32_t, 4>()); break;
+        case 5: work(integral_constant<uint32_t, 5>()); break;
+        case 6: work(integral_constant<uint32_t, 6>()); break;
+        case 7: work(integral_constant<uint32_t, 7>()); break;
+        default: work(integral_constant<uint32_t, 8>()); break;
+    }
+}
+
+#endif
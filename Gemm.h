@@ -0,0 +1,243 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+//Register tile of the micro-kernel, GEMM_MR rows of A times GEMM_NR columns of B are accumulated in registers
+const uint32_t GEMM_MR = 4;
+const uint32_t GEMM_NR = 8;
+//Cache blocks: a GEMM_KC x GEMM_NR sliver of B stays in L1 across a whole GEMM_MC x GEMM_KC block of A
+//which stays in L2, and the GEMM_KC x GEMM_NC block of B stays in L3
+const uint32_t GEMM_KC = 256;
+const uint32_t GEMM_MC = 96;
+const uint32_t GEMM_NC = 2048;
+//Products with fewer multiply-adds than this skip packing and use the direct row loop
+const uint64_t GEMM_SMALL_WORK = 32 * 32 * 32;
+//Products with fewer multiply-adds than this stay on the calling thread
+const uint64_t GEMM_PARALLEL_WORK = 128 * 128 * 128;
+//Output tile handed to one pool task, a whole GEMM_MC block of rows by a few dozen micro-kernel columns
+const uint32_t GEMM_TILE_ROWS = GEMM_MC;
+const uint32_t GEMM_TILE_COLS = 32 * GEMM_NR;
+
+//Packing buffer owned by one thread, grown on demand and reused by every later product on that thread
+template<typename T>
+struct GemmPackBuffer {
+    T *data = nullptr;
+    size_t capacity = 0;
+
+    //REQUIRES: Nothing
+    //MODIFIES: data, capacity
+    //EFFECTS: Returns a buffer of at least count elements
+    T *reserve(size_t count) {
+        if(count > capacity) {
+            alignedFree(data);
+            data = alignedAllocate<T>(count);
+            capacity = count;
+        }
+        return data;
+    }
+
+    ~GemmPackBuffer() {
+        alignedFree(data);
+    }
+};
+
+//REQUIRES: A is valid, [row, row + mc) x [col, col + kc) lies within A
+//MODIFIES: packed
+//EFFECTS: Copies the block of A into GEMM_MR row panels, each stored column by column (kc x GEMM_MR)
+//         Rows past the end of the last panel are zero filled so the micro-kernel never branches
+template<typename T>
+void gemmPackA(const MatrixBlock<const Matrix<T>> &A, uint32_t row, uint32_t col, uint32_t mc, uint32_t kc, T *packed) {
+    for(uint32_t panel = 0; panel < mc; panel += GEMM_MR) {
+        T *dest = packed + (size_t)panel * kc;
+        for(uint32_t i = 0; i < GEMM_MR; i++) {
+            if(panel + i < mc) {
+                const T *aRow = A.rowPtr(row + panel + i) + col;
+                for(uint32_t p = 0; p < kc; p++) {
+                    dest[p * GEMM_MR + i] = aRow[p];
+                }
+            }
+            else {
+                for(uint32_t p = 0; p < kc; p++) {
+                    dest[p * GEMM_MR + i] = 0;
+                }
+            }
+        }
+    }
+}
+
+//REQUIRES: B is valid, [row, row + kc) x [col, col + nc) lies within B
+//MODIFIES: packed
+//EFFECTS: Copies the block of B into GEMM_NR column panels, each stored row by row (kc x GEMM_NR)
+//         Columns past the end of the last panel are zero filled
+template<typename T>
+void gemmPackB(const MatrixBlock<const Matrix<T>> &B, uint32_t row, uint32_t col, uint32_t kc, uint32_t nc, T *packed) {
+    for(uint32_t p = 0; p < kc; p++) {
+        const T *bRow = B.rowPtr(row + p) + col;
+        for(uint32_t panel = 0; panel < nc; panel += GEMM_NR) {
+            T *dest = packed + (size_t)panel * kc + (size_t)p * GEMM_NR;
+            uint32_t width = min(GEMM_NR, nc - panel);
+            for(uint32_t j = 0; j < width; j++) {
+                dest[j] = bRow[panel + j];
+            }
+            for(uint32_t j = width; j < GEMM_NR; j++) {
+                dest[j] = 0;
+            }
+        }
+    }
+}
+
+//REQUIRES: packedA is a kc x GEMM_MR panel, packedB is a kc x GEMM_NR panel,
+//          the mr x nr tile of C at [row, col] lies within C
+//MODIFIES: C
+//EFFECTS: Computes the GEMM_MR x GEMM_NR product of the panels in registers, then stores
+//         C = alpha * product + beta * C for the mr x nr part of the tile that exists
+//         C is overwritten rather than scaled when beta is zero so garbage in C never propagates
+template<typename T>
+void gemmMicroKernel(uint32_t kc, const T *packedA, const T *packedB, T alpha, T beta,
+                     const MatrixBlock<Matrix<T>> &C, uint32_t row, uint32_t col, uint32_t mr, uint32_t nr) {
+    T tile[GEMM_MR][GEMM_NR] = {};
+    for(uint32_t p = 0; p < kc; p++) {
+        const T *a = packedA + p * GEMM_MR;
+        const T *b = packedB + p * GEMM_NR;
+        for(uint32_t i = 0; i < GEMM_MR; i++) {
+            for(uint32_t j = 0; j < GEMM_NR; j++) {
+                tile[i][j] += a[i] * b[j];
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < mr; i++) {
+        T *cRow = C.rowPtr(row + i) + col;
+        if(beta == 0) {
+            for(uint32_t j = 0; j < nr; j++) {
+                cRow[j] = alpha * tile[i][j];
+            }
+        }
+        else {
+            for(uint32_t j = 0; j < nr; j++) {
+                cRow[j] = beta * cRow[j] + alpha * tile[i][j];
+            }
+        }
+    }
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and does not overlap A or B,
+//          [rowBegin, rowEnd) x [colBegin, colEnd) lies within C
+//MODIFIES: C
+//EFFECTS: Computes C = alpha * A * B + beta * C on the given range of C only, blocking for each cache level
+//         and packing A and B so the micro-kernel streams through contiguous memory
+//         Separate ranges of C may be computed independently (and concurrently)
+template<typename T>
+void gemmRange(T alpha, const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B, T beta,
+               const MatrixBlock<Matrix<T>> &C, uint32_t rowBegin, uint32_t rowEnd, uint32_t colBegin, uint32_t colEnd) {
+    thread_local GemmPackBuffer<T> bufferA;
+    thread_local GemmPackBuffer<T> bufferB;
+    const uint32_t depth = A.columns;
+    T *packedA = bufferA.reserve((size_t)GEMM_MC * GEMM_KC);
+    T *packedB = bufferB.reserve((size_t)GEMM_KC * (GEMM_NC + GEMM_NR));
+
+    for(uint32_t jc = colBegin; jc < colEnd; jc += GEMM_NC) {
+        uint32_t nc = min(GEMM_NC, colEnd - jc);
+        for(uint32_t pc = 0; pc < depth; pc += GEMM_KC) {
+            uint32_t kc = min(GEMM_KC, depth - pc);
+            T blockBeta = (pc == 0) ? beta : 1; //later depth blocks accumulate onto the first
+            gemmPackB(B, pc, jc, kc, nc, packedB);
+            for(uint32_t ic = rowBegin; ic < rowEnd; ic += GEMM_MC) {
+                uint32_t mc = min(GEMM_MC, rowEnd - ic);
+                gemmPackA(A, ic, pc, mc, kc, packedA);
+                for(uint32_t jr = 0; jr < nc; jr += GEMM_NR) {
+                    for(uint32_t ir = 0; ir < mc; ir += GEMM_MR) {
+                        gemmMicroKernel(kc, packedA + (size_t)ir * kc, packedB + (size_t)jr * kc, alpha, blockBeta,
+                                        C, ic + ir, jc + jr, min(GEMM_MR, mc - ir), min(GEMM_NR, nc - jr));
+                    }
+                }
+            }
+        }
+    }
+
+    if(depth == 0) { //empty inner dimension, the product is zero
+        for(uint32_t r = rowBegin; r < rowEnd; r++) {
+            T *cRow = C.rowPtr(r);
+            for(uint32_t c = colBegin; c < colEnd; c++) {
+                cRow[c] = (beta == 0) ? 0 : beta * cRow[c];
+            }
+        }
+    }
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and does not overlap A or B
+//MODIFIES: C
+//EFFECTS: Computes C = alpha * A * B + beta * C with a direct row-by-row loop, used for small products
+template<typename T>
+void gemmSmall(T alpha, const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B, T beta,
+               const MatrixBlock<Matrix<T>> &C) {
+    for(uint32_t r = 0; r < C.rows; r++) {
+        T *cRow = C.rowPtr(r);
+        for(uint32_t c = 0; c < C.columns; c++) {
+            cRow[c] = (beta == 0) ? 0 : beta * cRow[c];
+        }
+        const T *aRow = A.rowPtr(r);
+        for(uint32_t k = 0; k < A.columns; k++) {
+            T coef = alpha * aRow[k];
+            const T *bRow = B.rowPtr(k);
+            for(uint32_t c = 0; c < C.columns; c++) {
+                cRow[c] += coef * bRow[c];
+            }
+        }
+    }
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and does not overlap A or B
+//MODIFIES: C
+//EFFECTS: Computes C = alpha * A * B + beta * C by splitting C into GEMM_TILE_ROWS x GEMM_TILE_COLS tiles
+//         and running one gemmRange per tile on the thread pool
+template<typename T>
+void gemmParallel(T alpha, const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B, T beta,
+                  const MatrixBlock<Matrix<T>> &C) {
+    const uint32_t tilesDown = (C.rows + GEMM_TILE_ROWS - 1) / GEMM_TILE_ROWS;
+    const uint32_t tilesAcross = (C.columns + GEMM_TILE_COLS - 1) / GEMM_TILE_COLS;
+    ThreadPool::instance().parallelFor(tilesDown * tilesAcross, [&](uint32_t tile) {
+        uint32_t rowBegin = tile / tilesAcross * GEMM_TILE_ROWS;
+        uint32_t colBegin = tile % tilesAcross * GEMM_TILE_COLS;
+        gemmRange(alpha, A, B, beta, C, rowBegin, min(rowBegin + GEMM_TILE_ROWS, C.rows),
+                  colBegin, min(colBegin + GEMM_TILE_COLS, C.columns));
+    });
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and does not overlap A or B
+//          (the blocks may come from the same matrix as long as their regions are disjoint)
+//MODIFIES: C
+//EFFECTS: General matrix multiply on blocks, C = alpha * A * B + beta * C
+//         Small products use the direct loop, large ones are tiled across the thread pool
+template<typename T>
+void gemm(T alpha, const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B, T beta,
+          const MatrixBlock<Matrix<T>> &C) {
+    assert(A.columns == B.rows);
+    assert(C.rows == A.rows && C.columns == B.columns);
+    const uint64_t work = (uint64_t)A.rows * B.columns * A.columns;
+    countFlops(2 * work);
+    if(work < GEMM_SMALL_WORK) {
+        gemmSmall(alpha, A, B, beta, C);
+    }
+    else if(work < GEMM_PARALLEL_WORK || ThreadPool::instance().size() == 1) {
+        gemmRange(alpha, A, B, beta, C, 0, C.rows, 0, C.columns);
+    }
+    else {
+        gemmParallel(alpha, A, B, beta, C);
+    }
+}
+
+//REQUIRES: A, B, C are valid, A.columns == B.rows, C is A.rows x B.columns and does not alias A or B
+//MODIFIES: C
+//EFFECTS: General matrix multiply, C = alpha * A * B + beta * C
+template<typename T>
+void gemm(typename Matrix<T>::value_type alpha, const Matrix<T> &A, const Matrix<T> &B,
+          typename Matrix<T>::value_type beta, Matrix<T> &C) {
+    assert(&C != &A && &C != &B);
+    gemm<T>(alpha, wholeBlock(A), wholeBlock(B), beta, wholeBlock(C));
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "InputReader.h"
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+InputReader::InputReader(int fdIn) : fd(fdIn) {
+    struct stat info;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void *map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+            mapping = map;
+            mappingSize = (size_t)info.st_size;
+            data = static_cast<const char *>(map);
+            size = mappingSize;
+            eof = true; //the whole file is already in the window
+            return;
+        }
+    }
+    buffer.resize(BLOCK_SIZE); //not mappable, fall back to block reads
+    data = buffer.data();
+}
+
+InputReader::~InputReader() {
+    if(mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+bool InputReader::atEnd() {
+    while(true) {
+        for(; pos < size; pos++) {
+            char ch = data[pos];
+            if(ch == '\n') {
+                line++;
+                lineStart = windowOffset + pos + 1;
+            }
+            else if(!isspace((unsigned char)ch)) {
+                return false;
+            }
+        }
+        if(!refill()) {
+            return true;
+        }
+    }
+}
+
+void InputReader::releaseParsed() {
+    if(mapping == nullptr) {
+        return;
+    }
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t parsed = pos / page * page;
+    if(parsed >= released + RELEASE_STEP) {
+        madvise(static_cast<char *>(mapping) + released, parsed - released, MADV_DONTNEED); //read again if touched
+        released = parsed;
+    }
+}
+
+uint32_t InputReader::readCount(const char *what) {
+    const char *begin;
+    const char *end;
+    if(!nextToken(begin, end)) {
+        fail(string("input ended where the ") + what + " was expected");
+    }
+    uint32_t value = 0;
+    from_chars_result result = from_chars(begin, end, value);
+    if(result.ec != errc() || result.ptr != end) {
+        fail(string("expected the ") + what + " (a non-negative integer), found '" + string(begin, end) + "'");
+    }
+    return value;
+}
+
+string InputReader::readWord(const char *what) {
+    const char *begin;
+    const char *end;
+    if(!nextToken(begin, end)) {
+        fail(string("input ended where the ") + what + " was expected");
+    }
+    double number;
+    const char *start = (*begin == '+' && end - begin > 1) ? begin + 1 : begin;
+    from_chars_result result = from_chars(start, end, number);
+    if(result.ec == errc() && result.ptr == end) { //a number where a word belongs, the matrix had too many elements
+        fail(string("expected the ") + what + ", found the number '" + string(begin, end)
+             + "' (more elements than the matrix dimensions allow?)");
+    }
+    return string(begin, end);
+}
+
+bool InputReader::readKeyword(const char *word) {
+    const char *begin;
+    const char *end;
+    if(!nextToken(begin, end)) {
+        return false;
+    }
+    if((size_t)(end - begin) == strlen(word) && memcmp(begin, word, strlen(word)) == 0) {
+        return true;
+    }
+    pos = (size_t)(begin - data); //the token is still in the window, the next read starts at it again
+    return false;
+}
+
+//REQUIRES: [begin, end) is a token
+//MODIFIES: Nothing
+//EFFECTS: Returns the token as a row or column index below limit, anything else is reported as an error
+uint32_t InputReader::parseIndex(const char *begin, const char *end, uint32_t limit, const char *what,
+                                 const string &shape, uint32_t index) const {
+    uint32_t value = 0;
+    from_chars_result result = from_chars(begin, end, value);
+    if(result.ec != errc() || result.ptr != end || value >= limit) {
+        fail(string("expected a ") + what + " index below " + to_string(limit) + " in the " + shape
+             + " sparse matrix " + to_string(index) + ", found '" + string(begin, end) + "'");
+    }
+    return value;
+}
+
+void InputReader::fail(const string &message) const {
+    cerr << "Input error at line " << tokenLine << ", column " << tokenColumn << ": " << message << "\n";
+    exit(1);
+}
+
+//REQUIRES: Nothing
+//MODIFIES: this
+//EFFECTS: Moves the unread tail of the window to the front of the buffer and reads the next block after it
+//         Returns false if nothing more could be read
+bool InputReader::refill() {
+    if(eof) {
+        return false;
+    }
+    size_t unread = size - pos;
+    memmove(buffer.data(), buffer.data() + pos, unread);
+    windowOffset += pos;
+    pos = 0;
+    size = unread;
+    if(size == buffer.size()) { //a single token fills the whole buffer, make room for the rest of it
+        buffer.resize(buffer.size() * 2);
+    }
+    data = buffer.data();
+
+    ssize_t got;
+    do {
+        got = read(fd, buffer.data() + size, buffer.size() - size);
+    } while(got < 0 && errno == EINTR);
+    if(got <= 0) {
+        eof = true;
+        return false;
+    }
+    size += (size_t)got;
+    return true;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: this
+//EFFECTS: Skips whitespace and sets [begin, end) to the next token, which stays valid until the next call
+//         Returns false at the end of the input
+bool InputReader::nextToken(const char *&begin, const char *&end) {
+    if(atEnd()) {
+        return false;
+    }
+    tokenLine = line;
+    tokenColumn = windowOffset + pos - lineStart + 1;
+
+    size_t tokenEnd = pos;
+    while(true) {
+        while(tokenEnd < size && !isspace((unsigned char)data[tokenEnd])) {
+            tokenEnd++;
+        }
+        if(tokenEnd < size) {
+            break;
+        }
+        size_t scanned = tokenEnd - pos; //token runs to the end of the window, read more of it
+        bool more = refill();
+        tokenEnd = pos + scanned; //refill may have moved the token to the front of the buffer
+        if(!more) {
+            break;
+        }
+    }
+    begin = data + pos;
+    end = data + tokenEnd;
+    pos = tokenEnd;
+    return true;
+}
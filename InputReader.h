@@ -0,0 +1,172 @@
+#ifndef INPUTREADER_H
+#define INPUTREADER_H
+
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Whitespace separated token reader over a file descriptor
+//A regular file is memory mapped and parsed in place, anything else (a pipe, a terminal) is read in large blocks
+//Numbers are converted with from_chars straight from the input bytes, no streams or locales are involved
+//Malformed input is reported with its line and column and ends the program, like a bad command line option
+class InputReader {
+public:
+    //REQUIRES: fd is open for reading
+    //MODIFIES: this
+    //EFFECTS: Maps the file behind fd if it is a regular file, otherwise prepares to read it block by block
+    explicit InputReader(int fd);
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Unmaps the file if it was mapped
+    ~InputReader();
+
+    InputReader(const InputReader &) = delete;
+    InputReader &operator=(const InputReader &) = delete;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Returns whether only whitespace remains
+    bool atEnd();
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Gives the pages of a mapped input that have been parsed back to the kernel, once at least
+    //         RELEASE_STEP of them have accumulated, so that an input read piece by piece (--stream) does not stay
+    //         resident as a whole, block reads only ever hold one block anyway
+    void releaseParsed();
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Reads a non-negative integer, what names it in the error message if the token is not one
+    uint32_t readCount(const char *what);
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Reads a word that is not a number, what names it in the error message if it is missing or numeric
+    string readWord(const char *what);
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Reads the next token and returns true if it is word, otherwise leaves it unread and returns false
+    bool readKeyword(const char *word);
+
+    //REQUIRES: mat has the dimensions given in the input, index is the matrix's position in the input
+    //MODIFIES: this, mat
+    //EFFECTS: Parses exactly mat.rows * mat.columns numbers directly into mat's rows
+    //         Too few elements (the command or end of input comes early) is reported as an error
+    template<typename T>
+    void readMatrix(Matrix<T> &mat, uint32_t index) {
+        readRows(mat, 0, mat.rows, mat.rows, index);
+    }
+
+    //REQUIRES: band has the columns given in the input and at least count rows, the rows of the numRows row matrix
+    //          index before firstRow have been read
+    //MODIFIES: this, band
+    //EFFECTS: Parses rows [firstRow, firstRow + count) of the matrix into the first count rows of band, so that a
+    //         matrix too large for memory can be read a band of rows at a time, errors are reported as readMatrix
+    //         reports them
+    template<typename T>
+    void readRows(Matrix<T> &band, uint32_t firstRow, uint32_t count, uint32_t numRows, uint32_t index) {
+        for(uint32_t r = 0; r < count; r++) {
+            T *row = band.rowPtr(r);
+            const uint64_t before = (uint64_t)(firstRow + r) * band.columns;
+            for(uint32_t c = 0; c < band.columns; c++) {
+                const char *begin;
+                const char *end;
+                if(!nextToken(begin, end)) {
+                    fail("input ended after " + to_string(before + c) + " of the "
+                         + dimensions(numRows, band.columns) + " elements of matrix " + to_string(index));
+                }
+                if(!parseNumber(begin, end, row[c])) {
+                    fail("expected element " + to_string(before + c + 1) + " of the "
+                         + dimensions(numRows, band.columns) + " matrix " + to_string(index) + ", found '"
+                         + string(begin, end) + "'");
+                }
+            }
+        }
+    }
+
+    //REQUIRES: index is the matrix's position in the input
+    //MODIFIES: this
+    //EFFECTS: Parses nonzeros "row col value" triplets (0-based, in any order, duplicates are summed) and returns
+    //         the numRows x numCols sparse matrix they describe
+    //         A position outside the matrix or too few triplets is reported as an error
+    template<typename T>
+    SparseMatrix<T> readSparseMatrix(uint32_t numRows, uint32_t numCols, uint32_t nonzeros, uint32_t index) {
+        const string shape = to_string(numRows) + "x" + to_string(numCols);
+        vector<SparseEntry<T>> entries(nonzeros);
+        for(uint32_t e = 0; e < nonzeros; e++) {
+            const char *begin;
+            const char *end;
+            if(!nextToken(begin, end)) {
+                fail("input ended after " + to_string(e) + " of the " + to_string(nonzeros)
+                     + " entries of sparse matrix " + to_string(index));
+            }
+            entries[e].row = parseIndex(begin, end, numRows, "row", shape, index);
+            if(!nextToken(begin, end)) {
+                fail("input ended inside entry " + to_string(e + 1) + " of sparse matrix " + to_string(index));
+            }
+            entries[e].col = parseIndex(begin, end, numCols, "column", shape, index);
+            if(!nextToken(begin, end) || !parseNumber(begin, end, entries[e].value)) {
+                fail("expected the value of entry " + to_string(e + 1) + " of the " + shape + " sparse matrix "
+                     + to_string(index));
+            }
+        }
+        return SparseMatrix<T>(numRows, numCols, entries);
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Prints message with the line and column of the last token read to cerr and exits
+    [[noreturn]] void fail(const string &message) const;
+
+private:
+    static const size_t BLOCK_SIZE = 1 << 20; //bytes requested per read when the input is not mapped
+    static const size_t RELEASE_STEP = 1 << 26; //parsed bytes of a mapping releaseParsed gives back at once
+
+    int fd;
+    const char *data = nullptr; //current window of input bytes
+    size_t size = 0; //valid bytes in the window
+    size_t pos = 0; //next unread byte in the window
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    size_t released = 0; //bytes at the start of the mapping given back by releaseParsed
+    vector<char> buffer; //window storage when reading in blocks
+    bool eof = false;
+
+    uint64_t windowOffset = 0; //offset in the input of data[0]
+    uint64_t line = 1; //line of data[pos]
+    uint64_t lineStart = 0; //input offset of the first byte of that line
+    uint64_t tokenLine = 1;
+    uint64_t tokenColumn = 1;
+
+    bool refill();
+    bool nextToken(const char *&begin, const char *&end);
+
+    uint32_t parseIndex(const char *begin, const char *end, uint32_t limit, const char *what, const string &shape,
+                        uint32_t index) const;
+
+    //REQUIRES: [begin, end) is a token
+    //MODIFIES: value
+    //EFFECTS: Converts the whole token to a number, returns false if it is not one
+    template<typename T>
+    static bool parseNumber(const char *begin, const char *end, T &value) {
+        if(*begin == '+' && end - begin > 1) { //from_chars does not take an explicit plus sign
+            begin++;
+        }
+        from_chars_result result = from_chars(begin, end, value);
+        return result.ec == errc() && result.ptr == end;
+    }
+
+    static string dimensions(uint32_t numRows, uint32_t numCols) {
+        return to_string(numRows) + "x" + to_string(numCols);
+    }
+};
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef LUFACTORIZATION_H
+#define LUFACTORIZATION_H
+
+#include "Matrix.h"
+#include "FixedMatrix.h"
+#include "RowKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+//Columns per panel of the blocked factorization, matrices no larger than this are factored in one unblocked panel
+const uint32_t LU_DEFAULT_BLOCK_SIZE = 96;
+//Smallest double system that Solve factors in float and refines (solveRefined), below it the O(n^2) refinement
+//steps cost more than the cheaper factorization saves
+const uint32_t MIXED_SOLVE_MIN_SIZE = 256;
+//Refinement steps solveRefined takes before giving up (LAPACK's dsgesv uses the same limit)
+const uint32_t MIXED_SOLVE_MAX_STEPS = 30;
+
+//LU factorization with partial pivoting, P * A = L * U
+//L (unit diagonal, below the diagonal) and U (on and above the diagonal) share one matrix, the row interchanges
+//are kept both as the LAPACK style pivot vector and in the matrix's own row order
+//Factor once, then solve, invert and take the determinant as often as needed without eliminating A again
+//Large matrices are factored by blocks so that almost all of the work is a GEMM update of the trailing submatrix,
+//matrices up to FIXED_MAX_SIZE are factored and inverted by the unrolled FixedLU (same operations, same results)
+template<typename T>
+class LUFactorization {
+public:
+    //REQUIRES: A is a valid square matrix, blockSize >= 1
+    //MODIFIES: this
+    //EFFECTS: Factors a copy of A, at step k the row with the largest magnitude entry in column k becomes the pivot
+    //         blockSize columns are factored at a time before the rest of the matrix is updated
+    explicit LUFactorization(const Matrix<T> &A, uint32_t blockSize = LU_DEFAULT_BLOCK_SIZE) : lu(A), pivots(A.rows) {
+        assert(A.rows == A.columns);
+        lu.determinant = 1;
+        factor(max(1u, blockSize));
+    }
+
+    //REQUIRES: A is a valid square matrix, blockSize >= 1
+    //MODIFIES: this, A
+    //EFFECTS: Factors A in place, taking over its buffer instead of copying it (for a matrix built to be factored)
+    explicit LUFactorization(Matrix<T> &&A, uint32_t blockSize = LU_DEFAULT_BLOCK_SIZE)
+        : lu(move(A)), pivots(lu.rows) {
+        assert(lu.rows == lu.columns);
+        lu.determinant = 1;
+        factor(max(1u, blockSize));
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns whether a pivot was exactly zero, in which case solve and inverse are not available
+    bool isSingular() const {
+        return singular;
+    }
+
+    uint32_t size() const {
+        return lu.rows;
+    }
+
+    //Combined factors, L strictly below the diagonal and U on and above it
+    const Matrix<T> &getLU() const {
+        return lu;
+    }
+
+    //pivots[k] is the row interchanged with row k at step k
+    const vector<uint32_t> &getPivots() const {
+        return pivots;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns U, which is the row echelon form of A that partial pivoting elimination produces
+    Matrix<T> getU() const {
+        Matrix<T> upper(lu.rows, lu.columns);
+        for(uint32_t r = 0; r < lu.rows; r++) {
+            const T *luRow = lu.rowPtr(r);
+            T *upperRow = upper.rowPtr(r);
+            for(uint32_t c = r; c < lu.columns; c++) {
+                upperRow[c] = luRow[c];
+            }
+        }
+        return upper;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns det(A), the product of U's diagonal with the sign of the row permutation
+    T determinant() const {
+        T det = (T)sign;
+        for(uint32_t k = 0; k < lu.rows; k++) {
+            det *= lu(k,k);
+        }
+        return det;
+    }
+
+    //REQUIRES: the factorization is not singular, B has size() rows
+    //MODIFIES: Nothing
+    //EFFECTS: Returns X such that A * X = B, each column of B is one right hand side
+    Matrix<T> solve(const Matrix<T> &B) const {
+        Matrix<T> X(B);
+        solveInPlace(X);
+        return X;
+    }
+
+    //REQUIRES: the factorization is not singular, b has size() entries
+    //MODIFIES: Nothing
+    //EFFECTS: Returns x such that A * x = b
+    vector<T> solve(const vector<T> &b) const {
+        assert(!singular && b.size() == lu.rows);
+        const uint32_t n = lu.rows;
+        vector<T> x(b);
+        for(uint32_t k = 0; k < n; k++) {
+            swap(x[k], x[pivots[k]]);
+        }
+        for(uint32_t i = 0; i < n; i++) { //forward substitution with unit diagonal L
+            const T *luRow = lu.rowPtr(i);
+            T sum = x[i];
+            for(uint32_t j = 0; j < i; j++) {
+                sum -= luRow[j] * x[j];
+            }
+            x[i] = sum;
+            countFlops(2 * (uint64_t)i);
+        }
+        for(uint32_t i = n - 1; i < n; i--) { //back substitution with U, rolls over after zero
+            const T *luRow = lu.rowPtr(i);
+            T sum = x[i];
+            for(uint32_t j = i + 1; j < n; j++) {
+                sum -= luRow[j] * x[j];
+            }
+            x[i] = sum / luRow[i];
+            countFlops(2 * (uint64_t)(n - i - 1) + 1);
+        }
+        return x;
+    }
+
+    //REQUIRES: the factorization is not singular, B has size() rows, firstCol <= B.columns
+    //MODIFIES: B
+    //EFFECTS: Overwrites columns [firstCol, B.columns) of B with the solution X of A * X = B for those columns,
+    //         working on whole rows of B at a time, the columns before firstCol only follow the row interchanges
+    //         (so a system can be solved inside the matrix it is returned in)
+    void solveInPlace(Matrix<T> &B, uint32_t firstCol = 0) const {
+        assert(!singular && B.rows == lu.rows && firstCol <= B.columns);
+        const uint32_t n = lu.rows;
+        const uint32_t width = B.columns - firstCol;
+        for(uint32_t k = 0; k < n; k++) {
+            if(pivots[k] != k) {
+                B.interchangeRows(k, pivots[k]);
+            }
+        }
+        for(uint32_t i = 0; i < n; i++) { //forward substitution, row_i -= L(i,j) * row_j
+            const T *luRow = lu.rowPtr(i);
+            T *bRow = B.rowPtr(i) + firstCol;
+            for(uint32_t j = 0; j < i; j++) {
+                const T coef = luRow[j];
+                if(coef != 0) {
+                    rowSubtractScaled(bRow, B.rowPtr(j) + firstCol, coef, width);
+                    countFlops(2 * (uint64_t)width);
+                }
+            }
+        }
+        for(uint32_t i = n - 1; i < n; i--) { //back substitution, rolls over after zero
+            const T *luRow = lu.rowPtr(i);
+            T *bRow = B.rowPtr(i) + firstCol;
+            for(uint32_t j = i + 1; j < n; j++) {
+                const T coef = luRow[j];
+                if(coef != 0) {
+                    rowSubtractScaled(bRow, B.rowPtr(j) + firstCol, coef, width);
+                    countFlops(2 * (uint64_t)width);
+                }
+            }
+            rowDivide(bRow, luRow[i], width);
+            countFlops(width);
+        }
+    }
+
+    //REQUIRES: the factorization is not singular
+    //MODIFIES: Nothing
+    //EFFECTS: Returns A^-1 by solving against the identity
+    Matrix<T> inverse() const {
+        if(lu.rows >= 1 && lu.rows <= FIXED_MAX_SIZE) {
+            Matrix<T> result;
+            dispatchFixedSize(lu.rows, [&](auto size) {
+                result = fixedFactors<size()>().inverse();
+            });
+            countFlops(4 * (uint64_t)lu.rows * lu.rows * lu.rows / 3);
+            result.determinant = 1 / determinant();
+            return result;
+        }
+        Matrix<T> identity(lu.rows, lu.rows);
+        for(uint32_t diag = 0; diag < lu.rows; diag++) {
+            identity(diag,diag) = 1;
+        }
+        solveInPlace(identity);
+        identity.determinant = 1 / determinant();
+        return identity;
+    }
+
+private:
+    Matrix<T> lu;
+    vector<uint32_t> pivots;
+    int sign = 1;
+    bool singular = false;
+
+    //REQUIRES: lu holds A, blockSize >= 1
+    //MODIFIES: lu, pivots, sign, singular
+    //EFFECTS: Right-looking blocked LU, for each panel of blockSize columns:
+    //         factor the panel, solve for the matching block row of U, then update the trailing submatrix with
+    //         one GEMM (which runs on the thread pool when it is large)
+    void factor(uint32_t blockSize) {
+        const uint32_t n = lu.rows;
+        if(n >= 1 && n <= FIXED_MAX_SIZE && n <= blockSize) { //one unblocked panel, unrolled
+            dispatchFixedSize(n, [&](auto size) {
+                factorFixed<size()>();
+            });
+            return;
+        }
+        const Matrix<T> &factors = lu;
+        for(uint32_t k0 = 0; k0 < n; k0 += blockSize) {
+            const uint32_t kb = min(blockSize, n - k0);
+            const uint32_t trailing = n - k0 - kb;
+            factorPanel(k0, kb);
+            if(trailing == 0) {
+                continue;
+            }
+            solvePanelRows(k0, kb);
+            gemm<T>(-1, subBlock(factors, k0 + kb, k0, trailing, kb), subBlock(factors, k0, k0 + kb, kb, trailing),
+                    1, subBlock(lu, k0 + kb, k0 + kb, trailing, trailing));
+        }
+    }
+
+    //REQUIRES: lu holds A, which is N x N
+    //MODIFIES: lu, pivots, sign, singular
+    //EFFECTS: Factors lu with FixedLU, which eliminates exactly like factorPanel(0, N)
+    template<uint32_t N>
+    void factorFixed() {
+        const FixedLU<T, N> small{FixedMatrix<T, N, N>(lu)};
+        lu = small.getLU();
+        for(uint32_t k = 0; k < N; k++) {
+            pivots[k] = small.getPivots()[k];
+        }
+        sign = small.getSign();
+        singular = small.isSingular();
+        countFlops(2 * (uint64_t)N * N * N / 3);
+    }
+
+    //REQUIRES: the factorization is N x N
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the factorization as a FixedLU
+    template<uint32_t N>
+    FixedLU<T, N> fixedFactors() const {
+        return FixedLU<T, N>(FixedMatrix<T, N, N>(lu), pivots.data(), sign, singular);
+    }
+
+    //REQUIRES: columns before k0 are factored and applied to the rest of lu
+    //MODIFIES: lu, pivots, sign, singular
+    //EFFECTS: Unblocked elimination with partial pivoting of columns [k0, k0 + kb) over rows [k0, n)
+    //         Row interchanges swap whole rows in O(1) so the columns outside the panel follow along
+    void factorPanel(uint32_t k0, uint32_t kb) {
+        const uint32_t n = lu.rows;
+        for(uint32_t k = k0; k < k0 + kb; k++) {
+            uint32_t pivotRow = k;
+            T largest = abs(lu(k,k));
+            for(uint32_t r = k + 1; r < n; r++) {
+                if(abs(lu(r,k)) > largest) {
+                    largest = abs(lu(r,k));
+                    pivotRow = r;
+                }
+            }
+            pivots[k] = pivotRow;
+            if(pivotRow != k) {
+                lu.interchangeRows(k, pivotRow);
+                sign = -sign;
+            }
+            if(largest == 0) { //whole column is zero below the diagonal, nothing to eliminate
+                singular = true;
+                continue;
+            }
+
+            const T *pivotRowPtr = lu.rowPtr(k);
+            const T pivot = pivotRowPtr[k];
+            for(uint32_t r = k + 1; r < n; r++) {
+                T *row = lu.rowPtr(r);
+                const T multiplier = row[k] / pivot;
+                row[k] = multiplier;
+                if(multiplier != 0) {
+                    rowSubtractScaled(row + k + 1, pivotRowPtr + k + 1, multiplier, k0 + kb - k - 1);
+                }
+                countFlops(1 + 2 * (uint64_t)(k0 + kb - k - 1));
+            }
+        }
+    }
+
+    //REQUIRES: the panel at k0 is factored
+    //MODIFIES: lu
+    //EFFECTS: Replaces rows [k0, k0 + kb) right of the panel with L11^-1 times themselves, giving that block row of U
+    void solvePanelRows(uint32_t k0, uint32_t kb) {
+        const uint32_t n = lu.rows;
+        for(uint32_t i = k0 + 1; i < k0 + kb; i++) {
+            T *row = lu.rowPtr(i);
+            for(uint32_t j = k0; j < i; j++) {
+                const T coef = row[j];
+                if(coef != 0) {
+                    rowSubtractScaled(row + k0 + kb, lu.rowPtr(j) + k0 + kb, coef, n - k0 - kb);
+                    countFlops(2 * (uint64_t)(n - k0 - kb));
+                }
+            }
+        }
+    }
+};
+
+//REQUIRES: A is square, B and X are A.rows x B.columns, X does not overlap A or B, Low is a floating point type
+//          narrower than T
+//MODIFIES: X
+//EFFECTS: Solves A * X = B by mixed precision iterative refinement: A is factored in Low (half the memory traffic
+//         and twice the elements per vector of T for float and double), then each step computes the residual
+//         R = B - A * X in T and adds the correction A^-1 * R solved through the Low factors
+//         X is written in place, so it can be the block of the result the solution is printed from
+//         Stops once every column satisfies ||r||_inf <= ||x||_inf * ||A||_inf * eps * sqrt(n) with eps of T,
+//         the backward error of a factorization in T (the test LAPACK's dsgesv uses), and returns true
+//         Returns false, leaving X undefined, if A has an element outside the range of Low, a pivot of the Low
+//         factors is below ||A||_inf * eps of Low (A is singular as far as Low can tell) or the steps do not
+//         converge (A is too ill conditioned for Low), the caller then factors in T
+template<typename Low, typename T>
+bool solveRefined(const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B,
+                  const MatrixBlock<Matrix<T>> &X, uint32_t blockSize = LU_DEFAULT_BLOCK_SIZE) {
+    assert(A.rows == A.columns && B.rows == A.rows && X.rows == B.rows && X.columns == B.columns);
+    const uint32_t n = A.rows;
+    const uint32_t width = B.columns;
+    const ScratchScope scratch; //the Low factors, the residual and the correction, X is the caller's
+    Matrix<Low> lowA(n, n);
+    T normA = 0;
+    for(uint32_t r = 0; r < n; r++) {
+        const T *row = A.rowPtr(r);
+        Low *lowRow = lowA.rowPtr(r);
+        T rowSum = 0;
+        for(uint32_t c = 0; c < n; c++) {
+            if(!(abs(row[c]) <= (T)numeric_limits<Low>::max())) { //NaN fails the test as well
+                return false;
+            }
+            lowRow[c] = (Low)row[c];
+            rowSum += abs(row[c]);
+        }
+        normA = max(normA, rowSum);
+    }
+    const LUFactorization<Low> lu(move(lowA), blockSize);
+    if(lu.isSingular()) {
+        return false;
+    }
+    for(uint32_t k = 0; k < n; k++) { //singular to Low's precision, refinement could settle on another solution
+        if(abs((T)lu.getLU()(k,k)) <= normA * (T)numeric_limits<Low>::epsilon()) {
+            return false;
+        }
+    }
+
+    Matrix<Low> correction(n, width);
+    Matrix<T> residual(n, width);
+    for(uint32_t r = 0; r < n; r++) {
+        memset(X.rowPtr(r), 0, width * sizeof(T));
+    }
+    const MatrixBlock<const Matrix<T>> solution{X.mat, X.row, X.col, X.rows, X.columns};
+    const T tolerance = normA * numeric_limits<T>::epsilon() * sqrt((T)n);
+    for(uint32_t step = 0; step <= MIXED_SOLVE_MAX_STEPS; step++) {
+        for(uint32_t r = 0; r < n; r++) { //residual = B - A * X, the whole of B while X is still zero
+            memcpy(residual.rowPtr(r), B.rowPtr(r), width * sizeof(T));
+        }
+        if(step > 0) {
+            if(width >= GEMM_NR) {
+                gemm<T>(-1, A, solution, 1, wholeBlock(residual));
+            }
+            else { //a few right hand sides, dot products over the rows of A skip packing A for a sliver of B
+                for(uint32_t r = 0; r < n; r++) {
+                    const T *aRow = A.rowPtr(r);
+                    for(uint32_t c = 0; c < width; c++) {
+                        T dot = 0;
+                        for(uint32_t k = 0; k < n; k++) {
+                            dot += aRow[k] * X.rowPtr(k)[c];
+                        }
+                        residual(r,c) -= dot;
+                    }
+                }
+                countFlops(2 * (uint64_t)n * n * width);
+            }
+            bool converged = true;
+            for(uint32_t c = 0; c < width && converged; c++) {
+                T largestR = 0;
+                T largestX = 0;
+                for(uint32_t r = 0; r < n; r++) {
+                    largestR = max(largestR, abs(residual(r,c)));
+                    largestX = max(largestX, abs(X.rowPtr(r)[c]));
+                }
+                converged = largestR <= largestX * tolerance;
+            }
+            if(converged) {
+                return true;
+            }
+            if(step == MIXED_SOLVE_MAX_STEPS) {
+                break;
+            }
+        }
+        for(uint32_t r = 0; r < n; r++) {
+            const T *residualRow = residual.rowPtr(r);
+            Low *correctionRow = correction.rowPtr(r);
+            for(uint32_t c = 0; c < width; c++) {
+                correctionRow[c] = (Low)residualRow[c];
+            }
+        }
+        lu.solveInPlace(correction);
+        for(uint32_t r = 0; r < n; r++) {
+            T *xRow = X.rowPtr(r);
+            const Low *correctionRow = correction.rowPtr(r);
+            for(uint32_t c = 0; c < width; c++) {
+                xRow[c] += (T)correctionRow[c];
+            }
+        }
+        countFlops((uint64_t)n * width);
+    }
+    return false;
+}
+
+#endif
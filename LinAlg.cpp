@@ -1,38 +1,196 @@
 #include "LinAlg.h"
 #include <getopt.h>
+#include <unistd.h>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <deque>
+#include <cmath>
+#include <algorithm>
 
 //TODO: Command line processing not needed for now, will later add precision option for the command line
 // Process command line arguments
 //REQUIRES: Nothing
 //MODIFIES: Nothing
 //EFFECTS: Prints helpful information regarding the program to cout
-void LinearAlgebra::printHelp() {
+template<typename T>
+void LinearAlgebra<T>::printHelp() {
     cout << "This program will read in a matrix and perform specified operations\n";
     cout << "It will then output requested information about the new matrix\n";
     cout << "The --operations flag will perform specified operations on the input matrices\n";
     cout << "The --information flag will give information about the one input matrix\n";
+    cout << "The -p/--precision [num] flag sets the number of output decimal places, default 2\n";
+    cout << "The -j/--threads [num] flag sets the number of threads used for large operations, default one per core\n";
+    cout << "The -b/--block-size [num] flag sets the panel width of the blocked LU factorization, default 96\n";
+    cout << "The -f/--format [text|binary] flag selects the output format, binary writes a matrix file, default text\n";
+    cout << "The --strassen [size|off] flag sets the smallest product the * operand computes by Strassen-Winograd, default 1024\n";
+    cout << "The --spaces [rref|qr] flag selects what the row, column and null spaces are computed from, default rref\n";
+    cout << "The --dtype [float|double] flag sets the element type matrices are stored and computed in, default double\n";
+    cout << "The --stats[=text|json] flag reports time, flops and allocations per command and per matrix to stderr\n";
+    cout << "The --stats-file [path] flag writes the --stats report to path instead of stderr\n";
+    cout << "The --stream flag reads, computes and prints one matrix or operand chain at a time, in bounded memory\n";
+    cout << "The --tile-memory [MB] flag stores dense matrices larger than MB on disk in tiles, cached in MB of memory\n";
+    cout << "The --tile-size [num] flag sets the rows and columns of a tile, default 1024\n";
+    cout << "The --tile-dir [path] flag sets where tiles are stored, default $TMPDIR or /tmp\n";
+    cout << "The --check-allocations flag (debug builds) fails if a command allocates more matrices than its results\n";
     cout << "The --help flag will give information about program functionality and command-line flags\n";
 }
 
+//REQUIRES: argc, argv are valid
+//MODIFIES: Nothing
+//EFFECTS: Returns the element type given with --dtype (the last one if it is repeated), double without one
+//         An invalid type is left for getMode to report
+ScalarType scalarTypeOf(int argc, char *argv[]) {
+    ScalarType type = ScalarType::Double;
+    for(int a = 1; a < argc; a++) {
+        const string arg = argv[a];
+        string value;
+        if(arg == "--dtype" && a + 1 < argc) {
+            value = argv[++a];
+        }
+        else if(arg.compare(0, 8, "--dtype=") == 0) {
+            value = arg.substr(8);
+        }
+        else {
+            continue;
+        }
+        type = value == "float" ? ScalarType::Float : ScalarType::Double;
+    }
+    return type;
+}
+
 //REQUIRES: argc, argv are valid
 //MODIFIES: 
 //EFFECTS:
-void LinearAlgebra::getMode(int argc, char * argv[]) {
+template<typename T>
+void LinearAlgebra<T>::getMode(int argc, char * argv[]) {
     // These are used with getopt_long()
     opterr = false; // Let us handle all error output for command line options
     int choice;
     int option_index = 0;
     option long_options[] = {
         {"precision",    required_argument, nullptr, 'p'  },
+        {"threads",      required_argument, nullptr, 'j'  },
+        {"block-size",   required_argument, nullptr, 'b'  },
+        {"format",       required_argument, nullptr, 'f'  },
+        {"dtype",        required_argument, nullptr, 'd'  },
+        {"spaces",       required_argument, nullptr, 'q'  },
+        {"strassen",     required_argument, nullptr, 'w'  },
+        {"stats",        optional_argument, nullptr, 's'  },
+        {"stats-file",   required_argument, nullptr, 'S'  },
+        {"stream",       no_argument,       nullptr, 'r'  },
+        {"tile-memory",  required_argument, nullptr, 'M'  },
+        {"tile-size",    required_argument, nullptr, 'T'  },
+        {"tile-dir",     required_argument, nullptr, 'D'  },
+        {"check-allocations", no_argument,  nullptr, 'A'  },
         {"help",         no_argument,       nullptr, 'h'  },
         {nullptr,        0,                 nullptr, '\0' }
     };
 
-    while ((choice = getopt_long(argc, argv, "oih", long_options, &option_index)) != -1) {
+    while ((choice = getopt_long(argc, argv, "p:j:b:f:oih", long_options, &option_index)) != -1) {
         switch (choice) {
             case 'p':
                 precision = (uint32_t)atoi(optarg);
                 break;
+            case 'j':
+                if(atoi(optarg) < 1) {
+                    cerr << "Thread count must be at least 1\n";
+                    exit(1);
+                }
+                ThreadPool::instance().resize((uint32_t)atoi(optarg));
+                break;
+            case 'b':
+                if(atoi(optarg) < 1) {
+                    cerr << "Block size must be at least 1\n";
+                    exit(1);
+                }
+                luBlockSize = (uint32_t)atoi(optarg);
+                break;
+            case 'f':
+                if(string(optarg) == "binary") {
+                    binaryOutput = true;
+                    messages = &cerr; //keep stdout a valid matrix file
+                }
+                else if(string(optarg) != "text") {
+                    cerr << "Output format must be text or binary\n";
+                    exit(1);
+                }
+                break;
+            case 'd': //already picked the engine's T (scalarTypeOf), only checked here
+                if(string(optarg) != "float" && string(optarg) != "double") {
+                    cerr << "Element type must be float or double\n";
+                    exit(1);
+                }
+                break;
+            case 'w':
+                if(string(optarg) == "off") {
+                    strassenCrossover = STRASSEN_OFF;
+                }
+                else if(atoi(optarg) < 2) {
+                    cerr << "Strassen crossover must be at least 2 or off\n";
+                    exit(1);
+                }
+                else {
+                    strassenCrossover = (uint32_t)atoi(optarg);
+                }
+                break;
+            case 'q':
+                if(string(optarg) == "qr") {
+                    spaceBackend = SpaceBackend::Qr;
+                }
+                else if(string(optarg) != "rref") {
+                    cerr << "Space backend must be rref or qr\n";
+                    exit(1);
+                }
+                break;
+            case 's':
+                if(optarg == nullptr || string(optarg) == "text") {
+                    statsFormat = StatsFormat::Text;
+                }
+                else if(string(optarg) == "json") {
+                    statsFormat = StatsFormat::Json;
+                }
+                else {
+                    cerr << "Stats format must be text or json\n";
+                    exit(1);
+                }
+                break;
+            case 'S':
+                statsFile = optarg;
+                if(statsFormat == StatsFormat::None) {
+                    statsFormat = StatsFormat::Text;
+                }
+                break;
+            case 'r':
+                streaming = true;
+                break;
+            case 'M':
+                if(atoi(optarg) < 1) {
+                    cerr << "Tile memory must be at least 1 MB\n";
+                    exit(1);
+                }
+                tileMemory = (size_t)atoi(optarg) << 20;
+                break;
+            case 'T':
+                if(atoi(optarg) < 1) {
+                    cerr << "Tile size must be at least 1\n";
+                    exit(1);
+                }
+                //every row of a tile starts aligned (TILE_SIZE_STEP)
+                tileSize = ((uint32_t)atoi(optarg) + TILE_SIZE_STEP - 1) / TILE_SIZE_STEP * TILE_SIZE_STEP;
+                break;
+            case 'D':
+                tileDirectory = optarg;
+                break;
+            case 'A':
+#ifdef DEBUG
+                checkAllocations = true;
+                break;
+#else
+                cerr << "--check-allocations needs a debug build (make debug)\n";
+                exit(1);
+#endif
             case 'h':
                 printHelp();
                 exit(0);
@@ -44,184 +202,1218 @@ void LinearAlgebra::getMode(int argc, char * argv[]) {
             } // switch
     } // while
 
-    cout << std::setprecision(precision); //Set number of output decimal places
-    cout << std::fixed(); //Disable scientific notation
+    if(streaming && binaryOutput) {
+        cerr << "--stream writes text only, a matrix file is laid out once every result is known\n";
+        exit(1);
+    }
+    if(tileMemory > 0) {
+        if(tileDirectory.empty()) {
+            const char *tmp = getenv("TMPDIR");
+            tileDirectory = tmp != nullptr && *tmp != '\0' ? tmp : "/tmp";
+        }
+        tileCache.reset(new TileCache(tileMemory, tileDirectory));
+    }
+    out.setPrecision(precision); //Set number of output decimal places
+    *messages << std::setprecision(precision); //Matrices in messages match the results
+    *messages << std::fixed; //Disable scientific notation
+}
+
+//REQUIRES: stdin holds input in the text or binary format described in README.md
+//MODIFIES: matrices, analyses, commands, numMatrices, matrixFile, reader
+//EFFECTS: Reads every matrix and its command, parsing the elements straight into each matrix's buffer
+//         Malformed input (bad numbers, too few or too many elements) is reported with its line and column
+//         A binary matrix file is mapped instead and its matrices view the mapping, nothing is parsed or copied
+template<typename T>
+void LinearAlgebra<T>::getInput() {
+    const auto phaseStart = chrono::steady_clock::now();
+    openInput();
+    matrices.reserve(inputCount);
+    for(uint32_t count = 0; count < inputCount; count++) {
+        readNextMatrix(count);
+    }
+    checkInputEnd();
+    reader.reset(); //unmaps text input, a matrix file stays mapped while its matrices view it
+    parsePhaseSeconds += secondsSince(phaseStart);
 }
 
-void LinearAlgebra::getInput() {
-    uint32_t row;
-    uint32_t col;
-    uint32_t count = 0;
-    
-    cin >> numMatrices;
-    commands.reserve(numMatrices);
-    matrices.resize(numMatrices, vector<Matrix<double>>());
-    while(cin >> row >> col) {
-        matrices[count].emplace_back(row,col,cin); //don't copy the matrix, construct it in place
-        cin >> commands[count];
+//REQUIRES: stdin holds input in the text or binary format described in README.md
+//MODIFIES: matrixFile, reader, inputCount
+//EFFECTS: Maps a binary matrix file or starts reading text input, and reads the number of matrices it holds
+template<typename T>
+void LinearAlgebra<T>::openInput() {
+    if(MatrixFileReader::isMatrixFile(STDIN_FILENO)) {
+        matrixFile.reset(new MatrixFileReader(STDIN_FILENO));
+        inputCount = matrixFile->count();
+    }
+    else {
+        reader.reset(new InputReader(STDIN_FILENO));
+        inputCount = reader->readCount("number of matrices");
     }
 }
 
-void LinearAlgebra::processCommands() {
-    for(uint32_t c = 0; c < numMatrices; c++) {
-        if(commands[c] == "All") {
-            for(uint32_t i = 0; i < 7; i++) { //Need 7 new copies
-                matrices[c].emplace_back(matrices[c][0]);
+//REQUIRES: openInput has run, index < inputCount is the next matrix of the input
+//MODIFIES: matrices, sparseMatrices, commands, analyses, batches, batchOf, stats, numMatrices, reader
+//EFFECTS: Reads input matrix index and its command and appends it as the next matrix of the engine
+template<typename T>
+void LinearAlgebra<T>::readNextMatrix(uint32_t index) {
+    const uint32_t count = numMatrices++;
+    commands.emplace_back();
+    sparseMatrices.emplace_back();
+    tiledMatrices.emplace_back();
+    analyses.emplace_back();
+    batchOf.push_back(NO_BATCH);
+    if(statsFormat != StatsFormat::None) {
+        stats.emplace_back();
+    }
+    measure(count, &MatrixStats::parseSeconds, [&] {
+        if(matrixFile) {
+            Matrix<T> mat = matrixFile->template matrix<T>(index);
+            commands[count] = matrixFile->command(index);
+            if(tiles(mat.rows, mat.columns)) { //its pages of the mapping are given back once it is in tiles
+                tiledMatrices[count].reset(new TiledMatrix<T>(toTiled(mat, tileSize, *tileCache)));
+                matrixFile->release(index, index + 1);
+                matrices.emplace_back();
+                return;
             }
+            if(!addToBatch(mat, count)) {
+                matrices.push_back(move(mat));
+            }
+            return;
+        }
+        InputReader &input = *reader;
+        if(input.readKeyword("Sparse")) { //Sparse [Rows] [Columns] [Nonzeros], then "row col value" triplets
+            uint32_t row = input.readCount("row count");
+            uint32_t col = input.readCount("column count");
+            uint32_t nonzeros = input.readCount("nonzero count");
+            matrices.emplace_back();
+            sparseMatrices[count].reset(new SparseMatrix<T>(
+                input.readSparseMatrix<T>(row, col, nonzeros, index)));
+            commands[count] = input.readWord("command");
+            return;
+        }
+        uint32_t row = input.readCount("row count");
+        uint32_t col = input.readCount("column count");
+        if(tiles(row, col)) {
+            matrices.emplace_back();
+            tiledMatrices[count].reset(new TiledMatrix<T>(readTiled(row, col, index)));
+            commands[count] = input.readWord("command");
+            return;
+        }
+        if(!batchableShape(row, col, count)) { //no command can batch it, it is parsed where it is kept
+            matrices.emplace_back(row,col);
+            input.readMatrix(matrices[count], index);
+            commands[count] = input.readWord("command");
+            return;
+        }
+        //Whether it joins a batch is up to its command, which follows it, so it is parsed into batchInput and
+        //moved to matrices if it does not
+        if(batchInput.rows != row || batchInput.columns != col) {
+            batchInput = Matrix<T>(row,col);
+        }
+        input.readMatrix(batchInput, index);
+        commands[count] = input.readWord("command");
+        if(!addToBatch(batchInput, count)) {
+            matrices.push_back(move(batchInput));
+        }
+    });
+}
 
-            subtractDown(matrices[c][1], 0, 0, matrices[c][1].columns); //REF
-            matrices[c][2] = matrices[c][1]; //copy REF before converting to RREF
+//REQUIRES: every matrix of the input has been read
+//MODIFIES: cerr
+//EFFECTS: Warns if text input continues after the matrices it announced
+template<typename T>
+void LinearAlgebra<T>::checkInputEnd() {
+    if(reader && !reader->atEnd()) {
+        cerr << "Warning: input continues after the " << inputCount << " matrices announced, the rest is ignored\n";
+    }
+}
 
-            subtractUp(matrices[c][2], 0, matrices[c][2].columns); //RREF
+//REQUIRES: getMode has run
+//MODIFIES: everything getInput, processCommands and printInformation modify
+//EFFECTS: Runs the input one window at a time, as --stream asks: a window is read, computed, printed and freed
+//         before the next one is read, so memory is bounded by the largest window instead of the whole input
+//         A window ends after a matrix whose command is not an operand, so an operand chain is always one window,
+//         except that a run of batched matrices goes on until its batch is full or another batch starts
+//         With --stats every matrix's stats and command are kept for printStats
+template<typename T>
+void LinearAlgebra<T>::streamInput() {
+    openInput();
+    vector<MatrixStats> streamedStats;
+    vector<string> streamedCommands;
+    for(uint32_t next = 0; next < inputCount;) {
+        const auto readStart = chrono::steady_clock::now();
+        indexBase = next;
+        do {
+            readNextMatrix(next++);
+        } while(next < inputCount && windowContinues());
+        if(reader) {
+            reader->releaseParsed();
+        }
+        parsePhaseSeconds += secondsSince(readStart);
+        processCommands();
+        printInformation();
+        if(statsFormat != StatsFormat::None) {
+            streamedStats.insert(streamedStats.end(), stats.begin(), stats.end());
+            streamedCommands.insert(streamedCommands.end(), make_move_iterator(commands.begin()),
+                                    make_move_iterator(commands.end()));
+        }
+        if(matrixFile) {
+            matrixFile->release(indexBase, next);
+        }
+        matrices.clear(); //printInformation has released everything they held
+        sparseMatrices.clear();
+        tiledMatrices.clear();
+        commands.clear();
+        analyses.clear();
+        arenas.clear();
+        batches.clear();
+        batchOf.clear();
+        stats.clear();
+        numMatrices = 0;
+    }
+    checkInputEnd();
+    reader.reset();
+    indexBase = 0; //printStats reports the whole input
+    numMatrices = inputCount;
+    stats = move(streamedStats);
+    commands = move(streamedCommands);
+}
 
-            transpose(matrices[c][3]); //Transpose
+//REQUIRES: numMatrices > 0
+//MODIFIES: Nothing
+//EFFECTS: Returns whether the window streamInput is reading needs the next matrix too: the last one is an operand,
+//         or it is in the window's only batch and that batch is not full
+template<typename T>
+bool LinearAlgebra<T>::windowContinues() const {
+    const uint32_t last = numMatrices - 1;
+    return isOperand(commands[last]) || (batchOf[last] != NO_BATCH && batches.size() == 1
+                                         && batches.back().inputs.size() < BATCH_MAX_SIZE);
+}
 
-            if(matrices[c][0].rows == matrices[c][0].columns) { //square matrix
-                inverse(matrices[c][4]); //Inverse
-            }
+//REQUIRES: Nothing
+//MODIFIES: matrices, analyses, commands, numMatrices, stats
+//EFFECTS: Appends mat with its command as the next input matrix, as if it had been read by getInput
+template<typename T>
+void LinearAlgebra<T>::addMatrix(Matrix<T> mat, const string &command) {
+    matrices.push_back(move(mat));
+    sparseMatrices.emplace_back();
+    tiledMatrices.emplace_back();
+    batchOf.push_back(NO_BATCH);
+    commands.push_back(command);
+    analyses.emplace_back();
+    if(statsFormat != StatsFormat::None) {
+        stats.emplace_back();
+    }
+    numMatrices++;
+}
 
-            findRowSpace(matrices[c][5]);
-            findColSpace(matrices[c][6]);
-            findNullSpace(matrices[c][7]);
-        }
-        else if(commands[c] == "REF") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            subtractDown(matrices[c][1], 0, 0, matrices[c][1].columns);
-        }
-        else if(commands[c] == "RREF") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            subtractDown(matrices[c][1], 0, 0, matrices[c][1].columns);
-            subtractUp(matrices[c][1], 0, matrices[c][1].columns);
-        }
-        else if(commands[c] == "Transpose") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            transpose(matrices[c][1]);
-        }
-        else if(commands[c] == "Inverse") {
-            if(matrices[c][0].rows == matrices[c][0].columns) { //Square
-                matrices[c].resize(2);
-                matrices[c][1] = matrices[c][0];
-                inverse(matrices[c][1]);
-            }
-            else {
-                cout << "Invalid command for input matrix " << c << ", matrix is not square\n";
-                cout << "Original Matrix:\n" << matrices[c][0] << "\n";
-            }
+//REQUIRES: Nothing
+//MODIFIES: matrices, sparseMatrices, analyses, commands, numMatrices, stats
+//EFFECTS: Appends mat with its command as the next input matrix, kept sparse as if it had been read in coordinate form
+template<typename T>
+void LinearAlgebra<T>::addMatrix(SparseMatrix<T> mat, const string &command) {
+    addMatrix(Matrix<T>(), command);
+    sparseMatrices.back().reset(new SparseMatrix<T>(move(mat)));
+}
+
+//REQUIRES: commands[m - 1] has been read if m > 0
+//MODIFIES: Nothing
+//EFFECTS: Returns whether a dense numRows x numCols input matrix m may be computed by the batch kernels, before its
+//         own command is known: it has at most FIXED_MAX_SIZE rows and columns and no operand changes it first
+template<typename T>
+bool LinearAlgebra<T>::batchableShape(uint32_t numRows, uint32_t numCols, uint32_t m) const {
+    return numRows != 0 && numCols != 0 && numRows <= FIXED_MAX_SIZE && numCols <= FIXED_MAX_SIZE
+           && !(m > 0 && isOperand(commands[m - 1]));
+}
+
+//REQUIRES: commands[m] has been read
+//MODIFIES: Nothing
+//EFFECTS: Returns whether input matrix m, with the values of mat, is computed by the batch kernels: a matrix of
+//         batchableShape to transpose, to invert or to solve for one right-hand side
+//         Inverse and Solve also need the matrix to fit one LU panel, so that the batch kernels eliminate exactly
+//         like getInverse and getSolution would (FixedLU)
+template<typename T>
+bool LinearAlgebra<T>::batchable(const Matrix<T> &mat, uint32_t m) const {
+    const string &command = commands[m];
+    if(!batchableShape(mat.rows, mat.columns, m)) {
+        return false;
+    }
+    if(command == "Transpose") {
+        return true;
+    }
+    if(command == "Inverse") {
+        return mat.columns == mat.rows && mat.rows <= luBlockSize;
+    }
+    return command == "Solve" && mat.columns == mat.rows + 1 && mat.rows <= luBlockSize;
+}
+
+//REQUIRES: m == matrices.size(), commands[m] has been read
+//MODIFIES: matrices, batches, batchOf
+//EFFECTS: If input matrix m is batchable, appends a copy of mat to the last batch if it holds m - 1 with the same
+//         shape and command and is not full (BATCH_MAX_SIZE), otherwise to a new batch, stores an empty Matrix as
+//         matrices[m] and returns true
+//         Otherwise stores nothing and returns false
+template<typename T>
+bool LinearAlgebra<T>::addToBatch(const Matrix<T> &mat, uint32_t m) {
+    if(!batchable(mat, m)) {
+        return false;
+    }
+    const bool extends = m > 0 && batchOf[m - 1] != NO_BATCH && commands[m - 1] == commands[m]
+                         && batches.back().inputs.getRows() == mat.rows
+                         && batches.back().inputs.getCols() == mat.columns
+                         && batches.back().inputs.size() < BATCH_MAX_SIZE;
+    if(!extends) {
+        batches.emplace_back();
+        batches.back().first = m;
+        batches.back().inputs = MatrixBatch<T>(mat.rows, mat.columns);
+    }
+    batches.back().inputs.append(mat);
+    batchOf[m] = (uint32_t)batches.size() - 1;
+    matrices.emplace_back();
+    return true;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns whether a dense numRows x numCols input matrix is stored in tiles on disk instead of in memory:
+//         there is a --tile-memory and its elements alone take more than that
+template<typename T>
+bool LinearAlgebra<T>::tiles(uint32_t numRows, uint32_t numCols) const {
+    return tileCache && (uint64_t)numRows * numCols * sizeof(T) > tileMemory;
+}
+
+//REQUIRES: the next elements of the text input are the numRows x numCols input matrix index
+//MODIFIES: reader, the tile cache
+//EFFECTS: Parses the matrix straight into tiles, one tile row at a time, and gives the parsed pages of the input
+//         back as it goes, so neither the matrix nor its text is ever held in memory as a whole
+template<typename T>
+TiledMatrix<T> LinearAlgebra<T>::readTiled(uint32_t numRows, uint32_t numCols, uint32_t index) {
+    MatrixArena::Scope heap(nullptr);
+    TiledMatrix<T> tiled(numRows, numCols, tileSize, *tileCache);
+    Matrix<T> band(min(tileSize, numRows), numCols);
+    for(uint32_t first = 0; first < numRows; first += band.rows) {
+        const uint32_t count = min(band.rows, numRows - first);
+        reader->readRows(band, first, count, numRows, index);
+        tiled.storeRows(first, band, 0, count);
+        reader->releaseParsed();
+    }
+    return tiled;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: matrices, analyses, arenas, messages, stats
+//EFFECTS: Runs every command, independent matrices concurrently on the thread pool
+//         An operand (+,-,*) links matrix c to matrix c + 1, so each chain of linked matrices runs in input order
+//         on one thread while separate chains run in parallel, messages are still reported in input order
+//         Each matrix's results are allocated from its own arena, an operand works in the arena of the matrix it
+//         stores its result into so that nothing outlives its arena
+//         The batches run first, also in parallel, a batched matrix has no arena and is not part of any chain
+template<typename T>
+void LinearAlgebra<T>::processCommands() {
+    const auto phaseStart = chrono::steady_clock::now();
+    ThreadPool::instance().parallelFor((uint32_t)batches.size(), [&](uint32_t b) {
+        processBatch(b);
+    });
+    arenas.resize(numMatrices);
+    vector<uint32_t> chainStarts;
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        if(batchOf[m] != NO_BATCH) {
+            continue;
         }
-        else if(commands[c] == "RowSpace") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            findRowSpace(matrices[c][1]);
-        }
-        else if(commands[c] == "ColumnSpace") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            findColSpace(matrices[c][1]);
-        }
-        else if(commands[c] == "NullSpace") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            findNullSpace(matrices[c][1]);
-        }
-        else if(commands[c] == "Solve") {
-            matrices[c].resize(2);
-            matrices[c][1] = matrices[c][0];
-            subtractDown(matrices[c][1], 0, 0, matrices[c][1].columns - 1);
-            subtractUp(matrices[c][1], 0, matrices[c][1].columns - 1);
-        }
-        else if(commands[c] == "+") {
-            if(c < numMatrices - 1) { //not the last matrix
-                matrices[c + 1][0] = matrices[c + 1][0] + matrices[c][0];
-            }
-            else {
-                cout << "Invalid command for input Matrix " << c << ", unable to add to next matrix\n";
-                cout << "Original Matrix:\n" << matrices[c][0] << "\n";
+        //the first chunk holds a few copies of the input, most results fit
+        const size_t inputBytes = (size_t)matrices[m].rows * matrices[m].getStride() * sizeof(T);
+        arenas[m].reset(new MatrixArena(min(max(8 * inputBytes, (size_t)4096), ARENA_CHUNK_LIMIT)));
+        if(m == 0 || !isOperand(commands[m - 1])) {
+            chainStarts.push_back(m);
+        }
+    }
+
+    vector<string> notes(chainStarts.size());
+    ThreadPool::instance().parallelFor((uint32_t)notes.size(), [&](uint32_t chain) {
+        ostringstream chainNotes;
+        chainNotes << std::setprecision(precision) << std::fixed;
+        const uint32_t start = chainStarts[chain];
+        for(uint32_t c = start; c < numMatrices && (c == start || isOperand(commands[c - 1])); c++) {
+            const uint32_t owner = isOperand(commands[c]) && c + 1 < numMatrices ? c + 1 : c;
+            measure(c, &MatrixStats::computeSeconds, [&] {
+                MatrixArena::Scope scope(arenas[owner].get());
+                processCommand(c, chainNotes);
+            });
+        }
+        notes[chain] = chainNotes.str();
+    });
+    for(const string &chainNotes : notes) {
+        if(!chainNotes.empty()) {
+            out.flush(); //with --stream the results of earlier windows are still buffered, they come first
+            *messages << chainNotes;
+        }
+    }
+    computePhaseSeconds += secondsSince(phaseStart);
+    if(checkAllocations) {
+        checkCommandAllocations();
+    }
+}
+
+//REQUIRES: processCommands has run every command once
+//MODIFIES: analyses, cerr
+//EFFECTS: Runs the command of every dense input matrix again from scratch, now that the kernels, the thread pool
+//         and the arenas are warmed up, and counts the bytes of the matrices it allocates on the way (arena or
+//         heap, OpCounters::matrixBytes) on one thread, so the workers' allocations are counted too
+//         A command may allocate the results its Analysis keeps (the LU factorization included) and the workspace
+//         its algorithms declare (ScratchScope) and nothing more, a copy of the input or a result that is copied
+//         instead of moved makes it fail: every matrix that allocates more is reported to cerr and the program
+//         exits with status 1
+//         Operands are not run again (that would change the next matrix), nor are batched, sparse and tiled
+//         matrices, whose results are not Matrix objects
+template<typename T>
+void LinearAlgebra<T>::checkCommandAllocations() {
+    const uint32_t threads = ThreadPool::instance().size();
+    ThreadPool::instance().resize(1);
+    bool failed = false;
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        if(batchOf[m] != NO_BATCH || isSparse(m) || isTiled(m) || isOperand(commands[m])) {
+            continue;
+        }
+        ostringstream notes; //reported by the first run already
+        analyses[m] = Analysis();
+        const OpCounters before = opCounters;
+        {
+            MatrixArena::Scope scope(arenas[m].get());
+            processCommand(m, notes);
+        }
+        const uint64_t scratch = opCounters.scratchBytes - before.scratchBytes;
+        const uint64_t allocated = opCounters.matrixBytes - before.matrixBytes - scratch;
+        const size_t results = resultBytes(analyses[m]);
+        if(allocated > results) {
+            cerr << "Allocation check failed for input matrix " << indexBase + m << " (" << commands[m] << "): "
+                 << allocated << " bytes of matrices allocated for " << results << " bytes of results (and "
+                 << scratch << " bytes of declared workspace)\n";
+            failed = true;
+        }
+    }
+    ThreadPool::instance().resize(threads);
+    if(failed) {
+        exit(1);
+    }
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the bytes of every dense matrix analysis holds, as Matrix counts them when it allocates
+template<typename T>
+size_t LinearAlgebra<T>::resultBytes(const Analysis &analysis) {
+    size_t bytes = analysis.lu ? analysis.lu->getLU().getStorageBytes() : 0;
+    for(const unique_ptr<Matrix<T>> *result : {&analysis.ref, &analysis.rref, &analysis.transpose, &analysis.inverse,
+                                               &analysis.rowSpace, &analysis.colSpace, &analysis.nullSpace,
+                                               &analysis.solution}) {
+        bytes += *result ? (*result)->getStorageBytes() : 0;
+    }
+    return bytes;
+}
+
+//REQUIRES: c is a valid input matrix index, matrices before c in its chain have been processed
+//MODIFIES: analyses[c], matrices[c + 1] for an operand, notes
+//EFFECTS: Computes the results the command of input matrix c prints, reporting an invalid command to notes
+//         Touches nothing outside its own chain, so it can run concurrently with other chains
+template<typename T>
+void LinearAlgebra<T>::processCommand(uint32_t c, ostream &notes) {
+    if(isTiled(c) || (isOperand(commands[c]) && c + 1 < numMatrices && isTiled(c + 1))) {
+        processTiledCommand(c, notes);
+        return;
+    }
+    if((isSparse(c) || (isOperand(commands[c]) && c + 1 < numMatrices && isSparse(c + 1)))
+       && processSparseCommand(c, notes)) {
+        return;
+    }
+    const bool square = matrices[c].rows == matrices[c].columns;
+    if(commands[c] == "All") { //every result below shares one REF, RREF and factorization
+        getREF(c);
+        getRREF(c);
+        getTranspose(c);
+        if(square) {
+            getInverse(c);
+        }
+        getRowSpace(c);
+        getColSpace(c);
+        getNullSpace(c);
+    }
+    else if(commands[c] == "REF") {
+        getREF(c);
+    }
+    else if(commands[c] == "RREF") {
+        getRREF(c);
+    }
+    else if(commands[c] == "Transpose") {
+        getTranspose(c);
+    }
+    else if(commands[c] == "Inverse") {
+        if(square) {
+            getInverse(c);
+        }
+        else {
+            notes << "Invalid command for input matrix " << indexBase + c << ", matrix is not square\n";
+            notes << "Original Matrix:\n" << matrices[c] << "\n";
+        }
+    }
+    else if(commands[c] == "RowSpace") {
+        getRowSpace(c);
+    }
+    else if(commands[c] == "ColumnSpace") {
+        getColSpace(c);
+    }
+    else if(commands[c] == "NullSpace") {
+        getNullSpace(c);
+    }
+    else if(commands[c] == "Solve") {
+        getSolution(c);
+    }
+    else if(commands[c] == "+") {
+        if(c < numMatrices - 1) { //not the last matrix
+            matrices[c + 1] += matrices[c];
+            countFlops((uint64_t)matrices[c].rows * matrices[c].columns);
+        }
+        else {
+            notes << "Invalid command for input Matrix " << indexBase + c << ", unable to add to next matrix\n";
+            notes << "Original Matrix:\n" << matrices[c] << "\n";
+        }
+    }
+    else if(commands[c] == "-") {
+        if(c < numMatrices - 1) { //not the last matrix
+            matrices[c + 1] -= matrices[c];
+            countFlops((uint64_t)matrices[c].rows * matrices[c].columns);
+        }
+        else {
+            notes << "Invalid command for input Matrix " << indexBase + c << ", unable to add to next matrix\n";
+            notes << "Original Matrix:\n" << matrices[c] << "\n";
+        }
+    }
+    else if(commands[c] == "*") {
+        if(c < numMatrices - 1) { //not the last matrix
+            matrices[c + 1] = multiply(matrices[c], matrices[c + 1], strassenCrossover); //neither operand is changed
+        }
+        else {
+            notes << "Invalid command for input Matrix " << indexBase + c << ", unable to add to next matrix\n";
+            notes << "Original Matrix:\n" << matrices[c] << "\n";
+        }
+    }
+    else {
+        notes << "Invalid command for input matrix " << indexBase + c << "\n";
+        notes << "Original Matrix:\n" << matrices[c] << "\n";
+    }
+}
+
+//REQUIRES: c is a valid input matrix index, it or the operand it combines with is sparse
+//MODIFIES: analyses[c], matrices, sparseMatrices of c and c + 1, notes
+//EFFECTS: Runs the command of input matrix c on sparse matrices and returns true, Solve (with a unique solution),
+//         Transpose and the operands keep the sparse form
+//         Any other command needs the dense form: the sparse matrix is converted and false is returned so that the
+//         dense code runs it, unless it is too large (SPARSE_DENSE_LIMIT), which is reported to notes instead
+template<typename T>
+bool LinearAlgebra<T>::processSparseCommand(uint32_t c, ostream &notes) {
+    const string &command = commands[c];
+    if(isOperand(command) && c + 1 < numMatrices) {
+        if(!isSparse(c)) { //dense with sparse, only the product is computed without converting
+            if(command == "*") {
+                matrices[c + 1] = multiply(matrices[c], *sparseMatrices[c + 1]);
+                sparseMatrices[c + 1].reset();
+                return true;
             }
+            return !makeDense(c + 1, notes);
         }
-        else if(commands[c] == "-") {
-            if(c < numMatrices - 1) { //not the last matrix
-                matrices[c + 1][0] = matrices[c + 1][0] - matrices[c][0];
+        const SparseMatrix<T> &lhs = *sparseMatrices[c];
+        if(isSparse(c + 1)) {
+            SparseMatrix<T> &rhs = *sparseMatrices[c + 1];
+            if(command == "*") {
+                rhs = multiply(lhs, rhs);
             }
             else {
-                cout << "Invalid command for input Matrix " << c << ", unable to add to next matrix\n";
-                cout << "Original Matrix:\n" << matrices[c][0] << "\n";
+                rhs = addScaled(rhs, lhs, command == "+" ? T(1) : T(-1));
             }
+            return true;
         }
-        else if(commands[c] == "*") {
-            if(c < numMatrices - 1) { //not the last matrix
-                Matrix<double> copy = matrices[c][0]; //temporary copy so that matrices[c][0] isn't changed
-                matrices[c + 1][0] = copy * matrices[c][1];
-            }
-            else {
-                cout << "Invalid command for input Matrix " << c << ", unable to add to next matrix\n";
-                cout << "Original Matrix:\n" << matrices[c][0] << "\n";
+        if(command == "*") {
+            matrices[c + 1] = multiply(lhs, matrices[c + 1]);
+            return true;
+        }
+        const T sign = command == "+" ? T(1) : T(-1);
+        for(uint32_t o = 0; o < lhs.outerSize(); o++) { //the next matrix is dense, add the entries into it
+            for(size_t p = lhs.starts[o]; p < lhs.starts[o + 1]; p++) {
+                const bool byRow = lhs.format == SparseFormat::Csr;
+                matrices[c + 1](byRow ? o : lhs.indices[p], byRow ? lhs.indices[p] : o) += sign * lhs.values[p];
             }
         }
+        countFlops(lhs.nonzeros());
+        return true;
+    }
+    if(command == "Transpose") {
+        getSparseTranspose(c);
+        return true;
+    }
+    if(command == "Solve") {
+        const SparseMatrix<T> &system = *sparseMatrices[c];
+        if(system.columns > system.rows && !getSparseFactorization(c).isSingular()) {
+            getSparseSolution(c);
+            return true;
+        }
+        //no unique solution, the dense code reduces the system
+    }
+    return !makeDense(c, notes);
+}
+
+//REQUIRES: m is a valid input matrix index
+//MODIFIES: matrices[m], sparseMatrices[m], notes
+//EFFECTS: Replaces a sparse input matrix with its dense form, returns false and reports it to notes if it is too
+//         large for that (SPARSE_DENSE_LIMIT), a dense matrix is left alone
+template<typename T>
+bool LinearAlgebra<T>::makeDense(uint32_t m, ostream &notes) {
+    if(!isSparse(m)) {
+        return true;
+    }
+    const SparseMatrix<T> &sparse = *sparseMatrices[m];
+    if((uint64_t)sparse.rows * sparse.columns > SPARSE_DENSE_LIMIT) {
+        notes << "Invalid command for input matrix " << indexBase + m << ", the " << sparse.rows << "x" << sparse.columns
+              << " sparse matrix is too large to store dense (Solve, Transpose and the operands keep it sparse)\n";
+        return false;
+    }
+    matrices[m] = sparse.toDense();
+    sparseMatrices[m].reset();
+    return true;
+}
+
+//REQUIRES: c is a valid input matrix index, it or the operand it combines with is tiled
+//MODIFIES: analyses[c], matrices, sparseMatrices and tiledMatrices of c and c + 1, notes
+//EFFECTS: Runs the command of input matrix c on tiles (TiledMatrix.h): Transpose, Solve of a system with a unique
+//         solution and the operands, which move the matrix they combine with into tiles if it is in memory
+//         Every other command needs the whole matrix in memory, which is reported to notes like an operand whose
+//         dimensions do not match and a system without a unique solution, and then nothing is printed for it
+//         The tile algorithms' own temporaries (a panel of the factorization, bands of rows) come from the heap,
+//         they are freed before the command returns
+template<typename T>
+void LinearAlgebra<T>::processTiledCommand(uint32_t c, ostream &notes) {
+    MatrixArena::Scope heap(nullptr);
+    const string &command = commands[c];
+    if(isOperand(command)) {
+        if(c + 1 == numMatrices) {
+            notes << "Invalid command for input Matrix " << indexBase + c << ", unable to add to next matrix\n";
+            return;
+        }
+        if(!tiledOperand(c, notes) || !tiledOperand(c + 1, notes)) {
+            return;
+        }
+        const TiledMatrix<T> &lhs = *tiledMatrices[c];
+        TiledMatrix<T> &rhs = *tiledMatrices[c + 1];
+        if(command == "*" ? lhs.columns != rhs.rows : lhs.rows != rhs.rows || lhs.columns != rhs.columns) {
+            notes << "Invalid command for input Matrix " << indexBase + c << ", the " << lhs.rows << "x" << lhs.columns
+                  << " matrix does not fit the " << rhs.rows << "x" << rhs.columns << " next matrix\n";
+            return;
+        }
+        if(command == "*") {
+            rhs = multiply(lhs, rhs);
+        }
+        else {
+            addTiled(rhs, lhs, command == "-");
+        }
+        return;
+    }
+    const TiledMatrix<T> &mat = *tiledMatrices[c];
+    Analysis &analysis = analyses[c];
+    if(command == "Transpose") {
+        analysis.tiledTranspose.reset(new TiledMatrix<T>(transposed(mat)));
+    }
+    else if(command == "Solve" && mat.columns > mat.rows) {
+        unique_ptr<TiledMatrix<T>> solution(new TiledMatrix<T>());
+        if(solveTiled(mat, *solution, luBlockSize)) {
+            analysis.tiledSolution = move(solution);
+        }
         else {
-            cout << "Invalid command for input matrix " << c << "\n";
-            cout << "Original Matrix:\n" << matrices[c][0] << "\n";
+            notes << "Invalid command for input matrix " << indexBase + c << ", the " << mat.rows << "x" << mat.columns
+                  << " system has no unique solution, a system too large for memory is not reduced\n";
         }
     }
+    else {
+        notes << "Invalid command for input matrix " << indexBase + c << ", the " << mat.rows << "x" << mat.columns
+              << " matrix is too large for memory (Transpose, Solve and the operands run on tiles)\n";
+    }
 }
 
-void LinearAlgebra::printInformation() {
-    for(uint32_t m = 0; m < numMatrices; m++) {
-        if(commands[m] == "All") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0] << "\n\n";
-            cout << "Row Echelon Form:\n" << matrices[m][1] << "\n\n";
-            cout << "Reduced Row Echelon Form:\n" << matrices[m][2] << "\n\n";
-            cout << "Transpose:\n" << matrices[m][3] << "\n\n";
-            if(matrices[m][0].rows == matrices[m][0].columns) { //square matrix
-                cout << "Inverse:\n" << matrices[m][4] << "\n\n";
+//REQUIRES: m is a valid input matrix index, there is a tile cache
+//MODIFIES: matrices[m], sparseMatrices[m], tiledMatrices[m], notes
+//EFFECTS: Moves input matrix m into tiles if it is in memory, so that an operand can combine it with a tiled
+//         matrix, returns false if it is sparse and too large to store dense (reported by makeDense)
+template<typename T>
+bool LinearAlgebra<T>::tiledOperand(uint32_t m, ostream &notes) {
+    if(isTiled(m)) {
+        return true;
+    }
+    if(!makeDense(m, notes)) {
+        return false;
+    }
+    tiledMatrices[m].reset(new TiledMatrix<T>(toTiled(matrices[m], tileSize, *tileCache)));
+    matrices[m] = Matrix<T>();
+    return true;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns whether command combines its matrix with the next one
+template<typename T>
+bool LinearAlgebra<T>::isOperand(const string &command) {
+    return command == "+" || command == "-" || command == "*";
+}
+
+//REQUIRES: b is a valid batch index
+//MODIFIES: batches[b], matrices and batchOf of its singular Solve systems, stats of its matrices
+//EFFECTS: Runs the batch kernel of the batch's command over all its matrices at once
+//         A singular system has no unique solution, it leaves the batch as a Matrix of its own so that the regular
+//         code reduces it (processCommands runs it after the batches)
+//         With --stats the batch's time, flops and allocations are split evenly between its matrices
+template<typename T>
+void LinearAlgebra<T>::processBatch(uint32_t b) {
+    Batch &batch = batches[b];
+    const string &command = commands[batch.first];
+    const OpCounters before = opCounters;
+    const auto start = chrono::steady_clock::now();
+    if(command == "Transpose") {
+        batch.results = transposed(batch.inputs);
+    }
+    else if(command == "Inverse") {
+        vector<T> determinants; //not printed
+        batchInverse(batch.inputs, batch.results, determinants, batch.singular);
+    }
+    else {
+        assert(command == "Solve");
+        batchSolve(batch.inputs, batch.results, batch.singular);
+        for(uint32_t lane = 0; lane < batch.inputs.size(); lane++) {
+            if(batch.singular[lane]) {
+                matrices[batch.first + lane] = batch.inputs.matrix(lane);
+                batchOf[batch.first + lane] = NO_BATCH;
             }
-            cout << "Column Space:\n";
-            printColumns(matrices[m][6]);
-            cout << "Null Space:\n";
-            printColumns(matrices[m][7]);
-            cout << "Row Space:\n";
-            printRows(matrices[m][5]);
         }
-        else if(commands[m] == "REF") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Row Echelon Form:\n" << matrices[m][1];
+    }
+    if(statsFormat == StatsFormat::None) {
+        return;
+    }
+    const double share = 1.0 / batch.inputs.size();
+    const double seconds = secondsSince(start) * share;
+    for(uint32_t lane = 0; lane < batch.inputs.size(); lane++) {
+        MatrixStats &matStats = stats[batch.first + lane];
+        matStats.computeSeconds += seconds;
+        matStats.flops += (uint64_t)((double)(opCounters.flops - before.flops) * share);
+        matStats.bytesAllocated += (uint64_t)((double)(opCounters.bytesAllocated - before.bytesAllocated) * share);
+        matStats.allocations += (uint64_t)((double)(opCounters.allocations - before.allocations) * share);
+    }
+}
+
+//REQUIRES: processCommands has run
+//MODIFIES: out (or cout with -f binary), stats, and with text output every input matrix, which is released as
+//          soon as it is printed
+//EFFECTS: Prints the results of every input matrix in input order
+template<typename T>
+void LinearAlgebra<T>::printInformation() {
+    const auto phaseStart = chrono::steady_clock::now();
+    for(uint32_t m = 0; m < stats.size(); m++) {
+        stats[m].rows = rowsOf(m);
+        stats[m].columns = columnsOf(m);
+    }
+    if(binaryOutput) { //the file is laid out once every result is known, nothing can be released early
+        writeMatrixFile();
+        printPhaseSeconds += secondsSince(phaseStart);
+        return;
+    }
+    cout.flush(); //messages from processCommands come first
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        measure(m, &MatrixStats::printSeconds, [&] {
+            MatrixArena::Scope scope(arenas[m].get());
+            printResults(m);
+        });
+        releaseMatrix(m);
+    }
+    out.flush();
+    printPhaseSeconds += secondsSince(phaseStart);
+}
+
+//REQUIRES: m is a valid input matrix index, processCommands has run
+//MODIFIES: out
+//EFFECTS: Prints input matrix m and the results its command asked for
+template<typename T>
+void LinearAlgebra<T>::printResults(uint32_t m) {
+    if(isTiled(m)) {
+        printTiledResults(m);
+        return;
+    }
+    if(isSparse(m)) {
+        printSparseResults(m);
+        return;
+    }
+    if(batchOf[m] != NO_BATCH) {
+        printBatchResults(m);
+        return;
+    }
+    if(commands[m] == "All") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m] << "\n\n";
+        out << "Row Echelon Form:\n" << getREF(m) << "\n\n";
+        out << "Reduced Row Echelon Form:\n" << getRREF(m) << "\n\n";
+        out << "Transpose:\n" << getTranspose(m) << "\n\n";
+        if(matrices[m].rows == matrices[m].columns) { //square matrix
+            out << "Inverse:\n";
+            printInverse(getInverse(m));
+            out << "\n\n";
+        }
+        out << "Column Space:\n";
+        printColumns(getColSpace(m));
+        out << "Null Space:\n";
+        printColumns(getNullSpace(m));
+        out << "Row Space:\n";
+        printRows(getRowSpace(m));
+    }
+    else if(commands[m] == "REF") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Row Echelon Form:\n" << getREF(m);
+    }
+    else if(commands[m] == "RREF") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Reduced Row Echelon Form:\n" << getRREF(m);
+    }
+    else if(commands[m] == "Transpose") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Transpose:\n" << getTranspose(m);
+    }
+    else if(commands[m] == "Inverse" && (matrices[m].rows == matrices[m].columns)) {
+        //square matrix, no output if invalid command
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Inverse:\n";
+        printInverse(getInverse(m));
+        out << "\n";
+    }
+    else if(commands[m] == "RowSpace") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Row Space:\n";
+        printRows(getRowSpace(m));
+    }
+    else if(commands[m] == "ColumnSpace") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Column Space:\n";
+        printColumns(getColSpace(m));
+    }
+    else if(commands[m] == "NullSpace") {
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Null Space:\n";
+        printColumns(getNullSpace(m));
+    }
+    else if(commands[m] == "Solve") { //TODO
+        out << "Matrix " << indexBase + m << ":\n" << matrices[m];
+        out << "Solved System:\n" << getSolution(m);
+    }
+    //No else as no output is printed if the command is invalid or if the command was an operand
+}
+
+//REQUIRES: m has been printed, the input matrices before it have been released
+//MODIFIES: matrices[m], sparseMatrices[m], analyses[m], arenas[m]
+//EFFECTS: Frees input matrix m and everything derived from it, its arena's chunks go back to the heap at once
+//         The matrices before m hold nothing from its arena anymore, an operand's product lives in the arena of
+//         the matrix it was stored into
+template<typename T>
+void LinearAlgebra<T>::releaseMatrix(uint32_t m) {
+    matrices[m] = Matrix<T>();
+    sparseMatrices[m].reset();
+    tiledMatrices[m].reset();
+    analyses[m] = Analysis();
+    arenas[m].reset();
+    if(batchOf[m] != NO_BATCH) { //a batch is freed with its last matrix
+        Batch &batch = batches[batchOf[m]];
+        if(m - batch.first + 1 == batch.inputs.size()) {
+            batch = Batch();
+        }
+    }
+}
+
+//REQUIRES: m is a valid input matrix index in a batch, processCommands has run
+//MODIFIES: result
+//EFFECTS: Sets result to what the command of input matrix m gives for it: the transpose, the inverse (an empty
+//         matrix if it is singular) or the solved system [ I | x ], reusing result's buffer if it has that shape
+template<typename T>
+void LinearAlgebra<T>::copyBatchResult(uint32_t m, Matrix<T> &result) const {
+    const Batch &batch = batches[batchOf[m]];
+    const uint32_t lane = m - batch.first;
+    const string &command = commands[m];
+    if(command == "Inverse" && batch.singular[lane]) {
+        result = Matrix<T>();
+        return;
+    }
+    const uint32_t rows = batch.results.getRows();
+    const uint32_t columns = command == "Solve" ? rows + 1 : batch.results.getCols();
+    if(result.rows != rows || result.columns != columns) {
+        result = Matrix<T>(rows, columns);
+    }
+    if(command != "Solve") {
+        batch.results.copyTo(lane, result);
+        return;
+    }
+    for(uint32_t r = 0; r < rows; r++) {
+        T *row = result.rowPtr(r);
+        for(uint32_t c = 0; c < rows; c++) {
+            row[c] = r == c ? T(1) : T(0);
         }
-        else if(commands[m] == "RREF") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Reduced Row Echelon Form:\n" << matrices[m][1];
+        row[rows] = batch.results(lane, r, 0);
+    }
+}
+
+//REQUIRES: m is a valid input matrix index in a batch, processCommands has run
+//MODIFIES: out, batchInput, batchOutput
+//EFFECTS: Prints input matrix m and its result exactly as printResults prints a matrix of its own
+template<typename T>
+void LinearAlgebra<T>::printBatchResults(uint32_t m) {
+    const Batch &batch = batches[batchOf[m]];
+    if(batchInput.rows != batch.inputs.getRows() || batchInput.columns != batch.inputs.getCols()) {
+        batchInput = Matrix<T>(batch.inputs.getRows(), batch.inputs.getCols());
+    }
+    batch.inputs.copyTo(m - batch.first, batchInput);
+    copyBatchResult(m, batchOutput);
+    out << "Matrix " << indexBase + m << ":\n" << batchInput;
+    if(commands[m] == "Transpose") {
+        out << "Transpose:\n" << batchOutput;
+    }
+    else if(commands[m] == "Inverse") {
+        out << "Inverse:\n";
+        printInverse(batchOutput);
+        out << "\n";
+    }
+    else {
+        out << "Solved System:\n" << batchOutput;
+    }
+}
+
+//REQUIRES: m is a valid input matrix index that is still sparse after processCommands
+//MODIFIES: out
+//EFFECTS: Prints input matrix m and its sparse result in coordinate form (see OutputWriter)
+template<typename T>
+void LinearAlgebra<T>::printSparseResults(uint32_t m) {
+    if(commands[m] == "Transpose") {
+        out << "Matrix " << indexBase + m << ":\n" << *sparseMatrices[m];
+        out << "Transpose:\n" << getSparseTranspose(m);
+    }
+    else if(commands[m] == "Solve") {
+        out << "Matrix " << indexBase + m << ":\n" << *sparseMatrices[m];
+        out << "Solved System:\n" << getSparseSolution(m);
+    }
+    //No else as operands and the commands a sparse matrix was too large for print nothing
+}
+
+//REQUIRES: m is a valid input matrix index that is tiled, processCommands has run
+//MODIFIES: out, the tile cache
+//EFFECTS: Prints input matrix m and its result exactly as printResults prints a matrix in memory, a tile row at a
+//         time, the solved system [ I | x ] is put together row by row as it is printed
+template<typename T>
+void LinearAlgebra<T>::printTiledResults(uint32_t m) {
+    const Analysis &analysis = analyses[m];
+    if(commands[m] == "Transpose") {
+        out << "Matrix " << indexBase + m << ":\n" << *tiledMatrices[m];
+        out << "Transpose:\n" << *analysis.tiledTranspose;
+    }
+    else if(commands[m] == "Solve" && analysis.tiledSolution) {
+        out << "Matrix " << indexBase + m << ":\n" << *tiledMatrices[m];
+        out << "Solved System:\n";
+        const TiledMatrix<T> &x = *analysis.tiledSolution;
+        MatrixArena::Scope heap(nullptr);
+        Matrix<T> band(min(x.getTileSize(), x.rows), x.columns);
+        for(uint32_t first = 0; first < x.rows; first += band.rows) {
+            const uint32_t count = min(band.rows, x.rows - first);
+            x.loadRows(first, band, 0, count);
+            for(uint32_t r = 0; r < count; r++) {
+                out << "[  ";
+                for(uint32_t c = 0; c < x.rows; c++) {
+                    out << (first + r == c ? 1.0 : 0.0) << " ";
+                }
+                const T *values = band.rowPtr(r);
+                for(uint32_t c = 0; c < x.columns; c++) {
+                    out << (double)values[c] << " ";
+                }
+                out << " ]\n";
+            }
         }
-        else if(commands[m] == "Transpose") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Transpose:\n" << matrices[m][1];
+    }
+    //No else as operands and the commands a tiled matrix is too large for print nothing
+}
+
+//REQUIRES: processCommands has run
+//MODIFIES: cout
+//EFFECTS: Writes the same results printInformation prints as one binary matrix file (see MatrixFile.h)
+//         Each input matrix is stored with the command "Matrix", followed by its results, each stored with the
+//         name of its command and the input matrix's index as its source, a singular inverse is an empty matrix
+template<typename T>
+void LinearAlgebra<T>::writeMatrixFile() {
+    MatrixFileWriter<T> file;
+    deque<Matrix<T>> dense; //sparse and batched inputs and results, the file layout is dense
+    auto addTiles = [&](const TiledMatrix<T> &tiled, uint32_t m, const string &name) { //loaded a tile row at a time
+        file.add(tiled.rows, tiled.columns, tiled.getTileSize(), [&tiled](uint32_t first, Matrix<T> &band) {
+            tiled.loadRows(first, band, 0, min(band.rows, tiled.rows - first));
+        }, m, name);
+    };
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        const string &command = commands[m];
+        if(isTiled(m)) {
+            const Analysis &analysis = analyses[m];
+            if(command == "Transpose") {
+                addTiles(*tiledMatrices[m], m, "Matrix");
+                addTiles(*analysis.tiledTranspose, m, command);
+            }
+            else if(command == "Solve" && analysis.tiledSolution) { //[ I | x ], about a tile's elements per band
+                const TiledMatrix<T> &x = *analysis.tiledSolution;
+                const uint32_t columns = x.rows + x.columns;
+                addTiles(*tiledMatrices[m], m, "Matrix");
+                file.add(x.rows, columns, max((uint32_t)((uint64_t)tileSize * tileSize / columns), 1u),
+                         [&x](uint32_t first, Matrix<T> &band) {
+                    const uint32_t count = min(band.rows, x.rows - first);
+                    Matrix<T> values(count, x.columns);
+                    x.loadRows(first, values, 0, count);
+                    for(uint32_t r = 0; r < count; r++) {
+                        T *row = band.rowPtr(r);
+                        for(uint32_t c = 0; c < x.rows; c++) {
+                            row[c] = first + r == c ? T(1) : T(0);
+                        }
+                        memcpy(row + x.rows, values.rowPtr(r), x.columns * sizeof(T));
+                    }
+                }, m, command);
+            }
+            continue;
+        }
+        if(isSparse(m)) {
+            if(command != "Transpose" && command != "Solve") {
+                continue;
+            }
+            const SparseMatrix<T> &result = command == "Solve" ? getSparseSolution(m) : getSparseTranspose(m);
+            if((uint64_t)result.rows * result.columns > SPARSE_DENSE_LIMIT) {
+                cerr << "Input matrix " << m << " is too large for a dense matrix file, its results are left out\n";
+                continue;
+            }
+            dense.push_back(sparseMatrices[m]->toDense());
+            file.add(dense.back(), m, "Matrix");
+            dense.push_back(result.toDense());
+            file.add(dense.back(), m, command);
+            continue;
         }
-        else if(commands[m] == "Inverse" && (matrices[m][0].rows == matrices[m][0].columns)) {
-            //square matrix, no output if invalid command
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Inverse:\n" << matrices[m][1] << "\n";
+        if(batchOf[m] != NO_BATCH) {
+            const Batch &batch = batches[batchOf[m]];
+            dense.push_back(batch.inputs.matrix(m - batch.first));
+            file.add(dense.back(), m, "Matrix");
+            dense.emplace_back();
+            copyBatchResult(m, dense.back());
+            file.add(dense.back(), m, command);
         }
-        else if(commands[m] == "RowSpace") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Row Space:\n";
-            printRows(matrices[m][1]);
+        else if(command == "All") {
+            file.add(matrices[m], m, "Matrix");
+            file.add(getREF(m), m, "REF");
+            file.add(getRREF(m), m, "RREF");
+            file.add(getTranspose(m), m, "Transpose");
+            if(matrices[m].rows == matrices[m].columns) { //square matrix
+                file.add(getInverse(m), m, "Inverse");
+            }
+            file.add(getColSpace(m), m, "ColumnSpace");
+            file.add(getNullSpace(m), m, "NullSpace");
+            file.add(getRowSpace(m), m, "RowSpace");
         }
-        else if(commands[m] == "ColumnSpace") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Column Space:\n";
-            printColumns(matrices[m][1]);
+        else if(command == "REF" || command == "RREF" || command == "Transpose" || command == "RowSpace"
+                || command == "ColumnSpace" || command == "NullSpace" || command == "Solve"
+                || (command == "Inverse" && matrices[m].rows == matrices[m].columns)) {
+            file.add(matrices[m], m, "Matrix");
+            file.add(getResult(m), m, command);
         }
-        else if(commands[m] == "NullSpace") {
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Null Space:\n";
-            printColumns(matrices[m][1]);
+        //Nothing is written for invalid commands and operands, as in the text output
+    }
+    file.write(cout);
+    cout.flush();
+}
+
+//REQUIRES: printInformation has run
+//MODIFIES: cerr or statsFile
+//EFFECTS: With --stats, reports the wall time of each phase and, per command and per input matrix, the time spent
+//         parsing, computing and printing along with the flops and allocations counted for it
+//         Does nothing without --stats
+template<typename T>
+void LinearAlgebra<T>::printStats() {
+    if(statsFormat == StatsFormat::None) {
+        return;
+    }
+    ofstream file;
+    if(!statsFile.empty()) {
+        file.open(statsFile);
+        if(!file) {
+            cerr << "Unable to write stats to " << statsFile << "\n";
+            exit(1);
         }
-        else if(commands[m] == "Solve") { //TODO
-            cout << "Matrix " << m << ":\n" << matrices[m][0];
-            cout << "Solved System:\n" << matrices[m][1];
+    }
+    ostream &os = statsFile.empty() ? cerr : file;
+    if(statsFormat == StatsFormat::Json) {
+        printStatsJson(os, statsByCommand());
+    }
+    else {
+        printStatsText(os, statsByCommand());
+    }
+    os.flush();
+}
+
+//Dimensions of input matrix m, sparse, dense or batched
+template<typename T>
+uint32_t LinearAlgebra<T>::rowsOf(uint32_t m) const {
+    if(isTiled(m)) {
+        return tiledMatrices[m]->rows;
+    }
+    if(batchOf[m] != NO_BATCH) {
+        return batches[batchOf[m]].inputs.getRows();
+    }
+    return isSparse(m) ? sparseMatrices[m]->rows : matrices[m].rows;
+}
+template<typename T>
+uint32_t LinearAlgebra<T>::columnsOf(uint32_t m) const {
+    if(isTiled(m)) {
+        return tiledMatrices[m]->columns;
+    }
+    if(batchOf[m] != NO_BATCH) {
+        return batches[batchOf[m]].inputs.getCols();
+    }
+    return isSparse(m) ? sparseMatrices[m]->columns : matrices[m].columns;
+}
+
+//REQUIRES: --stats is on
+//MODIFIES: Nothing
+//EFFECTS: Returns the stats summed per command, the command with the most compute time first
+template<typename T>
+vector<typename LinearAlgebra<T>::CommandStats> LinearAlgebra<T>::statsByCommand() {
+    map<string, CommandStats> byName;
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        const MatrixStats &matStats = stats[m];
+        CommandStats &command = byName[commands[m]];
+        command.command = commands[m];
+        command.matrices++;
+        command.sum.parseSeconds += matStats.parseSeconds;
+        command.sum.computeSeconds += matStats.computeSeconds;
+        command.sum.printSeconds += matStats.printSeconds;
+        command.sum.flops += matStats.flops;
+        command.sum.bytesAllocated += matStats.bytesAllocated;
+        command.sum.allocations += matStats.allocations;
+    }
+    vector<CommandStats> byCommand;
+    for(auto &named : byName) {
+        byCommand.push_back(move(named.second));
+    }
+    stable_sort(byCommand.begin(), byCommand.end(), [](const CommandStats &a, const CommandStats &b) {
+        return a.sum.computeSeconds > b.sum.computeSeconds;
+    });
+    return byCommand;
+}
+
+//REQUIRES: --stats is on
+//MODIFIES: os
+//EFFECTS: Writes the stats as tables: phases, commands by compute time, then the most expensive matrices
+template<typename T>
+void LinearAlgebra<T>::printStatsText(ostream &os, const vector<CommandStats> &byCommand) {
+    const uint32_t MAX_LISTED_MATRICES = 20;
+
+    MatrixStats total;
+    for(const CommandStats &command : byCommand) {
+        total.flops += command.sum.flops;
+        total.bytesAllocated += command.sum.bytesAllocated;
+        total.allocations += command.sum.allocations;
+    }
+
+    const ios_base::fmtflags oldFlags = os.flags();
+    const streamsize oldPrecision = os.precision();
+    os << fixed << setprecision(4);
+    os << "Phases (wall time): parse " << parsePhaseSeconds << " s, compute " << computePhaseSeconds
+       << " s, print " << printPhaseSeconds << " s\n";
+    os << "Totals: " << total.flops << " flops, " << total.bytesAllocated << " bytes in " << total.allocations
+       << " allocations\n\n";
+
+    os << left << setw(12) << "Command" << right << setw(10) << "Matrices" << setw(12) << "Parse s" << setw(12)
+       << "Compute s" << setw(12) << "Print s" << setw(16) << "Flops" << setw(10) << "GFLOP/s" << setw(16)
+       << "Bytes alloc" << "\n";
+    for(const CommandStats &command : byCommand) {
+        const MatrixStats &sum = command.sum;
+        os << left << setw(12) << command.command << right << setw(10) << command.matrices << setw(12) << sum.parseSeconds
+           << setw(12) << sum.computeSeconds << setw(12) << sum.printSeconds << setw(16) << sum.flops << setw(10)
+           << setprecision(2) << (sum.computeSeconds > 0 ? (double)sum.flops / sum.computeSeconds / 1e9 : 0.0)
+           << setprecision(4) << setw(16) << sum.bytesAllocated << "\n";
+    }
+
+    vector<uint32_t> order(numMatrices);
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        order[m] = m;
+    }
+    const auto cost = [&](uint32_t m) {
+        return stats[m].parseSeconds + stats[m].computeSeconds + stats[m].printSeconds;
+    };
+    const uint32_t listed = min(numMatrices, MAX_LISTED_MATRICES);
+    partial_sort(order.begin(), order.begin() + listed, order.end(), [&](uint32_t a, uint32_t b) {
+        return cost(a) > cost(b);
+    });
+    os << "\nMost expensive matrices (" << listed << " of " << numMatrices << "):\n";
+    os << right << setw(8) << "Matrix" << "  " << left << setw(12) << "Command" << setw(12) << "Size" << right
+       << setw(12) << "Parse s" << setw(12) << "Compute s" << setw(12) << "Print s" << setw(16) << "Flops"
+       << setw(16) << "Bytes alloc" << "\n";
+    for(uint32_t i = 0; i < listed; i++) {
+        const uint32_t m = order[i];
+        const MatrixStats &matStats = stats[m];
+        os << right << setw(8) << m << "  " << left << setw(12) << commands[m] << setw(12)
+           << (to_string(stats[m].rows) + "x" + to_string(stats[m].columns)) << right << setw(12)
+           << matStats.parseSeconds << setw(12) << matStats.computeSeconds << setw(12) << matStats.printSeconds
+           << setw(16) << matStats.flops << setw(16) << matStats.bytesAllocated << "\n";
+    }
+    os.flags(oldFlags);
+    os.precision(oldPrecision);
+}
+
+//REQUIRES: --stats=json is on
+//MODIFIES: os
+//EFFECTS: Writes the stats as one JSON object: the phase times, the sums per command and one record per input
+//         matrix in input order
+template<typename T>
+void LinearAlgebra<T>::printStatsJson(ostream &os, const vector<CommandStats> &byCommand) {
+    const auto quoted = [](const string &text) {
+        string json = "\"";
+        for(char ch : text) {
+            if(ch == '"' || ch == '\\') {
+                json += '\\';
+                json += ch;
+            }
+            else if((unsigned char)ch < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)(unsigned char)ch);
+                json += escaped;
+            }
+            else {
+                json += ch;
+            }
         }
-        //No else as no output is printed if the command is invalid or if the command was an operand
+        return json + "\"";
+    };
+
+    const ios_base::fmtflags oldFlags = os.flags();
+    const streamsize oldPrecision = os.precision();
+    os << fixed << setprecision(9);
+    os << "{\n  \"parse_seconds\": " << parsePhaseSeconds << ",\n  \"compute_seconds\": " << computePhaseSeconds
+       << ",\n  \"print_seconds\": " << printPhaseSeconds << ",\n  \"threads\": " << ThreadPool::instance().size()
+       << ",\n  \"commands\": [\n";
+    for(size_t i = 0; i < byCommand.size(); i++) {
+        const MatrixStats &sum = byCommand[i].sum;
+        os << "    {\"command\": " << quoted(byCommand[i].command) << ", \"matrices\": " << byCommand[i].matrices
+           << ", \"parse_seconds\": " << sum.parseSeconds << ", \"compute_seconds\": " << sum.computeSeconds
+           << ", \"print_seconds\": " << sum.printSeconds << ", \"flops\": " << sum.flops
+           << ", \"bytes_allocated\": " << sum.bytesAllocated << ", \"allocations\": " << sum.allocations << "}"
+           << (i + 1 < byCommand.size() ? "," : "") << "\n";
+    }
+    os << "  ],\n  \"matrices\": [\n";
+    for(uint32_t m = 0; m < numMatrices; m++) {
+        const MatrixStats &matStats = stats[m];
+        os << "    {\"index\": " << m << ", \"command\": " << quoted(commands[m]) << ", \"rows\": "
+           << stats[m].rows << ", \"columns\": " << stats[m].columns << ", \"parse_seconds\": "
+           << matStats.parseSeconds << ", \"compute_seconds\": " << matStats.computeSeconds
+           << ", \"print_seconds\": " << matStats.printSeconds << ", \"flops\": " << matStats.flops
+           << ", \"bytes_allocated\": " << matStats.bytesAllocated << ", \"allocations\": " << matStats.allocations
+           << "}" << (m + 1 < numMatrices ? "," : "") << "\n";
     }
+    os << "  ]\n}\n";
+    os.flags(oldFlags);
+    os.precision(oldPrecision);
 }
 
 //REQUIRES: mat is valid, row is the topmost row to be subtracted down, startcol is the first column to start subtracting,
@@ -231,7 +1423,8 @@ void LinearAlgebra::printInformation() {
 //          i.e. puts the matrix into row echelon form
 //          Also only considers pivots between [startCol,endCol) so that the whole row is subtracted, but if the method has not
 //          reached the bottom of the matrix, and there is no pivot remaining between [startCol,endCol) it will stop
-void LinearAlgebra::subtractDown(Matrix<double> &mat, uint32_t row, uint32_t startCol, uint32_t endCol) {
+template<typename T>
+void LinearAlgebra<T>::subtractDown(Matrix<T> &mat, uint32_t row, uint32_t startCol, uint32_t endCol) {
     pair<int,int> pos = findPivotInMatrix(mat, row, startCol, endCol);
     uint32_t nextRow = 0;
     while(pos.first != -1 && pos.second != -1 && (uint32_t)pos.second < endCol) {
@@ -241,7 +1434,7 @@ void LinearAlgebra::subtractDown(Matrix<double> &mat, uint32_t row, uint32_t sta
         for(uint32_t r = nextRow + 1; r < mat.rows; r++) {
             subtractRow(mat, nextRow, r);
         }
-        pos = findPivotInMatrix(mat, (uint32_t)pos.first + 1, (uint32_t)pos.second + 1, endCol);
+        pos = findPivotInMatrix(mat, nextRow + 1, (uint32_t)pos.second + 1, endCol); //pivot row now sits at nextRow
         nextRow++;
     }
 }
@@ -250,7 +1443,8 @@ void LinearAlgebra::subtractDown(Matrix<double> &mat, uint32_t row, uint32_t sta
 //          startcol is the first column to start subtracting, endcol is one past the last column to subtract
 //MODIFIES: mat
 //EFFECTS: Turns a matrix in Row Echelon Form (REF) to Reduced Row Echelon Form (RREF)
-void LinearAlgebra::subtractUp(Matrix<double> &mat, uint32_t startCol, uint32_t endCol) {
+template<typename T>
+void LinearAlgebra<T>::subtractUp(Matrix<T> &mat, uint32_t startCol, uint32_t endCol) {
     int pos;
     for(uint32_t r = mat.rows - 1; r < mat.rows; r--) { //rolls over after hits zero
         pos = findPivotInRow(mat, r, startCol, endCol);
@@ -265,38 +1459,26 @@ void LinearAlgebra::subtractUp(Matrix<double> &mat, uint32_t startCol, uint32_t
 
 //REQUIRES: mat is a valid matrix, mat is square
 //MODIFIES: mat
-//EFFECTS: Finds the inverse of mat and replaces mat with its inverse
-void LinearAlgebra::inverse(Matrix<double> &mat) {
-    Matrix<double> newMat(mat.rows, mat.columns * 2);
-    for(uint32_t r = 0; r < mat.rows; r++) {
-        for(uint32_t c = 0; c < mat.rows; c++) {
-            newMat(r,c) = mat(r,c);
-        }
-    }
-    for(uint32_t diag = 0; diag < mat.rows; diag++) {
-        newMat(diag,mat.columns + diag) = 1;
-    }
-    subtractDown(newMat,0,0,mat.columns);
-    subtractUp(newMat,0,mat.columns);
-
-    for(uint32_t r = 0; r < mat.rows; r++) {
-        for(uint32_t c = 0; c < mat.rows; c++) {
-            mat(r,c) = newMat(r, c + mat.columns);
-        }
-    }
+//EFFECTS: Finds the inverse of mat through its LU factorization and replaces mat with its inverse
+//         mat becomes an empty matrix if it is singular
+template<typename T>
+void LinearAlgebra<T>::inverse(Matrix<T> &mat) {
+    LUFactorization<T> lu(move(mat)); //mat is replaced anyway, it is factored in place
+    mat = lu.isSingular() ? Matrix<T>() : lu.inverse();
 }
 
 //REQUIRES: mat is a valid matrix, row is a valid row within mat
 //MODIFIES: mat, determinant
 //EFFECTS: Divides the corresponding row by its pivot so that its pivot is 1
 //          Determinant is multiplied by the coefficient dividing the row
-void LinearAlgebra::divideRow(Matrix<double> &mat, uint32_t row) {
+template<typename T>
+void LinearAlgebra<T>::divideRow(Matrix<T> &mat, uint32_t row) {
     int piv = findPivotInRow(mat, row, 0, mat.columns);
     if(piv != -1) { //nonzero row
-        double coef = mat(row, (uint32_t)piv);
-        for(uint32_t e = (uint32_t)piv; e < mat.columns; e++) {
-            mat(row, e) /= coef;
-        }
+        T *matRow = mat.rowPtr(row);
+        T coef = matRow[piv];
+        rowDivide(matRow + piv, coef, mat.columns - (uint32_t)piv);
+        countFlops(mat.columns - (uint32_t)piv);
         mat.determinant *= coef; //dividing multiplies the determinant by the coefficient
     }
 }
@@ -305,24 +1487,12 @@ void LinearAlgebra::divideRow(Matrix<double> &mat, uint32_t row) {
 //MODIFIES: mat
 //EFFECTS: Switches the positions of row1 and row2 in mat
 //         Determinant is multiplied by -1
-void LinearAlgebra::interchangeRow(Matrix<double> &mat, uint32_t row1, uint32_t row2) {
-    swap(mat.matrix[row1], mat.matrix[row2]); //swap the rows
+template<typename T>
+void LinearAlgebra<T>::interchangeRow(Matrix<T> &mat, uint32_t row1, uint32_t row2) {
+    mat.interchangeRows(row1, row2); //swap the rows through the row order, no elements move
     mat.determinant *= -1; //interchanging multiplies the determinant by -1
 }
 
-//REQUIRES: mat is a valid matrix
-//MODIFIES: mat
-//EFFECTS: Finds the transpose of mat and replaces mat with it
-void LinearAlgebra::transpose(Matrix<double> &mat) {
-    Matrix<double> newMat(mat.columns, mat.rows);
-    for(uint32_t r = 0; r < mat.rows; r++) {
-        for(uint32_t c = 0; c < mat.columns; c++) {
-            newMat(c,r) = mat(r,c);
-        }
-    }
-    mat = newMat; //Can use the steal constructor here, newMat is an rValue
-}
-
 //REQUIRES: mat is a valid matrix, toSubtract and subtractFrom are valid rows within mat
 //MODIFIES: mat
 //EFFECTS: Subtracts the row at the toSubtract position from the row at the subtractFrom position
@@ -330,120 +1500,395 @@ void LinearAlgebra::transpose(Matrix<double> &mat) {
 //         toSubtract pivot position column divided by the value of the toSubtract pivot position
 //         i.e. it subtracts the toSubtract row from the subtractFrom row so that the    E.x [1,1,1,1] -> [1,1,1,1]
 //         value in the subtractFrom row below the toSubtract pivot is zero                  [2,3,4,5]    [0,1,2,3]     
-void LinearAlgebra::subtractRow(Matrix<double> &mat, uint32_t toSubtract, uint32_t subtractFrom) {
+template<typename T>
+void LinearAlgebra<T>::subtractRow(Matrix<T> &mat, uint32_t toSubtract, uint32_t subtractFrom) {
     int piv = findPivotInRow(mat, toSubtract, 0, mat.columns);
     if(piv != -1) { //nonzero row
-        double coef = mat(subtractFrom, (uint32_t)piv) / mat(toSubtract, (uint32_t)piv);
-        for(uint32_t e = (uint32_t)piv; e < mat.columns; e++) {
-            mat(subtractFrom, e) -= coef * mat(toSubtract, e);
-        }
+        T *fromRow = mat.rowPtr(subtractFrom);
+        const T *subRow = mat.rowPtr(toSubtract);
+        T coef = fromRow[piv] / subRow[piv];
+        rowSubtractScaled(fromRow + piv + 1, subRow + piv + 1, coef, mat.columns - (uint32_t)piv - 1);
+        countFlops(1 + 2 * (uint64_t)(mat.columns - (uint32_t)piv - 1));
+        fromRow[piv] = 0; //eliminated exactly, rounding would leave a tiny false pivot for subtractUp and the spaces
     }
 }
 
-//REQUIRES: mat is a valid matrix
-//MODIFIES: mat
-//EFFECTS: Finds a basis for the Column Space of mat, and replaces mat with that basis
-void LinearAlgebra::findColSpace(Matrix<double> &mat) {
-    vector<bool> independentCols = getIndepCols(mat);
+/* ---------------------- ACCESSORS ---------------------- */
+//Each accessor computes its result on first use, from the other cached results where it can, and keeps it in
+//analyses[numInputMat], so for All the input is factored or eliminated once and reduced to RREF once
 
-    uint32_t numIndepCols = 0;
-    for(uint32_t c = 0; c < independentCols.size(); c++) {
-        if(independentCols[c]) {
-            numIndepCols++;
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the Row Echelon Form of the input matrix
+//         A square nonsingular input takes U from its blocked LU factorization (at GEMM speed, with the same pivot
+//         sequence as subtractDown, though the blocked update rounds differently so the last digits can differ from
+//         what subtractDown would give), any other input is eliminated by subtractDown
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getREF(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.ref) {
+        const Matrix<T> &input = matrices[numInputMat];
+        if(input.rows == input.columns && !getFactorization(numInputMat).isSingular()) {
+            analysis.ref.reset(new Matrix<T>(getFactorization(numInputMat).getU()));
+        }
+        else {
+            analysis.ref.reset(new Matrix<T>(input));
+            subtractDown(*analysis.ref, 0, 0, input.columns);
         }
     }
+    return *analysis.ref;
+}
 
-    Matrix<double> newMat(mat.rows, numIndepCols);
-    uint32_t newMatCol = 0;
-    for(uint32_t c = 0; c < mat.columns; c++) {
-        if(independentCols[c]) {
-            for(uint32_t r = 0; r < mat.rows; r++) {
-                newMat(r,newMatCol) = mat(r,newMatCol);
-            }
-            newMatCol++;
-        }
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the Reduced Row Echelon Form of the input matrix, reduced from the cached REF
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getRREF(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.rref) {
+        analysis.rref.reset(new Matrix<T>(getREF(numInputMat)));
+        subtractUp(*analysis.rref, 0, analysis.rref->columns);
     }
+    return *analysis.rref;
+}
 
-    mat = newMat;
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns whether each column of the input matrix is a pivot column
+template<typename T>
+const vector<bool>& LinearAlgebra<T>::getPivotCols(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.pivotCols) {
+        analysis.pivotCols.reset(new vector<bool>(findPivotCols(getSpaceBasis(numInputMat))));
+    }
+    return *analysis.pivotCols;
 }
 
-//REQUIRES: mat is a valid matrix
-//MODIFIES: mat
-//EFFECTS: Finds a basis for the Null Space of mat, and replaces mat with that basis
-void LinearAlgebra::findNullSpace(Matrix<double> &mat) {
-    vector<bool> independentCols = getIndepCols(mat);
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the reduced rows the spaces are read from: the RREF, or with --spaces qr the row space basis of a
+//         column pivoted QR (the RREF without its zero rows, ranked with a tolerance instead of exact zeros)
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getSpaceBasis(uint32_t numInputMat) {
+    return spaceBackend == SpaceBackend::Qr ? getRowSpace(numInputMat) : getRREF(numInputMat);
+}
 
-    uint32_t numNullCols = 0;
-    for(uint32_t c = 0; c < independentCols.size(); c++) {
-        if(!independentCols[c]) {
-            numNullCols++;
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the rank of the input matrix, its number of pivot columns
+template<typename T>
+uint32_t LinearAlgebra<T>::getRank(uint32_t numInputMat) {
+    const vector<bool> &pivotCols = getPivotCols(numInputMat);
+    return (uint32_t)count(pivotCols.begin(), pivotCols.end(), true);
+}
+
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the transpose of the input matrix
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getTranspose(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.transpose) {
+        const Matrix<T> &input = matrices[numInputMat];
+        if(input.rows == input.columns) { //a straight copy, then swapped across the diagonal in its own buffer
+            analysis.transpose.reset(new Matrix<T>(input));
+            transposeInPlace(*analysis.transpose);
+        }
+        else {
+            analysis.transpose.reset(new Matrix<T>(transposed(input))); //no copy of the input first
         }
     }
+    return *analysis.transpose;
+}
 
-    Matrix<double> newMat(mat.rows, numNullCols);
-    uint32_t newMatCol = 0;
-    for(uint32_t c = 0; c < mat.columns; c++) {
-        if(!independentCols[c]) {
-            for(uint32_t r = 0; r < mat.rows; r++) {
-                newMat(r,newMatCol) = mat(r,newMatCol);
-            }
-            newMatCol++;
+//REQUIRES: numInputMat is a valid input matrix index, that matrix is square
+//MODIFIES: analyses
+//EFFECTS: Returns the inverse of the input matrix from its LU factorization, an empty matrix if it is singular
+//         A small matrix that nothing else has factored yet is inverted by FixedLU on the stack, which gives the
+//         same result without allocating an LUFactorization
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getInverse(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.inverse) {
+        const Matrix<T> &input = matrices[numInputMat];
+        if(!analysis.lu && input.rows >= 1 && input.rows <= FIXED_MAX_SIZE && input.rows <= luBlockSize) {
+            dispatchFixedSize(input.rows, [&](auto size) {
+                const FixedLU<T, size()> lu{FixedMatrix<T, size(), size()>(input)};
+                analysis.inverse.reset(new Matrix<T>());
+                if(!lu.isSingular()) {
+                    *analysis.inverse = lu.inverse();
+                    analysis.inverse->determinant = 1 / lu.determinant();
+                }
+            });
+            countFlops(2 * (uint64_t)input.rows * input.rows * input.rows); //factor and solve, as counted by LU
+        }
+        else {
+            const LUFactorization<T> &lu = getFactorization(numInputMat);
+            analysis.inverse.reset(new Matrix<T>(lu.isSingular() ? Matrix<T>() : lu.inverse()));
         }
     }
+    return *analysis.inverse;
+}
 
-    mat = newMat;
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns a basis for the Row Space of the input matrix, the nonzero rows of its RREF
+//         With --spaces qr it is reduced from the rows of R that pass the rank tolerance instead
+//         Either way a zero left by dividing by a negative pivot is -0, the basis is returned with every zero as 0
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getRowSpace(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.rowSpace) {
+        if(spaceBackend == SpaceBackend::Qr) {
+            analysis.rowSpace.reset(new Matrix<T>(QRFactorization<T>(matrices[numInputMat]).rowSpaceBasis()));
+        }
+        else {
+            analysis.rowSpace.reset(new Matrix<T>(nonzeroRows(getRREF(numInputMat))));
+        }
+        analysis.rowSpace->clearNegativeZeros();
+    }
+    return *analysis.rowSpace;
 }
 
-//REQUIRES: mat is a valid matrix
-//MODIFIES: mat
-//EFFECTS: Finds a basis for the Row Space of mat, and replaces mat with that basis
-void LinearAlgebra::findRowSpace(Matrix<double> &mat) {
-    transpose(mat);
-    findColSpace(mat);
-    transpose(mat);
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns a basis for the Column Space of the input matrix, its pivot columns
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getColSpace(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.colSpace) {
+        analysis.colSpace.reset(new Matrix<T>(selectColumns(matrices[numInputMat], getPivotCols(numInputMat))));
+    }
+    return *analysis.colSpace;
 }
 
-//REQUIRES: mat is a valid matrix in Row Echelon Form or Reduced Row Echelon Form
-//MODIFIES: determinant
-//EFFECTS: Calculates the determinant of the mat
-void LinearAlgebra::calcDeterminant(Matrix<double> &mat) { //must be a square matrix
-    for(uint32_t r = 0; r < mat.rows; r++) {
-        mat.determinant *= mat(r,r);
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns a basis for the Null Space of the input matrix, one column per free variable of its RREF
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getNullSpace(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.nullSpace) {
+        analysis.nullSpace.reset(new Matrix<T>(nullSpaceBasis(getSpaceBasis(numInputMat),
+                                                                   getPivotCols(numInputMat))));
     }
+    return *analysis.nullSpace;
 }
 
-/* ---------------------- ACCESSORS ---------------------- */
+//REQUIRES: numInputMat is a valid input matrix index, that matrix is an augmented system [ A | b ]
+//MODIFIES: analyses
+//EFFECTS: Returns the solved system, [ I | x ] from the LU factorization of A when the solution is unique,
+//         otherwise the reduced system with its free variables
+//         A double system of at least MIXED_SOLVE_MIN_SIZE equations is factored in float and refined to double
+//         accuracy (solveRefined) unless A is too ill conditioned for that, then it is factored in double
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getSolution(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(analysis.solution) {
+        return *analysis.solution;
+    }
+    const Matrix<T> &system = matrices[numInputMat];
+    const uint32_t n = system.rows;
+    if(system.columns == 0) { //no variables and no right hand side, there is nothing to eliminate
+        analysis.solution.reset(new Matrix<T>(system));
+        return *analysis.solution;
+    }
+    if(system.columns <= n) { //nothing to solve for
+        analysis.solution.reset(new Matrix<T>(system));
+        subtractDown(*analysis.solution, 0, 0, system.columns - 1);
+        subtractUp(*analysis.solution, 0, system.columns - 1);
+        return *analysis.solution;
+    }
+    const uint32_t width = system.columns - n;
+    analysis.solution.reset(new Matrix<T>(n, system.columns)); //x is solved straight into the right of [ I | x ]
+    Matrix<T> &solved = *analysis.solution;
+    bool unique = false;
+    if(is_same<T, double>::value && n >= MIXED_SOLVE_MIN_SIZE && !analysis.lu) {
+        unique = solveRefined<float>(subBlock(system, 0, 0, n, n), subBlock(system, 0, n, n, width),
+                                     subBlock(solved, 0, n, n, width), luBlockSize);
+    }
+    if(!unique && !getFactorization(numInputMat).isSingular()) {
+        for(uint32_t r = 0; r < n; r++) {
+            memcpy(solved.rowPtr(r) + n, system.rowPtr(r) + n, width * sizeof(T));
+        }
+        getFactorization(numInputMat).solveInPlace(solved, n);
+        unique = true;
+    }
+    if(unique) {
+        for(uint32_t r = 0; r < n; r++) { //the left of every row is still zero, the interchanges only moved zeros
+            solved(r,r) = 1;
+        }
+    }
+    else {
+        solved = system; //same shape, the buffer is reused
+        subtractDown(solved, 0, 0, solved.columns - 1);
+        subtractUp(solved, 0, solved.columns - 1);
+    }
+    return *analysis.solution;
+}
 
-Matrix<double>& LinearAlgebra::getREF(uint32_t numInputMat) {
-    return matrices[numInputMat][1];
+//REQUIRES: numInputMat is a valid input matrix index whose command prints a single result
+//MODIFIES: analyses
+//EFFECTS: Returns that result, e.g. the REF for the REF command
+template<typename T>
+const Matrix<T>& LinearAlgebra<T>::getResult(uint32_t numInputMat) {
+    const string &command = commands[numInputMat];
+    if(command == "REF") {
+        return getREF(numInputMat);
+    }
+    if(command == "RREF") {
+        return getRREF(numInputMat);
+    }
+    if(command == "Transpose") {
+        return getTranspose(numInputMat);
+    }
+    if(command == "Inverse") {
+        return getInverse(numInputMat);
+    }
+    if(command == "RowSpace") {
+        return getRowSpace(numInputMat);
+    }
+    if(command == "ColumnSpace") {
+        return getColSpace(numInputMat);
+    }
+    if(command == "NullSpace") {
+        return getNullSpace(numInputMat);
+    }
+    assert(command == "Solve");
+    return getSolution(numInputMat);
 }
 
-Matrix<double>& LinearAlgebra::getRREF(uint32_t numInputMat) {
-    return matrices[numInputMat][2];
+template<typename T>
+double LinearAlgebra<T>::getDeterminant(Matrix<T> &mat) {
+    return mat.determinant;
 }
 
-Matrix<double>& LinearAlgebra::getTranspose(uint32_t numInputMat) {
-    return matrices[numInputMat][3];
+//REQUIRES: numInputMat is a valid input matrix index, that matrix is square
+//MODIFIES: analyses
+//EFFECTS: Returns the determinant of the input matrix from its (cached) LU factorization
+template<typename T>
+double LinearAlgebra<T>::getDeterminant(uint32_t numInputMat) {
+    return getFactorization(numInputMat).determinant();
 }
 
-Matrix<double>& LinearAlgebra::getInverse(uint32_t numInputMat) {
-    return matrices[numInputMat][4];
+//REQUIRES: numInputMat is a valid input matrix index, that matrix has at least as many columns as rows
+//MODIFIES: analyses
+//EFFECTS: Returns the LU factorization of the leading square block of the input matrix (the whole matrix if it
+//         is square, the coefficients of a Solve system otherwise), factoring it on first use only
+template<typename T>
+const LUFactorization<T>& LinearAlgebra<T>::getFactorization(uint32_t numInputMat) {
+    unique_ptr<LUFactorization<T>> &lu = analyses[numInputMat].lu;
+    if(!lu) {
+        const Matrix<T> &input = matrices[numInputMat];
+        if(input.columns == input.rows) {
+            lu.reset(new LUFactorization<T>(input, luBlockSize));
+        }
+        else {
+            Matrix<T> square(input.rows, input.rows);
+            for(uint32_t r = 0; r < input.rows; r++) {
+                for(uint32_t c = 0; c < input.rows; c++) {
+                    square(r,c) = input(r,c);
+                }
+            }
+            lu.reset(new LUFactorization<T>(move(square), luBlockSize));
+        }
+    }
+    return *lu;
 }
 
-Matrix<double>& LinearAlgebra::getRowSpace(uint32_t numInputMat) {
-    return matrices[numInputMat][5];
+//REQUIRES: numInputMat is a valid sparse input matrix index, that matrix has at least as many columns as rows
+//MODIFIES: analyses
+//EFFECTS: Returns the sparse LU factorization of the leading square block, factoring it on first use only
+template<typename T>
+const SparseLU<T>& LinearAlgebra<T>::getSparseFactorization(uint32_t numInputMat) {
+    unique_ptr<SparseLU<T>> &lu = analyses[numInputMat].sparseLu;
+    if(!lu) {
+        const SparseMatrix<T> &input = *sparseMatrices[numInputMat];
+        if(input.columns == input.rows) {
+            lu.reset(new SparseLU<T>(input));
+        }
+        else {
+            vector<SparseEntry<T>> coefficients;
+            coefficients.reserve(input.nonzeros());
+            SparseMatrix<T> held;
+            const SparseMatrix<T> &rows = csrOf(input, held);
+            for(uint32_t r = 0; r < rows.rows; r++) {
+                for(size_t p = rows.starts[r]; p < rows.starts[r + 1] && rows.indices[p] < rows.rows; p++) {
+                    coefficients.push_back({r, rows.indices[p], rows.values[p]});
+                }
+            }
+            lu.reset(new SparseLU<T>(SparseMatrix<T>(input.rows, input.rows, coefficients)));
+        }
+    }
+    return *lu;
+}
+
+//REQUIRES: numInputMat is a valid sparse input matrix index
+//MODIFIES: analyses
+//EFFECTS: Returns the transpose of the sparse input matrix in CSR
+template<typename T>
+const SparseMatrix<T>& LinearAlgebra<T>::getSparseTranspose(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(!analysis.sparseTranspose) {
+        analysis.sparseTranspose.reset(new SparseMatrix<T>(
+            sparseMatrices[numInputMat]->transposed().converted(SparseFormat::Csr)));
+    }
+    return *analysis.sparseTranspose;
 }
 
-Matrix<double>& LinearAlgebra::getColSpace(uint32_t numInputMat) {
-    return matrices[numInputMat][6];
+//REQUIRES: numInputMat is a valid sparse input matrix index, that matrix is an augmented system [ A | b ] whose
+//          sparse factorization is not singular
+//MODIFIES: analyses
+//EFFECTS: Returns the solved system [ I | x ], each right hand side solved through the sparse LU factorization
+template<typename T>
+const SparseMatrix<T>& LinearAlgebra<T>::getSparseSolution(uint32_t numInputMat) {
+    Analysis &analysis = analyses[numInputMat];
+    if(analysis.sparseSolution) {
+        return *analysis.sparseSolution;
+    }
+    const SparseMatrix<T> &system = *sparseMatrices[numInputMat];
+    const uint32_t n = system.rows;
+    const SparseLU<T> &lu = getSparseFactorization(numInputMat);
+    vector<vector<T>> rhs(system.columns - n, vector<T>(n, 0));
+    SparseMatrix<T> held;
+    const SparseMatrix<T> &rows = csrOf(system, held);
+    for(uint32_t r = 0; r < n; r++) {
+        for(size_t p = rows.starts[r]; p < rows.starts[r + 1]; p++) {
+            if(rows.indices[p] >= n) {
+                rhs[rows.indices[p] - n][r] = rows.values[p];
+            }
+        }
+    }
+    vector<SparseEntry<T>> solved;
+    solved.reserve((size_t)n * (rhs.size() + 1));
+    for(uint32_t r = 0; r < n; r++) {
+        solved.push_back({r, r, 1});
+    }
+    for(uint32_t b = 0; b < rhs.size(); b++) {
+        const vector<T> x = lu.solve(rhs[b]);
+        for(uint32_t r = 0; r < n; r++) {
+            solved.push_back({r, n + b, x[r]});
+        }
+    }
+    analysis.sparseSolution.reset(new SparseMatrix<T>(n, system.columns, solved));
+    return *analysis.sparseSolution;
 }
 
-Matrix<double>& LinearAlgebra::getNullSpace(uint32_t numInputMat) {
-    return matrices[numInputMat][7];
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: Nothing
+//EFFECTS: Returns whether the matrix is kept sparse (given in coordinate form and not converted by a command)
+template<typename T>
+bool LinearAlgebra<T>::isSparse(uint32_t numInputMat) const {
+    return sparseMatrices[numInputMat] != nullptr;
 }
 
-double LinearAlgebra::getDeterminant(Matrix<double> &mat) {
-    return mat.determinant;
+//REQUIRES: numInputMat is a valid input matrix index
+//MODIFIES: Nothing
+//EFFECTS: Returns whether the matrix is stored in tiles on disk (too large for --tile-memory, or combined by an
+//         operand with a matrix that is)
+template<typename T>
+bool LinearAlgebra<T>::isTiled(uint32_t numInputMat) const {
+    return tiledMatrices[numInputMat] != nullptr;
 }
 
 /* ---------------------- HELPERS ---------------------- */
@@ -452,92 +1897,180 @@ double LinearAlgebra::getDeterminant(Matrix<double> &mat) {
 //MODIFIES: Nothing
 //EFFECTS: Finds the column of the first non-zero element in the specified row in the range of columns [startCol,endCol)
 //         If no such pivot is found (the row is a zero row), -1 is returned
-int LinearAlgebra::findPivotInRow(Matrix<double> &mat, uint32_t row, uint32_t startCol, uint32_t endCol) {
-    for(uint32_t e = startCol; e < endCol; e++) {
-        if(mat(row, e) != 0) {
-            return (int)e;
-        }
+template<typename T>
+int LinearAlgebra<T>::findPivotInRow(Matrix<T> &mat, uint32_t row, uint32_t startCol, uint32_t endCol) {
+    if(startCol >= endCol) {
+        return -1;
     }
-    return -1;
+    const int offset = rowFindNonzero(mat.rowPtr(row) + startCol, endCol - startCol);
+    return offset == -1 ? -1 : (int)startCol + offset;
 }
 
 //REQUIRES: mat is a valid matrix,
 //MODIFIES: Nothing
-//EFFECTS: Finds the first non-zero (pivot) element in the matrix starting from startRow and in the range of columns [startCol,endCol)
-pair<int,int> LinearAlgebra::findPivotInMatrix(Matrix<double> &mat, uint32_t startRow, uint32_t startCol, uint32_t endCol) {
+//EFFECTS: Finds the pivot for the first column in [startCol,endCol) that is non-zero at or below startRow
+//         The pivot is the entry of largest magnitude in that column (partial pivoting), which keeps the
+//         multipliers at most 1 in magnitude and limits growth on nearly singular matrices
+template<typename T>
+pair<int,int> LinearAlgebra<T>::findPivotInMatrix(Matrix<T> &mat, uint32_t startRow, uint32_t startCol, uint32_t endCol) {
     for(uint32_t c = startCol; c < endCol; c++) {
+        int bestRow = -1;
+        T largest = 0;
         for(uint32_t r = startRow; r < mat.rows; r++) {
-            if(mat(r,c) != 0) {
-                return make_pair(r,c);
+            if(abs(mat(r,c)) > largest) {
+                largest = abs(mat(r,c));
+                bestRow = (int)r;
             }
         }
+        if(bestRow != -1) {
+            return make_pair(bestRow, (int)c);
+        }
     }
     return make_pair(-1, -1);
 }
 
-//REQUIRES: mat is a valid matrix
+//REQUIRES: rref is in Reduced Row Echelon Form
 //MODIFIES: Nothing
-//EFFECTS: Turns a copy of the input matrix into its corresponding RREF
-//         Then returns a vector of bools for whether or not a pivot appears in a specific column in the matrix
-//         Note: Not having a reference is intentional, a copy is needed so that the original matrix is untouched
-vector<bool> LinearAlgebra::getIndepCols(Matrix<double> mat) { //I should return this by reference but then its a reference to a destructed object
-    subtractDown(mat, 0, 0, mat.columns);                       //maybe stealing means its not actually copied?
-    subtractUp(mat, 0, mat.columns);
-    vector<bool> independentCols(mat.columns, false);
+//EFFECTS: Returns a vector of bools for whether or not a pivot appears in a specific column in rref
+template<typename T>
+vector<bool> LinearAlgebra<T>::findPivotCols(const Matrix<T> &rref) {
+    vector<bool> pivotCols(rref.columns, false);
     uint32_t nextRow = 0;
-    for(uint32_t c = 0; c < mat.columns; c++) {
-        for(uint32_t r = nextRow; r < mat.rows; r++) {
-            if(mat(r, c) != 0) {
-                independentCols[c] = true;
+    for(uint32_t c = 0; c < rref.columns; c++) {
+        for(uint32_t r = nextRow; r < rref.rows; r++) {
+            if(rref(r, c) != 0) {
+                pivotCols[c] = true;
                 nextRow = r + 1;
                 break;
             }
         }
     }
+    return pivotCols;
+}
+
+//REQUIRES: columns has mat.columns entries
+//MODIFIES: Nothing
+//EFFECTS: Returns the columns of mat for which columns is true, in order
+template<typename T>
+Matrix<T> LinearAlgebra<T>::selectColumns(const Matrix<T> &mat, const vector<bool> &columns) {
+    Matrix<T> selected(mat.rows, (uint32_t)count(columns.begin(), columns.end(), true));
+    for(uint32_t r = 0; r < mat.rows; r++) {
+        const T *matRow = mat.rowPtr(r);
+        T *selectedRow = selected.rowPtr(r);
+        uint32_t next = 0;
+        for(uint32_t c = 0; c < mat.columns; c++) {
+            if(columns[c]) {
+                selectedRow[next++] = matRow[c];
+            }
+        }
+    }
+    return selected;
+}
+
+//REQUIRES: rref is in Reduced Row Echelon Form, pivotCols = findPivotCols(rref)
+//MODIFIES: Nothing
+//EFFECTS: Returns a basis for the null space with one column per free variable f: x_f = 1, every other free
+//         variable is 0 and the variable of the pivot in row r is -rref(r, f)
+template<typename T>
+Matrix<T> LinearAlgebra<T>::nullSpaceBasis(const Matrix<T> &rref, const vector<bool> &pivotCols) {
+    vector<uint32_t> pivots; //pivots[r] is the column of the pivot in row r
+    for(uint32_t c = 0; c < rref.columns; c++) {
+        if(pivotCols[c]) {
+            pivots.push_back(c);
+        }
+    }
+    Matrix<T> basis(rref.columns, rref.columns - (uint32_t)pivots.size());
+    uint32_t next = 0;
+    for(uint32_t f = 0; f < rref.columns; f++) {
+        if(pivotCols[f]) {
+            continue;
+        }
+        basis(f, next) = 1;
+        for(uint32_t r = 0; r < pivots.size(); r++) {
+            basis(pivots[r], next) = 0 - rref(r, f); //not -rref(r, f), which turns an exact zero into -0
+        }
+        next++;
+    }
+    return basis;
+}
 
-    return independentCols;
+//REQUIRES: rref is in Reduced Row Echelon Form
+//MODIFIES: Nothing
+//EFFECTS: Returns the rows of rref that are not entirely zero, a basis for the row space
+template<typename T>
+Matrix<T> LinearAlgebra<T>::nonzeroRows(const Matrix<T> &rref) {
+    vector<uint32_t> kept;
+    for(uint32_t r = 0; r < rref.rows; r++) {
+        const T *row = rref.rowPtr(r);
+        if(any_of(row, row + rref.columns, [](T value) { return value != 0; })) {
+            kept.push_back(r);
+        }
+    }
+    Matrix<T> basis((uint32_t)kept.size(), rref.columns);
+    for(uint32_t r = 0; r < kept.size(); r++) {
+        memcpy(basis.rowPtr(r), rref.rowPtr(kept[r]), rref.columns * sizeof(T));
+    }
+    return basis;
 }
 
 //REQUIRES: mat is a valid matrix
 //MODIFIES: Nothing
 //EFFECTS: Prints out the columns of a matrix individually
-void LinearAlgebra::printColumns(Matrix<double> const &mat) {
+template<typename T>
+void LinearAlgebra<T>::printColumns(Matrix<T> const &mat) {
     if(mat.getRows() == 0 || mat.getCols() == 0) { //Empty Matrix
-        cout << "[  ]\n\n";
+        out << "[  ]\n\n";
     }
     else { //Non-Empty Matrix
         for(uint32_t r = 0; r < mat.getRows() - 1; r++) {
             for(uint32_t c = 0; c < mat.getCols(); c++) {
-                cout << "[ " << mat(r,c) << " ]   ";
+                out << "[ " << mat(r,c) << " ]   ";
             }
-            cout << "\n";
+            out << "\n";
         }
         for(uint32_t c = 0; c < mat.getCols(); c++) {
-            cout << "[ " << mat(mat.getRows() - 1,c) << " ],  ";
+            out << "[ " << mat(mat.getRows() - 1,c) << " ],  ";
         }
-        cout << "\n\n";
+        out << "\n\n";
+    }
+}
+
+//REQUIRES: mat is a valid inverse, or an empty matrix if the input was singular
+//MODIFIES: Nothing
+//EFFECTS: Prints out the inverse, or that none exists
+template<typename T>
+void LinearAlgebra<T>::printInverse(Matrix<T> const &mat) {
+    if(mat.getRows() == 0) {
+        out << "None, the matrix is singular\n";
+    }
+    else {
+        out << mat;
     }
 }
 
 //REQUIRES: mat is a valid matrix
 //MODIFIES: Nothing
 //EFFECTS: Prints out the rows of a matrix individually
-void LinearAlgebra::printRows(Matrix<double> const &mat) {
+template<typename T>
+void LinearAlgebra<T>::printRows(Matrix<T> const &mat) {
     if(mat.getRows() == 0 || mat.getCols() == 0) { //Empty Matrix
-        cout << "[ ";
+        out << "[ ";
     }
     else { //Non-Empty Matrix
         for(uint32_t r = 0; r < mat.getRows() - 1; r++) {
-            cout << "[  ";
+            out << "[  ";
             for(uint32_t c = 0; c < mat.getCols(); c++) {
-                cout << mat(r,c) << " ";
+                out << mat(r,c) << " ";
             }
-            cout << " ],\n";
+            out << " ],\n";
         }
-        cout << "[  ";
+        out << "[  ";
         for(uint32_t c = 0; c < mat.getCols(); c++) {
-            cout << mat(mat.getRows() - 1,c) << " ";
+            out << mat(mat.getRows() - 1,c) << " ";
         }
     }
-    cout << " ]\n\n";
-}
\ No newline at end of file
+    out << " ]\n\n";
+}
+
+template class LinearAlgebra<float>;
+template class LinearAlgebra<double>;
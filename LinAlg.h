@@ -1,47 +1,237 @@
 #include "Matrix.h"
+#include "MatrixArena.h"
+#include "LUFactorization.h"
+#include "QRFactorization.h"
+#include "SparseMatrix.h"
+#include "SparseLU.h"
+#include "TiledMatrix.h"
+#include "Transpose.h"
+#include "ThreadPool.h"
+#include "MatrixFile.h"
+#include "InputReader.h"
+#include "MatrixBatch.h"
+#include "OutputWriter.h"
+#include "OpCounters.h"
+#include "RowKernels.h"
+#include <chrono>
+#include <cstdio>
 #include <vector>
+#include <memory>
 #include <utility>
 using namespace std;
 
+//Largest sparse input (rows x columns) converted to a dense Matrix for a command that only the dense code runs,
+//2^27 doubles are 1 GB
+const uint64_t SPARSE_DENSE_LIMIT = (uint64_t)1 << 27;
 
+//Element type the engine computes and prints in, chosen with --dtype before the engine is constructed
+enum class ScalarType { Float, Double };
+
+ScalarType scalarTypeOf(int argc, char *argv[]);
+
+//The engine, T is the element type of every matrix it reads, computes and writes (float or double)
+template<typename T>
 class LinearAlgebra {
 public:
     void printHelp(); //DONE
     void getMode(int argc, char* argv[]); //DONE
     void getInput(); //DONE
-    void subtractDown(Matrix<double> &mat, uint32_t row, uint32_t startCol, uint32_t endCol); //DONE
-    void subtractUp(Matrix<double> &mat, uint32_t startCol, uint32_t endCol); //DONE
-    void divideRow(Matrix<double> &mat, uint32_t row); //DONE
-    void interchangeRow(Matrix<double> &mat, uint32_t row1, uint32_t row2); //DONE
-    void transpose(Matrix<double> &mat); //DONE
-    void inverse(Matrix<double> &mat); //DONE
-    void subtractRow(Matrix<double> &mat, uint32_t toSubtract, uint32_t subtractFrom); //DONE
-    int findPivotInRow(Matrix<double> &mat, uint32_t row, uint32_t startCol, uint32_t endCol); //DONE
-    pair<int,int> findPivotInMatrix(Matrix<double> &mat, uint32_t startRow, uint32_t startCol, uint32_t endCol); //DONE
-    vector<bool> getIndepCols(Matrix<double> mat); //?Works?
-    void calcDeterminant(Matrix<double> &mat); //DONE
-    void findRowSpace(Matrix<double> &mat); //DONE
-    void findColSpace(Matrix<double> &mat); //DONE
-    void findNullSpace(Matrix<double> &mat); //DONE
-
-    double getDeterminant(Matrix<double> &mat); //DONE
-    Matrix<double>& getREF(uint32_t numInputMat); //DONE
-    Matrix<double>& getRREF(uint32_t numInputMat); //DONE
-    Matrix<double>& getInverse(uint32_t numInputMat); //DONE
-    Matrix<double>& getTranspose(uint32_t numInputMat); //DONE
-    Matrix<double>& getRowSpace(uint32_t numInputMat); //DONE
-    Matrix<double>& getColSpace(uint32_t numInputMat); //DONE
-    Matrix<double>& getNullSpace(uint32_t numInputMat); //DONE
+    void streamInput();
+    bool isStreaming() const {
+        return streaming;
+    }
+    void addMatrix(Matrix<T> mat, const string &command);
+    void addMatrix(SparseMatrix<T> mat, const string &command);
+    void subtractDown(Matrix<T> &mat, uint32_t row, uint32_t startCol, uint32_t endCol); //DONE
+    void subtractUp(Matrix<T> &mat, uint32_t startCol, uint32_t endCol); //DONE
+    void divideRow(Matrix<T> &mat, uint32_t row); //DONE
+    void interchangeRow(Matrix<T> &mat, uint32_t row1, uint32_t row2); //DONE
+    void inverse(Matrix<T> &mat); //DONE
+    void subtractRow(Matrix<T> &mat, uint32_t toSubtract, uint32_t subtractFrom); //DONE
+    int findPivotInRow(Matrix<T> &mat, uint32_t row, uint32_t startCol, uint32_t endCol); //DONE
+    pair<int,int> findPivotInMatrix(Matrix<T> &mat, uint32_t startRow, uint32_t startCol, uint32_t endCol); //DONE
+    vector<bool> findPivotCols(const Matrix<T> &rref);
+    Matrix<T> selectColumns(const Matrix<T> &mat, const vector<bool> &columns);
+    Matrix<T> nullSpaceBasis(const Matrix<T> &rref, const vector<bool> &pivotCols);
+    Matrix<T> nonzeroRows(const Matrix<T> &rref);
+
+    double getDeterminant(Matrix<T> &mat); //DONE
+    double getDeterminant(uint32_t numInputMat);
+    const LUFactorization<T>& getFactorization(uint32_t numInputMat);
+    const Matrix<T>& getREF(uint32_t numInputMat); //DONE
+    const Matrix<T>& getRREF(uint32_t numInputMat); //DONE
+    const vector<bool>& getPivotCols(uint32_t numInputMat);
+    const Matrix<T>& getSpaceBasis(uint32_t numInputMat);
+    uint32_t getRank(uint32_t numInputMat);
+    const Matrix<T>& getInverse(uint32_t numInputMat); //DONE
+    const Matrix<T>& getTranspose(uint32_t numInputMat); //DONE
+    const Matrix<T>& getRowSpace(uint32_t numInputMat); //DONE
+    const Matrix<T>& getColSpace(uint32_t numInputMat); //DONE
+    const Matrix<T>& getNullSpace(uint32_t numInputMat); //DONE
+    const Matrix<T>& getSolution(uint32_t numInputMat);
+    const Matrix<T>& getResult(uint32_t numInputMat);
+    const SparseLU<T>& getSparseFactorization(uint32_t numInputMat);
+    const SparseMatrix<T>& getSparseTranspose(uint32_t numInputMat);
+    const SparseMatrix<T>& getSparseSolution(uint32_t numInputMat);
+    bool isSparse(uint32_t numInputMat) const;
+    bool isTiled(uint32_t numInputMat) const;
 
     void processCommands(); //DONE
+    void processCommand(uint32_t c, ostream &notes);
+    bool processSparseCommand(uint32_t c, ostream &notes);
+    bool makeDense(uint32_t m, ostream &notes);
+    void processTiledCommand(uint32_t c, ostream &notes);
+    void checkCommandAllocations();
+    static bool isOperand(const string &command);
 
     void printInformation();
-    void printColumns(Matrix<double> const &mat); //DONE
-    void printRows(Matrix<double> const &mat); //DONE
+    void printResults(uint32_t m);
+    void releaseMatrix(uint32_t m);
+    void printSparseResults(uint32_t m);
+    void printTiledResults(uint32_t m);
+    void processBatch(uint32_t b);
+    void copyBatchResult(uint32_t m, Matrix<T> &result) const;
+    void printBatchResults(uint32_t m);
+    void printStats();
+    void writeMatrixFile();
+    void printColumns(Matrix<T> const &mat); //DONE
+    void printRows(Matrix<T> const &mat); //DONE
+    void printInverse(Matrix<T> const &mat);
 
 private:
-    vector<vector<Matrix<double>>> matrices;
+    //What one input matrix cost, collected for --stats, seconds are wall time on the thread that did the work
+    struct MatrixStats {
+        double parseSeconds = 0;
+        double computeSeconds = 0;
+        double printSeconds = 0;
+        uint64_t flops = 0;
+        uint64_t bytesAllocated = 0;
+        uint64_t allocations = 0;
+        uint32_t rows = 0; //after processCommands, an operand may have changed them
+        uint32_t columns = 0;
+    };
+
+    //The stats of every input matrix with one command, summed
+    struct CommandStats {
+        string command;
+        uint32_t matrices = 0;
+        MatrixStats sum;
+    };
+
+    enum class StatsFormat { None, Text, Json };
+
+    //What the row, column and null spaces (and the rank) are computed from: the RREF of the elimination, exact
+    //zero tests, or a column pivoted QR with a tolerance, whose row space basis is then reduced (QRFactorization)
+    enum class SpaceBackend { Rref, Qr };
+
+    //Everything derived from one input matrix, each piece is computed on first use and then shared by every
+    //result that needs it (REF and the inverse come from lu, the spaces from rref and pivotCols)
+    struct Analysis {
+        unique_ptr<LUFactorization<T>> lu; //of the leading square block
+        unique_ptr<Matrix<T>> ref;
+        unique_ptr<Matrix<T>> rref;
+        unique_ptr<vector<bool>> pivotCols;
+        unique_ptr<Matrix<T>> transpose;
+        unique_ptr<Matrix<T>> inverse; //empty if singular
+        unique_ptr<Matrix<T>> rowSpace;
+        unique_ptr<Matrix<T>> colSpace;
+        unique_ptr<Matrix<T>> nullSpace;
+        unique_ptr<Matrix<T>> solution;
+        unique_ptr<SparseLU<T>> sparseLu; //of the leading square block of a sparse input
+        unique_ptr<SparseMatrix<T>> sparseTranspose;
+        unique_ptr<SparseMatrix<T>> sparseSolution; //[ I | x ]
+        unique_ptr<TiledMatrix<T>> tiledTranspose; //of a tiled input
+        unique_ptr<TiledMatrix<T>> tiledSolution; //x alone, [ I | x ] is only put together to print it, empty if
+                                                  //the system is singular
+    };
+
+    //Consecutive small dense matrices of one shape with one command that the batch kernels compute (see
+    //getInput), stored in a MatrixBatch instead of one Matrix and Analysis each
+    struct Batch {
+        uint32_t first; //input index of the batch's first matrix, matrix first + i is lane i
+        MatrixBatch<T> inputs;
+        MatrixBatch<T> results; //the transposes, inverses or solutions x
+        vector<uint8_t> singular; //of each lane, for Inverse
+    };
+
+    //One per input matrix, every Matrix computed for it (its results, the temporaries behind them and the product
+    //an operand stores into it) is carved from its arena, which is freed at once after the matrix is printed
+    //Declared before the matrices so that it is destroyed after them
+    vector<unique_ptr<MatrixArena>> arenas;
+    unique_ptr<TileCache> tileCache; //of every tiled matrix, only with --tile-memory, outlives them like the arenas
+    vector<Matrix<T>> matrices; //the input matrices, operands update the next one in place
+    vector<unique_ptr<SparseMatrix<T>>> sparseMatrices; //set for a matrix kept sparse, matrices[m] is then empty
+    vector<unique_ptr<TiledMatrix<T>>> tiledMatrices; //set for a matrix too large for --tile-memory, matrices[m] is
+                                                      //then empty
     vector<string> commands;
-    uint32_t numMatrices;
+    vector<Analysis> analyses; //one per input matrix
+    vector<Batch> batches;
+    vector<uint32_t> batchOf; //the batch of each input matrix, NO_BATCH if it is a Matrix of its own
+    static constexpr uint32_t NO_BATCH = UINT32_MAX;
+    Matrix<T> batchInput; //a small matrix being parsed or a batch lane being printed, kept while the shape is the same
+    Matrix<T> batchOutput;
+    unique_ptr<MatrixFileReader> matrixFile; //binary input, stays mapped while its matrices view it
+    unique_ptr<InputReader> reader; //text input
+    uint32_t inputCount = 0; //matrices the input holds
+    bool streaming = false; //--stream, the matrices above are only the current window of the input
+    uint32_t indexBase = 0; //input index of matrices[0], nonzero only while streaming
+    ostream *messages = &cout; //where invalid commands are reported, cerr when stdout carries a matrix file
+    bool binaryOutput = false;
+    OutputWriter out{fileno(stdout)}; //text results, stdout is already redirected when this is constructed
+    uint32_t numMatrices = 0; //in the engine, all of the input unless streaming
     uint32_t precision = 2;
+    uint32_t luBlockSize = LU_DEFAULT_BLOCK_SIZE;
+    SpaceBackend spaceBackend = SpaceBackend::Rref;
+    uint32_t strassenCrossover = STRASSEN_DEFAULT_CROSSOVER; //of the * operand, STRASSEN_OFF for classical products
+    size_t tileMemory = 0; //bytes of --tile-memory, 0 keeps every dense matrix in memory
+    uint32_t tileSize = TILE_DEFAULT_SIZE;
+    string tileDirectory; //of the tile files, $TMPDIR or /tmp unless --tile-dir is given
+    bool checkAllocations = false; //--check-allocations, only taken by debug builds
+    StatsFormat statsFormat = StatsFormat::None;
+    string statsFile; //where printStats writes, stderr if empty
+    vector<MatrixStats> stats; //one per input matrix, only filled with --stats
+    double parsePhaseSeconds = 0; //wall time of getInput, processCommands and printInformation
+    double computePhaseSeconds = 0;
+    double printPhaseSeconds = 0;
+
+    //REQUIRES: m is a valid input matrix index, stats has an entry for it
+    //MODIFIES: stats[m]
+    //EFFECTS: Runs work, with --stats its wall time is added to the given phase of stats[m] and the flops and
+    //         allocations this thread counted meanwhile to stats[m], without --stats nothing is measured
+    template<typename Work>
+    void measure(uint32_t m, double MatrixStats::*phase, Work work) {
+        if(statsFormat == StatsFormat::None) {
+            work();
+            return;
+        }
+        const OpCounters before = opCounters;
+        const auto start = chrono::steady_clock::now();
+        work();
+        MatrixStats &matStats = stats[m];
+        matStats.*phase += secondsSince(start);
+        matStats.flops += opCounters.flops - before.flops;
+        matStats.bytesAllocated += opCounters.bytesAllocated - before.bytesAllocated;
+        matStats.allocations += opCounters.allocations - before.allocations;
+    }
+
+    static double secondsSince(chrono::steady_clock::time_point start) {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    void openInput();
+    void readNextMatrix(uint32_t index);
+    void checkInputEnd();
+    bool windowContinues() const;
+    bool batchableShape(uint32_t numRows, uint32_t numCols, uint32_t m) const;
+    bool batchable(const Matrix<T> &mat, uint32_t m) const;
+    bool addToBatch(const Matrix<T> &mat, uint32_t m);
+    bool tiles(uint32_t numRows, uint32_t numCols) const;
+    TiledMatrix<T> readTiled(uint32_t numRows, uint32_t numCols, uint32_t index);
+    bool tiledOperand(uint32_t m, ostream &notes);
+    static size_t resultBytes(const Analysis &analysis);
+    uint32_t rowsOf(uint32_t m) const;
+    uint32_t columnsOf(uint32_t m) const;
+    vector<CommandStats> statsByCommand();
+    void printStatsText(ostream &os, const vector<CommandStats> &byCommand);
+    void printStatsJson(ostream &os, const vector<CommandStats> &byCommand);
 };
\ No newline at end of file
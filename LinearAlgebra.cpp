@@ -3,13 +3,32 @@
 #include "LinAlg.h"
 using namespace std;
 
+//REQUIRES: argc, argv are valid
+//MODIFIES: cin, cout
+//EFFECTS: Runs the whole program with the engine for element type T
+template<typename T>
+void run(int argc, char* argv[]) {
+    LinearAlgebra<T> linal;
+    linal.getMode(argc, argv);
+    if(linal.isStreaming()) {
+        linal.streamInput();
+    }
+    else {
+        linal.getInput();
+        linal.processCommands();
+        linal.printInformation();
+    }
+    linal.printStats();
+}
+
 int main(int argc, char* argv[]) {
     ios_base::sync_with_stdio(false);
     xcode_redirect(argc, argv); //file redirection
 
-    LinearAlgebra linal;
-    linal.getMode(argc, argv);
-    linal.getInput();
-    linal.processCommands();
-    linal.printInformation();
-}
\ No newline at end of file
+    if(scalarTypeOf(argc, argv) == ScalarType::Float) {
+        run<float>(argc, argv);
+    }
+    else {
+        run<double>(argc, argv);
+    }
+}
@@ -1,14 +1,61 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
 #include <string>
 #include <cassert>
 #include <cstring>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "MatrixExpr.h"
+#include "OpCounters.h"
+#include "MatrixArena.h"
 
 using namespace std;
 
+//Alignment in bytes of every matrix buffer, each row is padded so that it also starts on this boundary
+const size_t MATRIX_ALIGNMENT = 64;
+
+template<typename T> class Matrix;
+template<typename T> Matrix<T> multiply(const Matrix<T> &A, const Matrix<T> &B);
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns an uninitialized MATRIX_ALIGNMENT aligned block of count elements, nullptr if count is 0
+//         The block is counted in this thread's opCounters
+template<typename T>
+T *alignedAllocate(size_t count) {
+    if(count == 0) {
+        return nullptr;
+    }
+    size_t bytes = (count * sizeof(T) + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    void *block = aligned_alloc(MATRIX_ALIGNMENT, bytes);
+    if(block == nullptr) {
+        throw bad_alloc();
+    }
+    countAllocation(bytes);
+    return static_cast<T *>(block);
+}
+
+//REQUIRES: block was returned by alignedAllocate or is nullptr
+//MODIFIES: block
+//EFFECTS: Releases the block
+inline void alignedFree(void *block) {
+    free(block);
+}
+
 template<typename T>
 
-class Matrix {
+class Matrix : public MatrixExpr<Matrix<T>> {
+    static_assert(is_trivially_copyable<T>::value, "Matrix elements are stored in a raw aligned buffer");
+
 public:
+    typedef T value_type;
+
     //Default Constructor
     //REQUIRES: Nothing
     //MODIFIES: this
@@ -19,81 +66,80 @@ public:
     //REQUIRES: numRows >= 0, numCols >= 0, matrixInit is valid
     //MODIFIES: this
     //EFFECTS: Creates a matrix of size numRows x numCols with all values set to zero
-    Matrix(uint32_t numRows, uint32_t numCols) : rows(numRows), columns(numCols), matrix(new T*[rows]) {
-        // assert((rows >= 0) && (columns >= 0));
-        for(uint32_t i = 0; i < rows; i++) {
-            matrix[i] = new T[columns];
-        }
-        for(uint32_t row = 0; row < rows; row++) {
-            for(uint32_t col = 0; col < columns; col++) {
-                matrix[row][col] = 0;
-            }
+    //         Like every constructor that allocates, it takes its buffer from the current MatrixArena if there is one
+    Matrix(uint32_t numRows, uint32_t numCols) : rows(numRows), columns(numCols), stride(paddedStride(numCols)) {
+        allocate((size_t)rows * stride);
+        resetRowOrder();
+        for(size_t e = 0; e < (size_t)rows * stride; e++) {
+            matrix[e] = 0;
         }
     }
-    
+
     //Constructor + Initializer
     //REQUIRES: numRows >=0, numCols >=0, matrixInit is valid
-    //MODIFIES: this
-    //EFFECTS: Creates a matrix of size numRows x numCols with values read in from matrixInit
-    Matrix(uint32_t numRows, uint32_t numCols, std::istream& matrixInit) : 
-        rows(numRows), columns(numCols), matrix(new T*[rows]) {
-        // assert((rows >= 0) && (columns >= 0));
-        for(uint32_t i = 0; i < rows; i++) {
-            matrix[i] = new T[columns];
+    //MODIFIES: this, matrixInit
+    //EFFECTS: Creates a matrix of size numRows x numCols with the next numRows * numCols values read in from matrixInit
+    //         Nothing past the last element is consumed (InputReader is the fast path for whole input files)
+    Matrix(uint32_t numRows, uint32_t numCols, std::istream& matrixInit) : Matrix(numRows, numCols) {
+        for(uint32_t row = 0; row < rows; row++) {
+            T *matRow = rowPtr(row);
+            for(uint32_t col = 0; col < columns && (matrixInit >> matRow[col]); col++) {}
         }
+    }
 
-        T input;
-        uint32_t row = 0;
-        uint32_t col = 0;
-        while(matrixInit >> input) {
-            matrix[row][col] = input;
-            if((++col % columns) == 0) { //reached the end of a row
-                col = 0;
-                row++;
-            }
-        }
+    //View Constructor
+    //REQUIRES: external holds numRows rows of numStride >= numCols elements, starts on a MATRIX_ALIGNMENT boundary
+    //          and outlives this matrix (e.g. a mapped MatrixFile)
+    //MODIFIES: this
+    //EFFECTS: Creates a matrix over external without copying it, the memory is written in place but never freed
+    //         Only the row order is allocated
+    Matrix(T *external, uint32_t numRows, uint32_t numCols, uint32_t numStride) : rows(numRows), columns(numCols),
+        stride(numStride) {
+        assert(numStride >= numCols && (uintptr_t)external % MATRIX_ALIGNMENT == 0);
+        allocate(0);
+        matrix = external;
+        resetRowOrder();
     }
 
     //Copy Constructor
     //REQUIRES: rhs is a valid matrix
     //MODIFIES: this
-    //EFFECTS: Default constructs this with atomic type variables of rhs, then deep copies the rhs matrix
-    Matrix(Matrix &rhs) : determinant(rhs.determinant), rows(rhs.rows), columns(rhs.columns), matrix(new T*[rows]) {
-        assert((rows >= 0) && (columns >= 0));
-        for(uint32_t i = 0; i < rows; i++) {
-            matrix[i] = new T[rhs.columns];
-        }
+    //EFFECTS: Allocates one buffer with the shape of rhs, then deep copies the rhs matrix in logical row order
+    Matrix(const Matrix &rhs) : determinant(rhs.determinant), rows(rhs.rows), columns(rhs.columns), stride(rhs.stride) {
+        allocate((size_t)rows * stride);
+        resetRowOrder();
         copyVals(rhs);
     }
-    
+
     //Assignment Operator
     //REQUIRES: rhs is a valid matrix
     //MODIFIES: this
-    //EFFECTS: Deep copy rhs member variables to this
+    //EFFECTS: Deep copy rhs member variables to this, the existing buffer is reused if it is the same size
     Matrix &operator=(const Matrix &rhs) {
         if(this == &rhs) { //if same matrix
             return *this;
         }
-        deleteMatrix();
+        if((size_t)rows * stride != (size_t)rhs.rows * rhs.stride || rows != rhs.rows) {
+            deleteMatrix();
+            rows = rhs.rows;
+            allocate((size_t)rhs.rows * rhs.stride);
+        }
         determinant = rhs.determinant;
         rows = rhs.rows;
         columns = rhs.columns;
-        matrix = new T*[rows];
-        for(uint32_t i = 0; i < rows; i++) {
-            matrix[i] = new T[rhs.columns];
-        }
+        stride = rhs.stride;
+        resetRowOrder();
         copyVals(rhs);
-
-        assert((rows >= 0) && (columns >= 0));
         return *this;
     }
 
     //Move Copy Constructor
     //REQUIRES: rhs is a valid rvalue Matrix
     //MODIFIES: this
-    //EFFECTS: Creates a default matrix to swap with (allowing for safe deconstruction of rhs after swapping)
-    //         Steals the data from rhs by swapping it with the default matrix, functionally a shallow copy 
-    Matrix(Matrix &&rhs) : Matrix() { //Create a default matrix to swap with
+    //EFFECTS: Starts as an empty matrix that owns nothing (allowing for safe deconstruction of rhs after swapping)
+    //         Steals the data from rhs by swapping it with the empty matrix, functionally a shallow copy
+    //         Never allocates or throws, so vectors of matrices move them when they grow instead of copying
+    Matrix(Matrix &&rhs) noexcept : rows(0), columns(0), stride(0) {
         swap(*this, rhs);
     }
 
@@ -102,11 +148,35 @@ public:
     //MODIFIES: this
     //EFFECTS: Steals the data from rhs by swapping it with this (allowing for safe deconstruction of rhs after swapping)
     //         Functionally a shallow copy
-    Matrix &operator=(Matrix &&rhs) {
+    Matrix &operator=(Matrix &&rhs) noexcept {
         swap(*this, rhs);
         return *this;
     }
-    
+
+    //Expression Constructor
+    //REQUIRES: expr is a valid element-wise expression (see MatrixExpr.h)
+    //MODIFIES: this
+    //EFFECTS: Creates a matrix of the expression's shape and evaluates the whole expression into it in one pass
+    template<typename E>
+    Matrix(const MatrixExpr<E> &expr) : Matrix(expr.self().getRows(), expr.self().getCols()) {
+        evaluate(expr.self());
+    }
+
+    //Expression Assignment Operator
+    //REQUIRES: expr is a valid element-wise expression (see MatrixExpr.h)
+    //MODIFIES: this
+    //EFFECTS: Evaluates the expression into this in one pass, reusing the buffer when the shape already matches
+    //         The expression may read this matrix, every element only depends on the same position of its operands
+    template<typename E>
+    Matrix &operator=(const MatrixExpr<E> &expr) {
+        if(rows != expr.self().getRows() || columns != expr.self().getCols()) {
+            return *this = Matrix(expr);
+        }
+        evaluate(expr.self());
+        determinant = 1;
+        return *this;
+    }
+
     //Destructor
     //REQUIRES: Nothing
     //MODIFIES: matrix
@@ -122,23 +192,65 @@ public:
     uint32_t getCols() const {
         return columns;
     }
+    //Leading dimension of the buffer, the number of elements between the starts of two physical rows
+    uint32_t getStride() const {
+        return stride;
+    }
+    //Bytes of the block this matrix allocated (its elements and row order, only the row order for a view)
+    size_t getStorageBytes() const {
+        return storageBytes;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns numCols rounded up so that every row of the buffer starts on a MATRIX_ALIGNMENT boundary,
+    //         the stride of a numCols wide matrix
+    static uint32_t paddedStride(uint32_t numCols) {
+        const uint32_t perLine = (MATRIX_ALIGNMENT % sizeof(T) == 0) ? (uint32_t)(MATRIX_ALIGNMENT / sizeof(T)) : 1;
+        return (numCols + perLine - 1) / perLine * perLine;
+    }
+
+    //REQUIRES: row is within the bounds of the matrix
+    //MODIFIES: Nothing
+    //EFFECTS: Returns a pointer to the first element of the logical row, the row's columns are contiguous
+    T *rowPtr(uint32_t row) {
+        assert(row < rows);
+        return matrix + (size_t)rowOrder[row] * stride;
+    }
+    const T *rowPtr(uint32_t row) const {
+        assert(row < rows);
+        return matrix + (size_t)rowOrder[row] * stride;
+    }
+
+    //Row accessor used when the matrix is an operand of an expression
+    const T *exprRow(uint32_t row) const {
+        return rowPtr(row);
+    }
+
+    //REQUIRES: row1 and row2 are within the bounds of the matrix
+    //MODIFIES: rowOrder
+    //EFFECTS: Swaps the logical positions of row1 and row2 in O(1) without moving any elements
+    void interchangeRows(uint32_t row1, uint32_t row2) {
+        assert(row1 < rows && row2 < rows);
+        std::swap(rowOrder[row1], rowOrder[row2]);
+    }
 
     ///////////////////////////////////////////////// OPERATORS ////////////////////////////////////////////////////
     //REQUIRES: row and col are within the bounds of the matrix (>=0 and < numRows/numCols)
     //MODIFIES: Nothing
     //EFFECTS: Returns the value of the matrix in the [row,col] position by non-const reference
     T &operator()(uint32_t row, uint32_t col) {
-        assert(row >= 0 && row < rows);
-        assert(col >= 0 && col < columns);
-        return matrix[row][col];
+        assert(row < rows);
+        assert(col < columns);
+        return matrix[(size_t)rowOrder[row] * stride + col];
     }
     //REQUIRES: row and col are within the bounds of the matrix (>=0 and < numRows/numCols)
     //MODIFIES: Nothing
     //EFFECTS: Returns the value of the matrix in the [row,col] position by const reference
     const T &operator()(uint32_t row, uint32_t col) const {
-        assert(row >= 0 && row < rows);
-        assert(col >= 0 && col < columns);
-        return matrix[row][col];
+        assert(row < rows);
+        assert(col < columns);
+        return matrix[(size_t)rowOrder[row] * stride + col];
     }
 
     //REQUIRES: matrix and rhs are valid matrices
@@ -150,8 +262,10 @@ public:
             return false;
         }
         for(uint32_t row = 0; row < rows; row++) {
+            const T *lhsRow = rowPtr(row);
+            const T *rhsRow = rhs.rowPtr(row);
             for(uint32_t col = 0; col < columns; col++) {
-                if(matrix[row][col] != rhs(row,col)) {
+                if(lhsRow[col] != rhsRow[col]) {
                     return false;
                 }
             }
@@ -161,7 +275,7 @@ public:
 
     //REQUIRES: matrix and rhs are valid matrices
     //MODIFIES: Nothing
-    //EFFECTS: Returns whether the matrices are either not of the same shape or not every element 
+    //EFFECTS: Returns whether the matrices are either not of the same shape or not every element
     //         in the RHS matrix is equal to its corresponding element in the LHS matrix
     bool operator!=(const Matrix &rhs) const {
         return !(*this == rhs);
@@ -170,106 +284,223 @@ public:
     //REQUIRES: matrix and rhs are valid and of the same shape and type
     //          and the '+' operator is defined for the type
     //MODIFIES: matrix
-    //EFFECTS: Adds the RHS matrix to the LHS matrix
-    Matrix &operator+(const Matrix &rhs) {
-        assert((rows == rhs.rows) && (columns == rhs.columns));
-        for(uint32_t row = 0; row < rows; row++) {
-            for(uint32_t col = 0; col < columns; col++) {
-                matrix[row][col] += rhs(row,col);
-            }
-        }
-        return *this;
+    //EFFECTS: Adds the RHS matrix (or element-wise expression) to the LHS matrix in one pass
+    template<typename E>
+    Matrix &operator+=(const MatrixExpr<E> &rhs) {
+        return *this = *this + rhs;
     }
-    
-    //REQUIRES: matrix and rhs are valid and of the same shape and type 
+
+    //REQUIRES: matrix and rhs are valid and of the same shape and type
     //          and the '-' operator is defined for the type
     //MODIFIES: matrix
-    //EFFECTS: Subtracts the RHS matrix from the LHS matrix
-    Matrix &operator-(const Matrix &rhs) {
-        assert((rows == rhs.rows) && (columns == rhs.columns));
-        for(uint32_t row = 0; row < rows; row++) {
-            for(uint32_t col = 0; col < columns; col++) {
-                matrix[row][col] -= rhs(row,col);
-            }
-        }
-        return *this;
+    //EFFECTS: Subtracts the RHS matrix (or element-wise expression) from the LHS matrix in one pass
+    template<typename E>
+    Matrix &operator-=(const MatrixExpr<E> &rhs) {
+        return *this = *this - rhs;
     }
 
     //REQUIRES: matrix and rhs are valid matrices, matrix.columns == rhs.rows
     //          rhs and matrix are of the same type and the '*' operator is defined for the type
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the product of matrix and RHS, computed by the blocked GEMM kernel in Gemm.h, never Strassen
+    Matrix operator*(const Matrix &rhs) const {
+        return multiply(*this, rhs);
+    }
+
+    //REQUIRES: matrix and rhs are valid matrices, matrix.columns == rhs.rows
+    //MODIFIES: matrix
+    //EFFECTS: Replaces matrix with the product of matrix and RHS, the product is moved in rather than copied
+    Matrix &operator*=(const Matrix &rhs) {
+        return *this = multiply(*this, rhs);
+    }
+
+    //REQUIRES: the '*' operator is defined for the type T
     //MODIFIES: matrix
-    //EFFECTS: Multiplies matrix and RHS
-    Matrix &operator*(const Matrix &rhs) {
-        assert(columns == rhs.rows);
-        Matrix toReturn(rows, rhs.columns);
+    //EFFECTS: Multiplies each value in matrix by the input coefficient
+    Matrix &operator*=(T coefficient) {
+        return scale(coefficient);
+    }
 
-        T sum = 0;
+    //REQUIRES: matrix is valid, the '*' operator is defined for the type T
+    //MODIFIES: matrix
+    //EFFECTS: Multiplies each value in matrix by the input coefficient
+    Matrix &scale(T coefficient) {
         for(uint32_t row = 0; row < rows; row++) {
-            for(uint32_t col = 0; col < rhs.columns; col++) {
-                for(uint32_t elements = 0; elements < columns; elements++) {
-                    sum += matrix[row][elements] * rhs(elements,col);
-                }
-                toReturn(row,col) = sum;
-                sum = 0;
+            T *matRow = rowPtr(row);
+            for(uint32_t col = 0; col < columns; col++) {
+                matRow[col] *= coefficient;
             }
         }
-        *this = toReturn;
         return *this;
     }
 
-    //REQUIRES: matrix is valid, the '*' operator is defined for the type T
+    //REQUIRES: matrix is valid
     //MODIFIES: matrix
-    //EFFECTS: Multiplies each value in matrix by the input coefficient
-    Matrix scale(T coefficient) {
+    //EFFECTS: Replaces every -0 with 0, so that an exact zero prints the same however it was computed
+    Matrix &clearNegativeZeros() {
         for(uint32_t row = 0; row < rows; row++) {
+            T *matRow = rowPtr(row);
             for(uint32_t col = 0; col < columns; col++) {
-                matrix[row][col] *= coefficient;
+                matRow[col] += T(0); //-0 + 0 is 0, every other value is unchanged
             }
         }
         return *this;
     }
-    
+
     double determinant = 1;
     uint32_t rows;
     uint32_t columns;
-    T ** matrix;
 
 private:
+    uint32_t stride; //elements per physical row, columns rounded up to a multiple of the alignment
+    T *matrix = nullptr; //rows x stride elements in one MATRIX_ALIGNMENT aligned block
+    uint32_t *rowOrder = nullptr; //rowOrder[logical row] = physical row in matrix, stored after the elements
+    void *storage = nullptr; //the block holding the elements and rowOrder, only rowOrder for a view
+    size_t storageBytes = 0;
+    MatrixArena *arena = nullptr; //where storage came from, nullptr for the heap
+
+    //REQUIRES: expr has the same shape as this
+    //MODIFIES: matrix
+    //EFFECTS: Writes every element of expr into this, row by row so the inner loop is contiguous
+    template<typename E>
+    void evaluate(const E &expr) {
+        for(uint32_t row = 0; row < rows; row++) {
+            T *dest = rowPtr(row);
+            auto source = expr.exprRow(row);
+            for(uint32_t col = 0; col < columns; col++) {
+                dest[col] = source[col];
+            }
+        }
+    }
+
+    //REQUIRES: rows is set, nothing is allocated
+    //MODIFIES: matrix, rowOrder, storage, storageBytes, arena
+    //EFFECTS: Allocates one block for elements elements followed by rows row order entries, from the current
+    //         MatrixArena or else the heap, matrix is nullptr if there are no elements
+    void allocate(size_t elements) {
+        const size_t elementBytes = (elements * sizeof(T) + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+        storageBytes = elementBytes + (size_t)rows * sizeof(uint32_t);
+        arena = MatrixArena::current();
+        if(storageBytes != 0) {
+            storage = arena != nullptr ? arena->allocate(storageBytes) : alignedAllocate<char>(storageBytes);
+            countMatrixBytes(storageBytes);
+        }
+        matrix = elements == 0 ? nullptr : static_cast<T *>(storage);
+        rowOrder = reinterpret_cast<uint32_t *>(static_cast<char *>(storage) + elementBytes);
+    }
+
+    //REQUIRES: rowOrder has rows entries
+    //MODIFIES: rowOrder
+    //EFFECTS: Sets every logical row to its own physical row
+    void resetRowOrder() {
+        for(uint32_t row = 0; row < rows; row++) {
+            rowOrder[row] = row;
+        }
+    }
+
     //REQUIRES: matrix is valid
     //MODIFIES: matrix
-    //EFFECTS: deletes matrix
+    //EFFECTS: deletes matrix, giving the block back to the arena it came from, a view only lets go of its memory
     void deleteMatrix() {
-        for(uint32_t row = 0; row < rows; row++) {
-            delete[] matrix[row];
+        if(storage != nullptr) {
+            if(arena != nullptr) {
+                arena->deallocate(storage, storageBytes);
+            }
+            else {
+                alignedFree(storage);
+            }
         }
-        delete[] matrix;
+        matrix = nullptr;
+        rowOrder = nullptr;
+        storage = nullptr;
+        storageBytes = 0;
     }
 
-    //REQUIRES: rhs is a valid matrix
+    //REQUIRES: rhs is a valid matrix of the same shape, this has the identity row order
     //MODIFIES: matrix
-    //EFFECTS: Copies the RHS matrix into the lhs matrix
+    //EFFECTS: Copies the RHS matrix into the lhs matrix, one contiguous row (padding included) at a time
     void copyVals(const Matrix &rhs) {
+        if(stride == 0) { //no columns, nothing allocated
+            return;
+        }
         for(uint32_t row = 0; row < rows; row++) {
-            for(uint32_t col = 0; col < columns; col++) {
-                matrix[row][col] = rhs.matrix[row][col];
-            }
+            memcpy(matrix + (size_t)row * stride, rhs.rowPtr(row), stride * sizeof(T));
         }
     }
 
     //REQUIRES: first and second are valid matrices
     //MODIFIES: first and second
     //EFFECTS: Swaps the rows, columns determinants and matrices of first and second
-    void swap(Matrix<T> &first, Matrix<T> &second) { //custom swap for matrices
+    void swap(Matrix<T> &first, Matrix<T> &second) noexcept { //custom swap for matrices
         std::swap(first.rows, second.rows);
         std::swap(first.columns, second.columns);
         std::swap(first.determinant, second.determinant);
-        T** temp = first.matrix;
+        std::swap(first.stride, second.stride);
+        std::swap(first.rowOrder, second.rowOrder);
+        std::swap(first.storage, second.storage);
+        std::swap(first.storageBytes, second.storageBytes);
+        std::swap(first.arena, second.arena);
+        T *temp = first.matrix;
         first.matrix = second.matrix;
         second.matrix = temp; //need to let it destruct safely w/o destructing the swapped matrix
     }
 
 };
 
+//Rectangular window of a matrix, logical rows [row, row + rows) and columns [col, col + columns)
+//M is Matrix<T> for a writable block or const Matrix<T> for a read-only one, kernels that take blocks
+//can work on part of a matrix in place (e.g. the trailing submatrix of a factorization)
+template<typename M>
+struct MatrixBlock {
+    M *mat;
+    uint32_t row;
+    uint32_t col;
+    uint32_t rows;
+    uint32_t columns;
+
+    //REQUIRES: r < rows
+    //MODIFIES: Nothing
+    //EFFECTS: Returns a pointer to the first element of row r of the block, its columns are contiguous
+    auto rowPtr(uint32_t r) const {
+        return mat->rowPtr(row + r) + col;
+    }
+};
+
+//REQUIRES: the block lies within mat
+//MODIFIES: Nothing
+//EFFECTS: Returns the numRows x numCols block of mat whose top left element is [row, col]
+template<typename T>
+MatrixBlock<Matrix<T>> subBlock(Matrix<T> &mat, uint32_t row, uint32_t col, uint32_t numRows, uint32_t numCols) {
+    assert(row + numRows <= mat.rows && col + numCols <= mat.columns);
+    return MatrixBlock<Matrix<T>>{&mat, row, col, numRows, numCols};
+}
+template<typename T>
+MatrixBlock<const Matrix<T>> subBlock(const Matrix<T> &mat, uint32_t row, uint32_t col, uint32_t numRows, uint32_t numCols) {
+    assert(row + numRows <= mat.rows && col + numCols <= mat.columns);
+    return MatrixBlock<const Matrix<T>>{&mat, row, col, numRows, numCols};
+}
+
+//REQUIRES: the window lies within block
+//MODIFIES: Nothing
+//EFFECTS: Returns the numRows x numCols block of block whose top left element is [row, col]
+template<typename M>
+MatrixBlock<M> subBlock(const MatrixBlock<M> &block, uint32_t row, uint32_t col, uint32_t numRows, uint32_t numCols) {
+    assert(row + numRows <= block.rows && col + numCols <= block.columns);
+    return MatrixBlock<M>{block.mat, block.row + row, block.col + col, numRows, numCols};
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns a block covering all of mat
+template<typename T>
+MatrixBlock<Matrix<T>> wholeBlock(Matrix<T> &mat) {
+    return subBlock(mat, 0, 0, mat.rows, mat.columns);
+}
+template<typename T>
+MatrixBlock<const Matrix<T>> wholeBlock(const Matrix<T> &mat) {
+    return subBlock(mat, 0, 0, mat.rows, mat.columns);
+}
+
 //REQUIRES: mat is a valid matrix
 //MODIFIES: Nothing
 //EFFECTS: Prints out the matrix
@@ -289,4 +520,9 @@ std::ostream &operator<<(std::ostream &os, const Matrix<T> &mat) {
     }
 
     return os;
-}
\ No newline at end of file
+}
+
+#include "Gemm.h"
+#include "Strassen.h"
+
+#endif
@@ -0,0 +1,98 @@
+#include "MatrixArena.h"
+#include "Matrix.h"
+
+namespace {
+    thread_local MatrixArena *currentArena = nullptr;
+
+    size_t roundToAlignment(size_t bytes) {
+        return (bytes + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    }
+}
+
+MatrixArena::Scope::Scope(MatrixArena *arena) : previous(currentArena) {
+    currentArena = arena;
+}
+
+MatrixArena::Scope::~Scope() {
+    currentArena = previous;
+}
+
+MatrixArena::MatrixArena(size_t firstChunkBytes) : firstChunkBytes(roundToAlignment(firstChunkBytes)),
+    nextChunkBytes(this->firstChunkBytes) {}
+
+MatrixArena::~MatrixArena() {
+    release();
+}
+
+void *MatrixArena::allocate(size_t bytes) {
+    bytes = roundToAlignment(bytes);
+    Chunk *chunk = chunks.empty() ? nullptr : &chunks.back();
+    if(bytes > ARENA_CHUNK_LIMIT || chunk == nullptr || chunk->size - chunk->used < bytes) {
+        chunk = &addChunk(bytes, bytes > ARENA_CHUNK_LIMIT);
+    }
+    void *block = chunk->data + chunk->used;
+    chunk->used += bytes;
+    chunk->live++;
+    return block;
+}
+
+void MatrixArena::deallocate(void *block, size_t bytes) {
+    bytes = roundToAlignment(bytes);
+    char *start = static_cast<char *>(block);
+    for(size_t c = chunks.size(); c-- > 0;) { //recent blocks are the ones most likely given back
+        Chunk &chunk = chunks[c];
+        if(start < chunk.data || start >= chunk.data + chunk.size) {
+            continue;
+        }
+        chunk.live--;
+        if(start + bytes == chunk.data + chunk.used) {
+            chunk.used -= bytes;
+        }
+        if(chunk.live == 0) {
+            if(c + 1 == chunks.size()) { //keep carving from it
+                chunk.used = 0;
+            }
+            else { //nothing is carved from older chunks or from a block's own chunk again
+                alignedFree(chunk.data);
+                chunks.erase(chunks.begin() + (ptrdiff_t)c);
+            }
+        }
+        return;
+    }
+    assert(false && "block does not belong to this arena");
+}
+
+void MatrixArena::release() {
+    for(Chunk &chunk : chunks) {
+        alignedFree(chunk.data);
+    }
+    chunks.clear();
+    nextChunkBytes = firstChunkBytes;
+}
+
+size_t MatrixArena::bytesReserved() const {
+    size_t bytes = 0;
+    for(const Chunk &chunk : chunks) {
+        bytes += chunk.size;
+    }
+    return bytes;
+}
+
+MatrixArena *MatrixArena::current() {
+    return currentArena;
+}
+
+//REQUIRES: bytes is a multiple of MATRIX_ALIGNMENT
+//MODIFIES: this
+//EFFECTS: Allocates a chunk of exactly bytes for a block of its own, placed before the chunk blocks are carved from,
+//         or else the next chunk to carve from, of at least bytes
+MatrixArena::Chunk &MatrixArena::addChunk(size_t bytes, bool ownChunk) {
+    const size_t size = ownChunk ? bytes : max(bytes, nextChunkBytes);
+    Chunk chunk{alignedAllocate<char>(size), size, 0, 0};
+    if(ownChunk) {
+        return *chunks.insert(chunks.empty() ? chunks.end() : chunks.end() - 1, chunk);
+    }
+    nextChunkBytes = min(nextChunkBytes * 2, ARENA_CHUNK_LIMIT);
+    chunks.push_back(chunk);
+    return chunks.back();
+}
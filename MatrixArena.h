@@ -0,0 +1,81 @@
+#ifndef MATRIXARENA_H
+#define MATRIXARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+//Size of the first chunk an arena allocates unless it is told otherwise, each further chunk doubles up to
+//ARENA_CHUNK_LIMIT so that an arena makes a handful of allocations however many blocks it hands out
+const size_t ARENA_FIRST_CHUNK_BYTES = (size_t)16 << 10;
+//Largest chunk blocks are carved from, a larger block gets a chunk of its own that is freed as soon as the block is
+const size_t ARENA_CHUNK_LIMIT = (size_t)1 << 20;
+
+//Bump allocator for matrix buffers: blocks are carved in order out of a few large MATRIX_ALIGNMENT aligned chunks
+//and everything is returned to the heap at once by release, so a batch of small matrices costs a few mallocs
+//instead of several per matrix and leaves no holes behind in the heap
+//Giving a block back only reclaims its space when it is the newest block of its chunk (temporaries freed in
+//reverse order) or the last live block of its chunk, anything else waits for release
+//An arena is used by one thread at a time, Matrix takes its buffers from the arena of the current Scope
+class MatrixArena {
+public:
+    //Makes arena the one Matrix allocates from on this thread until the scope ends, nullptr means the heap
+    //Scopes nest, the previous arena is current again afterwards
+    class Scope {
+    public:
+        explicit Scope(MatrixArena *arena);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        MatrixArena *previous;
+    };
+
+    explicit MatrixArena(size_t firstChunkBytes = ARENA_FIRST_CHUNK_BYTES);
+    ~MatrixArena();
+    MatrixArena(const MatrixArena &) = delete;
+    MatrixArena &operator=(const MatrixArena &) = delete;
+
+    //REQUIRES: bytes > 0
+    //MODIFIES: this
+    //EFFECTS: Returns an uninitialized MATRIX_ALIGNMENT aligned block of at least bytes bytes, a new chunk is
+    //         allocated (and counted in this thread's opCounters) when the current one is full
+    void *allocate(size_t bytes);
+
+    //REQUIRES: block was returned by allocate(bytes) on this arena and not given back since
+    //MODIFIES: this
+    //EFFECTS: Gives the block back, see the class comment for when its space can be reused
+    void deallocate(void *block, size_t bytes);
+
+    //REQUIRES: No block of this arena is used afterwards
+    //MODIFIES: this
+    //EFFECTS: Frees every chunk, the next allocation starts over with a first chunk
+    void release();
+
+    //Bytes of the chunks currently held
+    size_t bytesReserved() const;
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the arena of this thread's innermost Scope, nullptr outside any (or in a nullptr Scope)
+    static MatrixArena *current();
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+        size_t used; //blocks are carved from [0, used)
+        size_t live; //blocks not given back yet
+    };
+
+    vector<Chunk> chunks; //the last one is the chunk new blocks are carved from
+    size_t firstChunkBytes;
+    size_t nextChunkBytes;
+
+    Chunk &addChunk(size_t bytes, bool ownChunk);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef MATRIXBATCH_H
+#define MATRIXBATCH_H
+
+#include "Matrix.h"
+#include "FixedMatrix.h"
+#include "RowKernels.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+//Most matrices the input reader groups into one batch, each batch is one task of the thread pool, so this keeps a
+//batch's planes within L2 and a long run of small matrices split into enough tasks for every thread
+const uint32_t BATCH_MAX_SIZE = 4096;
+
+//N same-shape matrices stored element by element (structure of arrays): plane (r, c) holds element [r, c] of every
+//matrix of the batch contiguously, so a kernel runs the same operation on a whole vector of matrices at a time
+//instead of one small matrix per call (see the batch kernels below)
+//Planes are MATRIX_ALIGNMENT aligned and padded to whole lines, the padding lanes hold zeros
+//The batch owns its block, there is no row order, and it is allocated from the heap, never from a MatrixArena
+template<typename T>
+class MatrixBatch {
+    static_assert(is_trivially_copyable<T>::value, "Batch elements are stored in a raw aligned buffer");
+
+public:
+    typedef T value_type;
+
+    //Lanes handled by one step of a batch kernel, one MATRIX_ALIGNMENT line of elements (8 doubles, 16 floats)
+    static constexpr uint32_t CHUNK = (uint32_t)(MATRIX_ALIGNMENT / sizeof(T));
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Creates an empty batch of numRows x numCols matrices with room for capacity of them before it grows
+    explicit MatrixBatch(uint32_t numRows = 0, uint32_t numCols = 0, uint32_t capacity = 0)
+        : rows(numRows), columns(numCols) {
+        reserve(capacity);
+    }
+
+    ~MatrixBatch() {
+        alignedFree(data);
+    }
+
+    MatrixBatch(const MatrixBatch &) = delete;
+    MatrixBatch &operator=(const MatrixBatch &) = delete;
+
+    MatrixBatch(MatrixBatch &&rhs) noexcept : rows(rhs.rows), columns(rhs.columns), count(rhs.count),
+        stride(rhs.stride), data(rhs.data) {
+        rhs.count = 0;
+        rhs.stride = 0;
+        rhs.data = nullptr;
+    }
+
+    MatrixBatch &operator=(MatrixBatch &&rhs) noexcept {
+        std::swap(rows, rhs.rows);
+        std::swap(columns, rhs.columns);
+        std::swap(count, rhs.count);
+        std::swap(stride, rhs.stride);
+        std::swap(data, rhs.data);
+        return *this;
+    }
+
+    uint32_t getRows() const {
+        return rows;
+    }
+    uint32_t getCols() const {
+        return columns;
+    }
+    //Number of matrices in the batch
+    uint32_t size() const {
+        return count;
+    }
+    //Elements between the starts of two planes, a multiple of CHUNK that is at least size()
+    uint32_t getStride() const {
+        return stride;
+    }
+
+    //REQUIRES: row < rows, col < columns
+    //MODIFIES: Nothing
+    //EFFECTS: Returns element [row, col] of every matrix, the one of matrix i at index i
+    T *plane(uint32_t row, uint32_t col) {
+        assert(row < rows && col < columns);
+        return data + ((size_t)row * columns + col) * stride;
+    }
+    const T *plane(uint32_t row, uint32_t col) const {
+        assert(row < rows && col < columns);
+        return data + ((size_t)row * columns + col) * stride;
+    }
+
+    //REQUIRES: i < size(), row < rows, col < columns
+    //MODIFIES: Nothing
+    //EFFECTS: Returns element [row, col] of matrix i
+    T &operator()(uint32_t i, uint32_t row, uint32_t col) {
+        assert(i < count);
+        return plane(row, col)[i];
+    }
+    const T &operator()(uint32_t i, uint32_t row, uint32_t col) const {
+        assert(i < count);
+        return plane(row, col)[i];
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Makes room for capacity matrices, the matrices already in the batch are kept
+    void reserve(uint32_t capacity) {
+        const uint32_t newStride = (capacity + CHUNK - 1) / CHUNK * CHUNK;
+        if(newStride <= stride) {
+            return;
+        }
+        const size_t planes = (size_t)rows * columns;
+        T *grown = alignedAllocate<T>(planes * newStride);
+        for(size_t p = 0; p < planes; p++) {
+            if(count != 0) {
+                memcpy(grown + p * newStride, data + p * stride, count * sizeof(T));
+            }
+            memset(grown + p * newStride + count, 0, (newStride - count) * sizeof(T));
+        }
+        alignedFree(data);
+        data = grown;
+        stride = newStride;
+    }
+
+    //REQUIRES: newCount >= size()
+    //MODIFIES: this
+    //EFFECTS: Makes the batch hold newCount matrices, the new ones are zero
+    void resize(uint32_t newCount) {
+        assert(newCount >= count);
+        reserve(newCount);
+        count = newCount;
+    }
+
+    //REQUIRES: mat is rows x columns
+    //MODIFIES: this
+    //EFFECTS: Adds a copy of mat as the last matrix, doubling the capacity when the batch is full
+    void append(const Matrix<T> &mat) {
+        assert(mat.rows == rows && mat.columns == columns);
+        if(count == stride) {
+            reserve(max(2 * stride, CHUNK));
+        }
+        for(uint32_t r = 0; r < rows; r++) {
+            const T *matRow = mat.rowPtr(r);
+            for(uint32_t c = 0; c < columns; c++) {
+                plane(r, c)[count] = matRow[c];
+            }
+        }
+        count++;
+    }
+
+    //REQUIRES: i < size(), mat is rows x columns
+    //MODIFIES: mat
+    //EFFECTS: Copies matrix i into mat, which is how a single matrix of the batch is handed to the Matrix code
+    void copyTo(uint32_t i, Matrix<T> &mat) const {
+        assert(i < count && mat.rows == rows && mat.columns == columns);
+        for(uint32_t r = 0; r < rows; r++) {
+            T *matRow = mat.rowPtr(r);
+            for(uint32_t c = 0; c < columns; c++) {
+                matRow[c] = plane(r, c)[i];
+            }
+        }
+    }
+
+    //REQUIRES: i < size()
+    //MODIFIES: Nothing
+    //EFFECTS: Returns a copy of matrix i as a Matrix
+    Matrix<T> matrix(uint32_t i) const {
+        Matrix<T> mat(rows, columns);
+        copyTo(i, mat);
+        return mat;
+    }
+
+private:
+    uint32_t rows;
+    uint32_t columns;
+    uint32_t count = 0;
+    uint32_t stride = 0;
+    T *data = nullptr; //rows x columns planes of stride elements
+};
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the batch of the transposes of the matrices of batch, each plane is copied whole to the plane of
+//         the mirrored position, so nothing is rearranged within a plane
+template<typename T>
+MatrixBatch<T> transposed(const MatrixBatch<T> &batch) {
+    MatrixBatch<T> result(batch.getCols(), batch.getRows(), batch.size());
+    result.resize(batch.size());
+    for(uint32_t r = 0; r < batch.getRows(); r++) {
+        for(uint32_t c = 0; c < batch.getCols(); c++) {
+            memcpy(result.plane(c, r), batch.plane(r, c), batch.size() * sizeof(T));
+        }
+    }
+    return result;
+}
+
+//The batch kernels below work on MatrixBatch::CHUNK matrices at a time, loading them into local arrays whose
+//innermost dimension is the lane, so every operation is one vector instruction across the chunk
+//They are compiled once per instruction set (BatchKernels.cpp) and run the one of level, by default the level
+//rowKernels() picked for the CPU
+//Each lane performs exactly the operations of the FixedMatrix code for one matrix, in the same order (branches
+//become selects), so a matrix gets the same bits in a batch as on its own (FixedLU, and through it
+//LUFactorization)
+//Every kernel takes matrices of 1 to FIXED_MAX_SIZE rows
+
+//REQUIRES: A holds square matrices
+//MODIFIES: inverses, determinants, singular
+//EFFECTS: Sets inverses to the inverses of A, determinants[i] to det(A[i]) and singular[i] to whether A[i] is
+//         singular (FixedLU::isSingular), in which case inverses[i] is unspecified
+template<typename T>
+void batchInverse(const MatrixBatch<T> &A, MatrixBatch<T> &inverses, vector<T> &determinants,
+                  vector<uint8_t> &singular, RowKernelLevel level = rowKernels().level);
+
+//REQUIRES: A holds square matrices
+//MODIFIES: determinants
+//EFFECTS: Sets determinants[i] to det(A[i]), the product of the pivots of its FixedLU factorization
+template<typename T>
+void batchDeterminant(const MatrixBatch<T> &A, vector<T> &determinants, RowKernelLevel level = rowKernels().level);
+
+//REQUIRES: systems holds n x (n + 1) augmented systems [ A | b ]
+//MODIFIES: solutions, singular
+//EFFECTS: Sets solutions[i] to the n x 1 solution x of A x = b and singular[i] to whether A is singular, in which
+//         case solutions[i] is unspecified
+template<typename T>
+void batchSolve(const MatrixBatch<T> &systems, MatrixBatch<T> &solutions, vector<uint8_t> &singular,
+                RowKernelLevel level = rowKernels().level);
+
+//REQUIRES: A and B hold square matrices of one size and as many of them
+//MODIFIES: products
+//EFFECTS: Sets products[i] to A[i] * B[i], accumulated in the order of FixedMatrix's operator*
+template<typename T>
+void batchMultiply(const MatrixBatch<T> &A, const MatrixBatch<T> &B, MatrixBatch<T> &products,
+                   RowKernelLevel level = rowKernels().level);
+
+#endif
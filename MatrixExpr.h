@@ -0,0 +1,156 @@
+#ifndef MATRIXEXPR_H
+#define MATRIXEXPR_H
+
+#include <cassert>
+#include <cstdint>
+
+using namespace std;
+
+template<typename T> class Matrix;
+
+//Base of every lazily evaluated element-wise matrix expression (CRTP)
+//A node exposes getRows(), getCols() and exprRow(row), where exprRow returns something indexable by column
+//Nothing is computed until the expression is assigned to a Matrix, which then evaluates every operator
+//in one fused pass per row with no intermediate matrices
+template<typename Derived>
+class MatrixExpr {
+public:
+    const Derived &self() const {
+        return static_cast<const Derived &>(*this);
+    }
+};
+
+//How a node holds its operands: matrices by reference, intermediate nodes by value
+//so that a node built from temporaries stays valid after the full expression ends
+template<typename E>
+struct ExprStorage {
+    typedef const E type;
+};
+template<typename T>
+struct ExprStorage<Matrix<T>> {
+    typedef const Matrix<T> &type;
+};
+
+struct ExprAdd {
+    template<typename T>
+    static T apply(T lhs, T rhs) {
+        return lhs + rhs;
+    }
+};
+struct ExprSubtract {
+    template<typename T>
+    static T apply(T lhs, T rhs) {
+        return lhs - rhs;
+    }
+};
+
+//Element-wise lhs (op) rhs
+template<typename Op, typename L, typename R>
+class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<Op, L, R>> {
+public:
+    typedef typename L::value_type value_type;
+
+    //One row of the expression, evaluates an element on demand
+    template<typename LRow, typename RRow>
+    struct Row {
+        LRow lhs;
+        RRow rhs;
+        value_type operator[](uint32_t col) const {
+            return Op::apply(lhs[col], rhs[col]);
+        }
+    };
+
+    //REQUIRES: lhs and rhs have the same shape
+    //MODIFIES: this
+    //EFFECTS: Records the operands, nothing is evaluated
+    MatrixBinaryExpr(const L &lhsIn, const R &rhsIn) : lhs(lhsIn), rhs(rhsIn) {
+        assert(lhs.getRows() == rhs.getRows() && lhs.getCols() == rhs.getCols());
+    }
+
+    uint32_t getRows() const {
+        return lhs.getRows();
+    }
+    uint32_t getCols() const {
+        return lhs.getCols();
+    }
+    auto exprRow(uint32_t row) const {
+        auto lhsRow = lhs.exprRow(row);
+        auto rhsRow = rhs.exprRow(row);
+        return Row<decltype(lhsRow), decltype(rhsRow)>{lhsRow, rhsRow};
+    }
+
+private:
+    typename ExprStorage<L>::type lhs;
+    typename ExprStorage<R>::type rhs;
+};
+
+//Element-wise coefficient * operand
+template<typename E>
+class MatrixScaledExpr : public MatrixExpr<MatrixScaledExpr<E>> {
+public:
+    typedef typename E::value_type value_type;
+
+    template<typename InnerRow>
+    struct Row {
+        value_type coefficient;
+        InnerRow inner;
+        value_type operator[](uint32_t col) const {
+            return coefficient * inner[col];
+        }
+    };
+
+    MatrixScaledExpr(value_type coefficientIn, const E &operandIn) : coefficient(coefficientIn), operand(operandIn) {}
+
+    uint32_t getRows() const {
+        return operand.getRows();
+    }
+    uint32_t getCols() const {
+        return operand.getCols();
+    }
+    auto exprRow(uint32_t row) const {
+        auto innerRow = operand.exprRow(row);
+        return Row<decltype(innerRow)>{coefficient, innerRow};
+    }
+
+private:
+    value_type coefficient;
+    typename ExprStorage<E>::type operand;
+};
+
+//REQUIRES: lhs and rhs have the same shape
+//MODIFIES: Nothing
+//EFFECTS: Returns the lazy element-wise sum, neither operand is changed
+template<typename L, typename R>
+MatrixBinaryExpr<ExprAdd, L, R> operator+(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs) {
+    return MatrixBinaryExpr<ExprAdd, L, R>(lhs.self(), rhs.self());
+}
+
+//REQUIRES: lhs and rhs have the same shape
+//MODIFIES: Nothing
+//EFFECTS: Returns the lazy element-wise difference, neither operand is changed
+template<typename L, typename R>
+MatrixBinaryExpr<ExprSubtract, L, R> operator-(const MatrixExpr<L> &lhs, const MatrixExpr<R> &rhs) {
+    return MatrixBinaryExpr<ExprSubtract, L, R>(lhs.self(), rhs.self());
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the lazy product of every element with coefficient
+template<typename E>
+MatrixScaledExpr<E> operator*(typename E::value_type coefficient, const MatrixExpr<E> &operand) {
+    return MatrixScaledExpr<E>(coefficient, operand.self());
+}
+template<typename E>
+MatrixScaledExpr<E> operator*(const MatrixExpr<E> &operand, typename E::value_type coefficient) {
+    return MatrixScaledExpr<E>(coefficient, operand.self());
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the lazy negation of every element
+template<typename E>
+MatrixScaledExpr<E> operator-(const MatrixExpr<E> &operand) {
+    return MatrixScaledExpr<E>(-1, operand.self());
+}
+
+#endif
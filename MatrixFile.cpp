@@ -0,0 +1,91 @@
+#include "MatrixFile.h"
+#include <algorithm>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MatrixFileReader::isMatrixFile(int fd) {
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (size_t)info.st_size < sizeof(MatrixFileHeader)) {
+        return false;
+    }
+    char magic[sizeof(MATRIX_FILE_MAGIC)];
+    return pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic)
+           && memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+MatrixFileReader::MatrixFileReader(int fd) {
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MatrixFileHeader)) {
+        fail("the file is too short to hold a header");
+    }
+    size = (size_t)info.st_size;
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED) {
+        fail("the file could not be mapped");
+    }
+    base = static_cast<char *>(map);
+
+    const MatrixFileHeader &head = header();
+    if(memcmp(head.magic, MATRIX_FILE_MAGIC, sizeof(head.magic)) != 0) {
+        fail("not a matrix file");
+    }
+    if(head.byteOrder != MATRIX_FILE_BYTE_ORDER) {
+        fail("the file was written on a machine with a different byte order");
+    }
+    if(head.version != MATRIX_FILE_VERSION) {
+        fail("version " + to_string(head.version) + " is not supported, expected " + to_string(MATRIX_FILE_VERSION));
+    }
+    if(head.entrySize != sizeof(MatrixFileEntry) || head.fileSize > size
+       || sizeof(MatrixFileHeader) + (uint64_t)head.count * sizeof(MatrixFileEntry) > head.fileSize) {
+        fail("the header does not match the size of the file (truncated?)");
+    }
+    for(uint32_t m = 0; m < head.count; m++) {
+        const MatrixFileEntry &matInfo = entry(m);
+        const string which = "matrix " + to_string(m) + ": ";
+        if(matInfo.dtype != MATRIX_FILE_FLOAT64 && matInfo.dtype != MATRIX_FILE_FLOAT32) {
+            fail(which + "unknown element type " + to_string(matInfo.dtype));
+        }
+        if(matInfo.stride < matInfo.columns || matInfo.offset % MATRIX_ALIGNMENT != 0) {
+            fail(which + "the stride is less than the column count or the data is not aligned");
+        }
+        const uint64_t bytes = (uint64_t)matInfo.rows * matInfo.stride * elementSize(matInfo.dtype);
+        if(matInfo.offset > head.fileSize || bytes > head.fileSize - matInfo.offset) {
+            fail(which + "the elements run past the end of the file");
+        }
+        if(memchr(matInfo.command, '\0', MATRIX_FILE_COMMAND_SIZE) == nullptr) {
+            fail(which + "the command is not terminated");
+        }
+    }
+}
+
+void MatrixFileReader::release(uint32_t first, uint32_t end) {
+    if(first >= end) {
+        return;
+    }
+    uint64_t begin = UINT64_MAX;
+    uint64_t finish = 0;
+    for(uint32_t m = first; m < end; m++) {
+        const MatrixFileEntry &matInfo = entry(m);
+        begin = min(begin, matInfo.offset);
+        finish = max(finish, matInfo.offset + (uint64_t)matInfo.rows * matInfo.stride * elementSize(matInfo.dtype));
+    }
+    const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    begin = (begin + page - 1) / page * page;
+    finish = finish / page * page;
+    if(begin < finish) { //pages touched again are read from the file, a private modification is dropped
+        madvise(base + begin, (size_t)(finish - begin), MADV_DONTNEED);
+    }
+}
+
+MatrixFileReader::~MatrixFileReader() {
+    if(base != nullptr) {
+        munmap(base, size);
+    }
+}
+
+void MatrixFileReader::fail(const string &message) {
+    cerr << "Matrix file error: " << message << "\n";
+    exit(1);
+}
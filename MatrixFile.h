@@ -0,0 +1,242 @@
+#ifndef MATRIXFILE_H
+#define MATRIXFILE_H
+
+#include "Matrix.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Binary matrix container, the alternative to the text format for large batches
+//
+//  offset 0    MatrixFileHeader (64 bytes)
+//  offset 64   count MatrixFileEntry records (64 bytes each)
+//  then        the elements of each matrix at its entry's offset, a multiple of MATRIX_ALIGNMENT,
+//              rows x stride elements in row order (the stride - columns padding elements are ignored)
+//
+//All fields are in the byte order of the machine that wrote the file, byteOrder tells a reader if that is not its own
+//Because every block is aligned like a Matrix buffer, a mapped file is used in place as the matrices' storage
+
+const char MATRIX_FILE_MAGIC[8] = {'L', 'I', 'N', 'A', 'L', 'G', 'M', 'F'};
+const uint32_t MATRIX_FILE_VERSION = 1;
+const uint32_t MATRIX_FILE_BYTE_ORDER = 0x01020304;
+const uint32_t MATRIX_FILE_COMMAND_SIZE = 32; //bytes for the command, including the terminating '\0'
+
+//Element types, the numbering is part of the format
+const uint32_t MATRIX_FILE_FLOAT64 = 1;
+const uint32_t MATRIX_FILE_FLOAT32 = 2;
+
+struct MatrixFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count; //number of matrices
+    uint32_t entrySize; //sizeof(MatrixFileEntry) when written
+    uint32_t byteOrder; //MATRIX_FILE_BYTE_ORDER as written
+    uint64_t fileSize;
+    char reserved[32];
+};
+
+struct MatrixFileEntry {
+    uint64_t offset; //bytes from the start of the file to row 0
+    uint32_t rows;
+    uint32_t columns;
+    uint32_t stride; //elements from the start of one row to the next
+    uint32_t dtype; //MATRIX_FILE_FLOAT64 or MATRIX_FILE_FLOAT32
+    uint32_t source; //index of the input matrix this one belongs to (its own index in an input file)
+    uint32_t reserved;
+    char command[MATRIX_FILE_COMMAND_SIZE]; //input: the command to run, output: which result this is
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64 && sizeof(MatrixFileEntry) == 64, "The layout is part of the format");
+
+template<typename T> struct MatrixFileDType;
+template<> struct MatrixFileDType<double> {
+    static const uint32_t value = MATRIX_FILE_FLOAT64;
+};
+template<> struct MatrixFileDType<float> {
+    static const uint32_t value = MATRIX_FILE_FLOAT32;
+};
+
+//Read side of the container, maps the whole file once and hands out matrices that view the mapping
+//The mapping is private and writable, so a matrix modified in place (e.g. by +) changes memory, never the file
+//Malformed files are reported and end the program, like malformed text input
+class MatrixFileReader {
+public:
+    //REQUIRES: fd is open for reading
+    //MODIFIES: Nothing
+    //EFFECTS: Returns whether fd is a regular file that starts with MATRIX_FILE_MAGIC, nothing is consumed
+    static bool isMatrixFile(int fd);
+
+    //REQUIRES: isMatrixFile(fd)
+    //MODIFIES: this
+    //EFFECTS: Maps the file behind fd and checks the header and every entry against the file size
+    explicit MatrixFileReader(int fd);
+
+    //REQUIRES: no matrix viewing the file is used afterwards
+    //MODIFIES: this
+    //EFFECTS: Unmaps the file
+    ~MatrixFileReader();
+
+    MatrixFileReader(const MatrixFileReader &) = delete;
+    MatrixFileReader &operator=(const MatrixFileReader &) = delete;
+
+    uint32_t count() const {
+        return header().count;
+    }
+
+    const MatrixFileEntry &entry(uint32_t index) const {
+        assert(index < count());
+        return reinterpret_cast<const MatrixFileEntry *>(base + sizeof(MatrixFileHeader))[index];
+    }
+
+    string command(uint32_t index) const {
+        return string(entry(index).command);
+    }
+
+    //REQUIRES: first <= end <= count(), no matrix viewing first to end - 1 is used afterwards
+    //MODIFIES: this
+    //EFFECTS: Gives the pages that lie entirely within the elements of matrices first to end - 1 back to the
+    //         kernel, so that a file read piece by piece (--stream) does not stay resident as a whole
+    void release(uint32_t first, uint32_t end);
+
+    //REQUIRES: index < count(), this outlives the returned matrix
+    //MODIFIES: Nothing
+    //EFFECTS: Returns matrix index, a view of the mapped elements when the file stores T,
+    //         otherwise a converted copy
+    template<typename T>
+    Matrix<T> matrix(uint32_t index) const {
+        const MatrixFileEntry &info = entry(index);
+        if(info.dtype == MatrixFileDType<T>::value && (uint64_t)info.rows * info.stride != 0) {
+            return Matrix<T>(reinterpret_cast<T *>(base + info.offset), info.rows, info.columns, info.stride);
+        }
+        Matrix<T> converted(info.rows, info.columns);
+        for(uint32_t r = 0; r < info.rows; r++) {
+            const char *row = base + info.offset + (uint64_t)r * info.stride * elementSize(info.dtype);
+            T *dest = converted.rowPtr(r);
+            for(uint32_t c = 0; c < info.columns; c++) {
+                if(info.dtype == MATRIX_FILE_FLOAT64) {
+                    dest[c] = (T)reinterpret_cast<const double *>(row)[c];
+                }
+                else {
+                    dest[c] = (T)reinterpret_cast<const float *>(row)[c];
+                }
+            }
+        }
+        return converted;
+    }
+
+private:
+    char *base = nullptr;
+    size_t size = 0;
+
+    const MatrixFileHeader &header() const {
+        return *reinterpret_cast<const MatrixFileHeader *>(base);
+    }
+
+    static uint32_t elementSize(uint32_t dtype) {
+        return dtype == MATRIX_FILE_FLOAT64 ? 8 : 4;
+    }
+
+    [[noreturn]] static void fail(const string &message);
+};
+
+//Write side of the container, collects matrices and then writes header, entries and aligned data in one pass
+template<typename T>
+class MatrixFileWriter {
+public:
+    //REQUIRES: mat stays valid and unchanged until write
+    //MODIFIES: this
+    //EFFECTS: Queues mat as the next entry, command is cut to MATRIX_FILE_COMMAND_SIZE - 1 characters
+    void add(const Matrix<T> &mat, uint32_t source, const string &command) {
+        items.push_back(Item{&mat, mat.rows, mat.columns, mat.getStride(), 0, nullptr, source, command});
+    }
+
+    //REQUIRES: fill sets the first min(bandRows, numRows - firstRow) rows of band to rows firstRow, ... of the
+    //          matrix until write, bandRows >= 1
+    //MODIFIES: this
+    //EFFECTS: Queues a numRows x numCols matrix that is never held in memory as a whole (a TiledMatrix or a result
+    //         derived from one): write has fill produce it a band of bandRows rows at a time
+    void add(uint32_t numRows, uint32_t numCols, uint32_t bandRows, function<void(uint32_t, Matrix<T> &)> fill,
+             uint32_t source, const string &command) {
+        items.push_back(Item{nullptr, numRows, numCols, Matrix<T>::paddedStride(numCols), bandRows, move(fill), source,
+                             command});
+    }
+
+    //REQUIRES: os is opened in binary mode (stdout is on the systems this builds on)
+    //MODIFIES: os
+    //EFFECTS: Writes the container with every queued matrix, rows in logical order
+    void write(ostream &os) const {
+        const uint64_t dataStart = alignUp(sizeof(MatrixFileHeader) + items.size() * sizeof(MatrixFileEntry));
+        vector<MatrixFileEntry> entries(items.size());
+        uint64_t offset = dataStart;
+        for(size_t i = 0; i < items.size(); i++) {
+            const Item &item = items[i];
+            MatrixFileEntry &info = entries[i];
+            memset(&info, 0, sizeof(info));
+            info.offset = offset;
+            info.rows = item.rows;
+            info.columns = item.columns;
+            info.stride = item.stride;
+            info.dtype = MatrixFileDType<T>::value;
+            info.source = item.source;
+            item.command.copy(info.command, MATRIX_FILE_COMMAND_SIZE - 1);
+            offset += alignUp((uint64_t)item.rows * item.stride * sizeof(T));
+        }
+
+        MatrixFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+        header.version = MATRIX_FILE_VERSION;
+        header.count = (uint32_t)items.size();
+        header.entrySize = sizeof(MatrixFileEntry);
+        header.byteOrder = MATRIX_FILE_BYTE_ORDER;
+        header.fileSize = offset;
+
+        static const char zeros[MATRIX_ALIGNMENT] = {};
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        os.write(reinterpret_cast<const char *>(entries.data()), (streamsize)(entries.size() * sizeof(MatrixFileEntry)));
+        os.write(zeros, (streamsize)(dataStart - sizeof(header) - entries.size() * sizeof(MatrixFileEntry)));
+        for(const Item &item : items) {
+            const size_t rowBytes = (size_t)item.stride * sizeof(T);
+            if(item.mat != nullptr) {
+                for(uint32_t r = 0; r < item.rows; r++) {
+                    os.write(reinterpret_cast<const char *>(item.mat->rowPtr(r)), (streamsize)rowBytes);
+                }
+            }
+            else if(item.rows > 0) {
+                Matrix<T> band(min(item.bandRows, item.rows), item.columns);
+                for(uint32_t first = 0; first < item.rows; first += band.rows) {
+                    item.fill(first, band);
+                    for(uint32_t r = 0; r < band.rows && first + r < item.rows; r++) {
+                        os.write(reinterpret_cast<const char *>(band.rowPtr(r)), (streamsize)rowBytes);
+                    }
+                }
+            }
+            const uint64_t blockBytes = (uint64_t)item.rows * rowBytes;
+            os.write(zeros, (streamsize)(alignUp(blockBytes) - blockBytes));
+        }
+    }
+
+private:
+    struct Item {
+        const Matrix<T> *mat; //null for a matrix produced by fill
+        uint32_t rows;
+        uint32_t columns;
+        uint32_t stride;
+        uint32_t bandRows;
+        function<void(uint32_t, Matrix<T> &)> fill;
+        uint32_t source;
+        string command;
+    };
+    vector<Item> items;
+
+    static uint64_t alignUp(uint64_t bytes) {
+        return (bytes + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    }
+};
+
+#endif
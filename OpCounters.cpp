@@ -0,0 +1,3 @@
+#include "OpCounters.h"
+
+thread_local OpCounters opCounters;
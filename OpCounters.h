@@ -0,0 +1,54 @@
+#ifndef OPCOUNTERS_H
+#define OPCOUNTERS_H
+
+#include <cstdint>
+
+using namespace std;
+
+//Work done by the kernels, counted per thread so that counting costs one add to thread local memory
+//A caller snapshots its thread's counters before and after a piece of work to attribute it (see --stats)
+//A kernel counts its flops on the thread that calls it, including the parts the thread pool runs for it
+struct OpCounters {
+    uint64_t flops = 0;
+    uint64_t bytesAllocated = 0;
+    uint64_t allocations = 0;
+    uint64_t matrixBytes = 0; //of every Matrix buffer, carved from an arena or not (bytesAllocated only sees chunks)
+    uint64_t scratchBytes = 0; //the part of matrixBytes allocated inside a ScratchScope
+    uint32_t scratchScopes = 0; //ScratchScopes open on this thread
+};
+
+extern thread_local OpCounters opCounters;
+
+inline void countFlops(uint64_t flops) {
+    opCounters.flops += flops;
+}
+
+inline void countAllocation(uint64_t bytes) {
+    opCounters.bytesAllocated += bytes;
+    opCounters.allocations++;
+}
+
+inline void countMatrixBytes(uint64_t bytes) {
+    opCounters.matrixBytes += bytes;
+    if(opCounters.scratchScopes != 0) {
+        opCounters.scratchBytes += bytes;
+    }
+}
+
+//Declares the matrices allocated while it is alive as workspace an algorithm needs by design (the factors of a
+//mixed precision solve, the copy a QR factorization works on), which --check-allocations allows a command on top
+//of its results, unlike a copy that a move or an in place update would have avoided
+class ScratchScope {
+public:
+    ScratchScope() {
+        opCounters.scratchScopes++;
+    }
+    ~ScratchScope() {
+        opCounters.scratchScopes--;
+    }
+
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#include "OutputWriter.h"
+#include <cerrno>
+#include <iostream>
+#include <unistd.h>
+
+OutputWriter::OutputWriter(int fdOut) : fd(fdOut), buffer(BUFFER_SIZE) {}
+
+OutputWriter::~OutputWriter() {
+    flush();
+}
+
+void OutputWriter::flush() {
+    size_t written = 0;
+    while(written < used) {
+        ssize_t got = write(fd, buffer.data() + written, used - written);
+        if(got < 0 && errno == EINTR) {
+            continue;
+        }
+        if(got <= 0) {
+            used = 0; //nothing more can be written, do not try again from the destructor
+            cerr << "Output error: " << strerror(errno) << "\n";
+            exit(1);
+        }
+        written += (size_t)got;
+    }
+    flushedBytes += used;
+    used = 0;
+}
@@ -0,0 +1,161 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "TiledMatrix.h"
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Buffered text output over a file descriptor, the counterpart of InputReader
+//Numbers are formatted with to_chars straight into one large buffer, which is written out in big blocks,
+//so printing a result costs about as much as copying its text
+//Doubles come out exactly as a stream set to fixed and setprecision(precision) prints them (including "-0.00")
+class OutputWriter {
+public:
+    //REQUIRES: fd is open for writing
+    //MODIFIES: this
+    //EFFECTS: Prepares an empty buffer for fd, doubles are printed with 2 decimal places until setPrecision
+    explicit OutputWriter(int fd);
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Writes out whatever is still buffered
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Sets the number of decimal places of every double printed afterwards
+    void setPrecision(uint32_t decimals) {
+        precision = decimals;
+    }
+
+    OutputWriter &operator<<(const char *text) {
+        return append(text, strlen(text));
+    }
+    OutputWriter &operator<<(const string &text) {
+        return append(text.data(), text.size());
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Appends value in decimal
+    OutputWriter &operator<<(uint32_t value) {
+        reserve(16);
+        used = (size_t)(to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data());
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Appends value in fixed notation with precision decimal places
+    OutputWriter &operator<<(double value) {
+        reserve(MAX_FIXED_DIGITS + precision);
+        char *first = buffer.data() + used;
+        used = (size_t)(to_chars(first, buffer.data() + buffer.size(), value, chars_format::fixed, (int)precision).ptr
+                        - buffer.data());
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Appends mat in the same layout as operator<<(ostream &, const Matrix &)
+    template<typename T>
+    OutputWriter &operator<<(const Matrix<T> &mat) {
+        if(mat.getRows() == 0 || mat.getCols() == 0) {
+            return *this << "[  ]\n";
+        }
+        for(uint32_t row = 0; row < mat.getRows(); row++) {
+            const T *values = mat.rowPtr(row);
+            *this << "[  ";
+            for(uint32_t col = 0; col < mat.getCols(); col++) {
+                *this << (double)values[col] << " ";
+            }
+            *this << " ]\n";
+        }
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Appends mat in coordinate form, the input layout of a sparse matrix: a "Sparse [Rows] [Columns]
+    //         [Nonzeros]" line, then one "row col value" line per nonzero in row major order
+    template<typename T>
+    OutputWriter &operator<<(const SparseMatrix<T> &mat) {
+        SparseMatrix<T> held;
+        const SparseMatrix<T> &rows = csrOf(mat, held);
+        *this << "Sparse " << rows.rows << " " << rows.columns << " " << to_string(rows.nonzeros()) << "\n";
+        for(uint32_t r = 0; r < rows.rows; r++) {
+            for(size_t p = rows.starts[r]; p < rows.starts[r + 1]; p++) {
+                *this << r << " " << rows.indices[p] << " " << (double)rows.values[p] << "\n";
+            }
+        }
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this, mat's cache
+    //EFFECTS: Appends mat in the same layout as a Matrix, loading one tile row of it at a time
+    template<typename T>
+    OutputWriter &operator<<(const TiledMatrix<T> &mat) {
+        if(mat.rows == 0 || mat.columns == 0) {
+            return *this << "[  ]\n";
+        }
+        MatrixArena::Scope heap(nullptr);
+        Matrix<T> band(min(mat.getTileSize(), mat.rows), mat.columns);
+        for(uint32_t first = 0; first < mat.rows; first += band.rows) {
+            const uint32_t count = min(band.rows, mat.rows - first);
+            mat.loadRows(first, band, 0, count);
+            *this << Matrix<T>(band.rowPtr(0), count, band.columns, band.getStride());
+        }
+        return *this;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Writes the buffer to fd, a failed write is reported to cerr and ends the program
+    void flush();
+
+    //Bytes appended so far, flushed or not
+    uint64_t bytesWritten() const {
+        return flushedBytes + used;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20; //bytes collected before a write
+    static const size_t MAX_FIXED_DIGITS = 320; //sign, digits of the largest double and the decimal point
+
+    int fd;
+    vector<char> buffer;
+    size_t used = 0; //bytes of buffer waiting to be written
+    uint64_t flushedBytes = 0;
+    uint32_t precision = 2;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Makes room for at least bytes more characters, flushing or growing the buffer
+    void reserve(size_t bytes) {
+        if(buffer.size() - used < bytes) {
+            flush();
+            if(buffer.size() < bytes) {
+                buffer.resize(bytes);
+            }
+        }
+    }
+
+    OutputWriter &append(const char *text, size_t length) {
+        reserve(length);
+        memcpy(buffer.data() + used, text, length);
+        used += length;
+        return *this;
+    }
+};
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef QRFACTORIZATION_H
+#define QRFACTORIZATION_H
+
+#include "Matrix.h"
+#include "RowKernels.h"
+#include "Transpose.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+using namespace std;
+
+//Columns per panel of both blocked factorizations
+const uint32_t QR_DEFAULT_BLOCK_SIZE = 32;
+//A matrix with at least this many times as many rows as columns is first reduced to its square R by a QR without
+//pivoting, which is all GEMM, and the column pivoting then runs on that R instead of on every row of the matrix
+const uint32_t QR_TALL_RATIO = 2;
+
+//Householder QR with column pivoting, A * P = Q * R, used to find the rank and the spaces of a matrix
+//At step k the remaining column with the largest norm moves to position k, so |R(k,k)| decreases and the rank is
+//the number of diagonal entries above max(rows, columns) * eps * |R(0,0)|, a rank that rounding noise can not raise
+//the way an exact zero test after elimination can
+//Both the pivoted and the unpivoted factorization are blocked (compact WY form): a panel of reflectors is built
+//with vector operations and then applied to the rest of the matrix as one GEMM, which also runs on the thread pool
+//Only R and P are kept, the space computations do not need Q
+template<typename T>
+class QRFactorization {
+public:
+    //REQUIRES: A is a valid matrix, blockSize >= 1
+    //MODIFIES: this
+    //EFFECTS: Factors a copy of A, blockSize reflectors at a time
+    //         The copy, the panels and R are workspace of whoever asked for the factorization (ScratchScope)
+    explicit QRFactorization(const Matrix<T> &A, uint32_t blockSize = QR_DEFAULT_BLOCK_SIZE)
+        : permutation(A.columns) {
+        const ScratchScope scratch;
+        const uint32_t m = A.rows;
+        const uint32_t n = A.columns;
+        iota(permutation.begin(), permutation.end(), 0);
+        Matrix<T> work(A);
+        if(m >= (uint64_t)QR_TALL_RATIO * n && n > 0) {
+            factorUnpivoted(work, blockSize);
+            Matrix<T> square(n, n);
+            for(uint32_t row = 0; row < n; row++) {
+                memcpy(square.rowPtr(row) + row, work.rowPtr(row) + row, (n - row) * sizeof(T));
+            }
+            work = move(square);
+        }
+        factorPivoted(work, blockSize);
+
+        const uint32_t diagonal = min(work.rows, n);
+        r = Matrix<T>(diagonal, n);
+        for(uint32_t row = 0; row < diagonal; row++) {
+            memcpy(r.rowPtr(row) + row, work.rowPtr(row) + row, (n - row) * sizeof(T));
+        }
+        threshold = diagonal == 0 ? 0 : (T)max(m, n) * numeric_limits<T>::epsilon() * abs(r(0,0));
+        while(numRank < diagonal && abs(r(numRank, numRank)) > threshold) {
+            numRank++;
+        }
+    }
+
+    //Number of diagonal entries of R above the threshold
+    uint32_t rank() const {
+        return numRank;
+    }
+
+    //R, min(rows, columns) x columns and upper trapezoidal, its columns in pivoted order
+    const Matrix<T> &getR() const {
+        return r;
+    }
+
+    //permutation[k] is the column of A that is column k of R
+    const vector<uint32_t> &getPermutation() const {
+        return permutation;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the row space of A in reduced row echelon form, one row per dimension, which is the RREF of A
+    //         without its zero rows: the first rank() rows of R (the same row space) with the columns put back in
+    //         order, reduced by Gauss-Jordan that only takes pivots above the threshold
+    //         A column without such a pivot is left as a free column and the noise left of each pivot is zeroed,
+    //         should fewer than rank() pivots pass the threshold the rows without one are left out
+    Matrix<T> rowSpaceBasis() const {
+        const uint32_t n = r.columns;
+        Matrix<T> basis(numRank, n);
+        for(uint32_t row = 0; row < numRank; row++) {
+            const T *rRow = r.rowPtr(row);
+            T *basisRow = basis.rowPtr(row);
+            for(uint32_t k = row; k < n; k++) {
+                basisRow[permutation[k]] = rRow[k];
+            }
+        }
+
+        vector<uint32_t> pivots;
+        for(uint32_t c = 0; c < n && pivots.size() < numRank; c++) {
+            const uint32_t next = (uint32_t)pivots.size();
+            uint32_t best = next;
+            for(uint32_t row = next + 1; row < numRank; row++) {
+                if(abs(basis(row, c)) > abs(basis(best, c))) {
+                    best = row;
+                }
+            }
+            if(!(abs(basis(best, c)) > threshold)) {
+                continue;
+            }
+            basis.interchangeRows(best, next);
+            T *pivotRow = basis.rowPtr(next);
+            rowDivide(pivotRow + c, pivotRow[c], n - c);
+            pivotRow[c] = 1;
+            for(uint32_t row = 0; row < numRank; row++) {
+                T *other = basis.rowPtr(row);
+                if(row != next && other[c] != 0) {
+                    rowSubtractScaled(other + c + 1, pivotRow + c + 1, other[c], n - c - 1);
+                    other[c] = 0;
+                }
+            }
+            countFlops((uint64_t)numRank * 2 * (n - c));
+            pivots.push_back(c);
+        }
+
+        if(pivots.size() == numRank) { //every row has its pivot, basis is returned as it is
+            for(uint32_t row = 0; row < numRank; row++) {
+                fill(basis.rowPtr(row), basis.rowPtr(row) + pivots[row], (T)0);
+            }
+            return basis;
+        }
+        Matrix<T> reduced((uint32_t)pivots.size(), n);
+        for(uint32_t row = 0; row < pivots.size(); row++) {
+            memcpy(reduced.rowPtr(row) + pivots[row], basis.rowPtr(row) + pivots[row],
+                   (n - pivots[row]) * sizeof(T));
+        }
+        return reduced;
+    }
+
+private:
+    Matrix<T> r;
+    vector<uint32_t> permutation;
+    uint32_t numRank = 0;
+    T threshold = 0; //absolute, |R(k,k)| must be above it for k to count towards the rank
+
+    //REQUIRES: element(i) is a reference to entry i of a vector x for i < count, count >= 1
+    //MODIFIES: x
+    //EFFECTS: Turns x into a Householder reflector H = I - tau * v * v^T with v(0) = 1 that maps x to
+    //         (beta, 0, ..., 0): beta is stored in x(0) and the rest of v after it, tau is returned
+    //         (0 when x is already zero after x(0), H is then the identity)
+    template<typename Element>
+    static T makeReflector(uint32_t count, Element element) {
+        const T alpha = element(0);
+        T scale = 0;
+        for(uint32_t i = 1; i < count; i++) {
+            scale = max(scale, abs(element(i)));
+        }
+        if(scale == 0) {
+            return 0;
+        }
+        T sum = 0;
+        for(uint32_t i = 1; i < count; i++) { //scaled so that squaring neither overflows nor underflows
+            const T scaled = element(i) / scale;
+            sum += scaled * scaled;
+        }
+        const T beta = -copysign(hypot(alpha, scale * sqrt(sum)), alpha);
+        const T factor = 1 / (alpha - beta);
+        for(uint32_t i = 1; i < count; i++) {
+            element(i) *= factor;
+        }
+        element(0) = beta;
+        countFlops(4 * (uint64_t)count);
+        return (beta - alpha) / beta;
+    }
+
+    //REQUIRES: [row, a.rows) x {col} lies within a
+    //MODIFIES: a
+    //EFFECTS: makeReflector on column col from row down, v ends up below the diagonal
+    static T makeReflector(Matrix<T> &a, uint32_t row, uint32_t col) {
+        return makeReflector(a.rows - row, [&](uint32_t i) -> T & { return a(row + i, col); });
+    }
+
+    //REQUIRES: x and y have count elements
+    //MODIFIES: Nothing
+    //EFFECTS: Returns x . y, summed in four interleaved partial sums so the loop is not one long dependency chain
+    static T dot(const T *x, const T *y, uint32_t count) {
+        T sums[4] = {0, 0, 0, 0};
+        uint32_t i = 0;
+        for(; i + 4 <= count; i += 4) {
+            sums[0] += x[i] * y[i];
+            sums[1] += x[i + 1] * y[i + 1];
+            sums[2] += x[i + 2] * y[i + 2];
+            sums[3] += x[i + 3] * y[i + 3];
+        }
+        for(; i < count; i++) {
+            sums[0] += x[i] * y[i];
+        }
+        countFlops(2 * (uint64_t)count);
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    //REQUIRES: a.rows >= a.columns, blockSize >= 1
+    //MODIFIES: a
+    //EFFECTS: Householder QR without pivoting, R ends up on and above the diagonal (below it is left garbage)
+    //         Each panel of blockSize columns is transposed so that every column is a contiguous row and factored
+    //         one reflector at a time, then its reflectors are combined into Q_panel = I - V * Tf * V^T and the
+    //         rest of the matrix is updated as A22 -= V * (Tf^T * (V^T * A22)), two GEMMs
+    static void factorUnpivoted(Matrix<T> &a, uint32_t blockSize) {
+        const uint32_t m = a.rows;
+        const uint32_t n = a.columns;
+        for(uint32_t k0 = 0; k0 < n; k0 += blockSize) {
+            const uint32_t kb = min(blockSize, n - k0);
+            const uint32_t height = m - k0;
+            const uint32_t rest = n - k0 - kb;
+            const Matrix<T> &aView = a;
+            Matrix<T> vt(kb, height); //vt(j, i) = a(k0 + i, k0 + j)
+            transposeBlock(subBlock(aView, k0, k0, height, kb), wholeBlock(vt));
+            vector<T> tau(kb);
+            for(uint32_t j = 0; j < kb; j++) {
+                T *v = vt.rowPtr(j) + j;
+                tau[j] = makeReflector(height - j, [v](uint32_t i) -> T & { return v[i]; });
+                if(tau[j] == 0) {
+                    continue;
+                }
+                const T beta = v[0];
+                v[0] = 1;
+                for(uint32_t i = j + 1; i < kb; i++) {
+                    T *column = vt.rowPtr(i) + j;
+                    rowSubtractScaled(column, v, tau[j] * dot(v, column, height - j), height - j);
+                }
+                countFlops(2 * (uint64_t)(kb - j - 1) * (height - j));
+                v[0] = beta;
+            }
+            for(uint32_t j = 0; j < kb; j++) { //R back in place, then vt becomes V^T (unit diagonal, zeros above)
+                T *v = vt.rowPtr(j);
+                for(uint32_t i = 0; i <= j; i++) {
+                    a(k0 + i, k0 + j) = v[i];
+                    v[i] = 0;
+                }
+                v[j] = 1;
+            }
+            if(rest == 0) {
+                continue;
+            }
+
+            //Tf is upper triangular: Tf(j,j) = tau_j, Tf(0:j, j) = -tau_j * Tf(0:j, 0:j) * V(:, 0:j)^T * v_j
+            Matrix<T> tf(kb, kb);
+            vector<T> products(kb);
+            for(uint32_t j = 0; j < kb; j++) {
+                for(uint32_t i = 0; i < j; i++) { //v_j is zero above row j
+                    products[i] = -tau[j] * dot(vt.rowPtr(i) + j, vt.rowPtr(j) + j, height - j);
+                }
+                for(uint32_t i = 0; i < j; i++) {
+                    T sum = 0;
+                    for(uint32_t e = i; e < j; e++) {
+                        sum += tf(i, e) * products[e];
+                    }
+                    tf(i, j) = sum;
+                }
+                tf(j, j) = tau[j];
+                countFlops((uint64_t)j * j);
+            }
+
+            Matrix<T> v(height, kb);
+            const Matrix<T> &vtView = vt;
+            const Matrix<T> &vView = v;
+            transposeBlock(wholeBlock(vtView), wholeBlock(v));
+            Matrix<T> product(kb, rest);
+            gemm<T>(1, wholeBlock(vtView), subBlock(aView, k0, k0 + kb, height, rest), 0, wholeBlock(product));
+            for(uint32_t i = kb; i-- > 0;) { //product = Tf^T * product, bottom row first so that the rows above it
+                T *row = product.rowPtr(i);  //are still unchanged when it reads them
+                for(uint32_t c = 0; c < rest; c++) {
+                    row[c] *= tf(i, i);
+                }
+                for(uint32_t e = 0; e < i; e++) {
+                    rowSubtractScaled(row, product.rowPtr(e), -tf(e, i), rest);
+                }
+                countFlops((uint64_t)(2 * i + 1) * rest);
+            }
+            const Matrix<T> &productView = product;
+            gemm<T>(-1, wholeBlock(vView), wholeBlock(productView), 1, subBlock(a, k0, k0 + kb, height, rest));
+        }
+    }
+
+    //REQUIRES: blockSize >= 1
+    //MODIFIES: a, permutation
+    //EFFECTS: Householder QR with column pivoting (LAPACK's dgeqp3 with the blocking of dlaqps), R ends up on and
+    //         above the diagonal, the column interchanges are applied to permutation
+    //         Within a panel the trailing matrix is not updated, instead F^T = Tf^T * V^T * A22 is built one row per
+    //         reflector, which is enough to bring the pivot column and the current row up to date, and the column
+    //         norms are downdated from that row. The panel ends early when a norm has lost too many digits to the
+    //         downdates, then A22 -= V * F^T as one GEMM and the affected norms are computed again
+    void factorPivoted(Matrix<T> &a, uint32_t blockSize) {
+        const uint32_t m = a.rows;
+        const uint32_t n = a.columns;
+        const uint32_t steps = min(m, n);
+        const T tolerance = sqrt(numeric_limits<T>::epsilon());
+        vector<T> norms(n, 0); //of each column below the rows factored so far
+        vector<T> lastExact(n); //norms when they were last computed rather than downdated
+        for(uint32_t row = 0; row < m; row++) {
+            const T *aRow = a.rowPtr(row);
+            for(uint32_t c = 0; c < n; c++) {
+                norms[c] += aRow[c] * aRow[c];
+            }
+        }
+        for(uint32_t c = 0; c < n; c++) {
+            norms[c] = sqrt(norms[c]);
+            lastExact[c] = norms[c];
+        }
+        countFlops(2 * (uint64_t)m * n);
+
+        Matrix<T> ft(min(blockSize, steps), n);
+        vector<uint32_t> stale;
+        for(uint32_t k0 = 0; k0 < steps;) {
+            const uint32_t kb = min(blockSize, steps - k0);
+            for(uint32_t j = 0; j < kb; j++) {
+                memset(ft.rowPtr(j), 0, n * sizeof(T));
+            }
+            uint32_t done = 0;
+            while(done < kb && stale.empty()) {
+                const uint32_t j = done;
+                const uint32_t k = k0 + j;
+                const uint32_t pivot = k + (uint32_t)(max_element(norms.begin() + k, norms.end(), [](T x, T y) {
+                    return x < y; //NaN norms are never picked over a number
+                }) - norms.begin() - k);
+                if(pivot != k) {
+                    for(uint32_t row = 0; row < m; row++) {
+                        swap(a(row, k), a(row, pivot));
+                    }
+                    for(uint32_t t = 0; t < j; t++) {
+                        swap(ft(t, k), ft(t, pivot));
+                    }
+                    swap(permutation[k], permutation[pivot]);
+                    swap(norms[k], norms[pivot]);
+                    swap(lastExact[k], lastExact[pivot]);
+                }
+
+                for(uint32_t row = k; row < m && j > 0; row++) { //column k -= V * F(k, :)^T, the panel so far
+                    const T *aRow = a.rowPtr(row);
+                    T sum = 0;
+                    for(uint32_t t = 0; t < j; t++) {
+                        sum += aRow[k0 + t] * ft(t, k);
+                    }
+                    a(row, k) -= sum;
+                }
+                countFlops(2 * (uint64_t)j * (m - k));
+
+                const T tau = makeReflector(a, k, k);
+                const T diagonal = a(k, k);
+                a(k, k) = 1;
+                T *fRow = ft.rowPtr(j);
+                const uint32_t rest = n - k - 1;
+                if(tau != 0 && rest > 0) {
+                    for(uint32_t row = k; row < m; row++) { //F(:, j)^T = tau * v^T * A22, A22 not yet updated
+                        rowSubtractScaled(fRow + k + 1, a.rowPtr(row) + k + 1, -tau * a(row, k), rest);
+                    }
+                    for(uint32_t t = 0; t < j; t++) { //minus tau * F(:, t)^T * (v_t^T * v), the earlier reflectors
+                        T dot = 0;
+                        for(uint32_t row = k; row < m; row++) {
+                            dot += a(row, k0 + t) * a(row, k);
+                        }
+                        rowSubtractScaled(fRow + k + 1, ft.rowPtr(t) + k + 1, tau * dot, rest);
+                    }
+                    countFlops(2 * (uint64_t)(m - k) * (rest + j) + 2 * (uint64_t)j * rest);
+                }
+                T *kRow = a.rowPtr(k);
+                for(uint32_t t = 0; t <= j; t++) { //row k of A22 -= V(k, :) * F^T, it is final from here on
+                    rowSubtractScaled(kRow + k + 1, ft.rowPtr(t) + k + 1, kRow[k0 + t], rest);
+                }
+                countFlops(2 * (uint64_t)(j + 1) * rest);
+                a(k, k) = diagonal;
+
+                for(uint32_t c = k + 1; c < n; c++) { //the norms lose row k
+                    if(norms[c] == 0) {
+                        continue;
+                    }
+                    T ratio = abs(kRow[c]) / norms[c];
+                    ratio = max((T)0, (1 + ratio) * (1 - ratio));
+                    const T relative = norms[c] / lastExact[c];
+                    if(ratio * relative * relative <= tolerance) {
+                        stale.push_back(c);
+                    }
+                    else {
+                        norms[c] *= sqrt(ratio);
+                    }
+                }
+                done++;
+            }
+
+            const uint32_t next = k0 + done;
+            if(next < m && next < n) { //rows below the panel, A22 -= V * F^T
+                const Matrix<T> &aView = a;
+                const Matrix<T> &ftView = ft;
+                gemm<T>(-1, subBlock(aView, next, k0, m - next, done), subBlock(ftView, 0, next, done, n - next), 1,
+                        subBlock(a, next, next, m - next, n - next));
+            }
+            for(uint32_t c : stale) {
+                T sum = 0;
+                for(uint32_t row = next; row < m; row++) {
+                    sum += a(row, c) * a(row, c);
+                }
+                norms[c] = sqrt(sum);
+                lastExact[c] = norms[c];
+            }
+            stale.clear();
+            k0 = next;
+        }
+    }
+};
+
+#endif
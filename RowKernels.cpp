@@ -0,0 +1,421 @@
+#include "RowKernels.h"
+
+//A fused multiply-add rounds once where the scalar reference rounds twice, and GCC fuses the vector multiply and
+//subtract of any target that has FMA (AVX-512 implies it) unless contraction is off
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* ---------------------- SCALAR (REFERENCE) ---------------------- */
+
+template<typename T>
+static void subtractScaledScalar(T *dest, const T *src, T coef, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        dest[i] -= coef * src[i];
+    }
+}
+
+template<typename T>
+static void divideScalar(T *row, T divisor, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        row[i] /= divisor;
+    }
+}
+
+template<typename T>
+static int findNonzeroScalar(const T *row, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(row[i] != 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+template<typename T>
+static void transposeTileScalar(const T *const *src, T *const *dest) {
+    for(uint32_t j = 0; j < TRANSPOSE_KERNEL_TILE; j++) {
+        for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i++) {
+            dest[j][i] = src[i][j];
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* ---------------------- SSE2, 2 DOUBLES ---------------------- */
+//Each vector loop leaves the elements that do not fill a vector to the scalar loop, except AVX-512 which masks them
+
+__attribute__((target("sse2")))
+static void subtractScaledSse2(double *dest, const double *src, double coef, uint32_t count) {
+    const __m128d coefs = _mm_set1_pd(coef);
+    uint32_t i = 0;
+    for(; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(dest + i, _mm_sub_pd(_mm_loadu_pd(dest + i), _mm_mul_pd(coefs, _mm_loadu_pd(src + i))));
+    }
+    subtractScaledScalar(dest + i, src + i, coef, count - i);
+}
+
+__attribute__((target("sse2")))
+static void divideSse2(double *row, double divisor, uint32_t count) {
+    const __m128d divisors = _mm_set1_pd(divisor);
+    uint32_t i = 0;
+    for(; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(row + i, _mm_div_pd(_mm_loadu_pd(row + i), divisors));
+    }
+    divideScalar(row + i, divisor, count - i);
+}
+
+__attribute__((target("sse2")))
+static int findNonzeroSse2(const double *row, uint32_t count) {
+    const __m128d zeros = _mm_setzero_pd();
+    uint32_t i = 0;
+    for(; i + 2 <= count; i += 2) {
+        const int nonzero = _mm_movemask_pd(_mm_cmpneq_pd(_mm_loadu_pd(row + i), zeros)); //NaN compares not equal
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    const int rest = findNonzeroScalar(row + i, count - i);
+    return rest == -1 ? -1 : (int)i + rest;
+}
+
+/* ---------------------- SSE2, 4 FLOATS ---------------------- */
+
+__attribute__((target("sse2")))
+static void subtractScaledFloatSse2(float *dest, const float *src, float coef, uint32_t count) {
+    const __m128 coefs = _mm_set1_ps(coef);
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dest + i, _mm_sub_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(coefs, _mm_loadu_ps(src + i))));
+    }
+    subtractScaledScalar(dest + i, src + i, coef, count - i);
+}
+
+__attribute__((target("sse2")))
+static void divideFloatSse2(float *row, float divisor, uint32_t count) {
+    const __m128 divisors = _mm_set1_ps(divisor);
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(row + i, _mm_div_ps(_mm_loadu_ps(row + i), divisors));
+    }
+    divideScalar(row + i, divisor, count - i);
+}
+
+__attribute__((target("sse2")))
+static int findNonzeroFloatSse2(const float *row, uint32_t count) {
+    const __m128 zeros = _mm_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        const int nonzero = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(row + i), zeros));
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    const int rest = findNonzeroScalar(row + i, count - i);
+    return rest == -1 ? -1 : (int)i + rest;
+}
+
+/* ---------------------- SSE2 TILE TRANSPOSES ---------------------- */
+
+//The 8 x 8 tile as 4 x 4 blocks, block (I, J) of src goes to block (J, I) of dest
+//A double block is four 2 x 2 transposes (an unpack of two rows each), a float block is one _MM_TRANSPOSE4_PS
+__attribute__((target("sse2")))
+static void transposeTileSse2(const double *const *src, double *const *dest) {
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i += 2) {
+        for(uint32_t j = 0; j < TRANSPOSE_KERNEL_TILE; j += 2) {
+            const __m128d upper = _mm_loadu_pd(src[i] + j);
+            const __m128d lower = _mm_loadu_pd(src[i + 1] + j);
+            _mm_storeu_pd(dest[j] + i, _mm_unpacklo_pd(upper, lower));
+            _mm_storeu_pd(dest[j + 1] + i, _mm_unpackhi_pd(upper, lower));
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void transposeTileFloatSse2(const float *const *src, float *const *dest) {
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i += 4) {
+        for(uint32_t j = 0; j < TRANSPOSE_KERNEL_TILE; j += 4) {
+            __m128 row0 = _mm_loadu_ps(src[i] + j);
+            __m128 row1 = _mm_loadu_ps(src[i + 1] + j);
+            __m128 row2 = _mm_loadu_ps(src[i + 2] + j);
+            __m128 row3 = _mm_loadu_ps(src[i + 3] + j);
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_storeu_ps(dest[j] + i, row0);
+            _mm_storeu_ps(dest[j + 1] + i, row1);
+            _mm_storeu_ps(dest[j + 2] + i, row2);
+            _mm_storeu_ps(dest[j + 3] + i, row3);
+        }
+    }
+}
+
+/* ---------------------- AVX2, 4 DOUBLES ---------------------- */
+
+__attribute__((target("avx2")))
+static void subtractScaledAvx2(double *dest, const double *src, double coef, uint32_t count) {
+    const __m256d coefs = _mm256_set1_pd(coef);
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) { //two independent vectors per iteration hide the load latency
+        __m256d low = _mm256_sub_pd(_mm256_loadu_pd(dest + i), _mm256_mul_pd(coefs, _mm256_loadu_pd(src + i)));
+        __m256d high = _mm256_sub_pd(_mm256_loadu_pd(dest + i + 4), _mm256_mul_pd(coefs, _mm256_loadu_pd(src + i + 4)));
+        _mm256_storeu_pd(dest + i, low);
+        _mm256_storeu_pd(dest + i + 4, high);
+    }
+    for(; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(dest + i, _mm256_sub_pd(_mm256_loadu_pd(dest + i), _mm256_mul_pd(coefs, _mm256_loadu_pd(src + i))));
+    }
+    subtractScaledScalar(dest + i, src + i, coef, count - i);
+}
+
+__attribute__((target("avx2")))
+static void divideAvx2(double *row, double divisor, uint32_t count) {
+    const __m256d divisors = _mm256_set1_pd(divisor);
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(row + i, _mm256_div_pd(_mm256_loadu_pd(row + i), divisors));
+    }
+    divideScalar(row + i, divisor, count - i);
+}
+
+__attribute__((target("avx2")))
+static int findNonzeroAvx2(const double *row, uint32_t count) {
+    const __m256d zeros = _mm256_setzero_pd();
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        const int nonzero = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(row + i), zeros, _CMP_NEQ_UQ));
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    const int rest = findNonzeroScalar(row + i, count - i);
+    return rest == -1 ? -1 : (int)i + rest;
+}
+
+/* ---------------------- AVX2, 8 FLOATS ---------------------- */
+
+__attribute__((target("avx2")))
+static void subtractScaledFloatAvx2(float *dest, const float *src, float coef, uint32_t count) {
+    const __m256 coefs = _mm256_set1_ps(coef);
+    uint32_t i = 0;
+    for(; i + 16 <= count; i += 16) { //two independent vectors per iteration, as for double
+        __m256 low = _mm256_sub_ps(_mm256_loadu_ps(dest + i), _mm256_mul_ps(coefs, _mm256_loadu_ps(src + i)));
+        __m256 high = _mm256_sub_ps(_mm256_loadu_ps(dest + i + 8), _mm256_mul_ps(coefs, _mm256_loadu_ps(src + i + 8)));
+        _mm256_storeu_ps(dest + i, low);
+        _mm256_storeu_ps(dest + i + 8, high);
+    }
+    for(; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dest + i, _mm256_sub_ps(_mm256_loadu_ps(dest + i), _mm256_mul_ps(coefs, _mm256_loadu_ps(src + i))));
+    }
+    subtractScaledScalar(dest + i, src + i, coef, count - i);
+}
+
+__attribute__((target("avx2")))
+static void divideFloatAvx2(float *row, float divisor, uint32_t count) {
+    const __m256 divisors = _mm256_set1_ps(divisor);
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(row + i, _mm256_div_ps(_mm256_loadu_ps(row + i), divisors));
+    }
+    divideScalar(row + i, divisor, count - i);
+}
+
+__attribute__((target("avx2")))
+static int findNonzeroFloatAvx2(const float *row, uint32_t count) {
+    const __m256 zeros = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        const int nonzero = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + i), zeros, _CMP_NEQ_UQ));
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    const int rest = findNonzeroScalar(row + i, count - i);
+    return rest == -1 ? -1 : (int)i + rest;
+}
+
+/* ---------------------- AVX2 TILE TRANSPOSES ---------------------- */
+
+//A double tile is four 4 x 4 blocks, each unpacked in pairs of rows and then recombined by 128 bit halves
+__attribute__((target("avx2")))
+static void transposeTileAvx2(const double *const *src, double *const *dest) {
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i += 4) {
+        for(uint32_t j = 0; j < TRANSPOSE_KERNEL_TILE; j += 4) {
+            const __m256d row0 = _mm256_loadu_pd(src[i] + j);
+            const __m256d row1 = _mm256_loadu_pd(src[i + 1] + j);
+            const __m256d row2 = _mm256_loadu_pd(src[i + 2] + j);
+            const __m256d row3 = _mm256_loadu_pd(src[i + 3] + j);
+            const __m256d even01 = _mm256_unpacklo_pd(row0, row1); //[0][0] [1][0] [0][2] [1][2]
+            const __m256d odd01 = _mm256_unpackhi_pd(row0, row1); //[0][1] [1][1] [0][3] [1][3]
+            const __m256d even23 = _mm256_unpacklo_pd(row2, row3);
+            const __m256d odd23 = _mm256_unpackhi_pd(row2, row3);
+            _mm256_storeu_pd(dest[j] + i, _mm256_permute2f128_pd(even01, even23, 0x20));
+            _mm256_storeu_pd(dest[j + 1] + i, _mm256_permute2f128_pd(odd01, odd23, 0x20));
+            _mm256_storeu_pd(dest[j + 2] + i, _mm256_permute2f128_pd(even01, even23, 0x31));
+            _mm256_storeu_pd(dest[j + 3] + i, _mm256_permute2f128_pd(odd01, odd23, 0x31));
+        }
+    }
+}
+
+//A float tile is one 8 x 8 transpose: unpacks interleave pairs of rows, shuffles gather groups of four and the
+//128 bit permutes put the low and high halves of the rows together
+__attribute__((target("avx2")))
+static void transposeTileFloatAvx2(const float *const *src, float *const *dest) {
+    __m256 rows[TRANSPOSE_KERNEL_TILE];
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i++) {
+        rows[i] = _mm256_loadu_ps(src[i]);
+    }
+    __m256 pairs[TRANSPOSE_KERNEL_TILE];
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i += 2) {
+        pairs[i] = _mm256_unpacklo_ps(rows[i], rows[i + 1]);
+        pairs[i + 1] = _mm256_unpackhi_ps(rows[i], rows[i + 1]);
+    }
+    __m256 quads[TRANSPOSE_KERNEL_TILE];
+    for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i += 4) {
+        quads[i] = _mm256_shuffle_ps(pairs[i], pairs[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        quads[i + 1] = _mm256_shuffle_ps(pairs[i], pairs[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        quads[i + 2] = _mm256_shuffle_ps(pairs[i + 1], pairs[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        quads[i + 3] = _mm256_shuffle_ps(pairs[i + 1], pairs[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for(uint32_t j = 0; j < 4; j++) {
+        _mm256_storeu_ps(dest[j], _mm256_permute2f128_ps(quads[j], quads[j + 4], 0x20));
+        _mm256_storeu_ps(dest[j + 4], _mm256_permute2f128_ps(quads[j], quads[j + 4], 0x31));
+    }
+}
+
+/* ---------------------- AVX-512, 8 DOUBLES ---------------------- */
+
+__attribute__((target("avx512f")))
+static void subtractScaledAvx512(double *dest, const double *src, double coef, uint32_t count) {
+    const __m512d coefs = _mm512_set1_pd(coef);
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(dest + i, _mm512_sub_pd(_mm512_loadu_pd(dest + i), _mm512_mul_pd(coefs, _mm512_loadu_pd(src + i))));
+    }
+    if(i < count) {
+        const __mmask8 tail = (__mmask8)((1u << (count - i)) - 1);
+        const __m512d product = _mm512_mul_pd(coefs, _mm512_maskz_loadu_pd(tail, src + i));
+        _mm512_mask_storeu_pd(dest + i, tail, _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, dest + i), product));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void divideAvx512(double *row, double divisor, uint32_t count) {
+    const __m512d divisors = _mm512_set1_pd(divisor);
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(row + i, _mm512_div_pd(_mm512_loadu_pd(row + i), divisors));
+    }
+    if(i < count) {
+        const __mmask8 tail = (__mmask8)((1u << (count - i)) - 1);
+        _mm512_mask_storeu_pd(row + i, tail, _mm512_div_pd(_mm512_maskz_loadu_pd(tail, row + i), divisors));
+    }
+}
+
+__attribute__((target("avx512f")))
+static int findNonzeroAvx512(const double *row, uint32_t count) {
+    const __m512d zeros = _mm512_setzero_pd();
+    for(uint32_t i = 0; i < count; i += 8) {
+        const __mmask8 valid = count - i >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << (count - i)) - 1);
+        const __mmask8 nonzero = _mm512_mask_cmp_pd_mask(valid, _mm512_maskz_loadu_pd(valid, row + i), zeros,
+                                                         _CMP_NEQ_UQ);
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    return -1;
+}
+
+/* ---------------------- AVX-512, 16 FLOATS ---------------------- */
+
+__attribute__((target("avx512f")))
+static void subtractScaledFloatAvx512(float *dest, const float *src, float coef, uint32_t count) {
+    const __m512 coefs = _mm512_set1_ps(coef);
+    uint32_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(dest + i, _mm512_sub_ps(_mm512_loadu_ps(dest + i), _mm512_mul_ps(coefs, _mm512_loadu_ps(src + i))));
+    }
+    if(i < count) {
+        const __mmask16 tail = (__mmask16)((1u << (count - i)) - 1);
+        const __m512 product = _mm512_mul_ps(coefs, _mm512_maskz_loadu_ps(tail, src + i));
+        _mm512_mask_storeu_ps(dest + i, tail, _mm512_sub_ps(_mm512_maskz_loadu_ps(tail, dest + i), product));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void divideFloatAvx512(float *row, float divisor, uint32_t count) {
+    const __m512 divisors = _mm512_set1_ps(divisor);
+    uint32_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(row + i, _mm512_div_ps(_mm512_loadu_ps(row + i), divisors));
+    }
+    if(i < count) {
+        const __mmask16 tail = (__mmask16)((1u << (count - i)) - 1);
+        _mm512_mask_storeu_ps(row + i, tail, _mm512_div_ps(_mm512_maskz_loadu_ps(tail, row + i), divisors));
+    }
+}
+
+__attribute__((target("avx512f")))
+static int findNonzeroFloatAvx512(const float *row, uint32_t count) {
+    const __m512 zeros = _mm512_setzero_ps();
+    for(uint32_t i = 0; i < count; i += 16) {
+        const __mmask16 valid = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1);
+        const __mmask16 nonzero = _mm512_mask_cmp_ps_mask(valid, _mm512_maskz_loadu_ps(valid, row + i), zeros,
+                                                          _CMP_NEQ_UQ);
+        if(nonzero != 0) {
+            return (int)i + __builtin_ctz((unsigned)nonzero);
+        }
+    }
+    return -1;
+}
+
+#endif
+
+/* ---------------------- DISPATCH ---------------------- */
+
+bool rowKernelsSupported(RowKernelLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    switch(level) {
+        case RowKernelLevel::Scalar: return true;
+        case RowKernelLevel::Sse2: return __builtin_cpu_supports("sse2");
+        case RowKernelLevel::Avx2: return __builtin_cpu_supports("avx2");
+        case RowKernelLevel::Avx512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return level == RowKernelLevel::Scalar;
+#endif
+}
+
+const RowKernels &rowKernelsFor(RowKernelLevel level) {
+    static const RowKernels scalar = {RowKernelLevel::Scalar, "scalar", subtractScaledScalar<double>,
+                                      divideScalar<double>, findNonzeroScalar<double>, subtractScaledScalar<float>,
+                                      divideScalar<float>, findNonzeroScalar<float>, transposeTileScalar<double>,
+                                      transposeTileScalar<float>};
+#if defined(__x86_64__) || defined(__i386__)
+    static const RowKernels sse2 = {RowKernelLevel::Sse2, "sse2", subtractScaledSse2, divideSse2, findNonzeroSse2,
+                                    subtractScaledFloatSse2, divideFloatSse2, findNonzeroFloatSse2,
+                                    transposeTileSse2, transposeTileFloatSse2};
+    static const RowKernels avx2 = {RowKernelLevel::Avx2, "avx2", subtractScaledAvx2, divideAvx2, findNonzeroAvx2,
+                                    subtractScaledFloatAvx2, divideFloatAvx2, findNonzeroFloatAvx2,
+                                    transposeTileAvx2, transposeTileFloatAvx2};
+    //an 8 x 8 tile is already a single pass of AVX2 registers, AVX-512 keeps those transposes
+    static const RowKernels avx512 = {RowKernelLevel::Avx512, "avx512", subtractScaledAvx512, divideAvx512,
+                                      findNonzeroAvx512, subtractScaledFloatAvx512, divideFloatAvx512,
+                                      findNonzeroFloatAvx512, transposeTileAvx2, transposeTileFloatAvx2};
+    switch(level) {
+        case RowKernelLevel::Sse2: return sse2;
+        case RowKernelLevel::Avx2: return avx2;
+        case RowKernelLevel::Avx512: return avx512;
+        default: return scalar;
+    }
+#else
+    return scalar;
+#endif
+}
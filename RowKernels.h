@@ -0,0 +1,125 @@
+#ifndef ROWKERNELS_H
+#define ROWKERNELS_H
+
+#include <cstdint>
+
+using namespace std;
+
+//Vectorized primitives of row reduction and the tile transpose of Transpose.h, on double and float rows, one
+//implementation per instruction set
+//The widest set the CPU supports is picked once at startup (CPUID), so one binary uses AVX-512 on the hosts that
+//have it and SSE2 on the oldest, the scalar versions are the reference the others must agree with
+//Every version performs the same IEEE operations per element (a multiply then a subtract, never a fused
+//multiply-add, and a true division), so results are identical whichever set runs
+enum class RowKernelLevel { Scalar, Sse2, Avx2, Avx512 };
+
+//Rows and columns of the tiles the transpose kernels move
+const uint32_t TRANSPOSE_KERNEL_TILE = 8;
+
+struct RowKernels {
+    RowKernelLevel level;
+    const char *name;
+    void (*subtractScaled)(double *dest, const double *src, double coef, uint32_t count); //dest -= coef * src
+    void (*divide)(double *row, double divisor, uint32_t count); //row /= divisor
+    int (*findNonzero)(const double *row, uint32_t count); //first index whose value is not 0, -1 if none
+    void (*subtractScaledFloat)(float *dest, const float *src, float coef, uint32_t count);
+    void (*divideFloat)(float *row, float divisor, uint32_t count);
+    int (*findNonzeroFloat)(const float *row, uint32_t count);
+    //dest[j][i] = src[i][j] for the 8 x 8 tile whose rows start at src[0..7], written to the rows at dest[0..7]
+    void (*transposeTile)(const double *const *src, double *const *dest);
+    void (*transposeTileFloat)(const float *const *src, float *const *dest);
+};
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns whether the CPU (and OS) can run the kernels of level
+bool rowKernelsSupported(RowKernelLevel level);
+
+//REQUIRES: rowKernelsSupported(level)
+//MODIFIES: Nothing
+//EFFECTS: Returns the kernels of level, for comparing levels (linal_bench)
+const RowKernels &rowKernelsFor(RowKernelLevel level);
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the kernels of the widest supported level, chosen on the first call
+inline const RowKernels &rowKernels() {
+    static const RowKernels &best = rowKernelsFor(rowKernelsSupported(RowKernelLevel::Avx512) ? RowKernelLevel::Avx512
+                                                  : rowKernelsSupported(RowKernelLevel::Avx2) ? RowKernelLevel::Avx2
+                                                  : rowKernelsSupported(RowKernelLevel::Sse2) ? RowKernelLevel::Sse2
+                                                  : RowKernelLevel::Scalar);
+    return best;
+}
+
+//REQUIRES: dest and src hold count elements
+//MODIFIES: dest
+//EFFECTS: dest[i] -= coef * src[i] for every i, through the selected kernels for double and float and a plain loop
+//         otherwise
+inline void rowSubtractScaled(double *dest, const double *src, double coef, uint32_t count) {
+    rowKernels().subtractScaled(dest, src, coef, count);
+}
+inline void rowSubtractScaled(float *dest, const float *src, float coef, uint32_t count) {
+    rowKernels().subtractScaledFloat(dest, src, coef, count);
+}
+template<typename T>
+void rowSubtractScaled(T *dest, const T *src, T coef, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        dest[i] -= coef * src[i];
+    }
+}
+
+//REQUIRES: row holds count elements
+//MODIFIES: row
+//EFFECTS: row[i] /= divisor for every i
+inline void rowDivide(double *row, double divisor, uint32_t count) {
+    rowKernels().divide(row, divisor, count);
+}
+inline void rowDivide(float *row, float divisor, uint32_t count) {
+    rowKernels().divideFloat(row, divisor, count);
+}
+template<typename T>
+void rowDivide(T *row, T divisor, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        row[i] /= divisor;
+    }
+}
+
+//REQUIRES: row holds count elements
+//MODIFIES: Nothing
+//EFFECTS: Returns the first index whose value is not 0 (NaN counts as nonzero, -0 does not), -1 if there is none
+inline int rowFindNonzero(const double *row, uint32_t count) {
+    return rowKernels().findNonzero(row, count);
+}
+inline int rowFindNonzero(const float *row, uint32_t count) {
+    return rowKernels().findNonzeroFloat(row, count);
+}
+template<typename T>
+int rowFindNonzero(const T *row, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(row[i] != 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+//REQUIRES: src and dest each hold TRANSPOSE_KERNEL_TILE rows of TRANSPOSE_KERNEL_TILE elements, not overlapping
+//MODIFIES: the rows of dest
+//EFFECTS: dest[j][i] = src[i][j], in vector registers through the selected kernels for double and float and with
+//         plain loops otherwise
+inline void tileTranspose(const double *const *src, double *const *dest) {
+    rowKernels().transposeTile(src, dest);
+}
+inline void tileTranspose(const float *const *src, float *const *dest) {
+    rowKernels().transposeTileFloat(src, dest);
+}
+template<typename T>
+void tileTranspose(const T *const *src, T *const *dest) {
+    for(uint32_t j = 0; j < TRANSPOSE_KERNEL_TILE; j++) {
+        for(uint32_t i = 0; i < TRANSPOSE_KERNEL_TILE; i++) {
+            dest[j][i] = src[i][j];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,859 @@
+#ifndef SPARSELU_H
+#define SPARSELU_H
+
+#include "SparseMatrix.h"
+#include "LUFactorization.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+//The diagonal entry of a column stays its pivot while its magnitude is at least this fraction of the largest
+//candidate, which keeps the fill-reducing order for the diagonally dominant systems that are typical and still
+//bounds the growth of L by 1 / SPARSE_PIVOT_TOLERANCE, partial pivoting is a tolerance of 1
+const double SPARSE_PIVOT_TOLERANCE = 0.1;
+
+const uint32_t SPARSE_NONE = UINT32_MAX;
+
+//Subtrees of the elimination tree with at most this many columns are factored as one front, the explicit zeros
+//this adds cost less than handling many tiny fronts one by one
+const uint32_t SPARSE_RELAX_COLUMNS = 16;
+//Largest front, in entries, that is factored densely, orders that need a larger one are left to the column by
+//column factorization which only ever stores the nonzeros
+const uint64_t SPARSE_FRONT_LIMIT = 1ull << 25;
+
+//REQUIRES: rowsA and colsA are the same square matrix in CSR and in CSC
+//MODIFIES: Nothing
+//EFFECTS: Returns a fill-reducing elimination order, order[k] is the row and column eliminated at step k
+//         Approximate minimum degree on the graph of A + A^T: the variable with the fewest neighbours goes next,
+//         its neighbours become one clique (an element) that is kept as a list instead of as edges, and each
+//         neighbour's degree is estimated from the sizes of its elements outside the new one
+//         Variables with the same neighbours are merged into one supervariable that is eliminated at once, so
+//         degrees count the variables a supervariable stands for and leave out its own (external degree)
+template<typename T>
+vector<uint32_t> minimumDegreeOrder(const SparseMatrix<T> &rowsA, const SparseMatrix<T> &colsA) {
+    assert(rowsA.rows == rowsA.columns);
+    const uint32_t n = rowsA.rows;
+
+    vector<vector<uint32_t>> variables(n); //neighbours of each variable not yet covered by an element
+    vector<vector<uint32_t>> elements(n); //elements each variable belongs to, an element is named by its pivot
+    vector<vector<uint32_t>> members(n); //variables of each element
+    vector<uint32_t> flag(n, 0);
+    uint32_t stamp = 0;
+    for(uint32_t i = 0; i < n; i++) { //the pattern of A + A^T without the diagonal
+        flag[i] = ++stamp;
+        for(const SparseMatrix<T> *half : {&rowsA, &colsA}) {
+            for(size_t p = half->starts[i]; p < half->starts[i + 1]; p++) {
+                const uint32_t j = half->indices[p];
+                if(flag[j] != stamp) {
+                    flag[j] = stamp;
+                    variables[i].push_back(j);
+                }
+            }
+        }
+    }
+
+    vector<uint32_t> degree(n);
+    vector<uint32_t> head(n + 1, SPARSE_NONE); //head[d] starts the list of variables of degree d
+    vector<uint32_t> next(n);
+    vector<uint32_t> prev(n);
+    uint32_t minDegree = 0;
+    auto insert = [&](uint32_t i) {
+        const uint32_t d = degree[i];
+        next[i] = head[d];
+        prev[i] = SPARSE_NONE;
+        if(head[d] != SPARSE_NONE) {
+            prev[head[d]] = i;
+        }
+        head[d] = i;
+        minDegree = min(minDegree, d);
+    };
+    auto remove = [&](uint32_t i) {
+        if(prev[i] != SPARSE_NONE) {
+            next[prev[i]] = next[i];
+        }
+        else {
+            head[degree[i]] = next[i];
+        }
+        if(next[i] != SPARSE_NONE) {
+            prev[next[i]] = prev[i];
+        }
+    };
+    for(uint32_t i = 0; i < n; i++) {
+        degree[i] = (uint32_t)variables[i].size();
+        insert(i);
+    }
+
+    vector<uint32_t> weight(n, 1); //variables a supervariable stands for, 0 once merged into another
+    vector<uint32_t> follower(n, SPARSE_NONE); //the variables merged into a supervariable, as a list
+    vector<uint32_t> tail(n);
+    for(uint32_t i = 0; i < n; i++) {
+        tail[i] = i;
+    }
+    vector<bool> eliminated(n, false);
+    vector<bool> absorbed(n, false);
+    vector<size_t> elementWeight(n, 0); //variables in an element, merging moves weight between its members
+    vector<size_t> external(n); //weight of an element outside the newest one
+    vector<uint32_t> externalStamp(n, 0);
+    vector<uint32_t> seen(n, 0); //marks the neighbours of one variable while supervariables are compared
+    uint32_t seenStamp = 0;
+    vector<pair<uint64_t, uint32_t>> hashes;
+    vector<uint32_t> order;
+    order.reserve(n);
+    while(order.size() < n) {
+        while(head[minDegree] == SPARSE_NONE) {
+            minDegree++;
+        }
+        const uint32_t pivot = head[minDegree];
+        remove(pivot);
+        eliminated[pivot] = true;
+        for(uint32_t v = pivot; v != SPARSE_NONE; v = follower[v]) {
+            order.push_back(v);
+        }
+
+        //the new element: the pivot's remaining neighbours and the members of every element it belonged to,
+        //which it absorbs
+        ++stamp;
+        vector<uint32_t> &clique = members[pivot];
+        size_t cliqueWeight = 0;
+        auto join = [&](uint32_t j) {
+            if(weight[j] != 0 && !eliminated[j] && flag[j] != stamp) {
+                flag[j] = stamp;
+                clique.push_back(j);
+                cliqueWeight += weight[j];
+            }
+        };
+        for(uint32_t j : variables[pivot]) {
+            join(j);
+        }
+        for(uint32_t e : elements[pivot]) {
+            if(absorbed[e]) {
+                continue;
+            }
+            for(uint32_t j : members[e]) {
+                join(j);
+            }
+            absorbed[e] = true;
+            vector<uint32_t>().swap(members[e]);
+        }
+        vector<uint32_t>().swap(variables[pivot]);
+        vector<uint32_t>().swap(elements[pivot]);
+        elementWeight[pivot] = cliqueWeight;
+
+        for(uint32_t i : clique) { //|L_e \ clique| of every other element touching the clique
+            for(uint32_t e : elements[i]) {
+                if(absorbed[e]) {
+                    continue;
+                }
+                if(externalStamp[e] != stamp) {
+                    externalStamp[e] = stamp;
+                    external[e] = elementWeight[e];
+                }
+                external[e] -= weight[i];
+            }
+        }
+
+        //drop what the new element covers: absorbed elements, elements inside it and edges between its members
+        hashes.clear();
+        for(uint32_t i : clique) {
+            remove(i);
+            vector<uint32_t> &own = elements[i];
+            own.erase(remove_if(own.begin(), own.end(), [&](uint32_t e) {
+                if(!absorbed[e] && external[e] == 0) { //aggressive absorption, L_e is a subset of the clique
+                    absorbed[e] = true;
+                    vector<uint32_t>().swap(members[e]);
+                }
+                return absorbed[e];
+            }), own.end());
+            vector<uint32_t> &adjacent = variables[i];
+            adjacent.erase(remove_if(adjacent.begin(), adjacent.end(), [&](uint32_t j) {
+                return eliminated[j] || weight[j] == 0 || flag[j] == stamp;
+            }), adjacent.end());
+            uint64_t hash = 0;
+            for(uint32_t e : own) {
+                hash += e;
+            }
+            for(uint32_t j : adjacent) {
+                hash += j;
+            }
+            hashes.emplace_back(hash, i);
+        }
+
+        //clique members with the same elements and neighbours are indistinguishable, the later ones merge into
+        //the first of them
+        sort(hashes.begin(), hashes.end());
+        for(size_t a = 0; a < hashes.size(); a++) {
+            const uint32_t i = hashes[a].second;
+            if(weight[i] == 0) {
+                continue;
+            }
+            bool marked = false;
+            for(size_t b = a + 1; b < hashes.size() && hashes[b].first == hashes[a].first; b++) {
+                const uint32_t j = hashes[b].second;
+                if(weight[j] == 0 || elements[j].size() != elements[i].size()
+                   || variables[j].size() != variables[i].size()) {
+                    continue;
+                }
+                if(!marked) {
+                    ++seenStamp;
+                    for(uint32_t e : elements[i]) {
+                        seen[e] = seenStamp;
+                    }
+                    for(uint32_t v : variables[i]) {
+                        seen[v] = seenStamp;
+                    }
+                    marked = true;
+                }
+                const bool same = all_of(elements[j].begin(), elements[j].end(), [&](uint32_t e) {
+                    return seen[e] == seenStamp;
+                }) && all_of(variables[j].begin(), variables[j].end(), [&](uint32_t v) {
+                    return seen[v] == seenStamp;
+                });
+                if(same) {
+                    weight[i] += weight[j];
+                    weight[j] = 0;
+                    follower[tail[i]] = j;
+                    tail[i] = tail[j];
+                    vector<uint32_t>().swap(elements[j]);
+                    vector<uint32_t>().swap(variables[j]);
+                }
+            }
+        }
+
+        const size_t remaining = n - order.size();
+        for(uint32_t i : clique) {
+            if(weight[i] == 0) {
+                continue;
+            }
+            size_t estimate = cliqueWeight - weight[i];
+            for(uint32_t j : variables[i]) {
+                estimate += weight[j];
+            }
+            for(uint32_t e : elements[i]) {
+                estimate += external[e];
+            }
+            elements[i].push_back(pivot);
+            degree[i] = (uint32_t)min(estimate, remaining - weight[i]);
+            insert(i);
+        }
+        clique.erase(remove_if(clique.begin(), clique.end(), [&](uint32_t j) { return weight[j] == 0; }),
+                     clique.end());
+    }
+    return order;
+}
+
+//Sparse LU factorization with threshold partial pivoting, P * A * Q = L * U
+//Q is a fill-reducing column order (minimumDegreeOrder), P is chosen column by column as the factorization goes,
+//preferring the diagonal of A(Q, Q) so that the order is kept
+//Multifrontal first: columns whose rows of L share a pattern (supernodes of the elimination tree) are eliminated
+//together in a small dense front, so almost all of the work is the blocked LU and GEMM of LUFactorization
+//Pivots are only chosen among the front's own rows, if none of them is acceptable the factorization starts over
+//left-looking (Gilbert-Peierls): column k of L and U comes from one sparse triangular solve with the columns
+//already finished, whose nonzero pattern is found first by a depth-first search through L, so the work is
+//proportional to the flops and never to n per column, and any row may become the pivot
+template<typename T>
+class SparseLU {
+public:
+    //REQUIRES: A is square
+    //MODIFIES: this
+    //EFFECTS: Orders and factors A, stopping at the first column without a nonzero pivot (isSingular)
+    explicit SparseLU(const SparseMatrix<T> &A, T pivotTolerance = (T)SPARSE_PIVOT_TOLERANCE)
+        : n(A.rows), pivotOf(A.rows, SPARSE_NONE),
+          lower(A.rows, A.rows, SparseFormat::Csc), upper(A.rows, A.rows, SparseFormat::Csc) {
+        assert(A.rows == A.columns);
+        SparseMatrix<T> heldRows;
+        SparseMatrix<T> heldColumns;
+        const SparseMatrix<T> &rowsA = csrOf(A, heldRows);
+        const SparseMatrix<T> &colsA = A.format == SparseFormat::Csc ? A
+                                                                     : (heldColumns = A.converted(SparseFormat::Csc));
+        order = minimumDegreeOrder(rowsA, colsA);
+        if(!factorFronts(rowsA, colsA, pivotTolerance)) {
+            pivotOf.assign(n, SPARSE_NONE);
+            lower = SparseMatrix<T>(n, n, SparseFormat::Csc);
+            upper = SparseMatrix<T>(n, n, SparseFormat::Csc);
+            factor(colsA, pivotTolerance);
+        }
+    }
+
+    bool isSingular() const {
+        return singular;
+    }
+    //Entries stored in L and U together, the fill is this minus the nonzeros of A
+    size_t factorNonzeros() const {
+        return lower.nonzeros() + upper.nonzeros();
+    }
+
+    //REQUIRES: the factorization is not singular, b has n elements
+    //MODIFIES: Nothing
+    //EFFECTS: Returns x such that A * x = b
+    vector<T> solve(const vector<T> &b) const {
+        assert(!singular && b.size() == n);
+        vector<T> x(n);
+        for(uint32_t i = 0; i < n; i++) {
+            x[pivotOf[i]] = b[i];
+        }
+        for(uint32_t j = 0; j < n; j++) { //L y = P b, the unit diagonal is the first entry of each column
+            const T xj = x[j];
+            if(xj != 0) {
+                for(size_t p = lower.starts[j] + 1; p < lower.starts[j + 1]; p++) {
+                    x[lower.indices[p]] -= lower.values[p] * xj;
+                }
+            }
+        }
+        for(uint32_t j = n - 1; j < n; j--) { //U z = y, the diagonal is the last entry of each column
+            x[j] /= upper.values[upper.starts[j + 1] - 1];
+            const T xj = x[j];
+            if(xj != 0) {
+                for(size_t p = upper.starts[j]; p + 1 < upper.starts[j + 1]; p++) {
+                    x[upper.indices[p]] -= upper.values[p] * xj;
+                }
+            }
+        }
+        countFlops(2 * (uint64_t)factorNonzeros());
+        vector<T> result(n);
+        for(uint32_t k = 0; k < n; k++) {
+            result[order[k]] = x[k];
+        }
+        return result;
+    }
+
+private:
+    uint32_t n;
+    vector<uint32_t> order; //column k of the factors is column order[k] of A
+    vector<uint32_t> pivotOf; //row i of A is row pivotOf[i] of the factors
+    SparseMatrix<T> lower; //CSC, unit diagonal stored first in each column
+    SparseMatrix<T> upper; //CSC, diagonal stored last in each column
+    bool singular = false;
+
+    //Update a front leaves for its parent, values are size x size row by row, both are kept on stacks
+    struct Update {
+        size_t values;
+        size_t indices;
+        uint32_t size;
+    };
+
+    //Workspace of the column solves
+    vector<T> x; //dense column, zero outside the current pattern
+    vector<uint32_t> pattern; //pattern[top, n) lists the rows reached, in topological order
+    vector<uint32_t> stack;
+    vector<size_t> resume; //where the search resumes in each stacked column of L
+    vector<uint32_t> visited; //column of the search that last visited each row
+
+    //REQUIRES: rowsA and colsA are A in CSR and CSC, order is a fill-reducing order
+    //MODIFIES: order
+    //EFFECTS: Returns the elimination tree of A(Q, Q) + A(Q, Q)^T in postorder, parent[k] is SPARSE_NONE at a root
+    //         order is renumbered to the postorder, which has the same fill and makes every subtree contiguous
+    vector<uint32_t> eliminationTree(const SparseMatrix<T> &rowsA, const SparseMatrix<T> &colsA) {
+        vector<uint32_t> position(n); //position[i] is the step at which row and column i of A are eliminated
+        for(uint32_t k = 0; k < n; k++) {
+            position[order[k]] = k;
+        }
+        vector<uint32_t> parent(n, SPARSE_NONE);
+        vector<uint32_t> ancestor(n, SPARSE_NONE); //path compressed parent, shortcuts the climb to the root
+        for(uint32_t k = 0; k < n; k++) {
+            forEachNeighbour(rowsA, colsA, position, order[k], [&](uint32_t i) {
+                while(i < k) {
+                    const uint32_t next = ancestor[i];
+                    ancestor[i] = k;
+                    if(next == SPARSE_NONE) {
+                        parent[i] = k;
+                        break;
+                    }
+                    i = next;
+                }
+            });
+        }
+
+        vector<uint32_t> firstChild(n, SPARSE_NONE);
+        vector<uint32_t> sibling(n, SPARSE_NONE);
+        for(uint32_t k = n - 1; k < n; k--) { //rolls over after zero, children end up listed in increasing order
+            if(parent[k] != SPARSE_NONE) {
+                sibling[k] = firstChild[parent[k]];
+                firstChild[parent[k]] = k;
+            }
+        }
+        vector<uint32_t> post;
+        post.reserve(n);
+        vector<uint32_t> path;
+        for(uint32_t root = 0; root < n; root++) {
+            if(parent[root] != SPARSE_NONE) {
+                continue;
+            }
+            path.push_back(root);
+            while(!path.empty()) { //a node leaves the path once its children are all numbered
+                const uint32_t k = path.back();
+                if(firstChild[k] == SPARSE_NONE) {
+                    post.push_back(k);
+                    path.pop_back();
+                }
+                else {
+                    path.push_back(firstChild[k]);
+                    firstChild[k] = sibling[firstChild[k]];
+                }
+            }
+        }
+
+        vector<uint32_t> rank(n);
+        vector<uint32_t> postOrder(n);
+        for(uint32_t k = 0; k < n; k++) {
+            rank[post[k]] = k;
+            postOrder[k] = order[post[k]];
+        }
+        vector<uint32_t> postParent(n);
+        for(uint32_t k = 0; k < n; k++) {
+            postParent[k] = parent[post[k]] == SPARSE_NONE ? SPARSE_NONE : rank[parent[post[k]]];
+        }
+        order.swap(postOrder);
+        return postParent;
+    }
+
+    //REQUIRES: position is the inverse of order
+    //MODIFIES: Nothing
+    //EFFECTS: Calls visit(k) for the step k of every row and column of A that meets row or column col off the
+    //         diagonal, a neighbour in both is visited twice
+    template<typename Visit>
+    static void forEachNeighbour(const SparseMatrix<T> &rowsA, const SparseMatrix<T> &colsA,
+                                 const vector<uint32_t> &position, uint32_t col, Visit visit) {
+        for(const SparseMatrix<T> *half : {&colsA, &rowsA}) {
+            for(size_t p = half->starts[col]; p < half->starts[col + 1]; p++) {
+                if(half->indices[p] != col) {
+                    visit(position[half->indices[p]]);
+                }
+            }
+        }
+    }
+
+    //REQUIRES: rowsA and colsA are A in CSR and CSC
+    //MODIFIES: this
+    //EFFECTS: Multifrontal LU, each supernode is assembled from A and the updates its children left, has its own
+    //         columns eliminated by blocks and leaves the update of the rest of its front to its parent
+    //         Returns false without finishing when a front has no acceptable pivot among its own rows, or when
+    //         a front would exceed SPARSE_FRONT_LIMIT
+    bool factorFronts(const SparseMatrix<T> &rowsA, const SparseMatrix<T> &colsA, T pivotTolerance) {
+        if(n == 0) {
+            return true;
+        }
+        const vector<uint32_t> parent = eliminationTree(rowsA, colsA);
+        vector<uint32_t> position(n);
+        for(uint32_t k = 0; k < n; k++) {
+            position[order[k]] = k;
+        }
+
+        //count[k] is the number of rows of L in column k, found by walking each row's subtree of the tree
+        vector<uint32_t> count(n, 1);
+        vector<uint32_t> descendants(n, 1);
+        vector<uint32_t> children(n, 0);
+        vector<uint32_t> mark(n, SPARSE_NONE);
+        for(uint32_t i = 0; i < n; i++) {
+            mark[i] = i;
+            forEachNeighbour(rowsA, colsA, position, order[i], [&](uint32_t k) {
+                for(; k < i && mark[k] != i; k = parent[k]) {
+                    mark[k] = i;
+                    count[k]++;
+                }
+            });
+            if(parent[i] != SPARSE_NONE) {
+                descendants[parent[i]] += descendants[i];
+                children[parent[i]]++;
+            }
+        }
+
+        //supernodes: whole subtrees of at most SPARSE_RELAX_COLUMNS columns, then chains of columns whose
+        //pattern is their parent's plus the diagonal
+        vector<uint32_t> relaxedRoot(n, SPARSE_NONE); //relaxedRoot[first column of the subtree]
+        for(uint32_t k = 0; k < n; k++) {
+            if(descendants[k] <= SPARSE_RELAX_COLUMNS
+               && (parent[k] == SPARSE_NONE || descendants[parent[k]] > SPARSE_RELAX_COLUMNS)) {
+                relaxedRoot[k + 1 - descendants[k]] = k;
+            }
+        }
+        vector<uint32_t> first; //supernode s is columns [first[s], first[s + 1])
+        vector<uint32_t> supernodeOf(n);
+        for(uint32_t k = 0; k < n;) {
+            uint32_t last = k;
+            if(relaxedRoot[k] != SPARSE_NONE) {
+                last = relaxedRoot[k];
+            }
+            else {
+                while(last + 1 < n && parent[last] == last + 1 && children[last + 1] == 1
+                      && count[last] == count[last + 1] + 1) {
+                    last++;
+                }
+            }
+            for(uint32_t j = k; j <= last; j++) {
+                supernodeOf[j] = (uint32_t)first.size();
+            }
+            first.push_back(k);
+            k = last + 1;
+        }
+        const uint32_t supernodes = (uint32_t)first.size();
+        first.push_back(n);
+
+        //a front holds its own columns and the rows below them in L, which are those of its last column
+        vector<uint32_t> updatesFrom(supernodes, 0); //children whose updates a supernode assembles
+        uint32_t largestFront = 0;
+        for(uint32_t s = 0; s < supernodes; s++) {
+            const uint32_t last = first[s + 1] - 1;
+            largestFront = max(largestFront, first[s + 1] - first[s] + count[last] - 1);
+            if(parent[last] != SPARSE_NONE) {
+                updatesFrom[supernodeOf[parent[last]]]++;
+            }
+        }
+        if((uint64_t)largestFront * largestFront > SPARSE_FRONT_LIMIT) {
+            return false;
+        }
+
+        Matrix<T> front(largestFront, largestFront);
+        vector<uint32_t> frontIndex(largestFront); //step of each column of the front
+        vector<uint32_t> rowIndex(largestFront); //step of each row, rows are interchanged by the pivoting
+        vector<uint32_t> local(n); //local[k] is the front column of step k
+        vector<T> updateValues;
+        vector<uint32_t> updateIndices;
+        vector<Update> pending; //updates of supernodes whose parent is not assembled yet, children on top
+        SparseMatrix<T> upperRows(n, n, SparseFormat::Csr);
+        lower.indices.reserve(2 * colsA.nonzeros() + n);
+        lower.values.reserve(2 * colsA.nonzeros() + n);
+        upperRows.indices.reserve(2 * colsA.nonzeros() + n);
+        upperRows.values.reserve(2 * colsA.nonzeros() + n);
+        fill(mark.begin(), mark.end(), SPARSE_NONE);
+
+        for(uint32_t s = 0; s < supernodes; s++) {
+            const uint32_t begin = first[s];
+            const uint32_t end = first[s + 1];
+            const uint32_t pivots = end - begin;
+
+            //the pattern: own columns first, then the rows of A and of the children's updates below them
+            uint32_t size = 0;
+            auto include = [&](uint32_t k) {
+                if(mark[k] != s) {
+                    mark[k] = s;
+                    local[k] = size;
+                    frontIndex[size++] = k;
+                }
+            };
+            for(uint32_t k = begin; k < end; k++) {
+                include(k);
+            }
+            for(uint32_t k = begin; k < end; k++) {
+                forEachNeighbour(rowsA, colsA, position, order[k], [&](uint32_t i) {
+                    if(i >= end) {
+                        include(i);
+                    }
+                });
+            }
+            const size_t childUpdates = pending.size() - updatesFrom[s];
+            for(size_t c = childUpdates; c < pending.size(); c++) {
+                const uint32_t *indices = updateIndices.data() + pending[c].indices;
+                for(uint32_t i = 0; i < pending[c].size; i++) {
+                    include(indices[i]);
+                }
+            }
+            assert(size <= largestFront);
+
+            //assembly, an entry of A goes to the front of the earlier of its row and column
+            for(uint32_t r = 0; r < size; r++) {
+                fill(front.rowPtr(r), front.rowPtr(r) + size, (T)0);
+                rowIndex[r] = frontIndex[r];
+            }
+            for(uint32_t k = begin; k < end; k++) {
+                const uint32_t col = order[k];
+                for(size_t p = colsA.starts[col]; p < colsA.starts[col + 1]; p++) {
+                    const uint32_t i = position[colsA.indices[p]];
+                    if(i >= begin) {
+                        front.rowPtr(local[i])[local[k]] += colsA.values[p];
+                    }
+                }
+                for(size_t p = rowsA.starts[col]; p < rowsA.starts[col + 1]; p++) {
+                    const uint32_t i = position[rowsA.indices[p]];
+                    if(i >= end) {
+                        front.rowPtr(local[k])[local[i]] += rowsA.values[p];
+                    }
+                }
+            }
+            for(size_t c = childUpdates; c < pending.size(); c++) { //extend-add
+                const Update &update = pending[c];
+                const uint32_t *indices = updateIndices.data() + update.indices;
+                const T *values = updateValues.data() + update.values;
+                for(uint32_t i = 0; i < update.size; i++) {
+                    T *row = front.rowPtr(local[indices[i]]);
+                    for(uint32_t j = 0; j < update.size; j++) {
+                        row[local[indices[j]]] += values[(size_t)i * update.size + j];
+                    }
+                }
+            }
+            if(childUpdates < pending.size()) {
+                updateValues.resize(pending[childUpdates].values);
+                updateIndices.resize(pending[childUpdates].indices);
+                pending.resize(childUpdates);
+            }
+
+            if(!factorFront(front, size, pivots, rowIndex, pivotTolerance)) {
+                return false;
+            }
+
+            for(uint32_t k = 0; k < pivots; k++) { //column begin + k of L and row begin + k of U
+                const T *row = front.rowPtr(k);
+                pivotOf[order[rowIndex[k]]] = begin + k;
+                lower.starts[begin + k] = lower.nonzeros();
+                lower.indices.push_back(order[rowIndex[k]]);
+                lower.values.push_back(1);
+                for(uint32_t r = k + 1; r < size; r++) {
+                    const T multiplier = front.rowPtr(r)[k];
+                    if(multiplier != 0) {
+                        lower.indices.push_back(order[rowIndex[r]]);
+                        lower.values.push_back(multiplier);
+                    }
+                }
+                upperRows.starts[begin + k] = upperRows.nonzeros();
+                for(uint32_t c = k; c < size; c++) {
+                    if(c == k || row[c] != 0) {
+                        upperRows.indices.push_back(frontIndex[c]);
+                        upperRows.values.push_back(row[c]);
+                    }
+                }
+            }
+            if(size > pivots) { //the root of a tree has nothing left to pass up
+                pending.push_back(Update{updateValues.size(), updateIndices.size(), size - pivots});
+                for(uint32_t r = pivots; r < size; r++) {
+                    const T *row = front.rowPtr(r);
+                    updateValues.insert(updateValues.end(), row + pivots, row + size);
+                }
+                updateIndices.insert(updateIndices.end(), frontIndex.begin() + pivots, frontIndex.begin() + size);
+            }
+        }
+
+        lower.starts[n] = lower.nonzeros();
+        upperRows.starts[n] = upperRows.nonzeros();
+        for(uint32_t &row : lower.indices) { //rows of L in pivot order
+            row = pivotOf[row];
+        }
+        sortColumns(lower);
+        upper = upperRows.converted(SparseFormat::Csc);
+        lower.countStorage();
+        upper.countStorage();
+        return true;
+    }
+
+    //REQUIRES: the first size rows and columns of front are assembled, the first pivots of them fully
+    //MODIFIES: front, rowIndex
+    //EFFECTS: Eliminates the first pivots columns with blocked right-looking LU, leaving L and U in place and the
+    //         update of the remaining rows and columns in the bottom right of the front
+    //         The pivot of a column must be one of the first pivots rows, the diagonal is kept while it is at least
+    //         pivotTolerance times the largest entry of the whole column, returns false if no row qualifies
+    static bool factorFront(Matrix<T> &front, uint32_t size, uint32_t pivots, vector<uint32_t> &rowIndex,
+                            T pivotTolerance) {
+        const Matrix<T> &factors = front;
+        for(uint32_t k0 = 0; k0 < pivots; k0 += LU_DEFAULT_BLOCK_SIZE) {
+            const uint32_t kb = min(LU_DEFAULT_BLOCK_SIZE, pivots - k0);
+            for(uint32_t k = k0; k < k0 + kb; k++) {
+                T largest = 0;
+                uint32_t candidate = k; //largest entry among the rows that may be the pivot
+                for(uint32_t r = k; r < size; r++) {
+                    const T magnitude = fabs(front.rowPtr(r)[k]);
+                    if(r < pivots && magnitude > fabs(front.rowPtr(candidate)[k])) {
+                        candidate = r;
+                    }
+                    largest = max(largest, magnitude);
+                }
+                const uint32_t pivotRow = fabs(front.rowPtr(k)[k]) >= pivotTolerance * largest ? k : candidate;
+                if(largest == 0 || fabs(front.rowPtr(pivotRow)[k]) < pivotTolerance * largest) {
+                    return false;
+                }
+                if(pivotRow != k) {
+                    front.interchangeRows(k, pivotRow);
+                    swap(rowIndex[k], rowIndex[pivotRow]);
+                }
+
+                const T *pivotRowPtr = front.rowPtr(k);
+                const T pivot = pivotRowPtr[k];
+                for(uint32_t r = k + 1; r < size; r++) {
+                    T *row = front.rowPtr(r);
+                    const T multiplier = row[k] / pivot;
+                    row[k] = multiplier;
+                    if(multiplier != 0) {
+                        rowSubtractScaled(row + k + 1, pivotRowPtr + k + 1, multiplier, k0 + kb - k - 1);
+                    }
+                    countFlops(1 + 2 * (uint64_t)(k0 + kb - k - 1));
+                }
+            }
+            const uint32_t trailing = size - k0 - kb;
+            if(trailing == 0) {
+                continue;
+            }
+            for(uint32_t i = k0 + 1; i < k0 + kb; i++) { //block row of U, L11^-1 times the rows right of the panel
+                T *row = front.rowPtr(i);
+                for(uint32_t j = k0; j < i; j++) {
+                    if(row[j] != 0) {
+                        rowSubtractScaled(row + k0 + kb, front.rowPtr(j) + k0 + kb, row[j], trailing);
+                        countFlops(2 * (uint64_t)trailing);
+                    }
+                }
+            }
+            gemm<T>(-1, subBlock(factors, k0 + kb, k0, trailing, kb), subBlock(factors, k0, k0 + kb, kb, trailing),
+                    1, subBlock(front, k0 + kb, k0 + kb, trailing, trailing));
+        }
+        return true;
+    }
+
+    //REQUIRES: colsA is A in CSC
+    //MODIFIES: this
+    //EFFECTS: Computes L, U and P column by column
+    void factor(const SparseMatrix<T> &colsA, T pivotTolerance) {
+        x.assign(n, 0);
+        pattern.resize(n);
+        stack.resize(n);
+        resume.resize(n);
+        visited.assign(n, SPARSE_NONE);
+        lower.indices.reserve(2 * colsA.nonzeros() + n);
+        lower.values.reserve(2 * colsA.nonzeros() + n);
+        upper.indices.reserve(2 * colsA.nonzeros() + n);
+        upper.values.reserve(2 * colsA.nonzeros() + n);
+        for(uint32_t k = 0; k < n; k++) {
+            lower.starts[k] = lower.nonzeros();
+            upper.starts[k] = upper.nonzeros();
+            const uint32_t col = order[k];
+            const uint32_t top = solveColumn(colsA, col, k);
+
+            uint32_t pivotRow = SPARSE_NONE;
+            T largest = 0;
+            for(uint32_t p = top; p < n; p++) {
+                const uint32_t i = pattern[p];
+                if(pivotOf[i] == SPARSE_NONE) {
+                    if(fabs(x[i]) > largest) {
+                        largest = fabs(x[i]);
+                        pivotRow = i;
+                    }
+                }
+                else if(x[i] != 0) { //a row already pivotal belongs to U
+                    upper.indices.push_back(pivotOf[i]);
+                    upper.values.push_back(x[i]);
+                }
+            }
+            if(pivotRow == SPARSE_NONE || largest == 0) {
+                singular = true;
+                return;
+            }
+            if(pivotOf[col] == SPARSE_NONE && fabs(x[col]) >= pivotTolerance * largest) {
+                pivotRow = col; //the diagonal of A(Q, Q)
+            }
+            const T pivot = x[pivotRow];
+            upper.indices.push_back(k);
+            upper.values.push_back(pivot);
+            pivotOf[pivotRow] = k;
+            lower.indices.push_back(pivotRow);
+            lower.values.push_back(1);
+            for(uint32_t p = top; p < n; p++) {
+                const uint32_t i = pattern[p];
+                if(pivotOf[i] == SPARSE_NONE && x[i] != 0) {
+                    lower.indices.push_back(i);
+                    lower.values.push_back(x[i] / pivot);
+                }
+                x[i] = 0;
+            }
+            countFlops(lower.nonzeros() - lower.starts[k] - 1);
+        }
+        lower.starts[n] = lower.nonzeros();
+        upper.starts[n] = upper.nonzeros();
+        for(uint32_t &row : lower.indices) { //rows of L in pivot order
+            row = pivotOf[row];
+        }
+        sortColumns(lower);
+        sortColumns(upper);
+        lower.countStorage();
+        upper.countStorage();
+        vector<T>().swap(x);
+        vector<uint32_t>().swap(pattern);
+        vector<uint32_t>().swap(stack);
+        vector<size_t>().swap(resume);
+        vector<uint32_t>().swap(visited);
+    }
+
+    //REQUIRES: columns [0, k) of L are finished
+    //MODIFIES: x, pattern, visited
+    //EFFECTS: Solves L * x = A(:, col) over the finished columns of L, rows of A not yet pivotal pass through
+    //         Returns top, pattern[top, n) holds every row where x can be nonzero
+    uint32_t solveColumn(const SparseMatrix<T> &colsA, uint32_t col, uint32_t k) {
+        uint32_t top = n;
+        for(size_t p = colsA.starts[col]; p < colsA.starts[col + 1]; p++) {
+            if(visited[colsA.indices[p]] != k) {
+                top = reach(colsA.indices[p], k, top);
+            }
+        }
+        for(size_t p = colsA.starts[col]; p < colsA.starts[col + 1]; p++) {
+            x[colsA.indices[p]] = colsA.values[p];
+        }
+        uint64_t flops = 0;
+        for(uint32_t p = top; p < n; p++) {
+            const uint32_t j = pattern[p];
+            const uint32_t J = pivotOf[j];
+            if(J == SPARSE_NONE) {
+                continue;
+            }
+            const T xj = x[j];
+            for(size_t q = lower.starts[J] + 1; q < lower.starts[J + 1]; q++) {
+                x[lower.indices[q]] -= lower.values[q] * xj;
+            }
+            flops += 2 * (lower.starts[J + 1] - lower.starts[J] - 1);
+        }
+        countFlops(flops);
+        return top;
+    }
+
+    //REQUIRES: row has not been visited for column k
+    //MODIFIES: pattern, stack, resume, visited
+    //EFFECTS: Depth-first search from row through the columns of L, every row reached is pushed in front of
+    //         pattern[top, n) after all the rows it reaches, which is the order the solve needs, returns the new top
+    uint32_t reach(uint32_t row, uint32_t k, uint32_t top) {
+        uint32_t depth = 0;
+        stack[0] = row;
+        while(true) {
+            const uint32_t j = stack[depth];
+            const uint32_t J = pivotOf[j];
+            if(visited[j] != k) {
+                visited[j] = k;
+                resume[depth] = J == SPARSE_NONE ? 0 : lower.starts[J] + 1; //skip the diagonal, it is j itself
+            }
+            const size_t end = J == SPARSE_NONE ? 0 : lower.starts[J + 1];
+            bool finished = true;
+            for(size_t p = resume[depth]; p < end; p++) {
+                const uint32_t i = lower.indices[p];
+                if(visited[i] != k) {
+                    resume[depth] = p + 1;
+                    stack[++depth] = i;
+                    finished = false;
+                    break;
+                }
+            }
+            if(finished) {
+                pattern[--top] = j;
+                if(depth == 0) {
+                    return top;
+                }
+                depth--;
+            }
+        }
+    }
+
+    //REQUIRES: mat is CSC
+    //MODIFIES: mat
+    //EFFECTS: Sorts the entries of every column by row, which keeps L's diagonal first and U's last
+    static void sortColumns(SparseMatrix<T> &mat) {
+        vector<pair<uint32_t, T>> column;
+        for(uint32_t c = 0; c < mat.columns; c++) {
+            column.clear();
+            for(size_t p = mat.starts[c]; p < mat.starts[c + 1]; p++) {
+                column.emplace_back(mat.indices[p], mat.values[p]);
+            }
+            sort(column.begin(), column.end(), [](const pair<uint32_t, T> &a, const pair<uint32_t, T> &b) {
+                return a.first < b.first;
+            });
+            for(size_t i = 0; i < column.size(); i++) {
+                mat.indices[mat.starts[c] + i] = column[i].first;
+                mat.values[mat.starts[c] + i] = column[i].second;
+            }
+        }
+    }
+};
+
+#endif
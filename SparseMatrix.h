@@ -0,0 +1,442 @@
+#ifndef SPARSEMATRIX_H
+#define SPARSEMATRIX_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include "RowKernels.h"
+#include "OpCounters.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//Stored entries a product must reach before its rows are split across the thread pool
+const size_t SPARSE_PARALLEL_NONZEROS = 1 << 16;
+//Rows of the result handed to one task of a parallel sparse product
+const uint32_t SPARSE_ROWS_PER_TASK = 1024;
+
+//One entry of a coordinate list (COO), "row col value", the input form of a SparseMatrix
+template<typename T>
+struct SparseEntry {
+    uint32_t row;
+    uint32_t col;
+    T value;
+};
+
+//Csr keeps each row's entries together (rows are the outer dimension), Csc each column's
+enum class SparseFormat { Csr, Csc };
+
+//Matrix that stores only its nonzero entries, compressed by row (CSR) or by column (CSC)
+//The entries of outer row/column o are indices[starts[o]] .. indices[starts[o + 1] - 1] with their values,
+//sorted by their inner index, with no duplicates and no stored zeros
+//A 100k x 100k matrix with 1M nonzeros takes 12 MB where the dense Matrix would need 80 GB
+template<typename T>
+class SparseMatrix {
+public:
+    typedef T value_type;
+
+    uint32_t rows = 0;
+    uint32_t columns = 0;
+    SparseFormat format = SparseFormat::Csr;
+    vector<size_t> starts; //outerSize() + 1 entries
+    vector<uint32_t> indices; //column (CSR) or row (CSC) of each entry
+    vector<T> values;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Creates an empty 0 x 0 matrix
+    SparseMatrix() : starts(1, 0) {}
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Creates a numRows x numCols matrix of zeros in the given format
+    SparseMatrix(uint32_t numRows, uint32_t numCols, SparseFormat fmt = SparseFormat::Csr)
+        : rows(numRows), columns(numCols), format(fmt), starts((size_t)outerSize() + 1, 0) {}
+
+    //REQUIRES: every entry is within numRows x numCols
+    //MODIFIES: this
+    //EFFECTS: Creates the matrix of a coordinate list, duplicate entries are summed and zeros are dropped
+    SparseMatrix(uint32_t numRows, uint32_t numCols, const vector<SparseEntry<T>> &entries,
+                 SparseFormat fmt = SparseFormat::Csr) : SparseMatrix(numRows, numCols, fmt) {
+        const bool byRow = format == SparseFormat::Csr;
+        for(const SparseEntry<T> &entry : entries) { //counting sort by the outer index
+            assert(entry.row < rows && entry.col < columns);
+            starts[(byRow ? entry.row : entry.col) + 1]++;
+        }
+        for(uint32_t o = 0; o < outerSize(); o++) {
+            starts[o + 1] += starts[o];
+        }
+        vector<size_t> next(starts.begin(), starts.end() - 1);
+        indices.resize(entries.size());
+        values.resize(entries.size());
+        for(const SparseEntry<T> &entry : entries) {
+            const size_t at = next[byRow ? entry.row : entry.col]++;
+            indices[at] = byRow ? entry.col : entry.row;
+            values[at] = entry.value;
+        }
+        size_t kept = 0;
+        vector<pair<uint32_t, T>> line;
+        for(uint32_t o = 0; o < outerSize(); o++) { //sort each row/column, merge duplicates, drop zeros
+            line.clear();
+            for(size_t p = starts[o]; p < starts[o + 1]; p++) {
+                line.emplace_back(indices[p], values[p]);
+            }
+            stable_sort(line.begin(), line.end(), [](const pair<uint32_t, T> &a, const pair<uint32_t, T> &b) {
+                return a.first < b.first; //duplicates are summed in input order
+            });
+            starts[o] = kept;
+            for(size_t i = 0; i < line.size();) {
+                const uint32_t index = line[i].first;
+                T sum = 0;
+                for(; i < line.size() && line[i].first == index; i++) {
+                    sum += line[i].second;
+                }
+                if(sum != 0) {
+                    indices[kept] = index;
+                    values[kept++] = sum;
+                }
+            }
+        }
+        starts[outerSize()] = kept;
+        indices.resize(kept);
+        values.resize(kept);
+        countStorage();
+    }
+
+    //REQUIRES: mat is a valid matrix
+    //MODIFIES: this
+    //EFFECTS: Creates the sparse form of mat, keeping its nonzero elements
+    explicit SparseMatrix(const Matrix<T> &mat, SparseFormat fmt = SparseFormat::Csr)
+        : SparseMatrix(mat.rows, mat.columns, fmt) {
+        if(format == SparseFormat::Csc) {
+            *this = SparseMatrix(mat).converted(SparseFormat::Csc);
+            return;
+        }
+        for(uint32_t r = 0; r < rows; r++) {
+            const T *row = mat.rowPtr(r);
+            for(uint32_t c = 0; c < columns; c++) {
+                if(row[c] != 0) {
+                    indices.push_back(c);
+                    values.push_back(row[c]);
+                }
+            }
+            starts[r + 1] = values.size();
+        }
+        countStorage();
+    }
+
+    uint32_t getRows() const {
+        return rows;
+    }
+    uint32_t getCols() const {
+        return columns;
+    }
+    //Number of rows (CSR) or columns (CSC), the dimension that starts is indexed by
+    uint32_t outerSize() const {
+        return format == SparseFormat::Csr ? rows : columns;
+    }
+    size_t nonzeros() const {
+        return values.size();
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the dense form of this matrix
+    Matrix<T> toDense() const {
+        Matrix<T> dense(rows, columns);
+        for(uint32_t o = 0; o < outerSize(); o++) {
+            for(size_t p = starts[o]; p < starts[o + 1]; p++) {
+                if(format == SparseFormat::Csr) {
+                    dense.rowPtr(o)[indices[p]] = values[p];
+                }
+                else {
+                    dense.rowPtr(indices[p])[o] = values[p];
+                }
+            }
+        }
+        return dense;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns this matrix stored in fmt, converting CSR and CSC is a counting sort over the entries
+    SparseMatrix converted(SparseFormat fmt) const {
+        if(fmt == format) {
+            return *this;
+        }
+        SparseMatrix result(rows, columns, fmt);
+        for(uint32_t index : indices) {
+            result.starts[index + 1]++;
+        }
+        for(uint32_t o = 0; o < result.outerSize(); o++) {
+            result.starts[o + 1] += result.starts[o];
+        }
+        vector<size_t> next(result.starts.begin(), result.starts.end() - 1);
+        result.indices.resize(nonzeros());
+        result.values.resize(nonzeros());
+        for(uint32_t o = 0; o < outerSize(); o++) { //visiting outer indices in order keeps the result sorted
+            for(size_t p = starts[o]; p < starts[o + 1]; p++) {
+                const size_t at = next[indices[p]]++;
+                result.indices[at] = o;
+                result.values[at] = values[p];
+            }
+        }
+        result.countStorage();
+        return result;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the transpose in the opposite format, the CSR arrays of A are the CSC arrays of A^T,
+    //         so nothing is sorted, use converted() on the result for the original format
+    SparseMatrix transposed() const {
+        SparseMatrix result(*this);
+        swap(result.rows, result.columns);
+        result.format = format == SparseFormat::Csr ? SparseFormat::Csc : SparseFormat::Csr;
+        result.countStorage();
+        return result;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: opCounters
+    //EFFECTS: Counts the arrays of this matrix as allocated, the vectors bypass alignedAllocate
+    void countStorage() const {
+        countAllocation(starts.size() * sizeof(size_t) + indices.size() * sizeof(uint32_t)
+                        + values.size() * sizeof(T));
+    }
+};
+
+//REQUIRES: Nothing
+//MODIFIES: held
+//EFFECTS: Returns A itself if it is CSR, otherwise converts it into held and returns held
+template<typename T>
+const SparseMatrix<T> &csrOf(const SparseMatrix<T> &A, SparseMatrix<T> &held) {
+    if(A.format == SparseFormat::Csr) {
+        return A;
+    }
+    held = A.converted(SparseFormat::Csr);
+    return held;
+}
+
+//REQUIRES: task(begin, end) can run concurrently on disjoint row ranges
+//MODIFIES: Whatever task modifies
+//EFFECTS: Calls task on each chunk of SPARSE_ROWS_PER_TASK consecutive rows of [0, rows), across the thread pool
+//         when the product visits at least SPARSE_PARALLEL_NONZEROS entries and serially otherwise
+template<typename Task>
+void sparseRowRanges(uint32_t rows, size_t work, Task task) {
+    const uint32_t chunks = (rows + SPARSE_ROWS_PER_TASK - 1) / SPARSE_ROWS_PER_TASK;
+    auto runChunk = [&](uint32_t chunk) {
+        const uint32_t begin = chunk * SPARSE_ROWS_PER_TASK;
+        task(begin, min(begin + SPARSE_ROWS_PER_TASK, rows));
+    };
+    if(work < SPARSE_PARALLEL_NONZEROS || ThreadPool::instance().size() == 1) {
+        for(uint32_t chunk = 0; chunk < chunks; chunk++) {
+            runChunk(chunk);
+        }
+        return;
+    }
+    ThreadPool::instance().parallelFor(chunks, runChunk);
+}
+
+//REQUIRES: x has A.columns elements
+//MODIFIES: Nothing
+//EFFECTS: Returns A * x (SpMV), rows are independent dot products in CSR, CSC scatters column by column
+template<typename T>
+vector<T> multiply(const SparseMatrix<T> &A, const vector<T> &x) {
+    assert(x.size() == A.columns);
+    vector<T> y(A.rows, 0);
+    countFlops(2 * (uint64_t)A.nonzeros());
+    if(A.format == SparseFormat::Csc) {
+        for(uint32_t c = 0; c < A.columns; c++) {
+            for(size_t p = A.starts[c]; p < A.starts[c + 1]; p++) {
+                y[A.indices[p]] += A.values[p] * x[c];
+            }
+        }
+        return y;
+    }
+    sparseRowRanges(A.rows, A.nonzeros(), [&](uint32_t begin, uint32_t end) {
+        for(uint32_t r = begin; r < end; r++) {
+            T sum = 0;
+            for(size_t p = A.starts[r]; p < A.starts[r + 1]; p++) {
+                sum += A.values[p] * x[A.indices[p]];
+            }
+            y[r] = sum;
+        }
+    });
+    return y;
+}
+
+//Dense accumulator for one row of a sparse product, owned by one thread and reused by every later product on it
+//Between rows every value is zero, a row marks the columns it touches with a stamp no other row uses
+template<typename T>
+struct SparseAccumulator {
+    vector<T> values;
+    vector<uint64_t> marks;
+    uint64_t stamp = 0;
+    vector<uint32_t> pattern;
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Makes room for rows of columns columns
+    void reserve(uint32_t columns) {
+        if(values.size() < columns) {
+            values.resize(columns, 0);
+            marks.resize(columns, 0);
+        }
+    }
+};
+
+//REQUIRES: A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns A * B (SpMM) in CSR, row by row (Gustavson): row r of the product is the sum of the rows of B
+//         picked by row r of A, gathered in a dense accumulator, chunks of rows run on the thread pool
+template<typename T>
+SparseMatrix<T> multiply(const SparseMatrix<T> &A, const SparseMatrix<T> &B) {
+    assert(A.columns == B.rows);
+    SparseMatrix<T> heldA;
+    const SparseMatrix<T> &rowsA = csrOf(A, heldA);
+    SparseMatrix<T> heldB;
+    const SparseMatrix<T> &rowsB = csrOf(B, heldB);
+    const uint32_t chunks = (A.rows + SPARSE_ROWS_PER_TASK - 1) / SPARSE_ROWS_PER_TASK;
+    vector<vector<uint32_t>> chunkIndices(chunks);
+    vector<vector<T>> chunkValues(chunks);
+    vector<size_t> rowLengths(A.rows, 0);
+    vector<uint64_t> chunkFlops(chunks, 0);
+    sparseRowRanges(A.rows, A.nonzeros() + B.nonzeros(), [&](uint32_t begin, uint32_t end) {
+        const uint32_t chunk = begin / SPARSE_ROWS_PER_TASK;
+        thread_local SparseAccumulator<T> workspace;
+        workspace.reserve(B.columns);
+        T *accumulator = workspace.values.data();
+        uint64_t *marks = workspace.marks.data();
+        vector<uint32_t> &pattern = workspace.pattern;
+        for(uint32_t r = begin; r < end; r++) {
+            const uint64_t stamp = ++workspace.stamp;
+            pattern.clear();
+            for(size_t p = rowsA.starts[r]; p < rowsA.starts[r + 1]; p++) {
+                const uint32_t k = rowsA.indices[p];
+                const T coef = rowsA.values[p];
+                for(size_t q = rowsB.starts[k]; q < rowsB.starts[k + 1]; q++) {
+                    const uint32_t c = rowsB.indices[q];
+                    if(marks[c] != stamp) {
+                        marks[c] = stamp;
+                        pattern.push_back(c);
+                    }
+                    accumulator[c] += coef * rowsB.values[q];
+                }
+                chunkFlops[chunk] += 2 * (uint64_t)(rowsB.starts[k + 1] - rowsB.starts[k]);
+            }
+            sort(pattern.begin(), pattern.end());
+            for(uint32_t c : pattern) {
+                if(accumulator[c] != 0) { //cancellation leaves no stored zeros
+                    chunkIndices[chunk].push_back(c);
+                    chunkValues[chunk].push_back(accumulator[c]);
+                    rowLengths[r]++;
+                }
+                accumulator[c] = 0;
+            }
+        }
+    });
+    SparseMatrix<T> product(A.rows, B.columns, SparseFormat::Csr);
+    for(uint32_t r = 0; r < A.rows; r++) {
+        product.starts[r + 1] = product.starts[r] + rowLengths[r];
+    }
+    product.indices.reserve(product.starts[A.rows]);
+    product.values.reserve(product.starts[A.rows]);
+    for(uint32_t chunk = 0; chunk < chunks; chunk++) { //chunks hold consecutive rows, so appending keeps the order
+        product.indices.insert(product.indices.end(), chunkIndices[chunk].begin(), chunkIndices[chunk].end());
+        product.values.insert(product.values.end(), chunkValues[chunk].begin(), chunkValues[chunk].end());
+        countFlops(chunkFlops[chunk]);
+    }
+    product.countStorage();
+    return product;
+}
+
+//REQUIRES: A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns the dense product A * B, row r is the combination of the rows of B picked by row r of A
+template<typename T>
+Matrix<T> multiply(const SparseMatrix<T> &A, const Matrix<T> &B) {
+    assert(A.columns == B.rows);
+    SparseMatrix<T> heldA;
+    const SparseMatrix<T> &rowsA = csrOf(A, heldA);
+    Matrix<T> product(A.rows, B.columns);
+    countFlops(2 * (uint64_t)A.nonzeros() * B.columns);
+    sparseRowRanges(A.rows, A.nonzeros() * B.columns, [&](uint32_t begin, uint32_t end) {
+        for(uint32_t r = begin; r < end; r++) {
+            T *row = product.rowPtr(r);
+            for(size_t p = rowsA.starts[r]; p < rowsA.starts[r + 1]; p++) { //row += v * B_k as row -= (-v) * B_k
+                rowSubtractScaled(row, B.rowPtr(rowsA.indices[p]), -rowsA.values[p], B.columns);
+            }
+        }
+    });
+    return product;
+}
+
+//REQUIRES: A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns the dense product A * B, row r is the combination of the rows of B picked by row r of A
+template<typename T>
+Matrix<T> multiply(const Matrix<T> &A, const SparseMatrix<T> &B) {
+    assert(A.columns == B.rows);
+    SparseMatrix<T> heldB;
+    const SparseMatrix<T> &rowsB = csrOf(B, heldB);
+    Matrix<T> product(A.rows, B.columns);
+    countFlops(2 * (uint64_t)A.rows * B.nonzeros());
+    sparseRowRanges(A.rows, (size_t)A.rows * B.nonzeros(), [&](uint32_t begin, uint32_t end) {
+        for(uint32_t r = begin; r < end; r++) {
+            const T *rowA = A.rowPtr(r);
+            T *row = product.rowPtr(r);
+            for(uint32_t k = 0; k < A.columns; k++) {
+                const T coef = rowA[k];
+                if(coef != 0) {
+                    for(size_t q = rowsB.starts[k]; q < rowsB.starts[k + 1]; q++) {
+                        row[rowsB.indices[q]] += coef * rowsB.values[q];
+                    }
+                }
+            }
+        }
+    });
+    return product;
+}
+
+//REQUIRES: A and B have the same dimensions
+//MODIFIES: Nothing
+//EFFECTS: Returns A + coef * B in CSR, merging the sorted rows of both
+template<typename T>
+SparseMatrix<T> addScaled(const SparseMatrix<T> &A, const SparseMatrix<T> &B, T coef) {
+    assert(A.rows == B.rows && A.columns == B.columns);
+    SparseMatrix<T> heldA;
+    const SparseMatrix<T> &rowsA = csrOf(A, heldA);
+    SparseMatrix<T> heldB;
+    const SparseMatrix<T> &rowsB = csrOf(B, heldB);
+    SparseMatrix<T> sum(A.rows, A.columns, SparseFormat::Csr);
+    sum.indices.reserve(A.nonzeros() + B.nonzeros());
+    sum.values.reserve(A.nonzeros() + B.nonzeros());
+    countFlops(2 * (uint64_t)B.nonzeros());
+    for(uint32_t r = 0; r < A.rows; r++) {
+        size_t p = rowsA.starts[r];
+        size_t q = rowsB.starts[r];
+        while(p < rowsA.starts[r + 1] || q < rowsB.starts[r + 1]) {
+            const uint32_t colA = p < rowsA.starts[r + 1] ? rowsA.indices[p] : A.columns;
+            const uint32_t colB = q < rowsB.starts[r + 1] ? rowsB.indices[q] : A.columns;
+            const uint32_t col = min(colA, colB);
+            T value = 0;
+            if(colA == col) {
+                value += rowsA.values[p++];
+            }
+            if(colB == col) {
+                value += coef * rowsB.values[q++];
+            }
+            if(value != 0) {
+                sum.indices.push_back(col);
+                sum.values.push_back(value);
+            }
+        }
+        sum.starts[r + 1] = sum.values.size();
+    }
+    sum.countStorage();
+    return sum;
+}
+
+#endif
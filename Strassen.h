@@ -0,0 +1,183 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "Gemm.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+//Default crossover of the * operand (--strassen): products whose three dimensions are all at least this go through
+//Strassen-Winograd, so do its subproducts while they still are, every other product (and every subproduct below it)
+//is the blocked GEMM
+//Leaves of 512 to 1023 are where the GEMM kernel runs fastest, 2048 x 2048 takes 0.85x the time (0.99x with a
+//crossover of 2048) and 4096 x 4096 0.65x (0.75x)
+const uint32_t STRASSEN_DEFAULT_CROSSOVER = 1024;
+//Crossover that keeps every product on the classical GEMM, for callers that need its error bound
+//(|error| <= k * eps * |A| * |B| elementwise, Strassen-Winograd is only bounded in norm and loses a little more
+//accuracy with each level)
+const uint32_t STRASSEN_OFF = UINT32_MAX;
+
+//Temporaries of every level of one Strassen-Winograd product, allocated once before the recursion starts
+//x[d] and y[d] belong to recursion depth d, which runs its seven subproducts one after another so they can share them
+template<typename T>
+struct StrassenWorkspace {
+    vector<Matrix<T>> x; //m/2 x max(k/2, n/2): sums of quadrants of A, then P1
+    vector<Matrix<T>> y; //k/2 x n/2: sums of quadrants of B
+};
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns whether an m x k times k x n product is split into quadrants
+inline bool strassenSplits(uint32_t m, uint32_t k, uint32_t n, uint32_t crossover) {
+    return min(m, min(k, n)) >= max(crossover, 2u);
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the temporaries for an m x k times k x n product, none if it is not split at all
+template<typename T>
+StrassenWorkspace<T> strassenWorkspace(uint32_t m, uint32_t k, uint32_t n, uint32_t crossover) {
+    StrassenWorkspace<T> workspace;
+    while(strassenSplits(m, k, n, crossover)) {
+        m /= 2;
+        k /= 2;
+        n /= 2;
+        workspace.x.emplace_back(m, max(k, n));
+        workspace.y.emplace_back(k, n);
+    }
+    return workspace;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns block as a read-only block
+template<typename T>
+MatrixBlock<const Matrix<T>> readOnly(const MatrixBlock<Matrix<T>> &block) {
+    return MatrixBlock<const Matrix<T>>{block.mat, block.row, block.col, block.rows, block.columns};
+}
+
+//REQUIRES: A, B and C have the same dimensions, C is A, B or overlaps neither
+//MODIFIES: C
+//EFFECTS: C = A - B if subtract, else C = A + B
+template<typename T>
+void blockAdd(const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B, bool subtract,
+              const MatrixBlock<Matrix<T>> &C) {
+    assert(A.rows == C.rows && B.rows == C.rows && A.columns == C.columns && B.columns == C.columns);
+    for(uint32_t r = 0; r < C.rows; r++) {
+        const T *aRow = A.rowPtr(r);
+        const T *bRow = B.rowPtr(r);
+        T *cRow = C.rowPtr(r);
+        if(subtract) {
+            for(uint32_t c = 0; c < C.columns; c++) {
+                cRow[c] = aRow[c] - bRow[c];
+            }
+        }
+        else {
+            for(uint32_t c = 0; c < C.columns; c++) {
+                cRow[c] = aRow[c] + bRow[c];
+            }
+        }
+    }
+    countFlops((uint64_t)C.rows * C.columns);
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and overlaps neither, workspace was made for this product
+//          from depth on
+//MODIFIES: C, workspace
+//EFFECTS: C = A * B, split into quadrants when workspace has a level for it: seven half size products (recursively)
+//         and fifteen quadrant additions in Winograd's form, scheduled so that C's own quadrants and the two
+//         temporaries of the level hold every intermediate (Douglas et al., DGEFMM)
+//         An odd dimension is peeled off: the even part is split and the last row, column or rank one term is
+//         added with GEMM
+template<typename T>
+void strassenLevel(const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B,
+                   const MatrixBlock<Matrix<T>> &C, StrassenWorkspace<T> &workspace, uint32_t depth) {
+    if(depth == workspace.x.size()) {
+        gemm<T>(1, A, B, 0, C);
+        return;
+    }
+    const uint32_t m = A.rows / 2;
+    const uint32_t k = A.columns / 2;
+    const uint32_t n = B.columns / 2;
+    const auto A11 = subBlock(A, 0, 0, m, k), A12 = subBlock(A, 0, k, m, k);
+    const auto A21 = subBlock(A, m, 0, m, k), A22 = subBlock(A, m, k, m, k);
+    const auto B11 = subBlock(B, 0, 0, k, n), B12 = subBlock(B, 0, n, k, n);
+    const auto B21 = subBlock(B, k, 0, k, n), B22 = subBlock(B, k, n, k, n);
+    const auto C11 = subBlock(C, 0, 0, m, n), C12 = subBlock(C, 0, n, m, n);
+    const auto C21 = subBlock(C, m, 0, m, n), C22 = subBlock(C, m, n, m, n);
+    const auto sumA = subBlock(workspace.x[depth], 0, 0, m, k);
+    const auto P1 = subBlock(workspace.x[depth], 0, 0, m, n);
+    const auto sumB = wholeBlock(workspace.y[depth]);
+    const uint32_t next = depth + 1;
+
+    blockAdd(A11, A21, true, sumA);                                        //S3 = A11 - A21
+    blockAdd(B22, B12, true, sumB);                                        //T3 = B22 - B12
+    strassenLevel(readOnly(sumA), readOnly(sumB), C21, workspace, next);   //P7 = S3 * T3
+    blockAdd(A21, A22, false, sumA);                                       //S1 = A21 + A22
+    blockAdd(B12, B11, true, sumB);                                        //T1 = B12 - B11
+    strassenLevel(readOnly(sumA), readOnly(sumB), C22, workspace, next);   //P5 = S1 * T1
+    blockAdd(readOnly(sumA), A11, true, sumA);                             //S2 = S1 - A11
+    blockAdd(B22, readOnly(sumB), true, sumB);                             //T2 = B22 - T1
+    strassenLevel(readOnly(sumA), readOnly(sumB), C12, workspace, next);   //P6 = S2 * T2
+    blockAdd(A12, readOnly(sumA), true, sumA);                             //S4 = A12 - S2
+    strassenLevel(readOnly(sumA), B22, C11, workspace, next);              //P3 = S4 * B22
+    strassenLevel(A11, B11, P1, workspace, next);                          //P1 = A11 * B11
+    blockAdd(readOnly(P1), readOnly(C12), false, C12);                     //U2 = P1 + P6
+    blockAdd(readOnly(C12), readOnly(C21), false, C21);                    //U3 = U2 + P7
+    blockAdd(readOnly(C12), readOnly(C22), false, C12);                    //U4 = U2 + P5
+    blockAdd(readOnly(C21), readOnly(C22), false, C22);                    //C22 = U3 + P5
+    blockAdd(readOnly(C12), readOnly(C11), false, C12);                    //C12 = U4 + P3
+    blockAdd(readOnly(sumB), B21, true, sumB);                             //T4 = T2 - B21
+    strassenLevel(A22, readOnly(sumB), C11, workspace, next);              //P4 = A22 * T4
+    blockAdd(readOnly(C21), readOnly(C11), true, C21);                     //C21 = U3 - P4
+    strassenLevel(A12, B21, C11, workspace, next);                         //P2 = A12 * B21
+    blockAdd(readOnly(P1), readOnly(C11), false, C11);                     //C11 = P1 + P2
+
+    if(A.columns > 2 * k) { //the last column of A times the last row of B
+        gemm<T>(1, subBlock(A, 0, 2 * k, 2 * m, 1), subBlock(B, 2 * k, 0, 1, 2 * n), 1,
+                subBlock(C, 0, 0, 2 * m, 2 * n));
+    }
+    if(B.columns > 2 * n) {
+        gemm<T>(1, A, subBlock(B, 0, 2 * n, B.rows, 1), 0, subBlock(C, 0, 2 * n, C.rows, 1));
+    }
+    if(A.rows > 2 * m) {
+        gemm<T>(1, subBlock(A, 2 * m, 0, 1, A.columns), subBlock(B, 0, 0, B.rows, 2 * n), 0,
+                subBlock(C, 2 * m, 0, 1, 2 * n));
+    }
+}
+
+//REQUIRES: A.columns == B.rows, C is A.rows x B.columns and overlaps neither A nor B
+//MODIFIES: C
+//EFFECTS: C = A * B, through Strassen-Winograd while every dimension is at least crossover (about 7/8 of the
+//         multiplications per level, at the cost of a slightly weaker error bound), with GEMM below it
+//         All temporaries are allocated once up front, about a third of A, B and C together
+template<typename T>
+void strassen(const MatrixBlock<const Matrix<T>> &A, const MatrixBlock<const Matrix<T>> &B,
+              const MatrixBlock<Matrix<T>> &C, uint32_t crossover) {
+    assert(A.columns == B.rows);
+    assert(C.rows == A.rows && C.columns == B.columns);
+    StrassenWorkspace<T> workspace = strassenWorkspace<T>(A.rows, A.columns, B.columns, crossover);
+    strassenLevel(A, B, C, workspace, 0);
+}
+
+//REQUIRES: A and B are valid, A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns the product A * B as a new matrix, neither input is changed
+//         Products of at least strassenCrossover in every dimension use Strassen-Winograd, STRASSEN_OFF never does
+template<typename T>
+Matrix<T> multiply(const Matrix<T> &A, const Matrix<T> &B, uint32_t strassenCrossover) {
+    Matrix<T> product(A.rows, B.columns);
+    strassen<T>(wholeBlock(A), wholeBlock(B), wholeBlock(product), strassenCrossover);
+    return product;
+}
+
+//REQUIRES: A and B are valid, A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns the product A * B as a new matrix, neither input is changed
+//         Always the classical product (the GEMM error bound), the * operand opts in to Strassen-Winograd itself
+template<typename T>
+Matrix<T> multiply(const Matrix<T> &A, const Matrix<T> &B) {
+    return multiply(A, B, STRASSEN_OFF);
+}
+
+#endif
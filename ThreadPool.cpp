@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace {
+    //Set on pool workers and on a caller while it runs tasks, nested parallelFor calls run serially
+    thread_local bool insideParallelFor = false;
+}
+
+ThreadPool::ThreadPool(uint32_t numThreads) {
+    start(numThreads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::resize(uint32_t numThreads) {
+    lock_guard<mutex> job(jobLock);
+    stop();
+    start(numThreads);
+}
+
+ThreadPool &ThreadPool::instance() {
+    static ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
+
+//REQUIRES: No workers are running
+//MODIFIES: this
+//EFFECTS: Creates one queue per participant and launches numThreads - 1 workers
+void ThreadPool::start(uint32_t numThreads) {
+    numThreads = max(1u, numThreads);
+    stopping = false;
+    queues.clear();
+    for(uint32_t q = 0; q < numThreads; q++) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for(uint32_t w = 1; w < numThreads; w++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, w);
+    }
+}
+
+//REQUIRES: No parallelFor is running
+//MODIFIES: this
+//EFFECTS: Wakes every worker with the stop flag set and joins them
+void ThreadPool::stop() {
+    {
+        lock_guard<mutex> guard(poolLock);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for(thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::parallelFor(uint32_t numTasks, const function<void(uint32_t)> &task) {
+    if(numTasks == 0) {
+        return;
+    }
+    if(workers.empty() || numTasks == 1 || insideParallelFor) {
+        for(uint32_t i = 0; i < numTasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    lock_guard<mutex> job(jobLock);
+    currentTask = &task;
+    remaining.store(numTasks);
+    for(uint32_t i = 0; i < numTasks; i++) { //deal the tasks out so each thread starts on its own share
+        WorkQueue &queue = *queues[i % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(i);
+    }
+    {
+        lock_guard<mutex> guard(poolLock);
+        generation++;
+    }
+    workReady.notify_all();
+
+    insideParallelFor = true;
+    while(runOne(0)) {}
+    insideParallelFor = false;
+
+    unique_lock<mutex> guard(poolLock);
+    workDone.wait(guard, [this]() { return remaining.load() == 0; });
+    currentTask = nullptr;
+}
+
+//REQUIRES: self is a valid queue index
+//MODIFIES: queues, remaining
+//EFFECTS: Runs one task from the front of queue self, or failing that from the back of another queue
+//         Returns false when every queue is empty
+bool ThreadPool::runOne(uint32_t self) {
+    uint32_t index = 0;
+    bool found = false;
+    for(uint32_t offset = 0; offset < queues.size() && !found; offset++) {
+        WorkQueue &queue = *queues[(self + offset) % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if(!queue.tasks.empty()) {
+            if(offset == 0) { //own queue, take the oldest task
+                index = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else { //steal the newest task, the owner is working from the other end
+                index = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            found = true;
+        }
+    }
+    if(!found) {
+        return false;
+    }
+
+    (*currentTask)(index);
+    if(remaining.fetch_sub(1) == 1) { //last task of the job
+        lock_guard<mutex> guard(poolLock);
+        workDone.notify_all();
+    }
+    return true;
+}
+
+//REQUIRES: self is a valid queue index other than 0
+//MODIFIES: queues, remaining
+//EFFECTS: Sleeps until a new job is posted, drains the queues, and repeats until the pool stops
+void ThreadPool::workerLoop(uint32_t self) {
+    insideParallelFor = true;
+    uint64_t seen = 0;
+    while(true) {
+        {
+            unique_lock<mutex> guard(poolLock);
+            workReady.wait(guard, [this, seen]() { return stopping || generation != seen; });
+            if(stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        while(runOne(self)) {}
+    }
+}
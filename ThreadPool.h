@@ -0,0 +1,79 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//Persistent pool of worker threads shared by every parallel kernel in the library
+//Each thread (the calling thread included) owns a queue of task indices, it takes work from the front of its own
+//queue and steals from the back of the others once it runs dry, so uneven tasks still balance
+class ThreadPool {
+public:
+    //REQUIRES: numThreads >= 1
+    //MODIFIES: this
+    //EFFECTS: Starts numThreads - 1 workers, the thread calling parallelFor is the last participant
+    explicit ThreadPool(uint32_t numThreads);
+
+    //REQUIRES: No parallelFor is running
+    //MODIFIES: this
+    //EFFECTS: Stops and joins every worker
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    //REQUIRES: numThreads >= 1, no parallelFor is running
+    //MODIFIES: this
+    //EFFECTS: Restarts the pool with numThreads participants
+    void resize(uint32_t numThreads);
+
+    //Number of threads that take part in a parallelFor, the caller included
+    uint32_t size() const {
+        return (uint32_t)workers.size() + 1;
+    }
+
+    //REQUIRES: task can be called concurrently for different indices
+    //MODIFIES: Whatever task modifies
+    //EFFECTS: Calls task(i) for every i in [0, numTasks) across the pool and returns once all calls have finished
+    //         Runs serially when the pool has one thread or when called from inside another parallelFor
+    void parallelFor(uint32_t numTasks, const function<void(uint32_t)> &task);
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns the library-wide pool, created with one thread per hardware core on first use
+    static ThreadPool &instance();
+
+private:
+    struct WorkQueue {
+        mutex lock;
+        deque<uint32_t> tasks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<WorkQueue>> queues; //queues[0] belongs to the calling thread
+    const function<void(uint32_t)> *currentTask = nullptr;
+    atomic<uint32_t> remaining{0};
+
+    mutex poolLock; //guards generation and stopping
+    condition_variable workReady;
+    condition_variable workDone;
+    uint64_t generation = 0;
+    bool stopping = false;
+    mutex jobLock; //one parallelFor at a time
+
+    void start(uint32_t numThreads);
+    void stop();
+    void workerLoop(uint32_t self);
+    bool runOne(uint32_t self);
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "TileCache.h"
+#include "Matrix.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    atomic<uint64_t> nextFileId{1};
+    const uint32_t SLOT_BITS = 40; //a key is the file id above the slot index
+}
+
+TileFile::TileFile(const string &dir, uint64_t numSlots, size_t bytes) : slotBytes(bytes), id(nextFileId++) {
+    const string pattern = dir + "/linal-tiles-XXXXXX";
+    vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    fd = mkstemp(path.data());
+    if(fd < 0) {
+        cerr << "Unable to create a tile file in " << dir << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+    unlink(path.data()); //deleted once closed, whatever happens to the process
+    if(ftruncate(fd, (off_t)(numSlots * slotBytes)) != 0) {
+        cerr << "Unable to size a tile file of " << numSlots * slotBytes << " bytes in " << dir << ": "
+             << strerror(errno) << "\n";
+        exit(1);
+    }
+}
+
+TileFile::~TileFile() {
+    close(fd);
+}
+
+void TileFile::read(uint64_t slot, void *buffer) const {
+    char *dest = static_cast<char *>(buffer);
+    const off_t start = (off_t)(slot * slotBytes);
+    size_t done = 0;
+    while(done < slotBytes) {
+        const ssize_t got = pread(fd, dest + done, slotBytes - done, start + (off_t)done);
+        if(got < 0 && errno == EINTR) {
+            continue;
+        }
+        if(got <= 0) {
+            cerr << "Unable to read a tile back from disk: " << (got < 0 ? strerror(errno) : "file truncated") << "\n";
+            exit(1);
+        }
+        done += (size_t)got;
+    }
+}
+
+void TileFile::write(uint64_t slot, const void *buffer) const {
+    const char *source = static_cast<const char *>(buffer);
+    const off_t start = (off_t)(slot * slotBytes);
+    size_t done = 0;
+    while(done < slotBytes) {
+        const ssize_t put = pwrite(fd, source + done, slotBytes - done, start + (off_t)done);
+        if(put < 0 && errno == EINTR) {
+            continue;
+        }
+        if(put <= 0) {
+            cerr << "Unable to write a tile to disk: " << (put < 0 ? strerror(errno) : "no progress") << "\n";
+            exit(1);
+        }
+        done += (size_t)put;
+    }
+}
+
+TileCache::TileCache(size_t budgetBytes, const string &dir) : budget(budgetBytes), directory(dir) {
+    prefetcher = thread(&TileCache::prefetchLoop, this);
+}
+
+TileCache::~TileCache() {
+    {
+        lock_guard<mutex> held(lock);
+        stopping = true;
+    }
+    queued.notify_all();
+    prefetcher.join();
+    for(auto &entry : slots) {
+        alignedFree(entry.second.buffer);
+    }
+}
+
+void *TileCache::pin(const TileFile &file, uint64_t slot, bool overwrite) {
+    const uint64_t key = keyOf(file, slot);
+    unique_lock<mutex> held(lock);
+    while(true) {
+        auto found = slots.find(key);
+        if(found == slots.end()) {
+            makeRoom(held, file.getSlotBytes()); //a pin goes over the budget if everything else is pinned
+            if(slots.count(key) != 0) { //loaded by another thread while makeRoom wrote a slot back
+                continue;
+            }
+            Slot &entry = insert(file, slot, 1);
+            held.unlock();
+            if(overwrite) {
+                memset(entry.buffer, 0, entry.bytes);
+            }
+            else {
+                file.read(slot, entry.buffer);
+            }
+            held.lock();
+            reads += overwrite ? 0 : 1;
+            entry.state = State::Ready;
+            changed.notify_all();
+            return entry.buffer;
+        }
+        Slot &entry = found->second;
+        if(entry.state != State::Ready) { //being read by a prefetch or written back by an eviction
+            changed.wait(held);
+            continue;
+        }
+        if(entry.pins == 0) {
+            lru.erase(entry.lru);
+        }
+        entry.pins++;
+        if(overwrite) {
+            memset(entry.buffer, 0, entry.bytes);
+        }
+        return entry.buffer;
+    }
+}
+
+void TileCache::unpin(const TileFile &file, uint64_t slot, bool changedSlot) {
+    const uint64_t key = keyOf(file, slot);
+    lock_guard<mutex> held(lock);
+    Slot &entry = slots.at(key);
+    assert(entry.pins > 0);
+    entry.dirty = entry.dirty || changedSlot;
+    if(--entry.pins == 0) {
+        lru.push_front(key);
+        entry.lru = lru.begin();
+    }
+}
+
+void TileCache::prefetch(const TileFile &file, uint64_t slot) {
+    {
+        lock_guard<mutex> held(lock);
+        if(slots.count(keyOf(file, slot)) != 0) {
+            return;
+        }
+        for(const Request &request : queue) {
+            if(request.file == &file && request.slot == slot) {
+                return;
+            }
+        }
+        queue.push_back(Request{&file, slot});
+    }
+    queued.notify_one();
+}
+
+void TileCache::drop(const TileFile &file) {
+    unique_lock<mutex> held(lock);
+    queue.erase(remove_if(queue.begin(), queue.end(), [&](const Request &request) {
+        return request.file == &file;
+    }), queue.end());
+    changed.wait(held, [&] {
+        if(prefetching == &file) {
+            return false;
+        }
+        for(const auto &entry : slots) {
+            if(entry.second.file == &file && entry.second.state != State::Ready) {
+                return false;
+            }
+        }
+        return true;
+    });
+    for(auto entry = slots.begin(); entry != slots.end();) {
+        if(entry->second.file != &file) {
+            ++entry;
+            continue;
+        }
+        assert(entry->second.pins == 0);
+        lru.erase(entry->second.lru);
+        used -= entry->second.bytes;
+        alignedFree(entry->second.buffer);
+        entry = slots.erase(entry);
+    }
+}
+
+uint64_t TileCache::getReads() const {
+    lock_guard<mutex> held(lock);
+    return reads;
+}
+
+uint64_t TileCache::getWrites() const {
+    lock_guard<mutex> held(lock);
+    return writes;
+}
+
+//REQUIRES: slot < 2^SLOT_BITS
+//MODIFIES: Nothing
+//EFFECTS: Returns the key of the slot of file in slots
+uint64_t TileCache::keyOf(const TileFile &file, uint64_t slot) {
+    assert(slot < ((uint64_t)1 << SLOT_BITS));
+    return file.getId() << SLOT_BITS | slot;
+}
+
+//REQUIRES: held holds lock
+//MODIFIES: this
+//EFFECTS: Evicts least recently used slots until bytes more fit the budget, a changed slot is written back with
+//         the lock released (it is Writing meanwhile, so nobody uses or drops it), returns whether they fit
+bool TileCache::makeRoom(unique_lock<mutex> &held, size_t bytes) {
+    while(used + bytes > budget && !lru.empty()) {
+        const uint64_t key = lru.back();
+        lru.pop_back();
+        Slot &victim = slots.at(key);
+        if(victim.dirty) {
+            victim.state = State::Writing;
+            held.unlock();
+            victim.file->write(victim.index, victim.buffer);
+            held.lock();
+            writes++;
+        }
+        used -= victim.bytes;
+        alignedFree(victim.buffer);
+        slots.erase(key);
+        changed.notify_all();
+    }
+    return used + bytes <= budget;
+}
+
+//REQUIRES: held holds lock, the slot is not cached
+//MODIFIES: this
+//EFFECTS: Adds the slot with a new buffer in the Loading state and the given pins, its reader fills the buffer
+TileCache::Slot &TileCache::insert(const TileFile &file, uint64_t slot, uint32_t pins) {
+    const size_t bytes = file.getSlotBytes();
+    Slot &entry = slots[keyOf(file, slot)];
+    entry.file = &file;
+    entry.index = slot;
+    entry.buffer = alignedAllocate<char>(bytes);
+    entry.bytes = bytes;
+    entry.state = State::Loading;
+    entry.pins = pins;
+    entry.dirty = false;
+    used += bytes;
+    return entry;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: this
+//EFFECTS: Runs on the prefetch thread until the cache stops: reads each queued slot that is not cached yet and
+//         fits the budget without evicting a pinned slot, and leaves it as the most recently used slot
+void TileCache::prefetchLoop() {
+    unique_lock<mutex> held(lock);
+    while(true) {
+        queued.wait(held, [&] {
+            return stopping || !queue.empty();
+        });
+        if(stopping) {
+            return;
+        }
+        const Request request = queue.front();
+        queue.pop_front();
+        const TileFile &file = *request.file;
+        prefetching = &file; //drop waits for this read, the file must outlive it
+        if(slots.count(keyOf(file, request.slot)) == 0 && makeRoom(held, file.getSlotBytes())
+           && slots.count(keyOf(file, request.slot)) == 0) {
+            Slot &entry = insert(file, request.slot, 0);
+            held.unlock();
+            file.read(request.slot, entry.buffer);
+            held.lock();
+            reads++;
+            entry.state = State::Ready;
+            lru.push_front(keyOf(file, request.slot));
+            entry.lru = lru.begin();
+        }
+        prefetching = nullptr;
+        changed.notify_all();
+    }
+}
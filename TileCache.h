@@ -0,0 +1,158 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+//Fixed-size slots of bytes in a temporary file, the disk side of a TiledMatrix
+//The file is created in dir and unlinked at once, so it never outlives the process even if it is killed, and is
+//sized up front without being written (a sparse file), a slot never stored reads back as zeros
+//A failed read or write (disk full, I/O error) is reported to cerr and ends the program
+class TileFile {
+public:
+    //REQUIRES: dir is a writable directory
+    //MODIFIES: this
+    //EFFECTS: Creates the file with room for numSlots slots of slotBytes bytes
+    TileFile(const string &dir, uint64_t numSlots, size_t slotBytes);
+
+    //REQUIRES: No TileCache holds a slot of this file anymore (TileCache::drop)
+    //MODIFIES: this
+    //EFFECTS: Closes the file, which deletes it
+    ~TileFile();
+
+    TileFile(const TileFile &) = delete;
+    TileFile &operator=(const TileFile &) = delete;
+
+    size_t getSlotBytes() const {
+        return slotBytes;
+    }
+    //Distinct for every file of the process, a TileCache keys its slots by it
+    uint64_t getId() const {
+        return id;
+    }
+
+    //REQUIRES: slot < numSlots, buffer holds getSlotBytes() bytes
+    //MODIFIES: buffer
+    //EFFECTS: Reads the slot into buffer
+    void read(uint64_t slot, void *buffer) const;
+
+    //REQUIRES: slot < numSlots, buffer holds getSlotBytes() bytes
+    //MODIFIES: the file
+    //EFFECTS: Writes buffer to the slot
+    void write(uint64_t slot, const void *buffer) const;
+
+private:
+    int fd = -1;
+    size_t slotBytes;
+    uint64_t id;
+};
+
+//Slots of TileFiles held in memory, shared by every TiledMatrix of the engine, under one budget of bytes
+//A slot is pinned while a tile algorithm works on it and cannot be evicted then, once unpinned it joins the
+//least recently used list and is evicted from its tail when a new slot needs the room, being written back first
+//if it was changed (write back), so tiles that are reused stay in memory and the rest go to disk
+//A background thread reads the slots asked for with prefetch into the cache, so an algorithm that prefetches the
+//tiles of its next step has them waiting when it gets there and its reads overlap its computation
+//Only pinned slots can push the cache past its budget, a prefetch never evicts a pinned slot to make room
+//Every method is thread safe, the slots themselves are only guarded by their pins
+class TileCache {
+public:
+    //REQUIRES: dir is a writable directory
+    //MODIFIES: this
+    //EFFECTS: Creates an empty cache of budgetBytes for the TileFiles of dir and starts its prefetch thread
+    TileCache(size_t budgetBytes, const string &dir);
+
+    //REQUIRES: No slot is pinned
+    //MODIFIES: this
+    //EFFECTS: Stops and joins the prefetch thread and frees every slot, changes are not written back (every file
+    //         has been dropped or is temporary anyway)
+    ~TileCache();
+
+    TileCache(const TileCache &) = delete;
+    TileCache &operator=(const TileCache &) = delete;
+
+    //REQUIRES: slot is a slot of file
+    //MODIFIES: this
+    //EFFECTS: Pins the slot and returns its MATRIX_ALIGNMENT aligned buffer, reading it from the file unless it is
+    //         cached (waiting for a prefetch of it that is under way) or overwrite is set, in which case the buffer
+    //         is zeroed instead because the caller writes all of it
+    void *pin(const TileFile &file, uint64_t slot, bool overwrite = false);
+
+    //REQUIRES: the slot was pinned by pin
+    //MODIFIES: this
+    //EFFECTS: Releases one pin of the slot, changed marks its buffer as to be written back before it is evicted
+    void unpin(const TileFile &file, uint64_t slot, bool changed);
+
+    //REQUIRES: slot is a slot of file, file is not dropped before the prefetch thread reads it
+    //MODIFIES: this
+    //EFFECTS: Queues the slot for the prefetch thread unless it is cached or already queued, returns at once
+    void prefetch(const TileFile &file, uint64_t slot);
+
+    //REQUIRES: No slot of file is pinned
+    //MODIFIES: this
+    //EFFECTS: Forgets every slot of file without writing any back and cancels its queued prefetches, waiting for
+    //         reads and writes of it that are under way, the file can be destroyed afterwards
+    void drop(const TileFile &file);
+
+    size_t getBudget() const {
+        return budget;
+    }
+    //Where the TiledMatrix objects using this cache create their files
+    const string &getDirectory() const {
+        return directory;
+    }
+
+    //Slot reads and writes so far, prefetches included
+    uint64_t getReads() const;
+    uint64_t getWrites() const;
+
+private:
+    enum class State { Loading, Ready, Writing };
+
+    struct Slot {
+        const TileFile *file;
+        uint64_t index;
+        char *buffer;
+        size_t bytes;
+        State state;
+        uint32_t pins;
+        bool dirty;
+        list<uint64_t>::iterator lru; //position in lru while the slot is Ready and unpinned
+    };
+
+    struct Request {
+        const TileFile *file;
+        uint64_t slot;
+    };
+
+    size_t budget;
+    string directory;
+    size_t used = 0; //bytes of every slot's buffer
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    unordered_map<uint64_t, Slot> slots; //by key
+    list<uint64_t> lru; //keys of the evictable slots, most recently used first
+    deque<Request> queue; //prefetches not started yet
+    const TileFile *prefetching = nullptr; //file of the prefetch taken off the queue and not finished yet
+    bool stopping = false;
+    mutable mutex lock; //guards everything above
+    condition_variable changed; //a slot finished loading or writing, or was erased
+    condition_variable queued; //a prefetch was queued or the cache is stopping
+    thread prefetcher;
+
+    static uint64_t keyOf(const TileFile &file, uint64_t slot);
+    bool makeRoom(unique_lock<mutex> &held, size_t bytes);
+    Slot &insert(const TileFile &file, uint64_t slot, uint32_t pins);
+    void prefetchLoop();
+};
+
+#endif
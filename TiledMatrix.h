@@ -0,0 +1,647 @@
+#ifndef TILEDMATRIX_H
+#define TILEDMATRIX_H
+
+#include "Matrix.h"
+#include "Gemm.h"
+#include "Transpose.h"
+#include "RowKernels.h"
+#include "LUFactorization.h"
+#include "TileCache.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//Rows and columns of a tile unless --tile-size says otherwise, a GEMM of two 1024 x 1024 tiles of doubles does
+//128 flops per byte it reads (2 GFLOP for 16 MB), so a tile algorithm computes far longer than it waits for a tile
+const uint32_t TILE_DEFAULT_SIZE = 1024;
+//Tile sizes are rounded up to a multiple of this, so that every row of a tile starts on a MATRIX_ALIGNMENT boundary
+const uint32_t TILE_SIZE_STEP = 16;
+
+//Dense matrix stored on disk as tileSize x tileSize tiles, for matrices larger than memory
+//Tile (I, J) holds rows [I * tileSize, ...) and columns [J * tileSize, ...), the tiles on the bottom and right edges
+//are smaller, each is one slot of a TileFile and is brought into memory through a TileCache shared by every tiled
+//matrix, which keeps the recently used tiles within its budget and writes the others back to disk
+//A tile is used by pinning it (read, write, overwrite): the Tile hands out a Matrix view of the cached slot that the
+//in-memory kernels (Gemm.h, Transpose.h, the row kernels) work on in place, and is unpinned when it is destroyed
+//The algorithms below prefetch the tiles of their next step while they compute on the current one
+template<typename T>
+class TiledMatrix {
+public:
+    //A pinned tile, tileHeight(I) x tileWidth(J), its view stays valid until the Tile is destroyed
+    class Tile {
+    public:
+        //REQUIRES: I < getTileRows(), J < getTileCols()
+        //MODIFIES: owner's cache
+        //EFFECTS: Pins tile (I, J), its elements are read unless overwrite is set, then they start out zero
+        Tile(const TiledMatrix &tiles, uint32_t I, uint32_t J, bool canWrite, bool overwrite)
+            : owner(&tiles), slot(tiles.slotOf(I, J)), writable(canWrite),
+              view(viewOf(tiles.cache->pin(*tiles.file, slot, overwrite), tiles.tileHeight(I), tiles.tileWidth(J),
+                          tiles.slotCols)) {}
+
+        Tile(Tile &&rhs) noexcept : owner(rhs.owner), slot(rhs.slot), writable(rhs.writable), view(move(rhs.view)) {
+            rhs.owner = nullptr;
+        }
+
+        Tile(const Tile &) = delete;
+        Tile &operator=(const Tile &) = delete;
+        Tile &operator=(Tile &&) = delete;
+
+        //REQUIRES: Nothing
+        //MODIFIES: owner's cache
+        //EFFECTS: Unpins the tile, a writable tile is written back to disk before it is evicted
+        ~Tile() {
+            if(owner != nullptr) {
+                owner->cache->unpin(*owner->file, slot, writable);
+            }
+        }
+
+        const Matrix<T> &matrix() const {
+            return view;
+        }
+        //REQUIRES: the tile was pinned by write or overwrite
+        Matrix<T> &mutableMatrix() {
+            assert(writable);
+            return view;
+        }
+
+    private:
+        const TiledMatrix *owner;
+        uint64_t slot;
+        bool writable;
+        Matrix<T> view;
+
+        //The view's row order is taken from the heap, a tile may be pinned inside a MatrixArena::Scope of another
+        //thread's arena
+        static Matrix<T> viewOf(void *buffer, uint32_t height, uint32_t width, uint32_t stride) {
+            MatrixArena::Scope heap(nullptr);
+            return Matrix<T>(static_cast<T *>(buffer), height, width, stride);
+        }
+    };
+
+    //REQUIRES: Nothing
+    //MODIFIES: this
+    //EFFECTS: Creates an empty tiled matrix with no file
+    TiledMatrix() = default;
+
+    //REQUIRES: size is a multiple of TILE_SIZE_STEP
+    //MODIFIES: this
+    //EFFECTS: Creates a numRows x numCols matrix of zeros, its tiles are stored in a new file of tileCache's
+    //         directory and cached by tileCache
+    TiledMatrix(uint32_t numRows, uint32_t numCols, uint32_t size, TileCache &tileCache)
+        : rows(numRows), columns(numCols), tileSize(size), tileRows((numRows + size - 1) / size),
+          tileCols((numCols + size - 1) / size), slotRows(min(size, numRows)),
+          slotCols(min(size, Matrix<T>::paddedStride(numCols))), cache(&tileCache) {
+        assert(size % TILE_SIZE_STEP == 0);
+        file.reset(new TileFile(cache->getDirectory(), (uint64_t)tileRows * tileCols,
+                                (size_t)slotRows * slotCols * sizeof(T)));
+    }
+
+    //REQUIRES: No tile is pinned
+    //MODIFIES: the cache
+    //EFFECTS: Drops the cached tiles and deletes the file
+    ~TiledMatrix() {
+        if(file) {
+            cache->drop(*file);
+        }
+    }
+
+    TiledMatrix(const TiledMatrix &) = delete;
+    TiledMatrix &operator=(const TiledMatrix &) = delete;
+    TiledMatrix(TiledMatrix &&rhs) = default;
+
+    //REQUIRES: No tile of either matrix is pinned
+    //MODIFIES: this, rhs
+    //EFFECTS: Takes over the tiles of rhs, the ones this held are dropped with rhs
+    TiledMatrix &operator=(TiledMatrix &&rhs) noexcept {
+        std::swap(rows, rhs.rows);
+        std::swap(columns, rhs.columns);
+        std::swap(tileSize, rhs.tileSize);
+        std::swap(tileRows, rhs.tileRows);
+        std::swap(tileCols, rhs.tileCols);
+        std::swap(slotRows, rhs.slotRows);
+        std::swap(slotCols, rhs.slotCols);
+        std::swap(cache, rhs.cache);
+        std::swap(file, rhs.file);
+        return *this;
+    }
+
+    uint32_t getTileSize() const {
+        return tileSize;
+    }
+    uint32_t getTileRows() const {
+        return tileRows;
+    }
+    uint32_t getTileCols() const {
+        return tileCols;
+    }
+    //Rows of tile row I and columns of tile column J, tileSize except on the edges
+    uint32_t tileHeight(uint32_t I) const {
+        return min(tileSize, rows - I * tileSize);
+    }
+    uint32_t tileWidth(uint32_t J) const {
+        return min(tileSize, columns - J * tileSize);
+    }
+    TileCache &getCache() const {
+        return *cache;
+    }
+
+    //REQUIRES: I < getTileRows(), J < getTileCols()
+    //MODIFIES: the cache
+    //EFFECTS: Pins tile (I, J) to read it, to change it, or to write all of it (it starts out zero)
+    Tile read(uint32_t I, uint32_t J) const {
+        return Tile(*this, I, J, false, false);
+    }
+    Tile write(uint32_t I, uint32_t J) {
+        return Tile(*this, I, J, true, false);
+    }
+    Tile overwrite(uint32_t I, uint32_t J) {
+        return Tile(*this, I, J, true, true);
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: the cache
+    //EFFECTS: Has the cache read tile (I, J) in the background, nothing happens if it is outside the matrix
+    void prefetch(uint32_t I, uint32_t J) const {
+        if(I < tileRows && J < tileCols) {
+            cache->prefetch(*file, slotOf(I, J));
+        }
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: the cache
+    //EFFECTS: Prefetches the tile after (I, J) in row major order
+    void prefetchNext(uint32_t I, uint32_t J) const {
+        if(J + 1 < tileCols) {
+            prefetch(I, J + 1);
+        }
+        else {
+            prefetch(I + 1, 0);
+        }
+    }
+
+    //REQUIRES: rows [firstRow, firstRow + count) are in the matrix, source has count rows from sourceRow on and
+    //          columns columns
+    //MODIFIES: this
+    //EFFECTS: Stores those rows of source as rows [firstRow, firstRow + count), tiles that are covered whole are
+    //         overwritten without being read
+    void storeRows(uint32_t firstRow, const Matrix<T> &source, uint32_t sourceRow, uint32_t count) {
+        assert(source.columns == columns && firstRow + count <= rows);
+        for(uint32_t I = firstRow / tileSize; I < tileRows && I * tileSize < firstRow + count; I++) {
+            const uint32_t top = I * tileSize;
+            const uint32_t begin = max(firstRow, top);
+            const uint32_t end = min(firstRow + count, top + tileHeight(I));
+            const bool whole = begin == top && end == top + tileHeight(I);
+            for(uint32_t J = 0; J < tileCols; J++) {
+                if(!whole) {
+                    prefetch(I, J + 1);
+                }
+                Tile tile(*this, I, J, true, whole);
+                for(uint32_t r = begin; r < end; r++) {
+                    memcpy(tile.mutableMatrix().rowPtr(r - top), source.rowPtr(sourceRow + r - firstRow) + J * tileSize,
+                           tileWidth(J) * sizeof(T));
+                }
+            }
+        }
+    }
+
+    //REQUIRES: rows [firstRow, firstRow + count) are in the matrix, dest has count rows from destRow on and
+    //          columns columns
+    //MODIFIES: dest
+    //EFFECTS: Copies rows [firstRow, firstRow + count) into those rows of dest
+    void loadRows(uint32_t firstRow, Matrix<T> &dest, uint32_t destRow, uint32_t count) const {
+        assert(dest.columns == columns && firstRow + count <= rows);
+        for(uint32_t I = firstRow / tileSize; I < tileRows && I * tileSize < firstRow + count; I++) {
+            const uint32_t top = I * tileSize;
+            const uint32_t begin = max(firstRow, top);
+            const uint32_t end = min(firstRow + count, top + tileHeight(I));
+            for(uint32_t J = 0; J < tileCols; J++) {
+                prefetchNext(I, J);
+                const Tile tile = read(I, J);
+                for(uint32_t r = begin; r < end; r++) {
+                    memcpy(dest.rowPtr(destRow + r - firstRow) + J * tileSize, tile.matrix().rowPtr(r - top),
+                           tileWidth(J) * sizeof(T));
+                }
+            }
+        }
+    }
+
+    uint32_t rows = 0;
+    uint32_t columns = 0;
+
+private:
+    uint32_t tileSize = TILE_DEFAULT_SIZE;
+    uint32_t tileRows = 0;
+    uint32_t tileCols = 0;
+    uint32_t slotRows = 0; //shape of every slot of the file, a tile of a matrix narrower than tileSize is narrower
+    uint32_t slotCols = 0; //elements between the starts of two rows of a tile
+    TileCache *cache = nullptr;
+    unique_ptr<TileFile> file;
+
+    uint64_t slotOf(uint32_t I, uint32_t J) const {
+        assert(I < tileRows && J < tileCols);
+        return (uint64_t)I * tileCols + J;
+    }
+};
+
+//REQUIRES: tileSize is a multiple of TILE_SIZE_STEP
+//MODIFIES: cache
+//EFFECTS: Returns a tiled copy of mat
+template<typename T>
+TiledMatrix<T> toTiled(const Matrix<T> &mat, uint32_t tileSize, TileCache &cache) {
+    TiledMatrix<T> tiled(mat.rows, mat.columns, tileSize, cache);
+    tiled.storeRows(0, mat, 0, mat.rows);
+    return tiled;
+}
+
+//REQUIRES: src and dest have as many rows and one tile size, src has at least firstCol + dest.columns columns
+//MODIFIES: dest
+//EFFECTS: Copies columns [firstCol, firstCol + dest.columns) of src into dest, a tile of dest takes its columns
+//         from one or two tiles of src
+template<typename T>
+void copyColumns(const TiledMatrix<T> &src, uint32_t firstCol, TiledMatrix<T> &dest) {
+    assert(src.rows == dest.rows && src.getTileSize() == dest.getTileSize());
+    assert(firstCol + dest.columns <= src.columns);
+    const uint32_t size = src.getTileSize();
+    for(uint32_t I = 0; I < dest.getTileRows(); I++) {
+        for(uint32_t J = 0; J < dest.getTileCols(); J++) {
+            typename TiledMatrix<T>::Tile target = dest.overwrite(I, J);
+            const uint32_t begin = firstCol + J * size;
+            const uint32_t end = begin + dest.tileWidth(J);
+            for(uint32_t S = begin / size; S * size < end; S++) {
+                src.prefetchNext(I, S);
+                const typename TiledMatrix<T>::Tile source = src.read(I, S);
+                const uint32_t from = max(begin, S * size);
+                const uint32_t to = min(end, S * size + src.tileWidth(S));
+                for(uint32_t r = 0; r < dest.tileHeight(I); r++) {
+                    memcpy(target.mutableMatrix().rowPtr(r) + (from - begin), source.matrix().rowPtr(r) + (from - S * size),
+                           (to - from) * sizeof(T));
+                }
+            }
+        }
+    }
+}
+
+//REQUIRES: Nothing
+//MODIFIES: cache
+//EFFECTS: Returns the transpose of A, tile (J, I) of the result is the transpose of tile (I, J) (transposeBlock)
+template<typename T>
+TiledMatrix<T> transposed(const TiledMatrix<T> &A) {
+    TiledMatrix<T> result(A.columns, A.rows, A.getTileSize(), A.getCache());
+    for(uint32_t I = 0; I < A.getTileRows(); I++) {
+        for(uint32_t J = 0; J < A.getTileCols(); J++) {
+            A.prefetchNext(I, J);
+            const typename TiledMatrix<T>::Tile source = A.read(I, J);
+            typename TiledMatrix<T>::Tile target = result.overwrite(J, I);
+            transposeBlock(wholeBlock(source.matrix()), wholeBlock(target.mutableMatrix()));
+        }
+    }
+    return result;
+}
+
+//REQUIRES: A and C have the same shape and tile size
+//MODIFIES: C
+//EFFECTS: Adds A to C, or subtracts it if subtract is set, tile by tile
+template<typename T>
+void addTiled(TiledMatrix<T> &C, const TiledMatrix<T> &A, bool subtract) {
+    assert(A.rows == C.rows && A.columns == C.columns && A.getTileSize() == C.getTileSize());
+    for(uint32_t I = 0; I < C.getTileRows(); I++) {
+        for(uint32_t J = 0; J < C.getTileCols(); J++) {
+            A.prefetchNext(I, J);
+            C.prefetchNext(I, J);
+            const typename TiledMatrix<T>::Tile source = A.read(I, J);
+            typename TiledMatrix<T>::Tile target = C.write(I, J);
+            Matrix<T> &sum = target.mutableMatrix();
+            for(uint32_t r = 0; r < sum.rows; r++) {
+                const T *aRow = source.matrix().rowPtr(r);
+                T *cRow = sum.rowPtr(r);
+                for(uint32_t c = 0; c < sum.columns; c++) {
+                    cRow[c] = subtract ? cRow[c] - aRow[c] : cRow[c] + aRow[c];
+                }
+            }
+        }
+    }
+    countFlops((uint64_t)C.rows * C.columns);
+}
+
+//REQUIRES: tileSize >= 1
+//MODIFIES: Nothing
+//EFFECTS: Returns the largest group g >= 1 for which a g x g block of product tiles, a tile of A and g tiles of B
+//         pinned, and the 2g tiles of the next step being prefetched, fit the cache's budget
+template<typename T>
+uint32_t tileGroup(const TileCache &cache, uint32_t tileSize) {
+    const uint64_t budgetTiles = cache.getBudget() / ((uint64_t)tileSize * tileSize * sizeof(T));
+    uint64_t group = 1;
+    while((group + 1) * (group + 1) + 3 * (group + 1) + 1 <= budgetTiles) {
+        group++;
+    }
+    return (uint32_t)group;
+}
+
+//REQUIRES: A.columns == B.rows, A and B have one tile size and cache
+//MODIFIES: cache
+//EFFECTS: Returns A * B, computed for a g x g block of product tiles at a time (tileGroup): the block stays pinned
+//         while every step K multiplies its tiles of A and B into it with gemm, so each tile of A and B is read
+//         once per block row or column instead of once per product tile, and the tiles of step K + 1 are
+//         prefetched while step K computes
+template<typename T>
+TiledMatrix<T> multiply(const TiledMatrix<T> &A, const TiledMatrix<T> &B) {
+    assert(A.columns == B.rows && A.getTileSize() == B.getTileSize());
+    typedef typename TiledMatrix<T>::Tile Tile;
+    TiledMatrix<T> C(A.rows, B.columns, A.getTileSize(), A.getCache());
+    const uint32_t group = tileGroup<T>(A.getCache(), A.getTileSize());
+    for(uint32_t I0 = 0; I0 < C.getTileRows(); I0 += group) {
+        const uint32_t I1 = min(I0 + group, C.getTileRows());
+        for(uint32_t J0 = 0; J0 < C.getTileCols(); J0 += group) {
+            const uint32_t J1 = min(J0 + group, C.getTileCols());
+            vector<Tile> products;
+            products.reserve((size_t)(I1 - I0) * (J1 - J0));
+            for(uint32_t I = I0; I < I1; I++) {
+                for(uint32_t J = J0; J < J1; J++) {
+                    products.push_back(C.overwrite(I, J));
+                }
+            }
+            for(uint32_t K = 0; K < A.getTileCols(); K++) {
+                for(uint32_t J = J0; J < J1; J++) {
+                    B.prefetch(K + 1, J);
+                }
+                for(uint32_t I = I0; I < I1; I++) {
+                    A.prefetch(I, K + 1);
+                }
+                vector<Tile> right;
+                right.reserve(J1 - J0);
+                for(uint32_t J = J0; J < J1; J++) {
+                    right.push_back(B.read(K, J));
+                }
+                for(uint32_t I = I0; I < I1; I++) {
+                    const Tile left = A.read(I, K);
+                    for(uint32_t J = J0; J < J1; J++) {
+                        gemm<T>(1, wholeBlock(left.matrix()), wholeBlock(right[J - J0].matrix()), 1,
+                                wholeBlock(products[(size_t)(I - I0) * (J1 - J0) + (J - J0)].mutableMatrix()));
+                    }
+                }
+            }
+        }
+    }
+    return C;
+}
+
+//REQUIRES: panel has at least as many rows as columns, blockSize >= 1
+//MODIFIES: panel, pivots
+//EFFECTS: Factors the tall panel in place with partial pivoting, P * panel = L * U with L below the diagonal and U
+//         on and above it, blockSize columns at a time like LUFactorization (factorPanel, solvePanelRows and a gemm
+//         update of the columns right of each block), pivots[k] is the row interchanged with row k at step k
+//         Rows are interchanged in O(1) through the row order
+//         Returns false as soon as a column has no nonzero pivot, the matrix it came from is singular
+template<typename T>
+bool factorTallPanel(Matrix<T> &panel, uint32_t blockSize, vector<uint32_t> &pivots) {
+    const uint32_t m = panel.rows;
+    const uint32_t w = panel.columns;
+    assert(m >= w && blockSize >= 1);
+    pivots.resize(w);
+    const Matrix<T> &factors = panel;
+    for(uint32_t k0 = 0; k0 < w; k0 += blockSize) {
+        const uint32_t kb = min(blockSize, w - k0);
+        for(uint32_t k = k0; k < k0 + kb; k++) {
+            uint32_t pivotRow = k;
+            T largest = abs(panel(k,k));
+            for(uint32_t r = k + 1; r < m; r++) {
+                if(abs(panel(r,k)) > largest) {
+                    largest = abs(panel(r,k));
+                    pivotRow = r;
+                }
+            }
+            pivots[k] = pivotRow;
+            if(pivotRow != k) {
+                panel.interchangeRows(k, pivotRow);
+            }
+            if(largest == 0) {
+                return false;
+            }
+            const T *pivotRowPtr = panel.rowPtr(k);
+            const T pivot = pivotRowPtr[k];
+            for(uint32_t r = k + 1; r < m; r++) {
+                T *row = panel.rowPtr(r);
+                const T multiplier = row[k] / pivot;
+                row[k] = multiplier;
+                if(multiplier != 0) {
+                    rowSubtractScaled(row + k + 1, pivotRowPtr + k + 1, multiplier, k0 + kb - k - 1);
+                }
+                countFlops(1 + 2 * (uint64_t)(k0 + kb - k - 1));
+            }
+        }
+        const uint32_t right = w - k0 - kb;
+        if(right == 0) {
+            continue;
+        }
+        for(uint32_t i = k0 + 1; i < k0 + kb; i++) {
+            T *row = panel.rowPtr(i);
+            for(uint32_t j = k0; j < i; j++) {
+                const T coef = row[j];
+                if(coef != 0) {
+                    rowSubtractScaled(row + k0 + kb, panel.rowPtr(j) + k0 + kb, coef, right);
+                    countFlops(2 * (uint64_t)right);
+                }
+            }
+        }
+        gemm<T>(-1, subBlock(factors, k0 + kb, k0, m - k0 - kb, kb), subBlock(factors, k0, k0 + kb, kb, right), 1,
+                subBlock(panel, k0 + kb, k0 + kb, m - k0 - kb, right));
+    }
+    return true;
+}
+
+//REQUIRES: pivots[k] >= k for every k
+//MODIFIES: moves
+//EFFECTS: Sets moves to where the interchanges of pivots, applied in order, leave rows: one (position, original
+//         position) pair for every row that ends up somewhere else, sorted by position
+inline void rowMoves(const vector<uint32_t> &pivots, vector<pair<uint32_t, uint32_t>> &moves) {
+    unordered_map<uint32_t, uint32_t> holds; //position -> original position of the row there, if it moved
+    auto at = [&](uint32_t position) {
+        auto found = holds.find(position);
+        return found == holds.end() ? position : found->second;
+    };
+    for(uint32_t k = 0; k < pivots.size(); k++) {
+        if(pivots[k] != k) {
+            const uint32_t here = at(k);
+            holds[k] = at(pivots[k]);
+            holds[pivots[k]] = here;
+        }
+    }
+    moves.clear();
+    for(const auto &held : holds) {
+        if(held.first != held.second) {
+            moves.push_back(held);
+        }
+    }
+    sort(moves.begin(), moves.end());
+}
+
+//REQUIRES: moves come from rowMoves for the panel of tile column K (positions relative to its first row)
+//MODIFIES: tile column J of M from tile row K down, saved
+//EFFECTS: Applies the panel's row interchanges to tile column J
+//         The interchanges of a panel swap a row of its diagonal tile row with a row at or below it, so a row below
+//         the diagonal tile row only ever receives a row of the diagonal tile, and the rows the diagonal tile
+//         receives from below come from where they started: the diagonal tile is saved to saved and every tile below
+//         is pinned once, whatever the number of interchanges
+template<typename T>
+void applyRowMoves(TiledMatrix<T> &M, uint32_t K, uint32_t J, const vector<pair<uint32_t, uint32_t>> &moves,
+                   Matrix<T> &saved) {
+    if(moves.empty()) {
+        return;
+    }
+    const uint32_t size = M.getTileSize();
+    const size_t rowBytes = M.tileWidth(J) * sizeof(T);
+    typename TiledMatrix<T>::Tile diagonal = M.write(K, J);
+    Matrix<T> &top = diagonal.mutableMatrix();
+    saved = top;
+    unordered_map<uint32_t, uint32_t> upward; //original position below -> position in the diagonal tile it moves to
+    for(const auto &move : moves) {
+        if(move.first < size && move.second >= size) {
+            upward[move.second] = move.first;
+        }
+    }
+    size_t next = lower_bound(moves.begin(), moves.end(), make_pair(size, 0u)) - moves.begin();
+    while(next < moves.size()) {
+        const uint32_t below = moves[next].first / size;
+        size_t end = next;
+        while(end < moves.size() && moves[end].first / size == below) {
+            end++;
+        }
+        if(end < moves.size()) {
+            M.prefetch(K + moves[end].first / size, J);
+        }
+        typename TiledMatrix<T>::Tile tile = M.write(K + below, J);
+        Matrix<T> &lower = tile.mutableMatrix();
+        for(; next < end; next++) {
+            const uint32_t position = moves[next].first;
+            const uint32_t original = moves[next].second;
+            assert(original < size);
+            auto up = upward.find(position);
+            if(up != upward.end()) {
+                memcpy(top.rowPtr(up->second), lower.rowPtr(position % size), rowBytes);
+            }
+            memcpy(lower.rowPtr(position % size), saved.rowPtr(original), rowBytes);
+        }
+    }
+    for(const auto &move : moves) {
+        if(move.first < size && move.second < size) {
+            memcpy(top.rowPtr(move.first), saved.rowPtr(move.second), rowBytes);
+        }
+    }
+}
+
+//REQUIRES: system is n x (n + k) with k >= 1, blockSize >= 1
+//MODIFIES: x, the cache
+//EFFECTS: Solves the augmented system [ A | B ] by a right-looking tiled LU with partial pivoting and sets x to the
+//         n x k solution X of A * X = B, returns false (x unspecified) if A is singular
+//         A and B are copied to tiled matrices of their own first, the system is left as it is
+//         For each tile column K of A: its panel (the tiles from the diagonal down) is read into memory and factored
+//         (factorTallPanel), then for each tile column to the right, of A and of B, the panel's row interchanges are
+//         applied, the diagonal tile is solved with L to give that tile of U (or of L^-1 B), and every tile below
+//         is updated with a gemm, which is where almost all of the work is
+//         The columns of A are updated right to left, so the next panel is the most recently used tile column and
+//         is still cached when it is read
+//         The row interchanges are not applied to the columns left of the panel, nothing reads L again once B has
+//         been carried through the factorization
+//         Finally X is back substituted through U one tile row at a time, bottom up
+template<typename T>
+bool solveTiled(const TiledMatrix<T> &system, TiledMatrix<T> &x, uint32_t blockSize = LU_DEFAULT_BLOCK_SIZE) {
+    typedef typename TiledMatrix<T>::Tile Tile;
+    const uint32_t n = system.rows;
+    const uint32_t size = system.getTileSize();
+    assert(system.columns > n);
+    TiledMatrix<T> lu(n, n, size, system.getCache());
+    copyColumns(system, 0, lu);
+    x = TiledMatrix<T>(n, system.columns - n, size, system.getCache());
+    copyColumns(system, n, x);
+
+    const uint32_t tiles = lu.getTileRows();
+    vector<uint32_t> pivots;
+    vector<pair<uint32_t, uint32_t>> moves;
+    Matrix<T> saved;
+    for(uint32_t K = 0; K < tiles; K++) {
+        const uint32_t width = lu.tileWidth(K);
+        Matrix<T> panel(n - K * size, width);
+        for(uint32_t I = K; I < tiles; I++) {
+            lu.prefetch(I + 1, K);
+            const Tile tile = lu.read(I, K);
+            for(uint32_t r = 0; r < lu.tileHeight(I); r++) {
+                memcpy(panel.rowPtr((I - K) * size + r), tile.matrix().rowPtr(r), width * sizeof(T));
+            }
+        }
+        if(!factorTallPanel(panel, blockSize, pivots)) {
+            return false;
+        }
+        for(uint32_t I = K; I < tiles; I++) {
+            Tile tile = lu.overwrite(I, K);
+            for(uint32_t r = 0; r < lu.tileHeight(I); r++) {
+                memcpy(tile.mutableMatrix().rowPtr(r), panel.rowPtr((I - K) * size + r), width * sizeof(T));
+            }
+        }
+        rowMoves(pivots, moves);
+
+        const Matrix<T> &factors = panel;
+        auto update = [&](TiledMatrix<T> &M, uint32_t J) {
+            applyRowMoves(M, K, J, moves, saved);
+            Tile head = M.write(K, J);
+            Matrix<T> &block = head.mutableMatrix();
+            for(uint32_t i = 1; i < width; i++) { //block = L11^-1 * block, L11 has a unit diagonal
+                const T *lRow = factors.rowPtr(i);
+                T *row = block.rowPtr(i);
+                for(uint32_t j = 0; j < i; j++) {
+                    if(lRow[j] != 0) {
+                        rowSubtractScaled(row, block.rowPtr(j), lRow[j], block.columns);
+                        countFlops(2 * (uint64_t)block.columns);
+                    }
+                }
+            }
+            for(uint32_t I = K + 1; I < tiles; I++) {
+                M.prefetch(I + 1, J);
+                Tile tile = M.write(I, J);
+                gemm<T>(-1, subBlock(factors, (I - K) * size, 0, lu.tileHeight(I), width), wholeBlock(head.matrix()), 1,
+                        wholeBlock(tile.mutableMatrix()));
+            }
+        };
+        for(uint32_t J = 0; J < x.getTileCols(); J++) {
+            update(x, J);
+        }
+        for(uint32_t J = tiles; J-- > K + 1;) {
+            update(lu, J);
+        }
+    }
+
+    for(uint32_t K = tiles; K-- > 0;) {
+        for(uint32_t J = 0; J < x.getTileCols(); J++) {
+            Tile target = x.write(K, J);
+            Matrix<T> &block = target.mutableMatrix();
+            for(uint32_t L = K + 1; L < tiles; L++) { //block -= U(K, L) * X(L, J)
+                lu.prefetch(K, L + 1);
+                x.prefetch(L + 1, J);
+                const Tile upper = lu.read(K, L);
+                const Tile known = x.read(L, J);
+                gemm<T>(-1, wholeBlock(upper.matrix()), wholeBlock(known.matrix()), 1, wholeBlock(block));
+            }
+            const Tile diagonal = lu.read(K, K);
+            const Matrix<T> &U = diagonal.matrix();
+            for(uint32_t i = U.rows; i-- > 0;) { //block = U(K, K)^-1 * block, as solveInPlace back substitutes
+                const T *uRow = U.rowPtr(i);
+                T *row = block.rowPtr(i);
+                for(uint32_t j = i + 1; j < U.rows; j++) {
+                    if(uRow[j] != 0) {
+                        rowSubtractScaled(row, block.rowPtr(j), uRow[j], block.columns);
+                        countFlops(2 * (uint64_t)block.columns);
+                    }
+                }
+                rowDivide(row, uRow[i], block.columns);
+                countFlops(block.columns);
+            }
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include "Matrix.h"
+#include "RowKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+//Cache-oblivious transpose: blocks are halved along their longer side until both sides fit TRANSPOSE_LEAF,
+//so at some level of the recursion a source and destination block fit each cache whatever its size,
+//and a leaf moves TRANSPOSE_TILE x TRANSPOSE_TILE tiles through vector registers (SSE2 or AVX2 shuffles picked for
+//the CPU, see tileTranspose), every load and store touching whole cache lines instead of one element per line
+const uint32_t TRANSPOSE_TILE = TRANSPOSE_KERNEL_TILE;
+const uint32_t TRANSPOSE_LEAF = 64; //a leaf's source and destination, 2 x 64 x 64 doubles, stay in L2
+
+//REQUIRES: the TRANSPOSE_TILE x TRANSPOSE_TILE tiles at [row, col] of src and [col, row] of dest exist
+//MODIFIES: dest
+//EFFECTS: Writes the transpose of the source tile into the destination tile
+template<typename T>
+void transposeTile(const MatrixBlock<const Matrix<T>> &src, uint32_t row, uint32_t col,
+                   const MatrixBlock<Matrix<T>> &dest) {
+    const T *srcRows[TRANSPOSE_TILE];
+    T *destRows[TRANSPOSE_TILE];
+    for(uint32_t i = 0; i < TRANSPOSE_TILE; i++) {
+        srcRows[i] = src.rowPtr(row + i) + col;
+        destRows[i] = dest.rowPtr(col + i) + row;
+    }
+    tileTranspose(srcRows, destRows);
+}
+
+//REQUIRES: dest is src.columns x src.rows, the two do not overlap
+//MODIFIES: dest
+//EFFECTS: Writes the transpose of src into dest, recursively (see TRANSPOSE_LEAF)
+template<typename T>
+void transposeBlock(const MatrixBlock<const Matrix<T>> &src, const MatrixBlock<Matrix<T>> &dest) {
+    assert(dest.rows == src.columns && dest.columns == src.rows);
+    if(src.rows > TRANSPOSE_LEAF || src.columns > TRANSPOSE_LEAF) {
+        if(src.rows >= src.columns) {
+            const uint32_t half = src.rows / 2 / TRANSPOSE_TILE * TRANSPOSE_TILE;
+            transposeBlock(subBlock(src, 0, 0, half, src.columns), subBlock(dest, 0, 0, dest.rows, half));
+            transposeBlock(subBlock(src, half, 0, src.rows - half, src.columns),
+                           subBlock(dest, 0, half, dest.rows, src.rows - half));
+        }
+        else {
+            const uint32_t half = src.columns / 2 / TRANSPOSE_TILE * TRANSPOSE_TILE;
+            transposeBlock(subBlock(src, 0, 0, src.rows, half), subBlock(dest, 0, 0, half, dest.columns));
+            transposeBlock(subBlock(src, 0, half, src.rows, src.columns - half),
+                           subBlock(dest, half, 0, src.columns - half, dest.columns));
+        }
+        return;
+    }
+    const uint32_t fullRows = src.rows / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    const uint32_t fullCols = src.columns / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    for(uint32_t r = 0; r < fullRows; r += TRANSPOSE_TILE) {
+        for(uint32_t c = 0; c < fullCols; c += TRANSPOSE_TILE) {
+            transposeTile(src, r, c, dest);
+        }
+    }
+    for(uint32_t r = 0; r < src.rows; r++) { //the edges that do not fill a tile
+        const T *srcRow = src.rowPtr(r);
+        for(uint32_t c = (r < fullRows ? fullCols : 0); c < src.columns; c++) {
+            dest.rowPtr(c)[r] = srcRow[c];
+        }
+    }
+}
+
+//REQUIRES: the TRANSPOSE_TILE x TRANSPOSE_TILE tiles at [row, col] of A and [col, row] of B exist, they are the
+//          same tile or do not overlap
+//MODIFIES: A, B
+//EFFECTS: Replaces each tile with the transpose of the other (a tile on the diagonal with its own transpose)
+template<typename T>
+void transposeSwapTile(const MatrixBlock<Matrix<T>> &A, uint32_t row, uint32_t col, const MatrixBlock<Matrix<T>> &B) {
+    T saved[TRANSPOSE_TILE][TRANSPOSE_TILE];
+    const T *aRows[TRANSPOSE_TILE];
+    const T *bRows[TRANSPOSE_TILE];
+    T *savedRows[TRANSPOSE_TILE];
+    T *aDest[TRANSPOSE_TILE];
+    for(uint32_t i = 0; i < TRANSPOSE_TILE; i++) {
+        aDest[i] = A.rowPtr(row + i) + col;
+        aRows[i] = aDest[i];
+        bRows[i] = B.rowPtr(col + i) + row;
+        savedRows[i] = saved[i];
+    }
+    tileTranspose(aRows, savedRows);
+    if(aRows[0] != bRows[0]) {
+        tileTranspose(bRows, aDest);
+    }
+    for(uint32_t i = 0; i < TRANSPOSE_TILE; i++) {
+        memcpy(B.rowPtr(col + i) + row, saved[i], sizeof(saved[i]));
+    }
+}
+
+//REQUIRES: A is rows x columns and B is columns x rows, the two do not overlap
+//MODIFIES: A, B
+//EFFECTS: Replaces A with the transpose of B and B with the transpose of A, recursively like transposeBlock
+//         (the off-diagonal halves of an in-place square transpose)
+template<typename T>
+void transposeSwapBlocks(const MatrixBlock<Matrix<T>> &A, const MatrixBlock<Matrix<T>> &B) {
+    assert(B.rows == A.columns && B.columns == A.rows);
+    if(A.rows > TRANSPOSE_LEAF || A.columns > TRANSPOSE_LEAF) {
+        if(A.rows >= A.columns) {
+            const uint32_t half = A.rows / 2 / TRANSPOSE_TILE * TRANSPOSE_TILE;
+            transposeSwapBlocks(subBlock(A, 0, 0, half, A.columns), subBlock(B, 0, 0, B.rows, half));
+            transposeSwapBlocks(subBlock(A, half, 0, A.rows - half, A.columns),
+                                subBlock(B, 0, half, B.rows, A.rows - half));
+        }
+        else {
+            const uint32_t half = A.columns / 2 / TRANSPOSE_TILE * TRANSPOSE_TILE;
+            transposeSwapBlocks(subBlock(A, 0, 0, A.rows, half), subBlock(B, 0, 0, half, B.columns));
+            transposeSwapBlocks(subBlock(A, 0, half, A.rows, A.columns - half),
+                                subBlock(B, half, 0, A.columns - half, B.columns));
+        }
+        return;
+    }
+    const uint32_t fullRows = A.rows / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    const uint32_t fullCols = A.columns / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    for(uint32_t r = 0; r < fullRows; r += TRANSPOSE_TILE) {
+        for(uint32_t c = 0; c < fullCols; c += TRANSPOSE_TILE) {
+            transposeSwapTile(A, r, c, B);
+        }
+    }
+    for(uint32_t r = 0; r < A.rows; r++) { //the edges that do not fill a tile
+        T *aRow = A.rowPtr(r);
+        for(uint32_t c = (r < fullRows ? fullCols : 0); c < A.columns; c++) {
+            std::swap(aRow[c], B.rowPtr(c)[r]);
+        }
+    }
+}
+
+//REQUIRES: A is square
+//MODIFIES: A
+//EFFECTS: Transposes A in place: the diagonal halves recursively, the off-diagonal halves swapped with each other
+template<typename T>
+void transposeDiagonalBlock(const MatrixBlock<Matrix<T>> &A) {
+    assert(A.rows == A.columns);
+    const uint32_t n = A.rows;
+    if(n > TRANSPOSE_LEAF) {
+        const uint32_t half = n / 2 / TRANSPOSE_TILE * TRANSPOSE_TILE;
+        transposeDiagonalBlock(subBlock(A, 0, 0, half, half));
+        transposeDiagonalBlock(subBlock(A, half, half, n - half, n - half));
+        transposeSwapBlocks(subBlock(A, 0, half, half, n - half), subBlock(A, half, 0, n - half, half));
+        return;
+    }
+    const uint32_t full = n / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    for(uint32_t r = 0; r < full; r += TRANSPOSE_TILE) { //each diagonal tile in place, then the tiles right of it
+        for(uint32_t c = r; c < full; c += TRANSPOSE_TILE) { //with their mirror images below the diagonal
+            transposeSwapTile(A, r, c, A);
+        }
+    }
+    for(uint32_t r = 0; r < n; r++) { //the edges that do not fill a tile
+        T *row = A.rowPtr(r);
+        for(uint32_t c = std::max(r + 1, r < full ? full : 0); c < n; c++) {
+            std::swap(row[c], A.rowPtr(c)[r]);
+        }
+    }
+}
+
+//REQUIRES: mat is a valid matrix
+//MODIFIES: Nothing
+//EFFECTS: Returns the transpose of mat, written straight from mat by the blocked kernel
+template<typename T>
+Matrix<T> transposed(const Matrix<T> &mat) {
+    Matrix<T> result(mat.columns, mat.rows);
+    transposeBlock(wholeBlock(mat), wholeBlock(result));
+    return result;
+}
+
+//REQUIRES: mat is square
+//MODIFIES: mat
+//EFFECTS: Transposes mat in its own buffer, no memory is allocated
+template<typename T>
+void transposeInPlace(Matrix<T> &mat) {
+    assert(mat.rows == mat.columns);
+    transposeDiagonalBlock(wholeBlock(mat));
+}
+
+#endif
@@ -0,0 +1,1006 @@
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include "LUFactorization.h"
+#include "FixedMatrix.h"
+#include "RowKernels.h"
+#include "LinAlg.h"
+#include "MatrixBatch.h"
+#include "InputReader.h"
+#include "OutputWriter.h"
+#include "SparseMatrix.h"
+#include "SparseLU.h"
+#include "TiledMatrix.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+//Benchmark suite for every kernel and command path, built by 'make bench' into linal_bench
+//Each case is swept over sizes (powers of two from --min-size to --max-size), shapes (square, tall, wide)
+//and, for the kernels that use the thread pool, thread counts
+//Throughput is nominal: GFLOP/s counts the textbook flops of the operation on a full rank input and GB/s counts
+//every input and output element once, so the numbers compare releases rather than describe the hardware
+
+struct Options {
+    uint32_t minSize = 8;
+    uint32_t maxSize = 1024;
+    double minSeconds = 0.2; //each measurement repeats the operation for at least this long
+    vector<uint32_t> threads; //thread counts swept for the parallel kernels
+    string filter; //only cases whose name contains this
+    string jsonFile;
+    string baselineFile;
+    double tolerance = 0.05; //slowdown against the baseline reported as a regression
+};
+
+struct Result {
+    string name;
+    string shape;
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    uint32_t inner = 0; //inner dimension of a product, 0 otherwise
+    uint32_t threads = 1;
+    double nsPerOp = 0;
+    double flops = 0; //per operation
+    double bytes = 0; //per operation
+
+    //Identifies the same measurement across runs
+    string key() const {
+        return name + "/" + shape + "/" + to_string(rows) + "x" + to_string(inner) + "x" + to_string(cols) + "/t"
+               + to_string(threads);
+    }
+    double gflops() const {
+        return flops / nsPerOp;
+    }
+    double gbps() const {
+        return bytes / nsPerOp;
+    }
+};
+
+//REQUIRES: mat is valid
+//MODIFIES: mat
+//EFFECTS: Fills mat with uniform random values in [-1,1)
+void fillRandom(Matrix<double> &mat, mt19937_64 &gen) {
+    uniform_real_distribution<double> dist(-1.0, 1.0);
+    for(uint32_t r = 0; r < mat.rows; r++) {
+        for(uint32_t c = 0; c < mat.columns; c++) {
+            mat(r,c) = dist(gen);
+        }
+    }
+}
+
+//REQUIRES: Nothing
+//MODIFIES: gen
+//EFFECTS: Returns a random rows x cols matrix
+Matrix<double> randomMatrix(uint32_t rows, uint32_t cols, mt19937_64 &gen) {
+    Matrix<double> mat(rows, cols);
+    fillRandom(mat, gen);
+    return mat;
+}
+
+//REQUIRES: A.columns == B.rows
+//MODIFIES: Nothing
+//EFFECTS: Returns A * B computed with the textbook i-j-k loop, used as the reference kernel
+Matrix<double> naiveMultiply(const Matrix<double> &A, const Matrix<double> &B) {
+    Matrix<double> product(A.rows, B.columns);
+    for(uint32_t row = 0; row < A.rows; row++) {
+        for(uint32_t col = 0; col < B.columns; col++) {
+            double sum = 0;
+            for(uint32_t k = 0; k < A.columns; k++) {
+                sum += A(row,k) * B(k,col);
+            }
+            product(row,col) = sum;
+        }
+    }
+    return product;
+}
+
+//REQUIRES: work is a callable, minSeconds > 0
+//MODIFIES: Nothing
+//EFFECTS: Runs work until at least minSeconds have elapsed and returns the average seconds per run
+template<typename Work>
+double timeIt(Work work, double minSeconds) {
+    uint32_t runs = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        work();
+        runs++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while(elapsed < minSeconds);
+    return elapsed / runs;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: value
+//EFFECTS: Makes the compiler assume value is read and changed here, so work on it is neither dropped nor
+//         hoisted out of a timing loop (the fixed size kernels are pure and small enough for both)
+template<typename V>
+void opaque(V &value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+//REQUIRES: setup and work are callables, minSeconds > 0
+//MODIFIES: Nothing
+//EFFECTS: Like timeIt, but calls setup untimed before every run (e.g. to copy the input an operation overwrites)
+template<typename Setup, typename Work>
+double timeWithSetup(Setup setup, Work work, double minSeconds) {
+    uint32_t runs = 0;
+    double timed = 0;
+    auto start = chrono::steady_clock::now();
+    do {
+        setup();
+        auto runStart = chrono::steady_clock::now();
+        work();
+        timed += chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+        runs++;
+    } while(chrono::duration<double>(chrono::steady_clock::now() - start).count() < minSeconds);
+    return timed / runs;
+}
+
+//REQUIRES: Nothing
+//MODIFIES: Nothing
+//EFFECTS: Returns the flops of eliminating a full rank rows x cols matrix to REF with subtractDown,
+//         plus the upward pass of subtractUp when reduced is set
+double eliminationFlops(uint32_t rows, uint32_t cols, bool reduced) {
+    double flops = 0;
+    const uint32_t pivots = min(rows, cols);
+    for(uint32_t k = 0; k < pivots; k++) {
+        flops += 2.0 * (rows - k - 1) * (cols - k); //one multiply and subtract per element right of the pivot
+        if(reduced) {
+            flops += (cols - k) + 2.0 * k * (cols - k); //divide the pivot row, clear the column above it
+        }
+    }
+    return flops;
+}
+
+//The shapes a matrix operand is swept over, each with about n * n elements
+struct Shape {
+    const char *name;
+    uint32_t rows;
+    uint32_t cols;
+};
+
+vector<Shape> shapesFor(uint32_t n) {
+    vector<Shape> shapes{{"square", n, n}};
+    if(n >= 8) {
+        shapes.push_back({"tall", 2 * n, n / 2});
+        shapes.push_back({"wide", n / 2, 2 * n});
+    }
+    return shapes;
+}
+
+class BenchSuite {
+public:
+    explicit BenchSuite(const Options &optionsIn) : options(optionsIn), gen(281) {}
+
+    //REQUIRES: Nothing
+    //MODIFIES: this, cout
+    //EFFECTS: Runs every case that matches the filter, printing a row per measurement
+    void run() {
+        printHeader();
+        for(uint32_t n = options.minSize; n <= options.maxSize; n *= 2) {
+            runMultiply(n);
+            runTranspose(n);
+            runRowKernels(n);
+            runFactorizations(n);
+            runElimination(n);
+            runSpaces(n);
+            runParsing(n);
+            runFormatting(n);
+            if(n > options.maxSize / 2) { //keep n *= 2 from overflowing
+                break;
+            }
+        }
+        runSmall();
+        runSmallBatches();
+        runBatch();
+        runSparse();
+        runTiled();
+    }
+
+    const vector<Result> &getResults() const {
+        return results;
+    }
+
+    //REQUIRES: file was written by writeJson
+    //MODIFIES: this
+    //EFFECTS: Loads the ns/op of every measurement in file, measurements are compared against it as they run
+    void loadBaseline(const string &file) {
+        ifstream in(file);
+        if(!in) {
+            cerr << "Unable to read baseline " << file << "\n";
+            exit(1);
+        }
+        string line;
+        while(getline(in, line)) { //one measurement per line, see writeJson
+            if(line.find("\"name\"") == string::npos) {
+                continue;
+            }
+            Result old;
+            old.name = jsonString(line, "name");
+            old.shape = jsonString(line, "shape");
+            old.rows = (uint32_t)jsonNumber(line, "rows");
+            old.cols = (uint32_t)jsonNumber(line, "cols");
+            old.inner = (uint32_t)jsonNumber(line, "inner");
+            old.threads = (uint32_t)jsonNumber(line, "threads");
+            baseline[old.key()] = jsonNumber(line, "ns_per_op");
+        }
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Writes every result as JSON, one measurement per line so that loadBaseline can read it back
+    void writeJson(const string &file) const {
+        ofstream out(file);
+        if(!out) {
+            cerr << "Unable to write " << file << "\n";
+            exit(1);
+        }
+        out << "{\n  \"threads_available\": " << max(1u, thread::hardware_concurrency()) << ",\n";
+        out << "  \"benchmarks\": [\n";
+        for(size_t i = 0; i < results.size(); i++) {
+            const Result &res = results[i];
+            out << "    {\"name\": \"" << res.name << "\", \"shape\": \"" << res.shape << "\", \"rows\": " << res.rows
+                << ", \"cols\": " << res.cols << ", \"inner\": " << res.inner << ", \"threads\": " << res.threads
+                << setprecision(6) << fixed << ", \"ns_per_op\": " << res.nsPerOp << ", \"gflops\": " << res.gflops()
+                << ", \"gbps\": " << res.gbps() << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: Nothing
+    //EFFECTS: Returns how many measurements are slower than the baseline by more than the tolerance
+    uint32_t regressions() const {
+        uint32_t slower = 0;
+        for(const Result &res : results) {
+            auto old = baseline.find(res.key());
+            if(old != baseline.end() && res.nsPerOp > old->second * (1 + options.tolerance)) {
+                slower++;
+            }
+        }
+        return slower;
+    }
+
+private:
+    const Options &options;
+    mt19937_64 gen;
+    vector<Result> results;
+    map<string, double> baseline; //key -> ns/op
+
+    bool wanted(const string &name) const {
+        return options.filter.empty() || name.find(options.filter) != string::npos;
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: this, cout
+    //EFFECTS: Records a measurement and prints it, with the change against the baseline if it has one
+    void record(Result res) {
+        cout << left << setw(24) << res.name << setw(8) << res.shape << right << setw(17)
+             << (to_string(res.rows) + "x" + (res.inner ? to_string(res.inner) + "x" : "") + to_string(res.cols))
+             << setw(4) << res.threads << setw(16) << setprecision(0) << fixed << res.nsPerOp << setprecision(2)
+             << setw(10) << res.gflops() << setw(10) << res.gbps();
+        auto old = baseline.find(res.key());
+        if(old != baseline.end()) {
+            double speedup = old->second / res.nsPerOp;
+            cout << setw(9) << speedup << "x";
+            if(res.nsPerOp > old->second * (1 + options.tolerance)) {
+                cout << "  SLOWER";
+            }
+        }
+        cout << endl;
+        results.push_back(res);
+    }
+
+    void printHeader() const {
+        cout << left << setw(24) << "case" << setw(8) << "shape" << right << setw(17) << "size" << setw(4) << "t"
+             << setw(16) << "ns/op" << setw(10) << "GFLOP/s" << setw(10) << "GB/s";
+        if(!baseline.empty()) {
+            cout << setw(10) << "vs base";
+        }
+        cout << "\n";
+    }
+
+    //REQUIRES: Nothing
+    //MODIFIES: ThreadPool::instance()
+    //EFFECTS: Calls measure once per thread count of the sweep, with the pool resized to it
+    void sweepThreads(const function<void(uint32_t)> &measure) {
+        for(uint32_t threads : options.threads) {
+            ThreadPool::instance().resize(threads);
+            measure(threads);
+        }
+        ThreadPool::instance().resize(options.threads.back());
+    }
+
+    //GEMM through Matrix::operator*, square (n x n x n), tall (2n x n/2 times n/2 x n) and
+    //wide (n/2 x 2n times 2n x n/2), swept over threads, plus the naive loop as the reference
+    //operator* is always the GEMM, multiply_strassen is what the * operand runs from STRASSEN_DEFAULT_CROSSOVER on
+    void runMultiply(uint32_t n) {
+        struct Product {
+            const char *shape;
+            uint32_t m, k, cols;
+        };
+        vector<Product> products{{"square", n, n, n}};
+        if(n >= 8) {
+            products.push_back({"tall", 2 * n, n / 2, n});
+            products.push_back({"wide", n / 2, 2 * n, n / 2});
+        }
+        for(const Product &p : products) {
+            Matrix<double> A = randomMatrix(p.m, p.k, gen);
+            Matrix<double> B = randomMatrix(p.k, p.cols, gen);
+            Result res{"", p.shape, p.m, p.cols, p.k, 1, 0, 2.0 * p.m * p.k * p.cols,
+                       8.0 * ((double)p.m * p.k + (double)p.k * p.cols + (double)p.m * p.cols)};
+            if(wanted("multiply")) {
+                sweepThreads([&](uint32_t threads) {
+                    res.name = "multiply";
+                    res.threads = threads;
+                    res.nsPerOp = 1e9 * timeIt([&]() { Matrix<double> C = A * B; }, options.minSeconds);
+                    record(res);
+                });
+            }
+            if(wanted("multiply_strassen") && n >= STRASSEN_DEFAULT_CROSSOVER) { //the * operand at its default
+                sweepThreads([&](uint32_t threads) {
+                    res.name = "multiply_strassen";
+                    res.threads = threads;
+                    res.nsPerOp = 1e9 * timeIt([&]() {
+                        Matrix<double> C = multiply(A, B, STRASSEN_DEFAULT_CROSSOVER);
+                    }, options.minSeconds);
+                    record(res);
+                });
+            }
+            if(wanted("multiply_naive") && n <= 512) {
+                res.name = "multiply_naive";
+                res.threads = 1;
+                res.nsPerOp = 1e9 * timeIt([&]() { naiveMultiply(A, B); }, options.minSeconds);
+                record(res);
+            }
+        }
+    }
+
+    void runTranspose(uint32_t n) {
+        if(wanted("transpose")) {
+            unique_ptr<LinearAlgebra<double>> linal;
+            for(const Shape &shape : shapesFor(n)) {
+                Matrix<double> input = randomMatrix(shape.rows, shape.cols, gen);
+                double seconds = timeWithSetup([&]() {
+                    linal.reset(new LinearAlgebra<double>());
+                    linal->addMatrix(input, "Transpose");
+                }, [&]() { linal->getTranspose(0); }, options.minSeconds);
+                record(Result{"transpose", shape.name, shape.rows, shape.cols, 0, ThreadPool::instance().size(),
+                              1e9 * seconds, 0, 16.0 * shape.rows * shape.cols});
+            }
+        }
+        if(wanted("transpose_inplace")) { //transposeInPlace alone, without the copy getTranspose makes first
+            Matrix<double> input = randomMatrix(n, n, gen);
+            Matrix<double> mat;
+            double seconds = timeWithSetup([&]() { mat = input; }, [&]() { transposeInPlace(mat); },
+                                           options.minSeconds);
+            record(Result{"transpose_inplace", "square", n, n, 0, 1, 1e9 * seconds, 0, 16.0 * n * n});
+        }
+    }
+
+    //The row kernels of every instruction set this CPU supports (rowsub_avx2, rowsub_float_avx2 etc.) on a square
+    //matrix, each run subtracts a multiple of row 0 from every other row, divides every row or scans a zero row for
+    //its last entry, and the transpose tile kernels of the same sets (trtile_avx2, trtile_float_avx2)
+    void runRowKernels(uint32_t n) {
+        for(RowKernelLevel level : {RowKernelLevel::Scalar, RowKernelLevel::Sse2, RowKernelLevel::Avx2,
+                                    RowKernelLevel::Avx512}) {
+            if(!rowKernelsSupported(level)) {
+                continue;
+            }
+            const RowKernels &kernels = rowKernelsFor(level);
+            const string suffix = string("_") + kernels.name;
+            benchRowOps<double>(n, suffix, kernels.subtractScaled, kernels.divide, kernels.findNonzero);
+            benchRowOps<float>(n, "_float" + suffix, kernels.subtractScaledFloat, kernels.divideFloat,
+                               kernels.findNonzeroFloat);
+            if(n >= TRANSPOSE_KERNEL_TILE) {
+                benchTransposeTiles<double>(n, "trtile" + suffix, kernels.transposeTile);
+                benchTransposeTiles<float>(n, "trtile_float" + suffix, kernels.transposeTileFloat);
+            }
+        }
+    }
+
+    //rowsub, rowdiv and rowscan of one level's kernels for T, suffix follows the case names
+    template<typename T>
+    void benchRowOps(uint32_t n, const string &suffix, void (*subtractScaled)(T *, const T *, T, uint32_t),
+                     void (*divide)(T *, T, uint32_t), int (*findNonzero)(const T *, uint32_t)) {
+        Matrix<T> mat(n, n);
+        uniform_real_distribution<T> dist(-1, 1);
+        for(uint32_t r = 0; r < n; r++) {
+            for(uint32_t c = 0; c < n; c++) {
+                mat(r,c) = dist(gen);
+            }
+        }
+        if(wanted("rowsub" + suffix)) {
+            double seconds = timeIt([&]() {
+                for(uint32_t r = 1; r < n; r++) {
+                    subtractScaled(mat.rowPtr(r), mat.rowPtr(0), (T)1e-3, n);
+                }
+                opaque(mat);
+            }, options.minSeconds);
+            record(Result{"rowsub" + suffix, "square", n, n, 0, 1, 1e9 * seconds, 2.0 * (n - 1) * n,
+                          3.0 * sizeof(T) * (n - 1) * n});
+        }
+        if(wanted("rowdiv" + suffix)) {
+            double seconds = timeIt([&]() {
+                for(uint32_t r = 0; r < n; r++) {
+                    divide(mat.rowPtr(r), 1, n);
+                }
+                opaque(mat);
+            }, options.minSeconds);
+            record(Result{"rowdiv" + suffix, "square", n, n, 0, 1, 1e9 * seconds, (double)n * n,
+                          2.0 * sizeof(T) * n * n});
+        }
+        if(wanted("rowscan" + suffix)) {
+            vector<T> row(n, 0);
+            row[n - 1] = 1;
+            int found = 0;
+            double seconds = timeIt([&]() {
+                opaque(row);
+                found += findNonzero(row.data(), n);
+                opaque(found);
+            }, options.minSeconds);
+            record(Result{"rowscan" + suffix, "square", 1, n, 0, 1, 1e9 * seconds, 0, (double)sizeof(T) * n});
+        }
+    }
+
+    //Every whole tile of an n x n matrix transposed by one level's tile kernel into a second matrix, in row order
+    template<typename T>
+    void benchTransposeTiles(uint32_t n, const string &name, void (*kernel)(const T *const *, T *const *)) {
+        if(!wanted(name)) {
+            return;
+        }
+        const uint32_t tile = TRANSPOSE_KERNEL_TILE;
+        const uint32_t full = n / tile * tile;
+        Matrix<T> src(n, n);
+        Matrix<T> dest(n, n);
+        for(uint32_t r = 0; r < n; r++) {
+            for(uint32_t c = 0; c < n; c++) {
+                src(r,c) = (T)(r * n + c);
+            }
+        }
+        double seconds = timeIt([&]() {
+            const T *srcRows[TRANSPOSE_KERNEL_TILE];
+            T *destRows[TRANSPOSE_KERNEL_TILE];
+            for(uint32_t r = 0; r < full; r += tile) {
+                for(uint32_t c = 0; c < full; c += tile) {
+                    for(uint32_t i = 0; i < tile; i++) {
+                        srcRows[i] = src.rowPtr(r + i) + c;
+                        destRows[i] = dest.rowPtr(c + i) + r;
+                    }
+                    kernel(srcRows, destRows);
+                }
+            }
+            opaque(dest);
+        }, options.minSeconds);
+        record(Result{name, "square", n, n, 0, 1, 1e9 * seconds, 0, 2.0 * sizeof(T) * full * full});
+    }
+
+    //Blocked LU and the inverse through it, square only, swept over threads
+    void runFactorizations(uint32_t n) {
+        Matrix<double> input = randomMatrix(n, n, gen);
+        const double bytes = 16.0 * n * n;
+        if(wanted("lu")) {
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() { LUFactorization<double> lu(input); }, options.minSeconds);
+                record(Result{"lu", "square", n, n, 0, threads, 1e9 * seconds, 2.0 / 3.0 * n * n * n, bytes});
+            });
+        }
+        if(wanted("lu_float")) {
+            Matrix<float> single(n, n);
+            for(uint32_t r = 0; r < n; r++) {
+                for(uint32_t c = 0; c < n; c++) {
+                    single(r,c) = (float)input(r,c);
+                }
+            }
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() { LUFactorization<float> lu(single); }, options.minSeconds);
+                record(Result{"lu_float", "square", n, n, 0, threads, 1e9 * seconds, 2.0 / 3.0 * n * n * n,
+                              bytes / 2});
+            });
+        }
+        if(wanted("solve_mixed")) { //one right hand side, factored in float and refined to double accuracy
+            const Matrix<double> &A = input;
+            const Matrix<double> b = randomMatrix(n, 1, gen);
+            Matrix<double> x(n, 1);
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() {
+                    bool refined = solveRefined<float>(wholeBlock(A), wholeBlock(b), wholeBlock(x));
+                    opaque(refined);
+                }, options.minSeconds);
+                record(Result{"solve_mixed", "square", n, n, 0, threads, 1e9 * seconds, 2.0 / 3.0 * n * n * n,
+                              bytes});
+            });
+        }
+        if(wanted("inverse")) {
+            LinearAlgebra<double> linal;
+            Matrix<double> mat;
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeWithSetup([&]() { mat = input; }, [&]() { linal.inverse(mat); },
+                                               options.minSeconds);
+                record(Result{"inverse", "square", n, n, 0, threads, 1e9 * seconds, 2.0 * n * n * n, bytes});
+            });
+        }
+    }
+
+    //subtractDown (REF) and subtractDown + subtractUp (RREF), the elimination every general command runs
+    void runElimination(uint32_t n) {
+        LinearAlgebra<double> linal;
+        for(const Shape &shape : shapesFor(n)) {
+            Matrix<double> input = randomMatrix(shape.rows, shape.cols, gen);
+            Matrix<double> mat;
+            const double bytes = 16.0 * shape.rows * shape.cols;
+            if(wanted("ref")) {
+                double seconds = timeWithSetup([&]() { mat = input; },
+                                               [&]() { linal.subtractDown(mat, 0, 0, mat.columns); },
+                                               options.minSeconds);
+                record(Result{"ref", shape.name, shape.rows, shape.cols, 0, 1, 1e9 * seconds,
+                              eliminationFlops(shape.rows, shape.cols, false), bytes});
+            }
+            if(wanted("rref")) {
+                double seconds = timeWithSetup([&]() { mat = input; }, [&]() {
+                    linal.subtractDown(mat, 0, 0, mat.columns);
+                    linal.subtractUp(mat, 0, mat.columns);
+                }, options.minSeconds);
+                record(Result{"rref", shape.name, shape.rows, shape.cols, 0, 1, 1e9 * seconds,
+                              eliminationFlops(shape.rows, shape.cols, true), bytes});
+            }
+        }
+    }
+
+    //The RowSpace, ColumnSpace and NullSpace commands, each on an engine of its own so that nothing is cached and
+    //it reduces the input to RREF itself, and the column pivoted QR behind --spaces qr
+    void runSpaces(uint32_t n) {
+        unique_ptr<LinearAlgebra<double>> linal;
+        const pair<const char *, const Matrix<double> &(LinearAlgebra<double>::*)(uint32_t)> spaces[] = {
+            {"rowspace", &LinearAlgebra<double>::getRowSpace},
+            {"colspace", &LinearAlgebra<double>::getColSpace},
+            {"nullspace", &LinearAlgebra<double>::getNullSpace}};
+        for(const Shape &shape : shapesFor(n)) {
+            Matrix<double> input = randomMatrix(shape.rows, shape.cols, gen);
+            for(const auto &space : spaces) {
+                if(!wanted(space.first)) {
+                    continue;
+                }
+                double seconds = timeWithSetup([&]() {
+                    linal.reset(new LinearAlgebra<double>());
+                    linal->addMatrix(input, "All");
+                }, [&]() { ((*linal).*space.second)(0); }, options.minSeconds);
+                record(Result{space.first, shape.name, shape.rows, shape.cols, 0, 1, 1e9 * seconds,
+                              eliminationFlops(shape.rows, shape.cols, true), 16.0 * shape.rows * shape.cols});
+            }
+        }
+        if(wanted("qr")) { //the --spaces qr backend, plus a 16:1 shape that takes the unpivoted QR first
+            vector<Shape> shapes = shapesFor(n);
+            if(n >= 8) {
+                shapes.push_back({"skinny", 4 * n, n / 4});
+            }
+            for(const Shape &shape : shapes) {
+                const Matrix<double> input = randomMatrix(shape.rows, shape.cols, gen);
+                const double m = shape.rows;
+                const double k = min(shape.rows, shape.cols);
+                const double flops = 4.0 * m * shape.cols * k - 2.0 * (m + shape.cols) * k * k + 4.0 / 3.0 * k * k * k;
+                sweepThreads([&](uint32_t threads) {
+                    double seconds = timeIt([&]() { QRFactorization<double> qr(input); }, options.minSeconds);
+                    record(Result{"qr", shape.name, shape.rows, shape.cols, 0, threads, 1e9 * seconds, flops,
+                                  16.0 * shape.rows * shape.cols});
+                });
+            }
+        }
+    }
+
+    //InputReader on an n x n text matrix in a temporary file (mapped, like a redirected input file)
+    //GB/s is input text per second
+    void runParsing(uint32_t n) {
+        if(!wanted("parse")) {
+            return;
+        }
+        char path[] = "/tmp/linal_benchXXXXXX";
+        int fd = mkstemp(path);
+        if(fd < 0) {
+            cerr << "Unable to create a temporary file\n";
+            exit(1);
+        }
+        unlink(path);
+        string text = "1\n" + to_string(n) + " " + to_string(n) + "\n";
+        uniform_real_distribution<double> dist(-1000.0, 1000.0);
+        char number[32];
+        for(uint32_t r = 0; r < n; r++) {
+            for(uint32_t c = 0; c < n; c++) {
+                snprintf(number, sizeof(number), "%.6f ", dist(gen));
+                text += number;
+            }
+            text += "\n";
+        }
+        text += "All\n";
+        if(write(fd, text.data(), text.size()) != (ssize_t)text.size()) {
+            cerr << "Unable to write the temporary file\n";
+            exit(1);
+        }
+        Matrix<double> mat(n, n);
+        double seconds = timeIt([&]() {
+            InputReader input(fd);
+            input.readCount("number of matrices");
+            input.readCount("row count");
+            input.readCount("column count");
+            input.readMatrix(mat, 0);
+            input.readWord("command");
+        }, options.minSeconds);
+        close(fd);
+        record(Result{"parse", "square", n, n, 0, 1, 1e9 * seconds, 0, (double)text.size()});
+    }
+
+    //OutputWriter formatting an n x n matrix at the default precision to /dev/null, GB/s is output text per second
+    void runFormatting(uint32_t n) {
+        if(!wanted("format")) {
+            return;
+        }
+        int fd = open("/dev/null", O_WRONLY);
+        Matrix<double> mat = randomMatrix(n, n, gen);
+        uint64_t bytes = 0;
+        {
+            OutputWriter out(fd);
+            double seconds = timeIt([&]() {
+                uint64_t before = out.bytesWritten();
+                out << mat;
+                out.flush();
+                bytes = out.bytesWritten() - before;
+            }, options.minSeconds);
+            record(Result{"format", "square", n, n, 0, 1, 1e9 * seconds, 0, (double)bytes});
+        }
+        close(fd);
+    }
+
+    //Multiply and inverse of 2x2, 4x4 and 8x8 matrices through the dynamic Matrix code and through FixedMatrix,
+    //the small_* and fixed_* results of one size are the same operation
+    void runSmall() {
+        const uint32_t repeats = 1000; //per timed run, so the clock reads do not dominate
+        for(uint32_t n : {2u, 4u, 8u}) {
+            dispatchFixedSize(n, [&](auto size) {
+                const Matrix<double> A = randomMatrix(n, n, gen);
+                const Matrix<double> B = randomMatrix(n, n, gen);
+                FixedMatrix<double, size(), size()> fixedA(A);
+                FixedMatrix<double, size(), size()> fixedB(B);
+                const double multiplyFlops = 2.0 * n * n * n;
+                const double inverseFlops = 2.0 * n * n * n;
+                if(wanted("small_multiply")) {
+                    double seconds = timeIt([&]() {
+                        for(uint32_t i = 0; i < repeats; i++) {
+                            Matrix<double> product = multiply(A, B);
+                            opaque(product);
+                        }
+                    }, options.minSeconds) / repeats;
+                    record(Result{"small_multiply", "square", n, n, n, 1, 1e9 * seconds, multiplyFlops, 24.0 * n * n});
+                }
+                if(wanted("fixed_multiply")) {
+                    double seconds = timeIt([&]() {
+                        for(uint32_t i = 0; i < repeats; i++) {
+                            opaque(fixedA);
+                            FixedMatrix<double, size(), size()> product = fixedA * fixedB;
+                            opaque(product);
+                        }
+                    }, options.minSeconds) / repeats;
+                    record(Result{"fixed_multiply", "square", n, n, n, 1, 1e9 * seconds, multiplyFlops, 24.0 * n * n});
+                }
+                if(wanted("small_inverse")) {
+                    double seconds = timeIt([&]() {
+                        for(uint32_t i = 0; i < repeats; i++) {
+                            Matrix<double> inv = LUFactorization<double>(A).inverse();
+                            opaque(inv);
+                        }
+                    }, options.minSeconds) / repeats;
+                    record(Result{"small_inverse", "square", n, n, 0, 1, 1e9 * seconds, inverseFlops, 16.0 * n * n});
+                }
+                if(wanted("fixed_inverse")) {
+                    double seconds = timeIt([&]() {
+                        for(uint32_t i = 0; i < repeats; i++) {
+                            opaque(fixedA);
+                            FixedMatrix<double, size(), size()> inv = inverse(fixedA);
+                            opaque(inv);
+                        }
+                    }, options.minSeconds) / repeats;
+                    record(Result{"fixed_inverse", "square", n, n, 0, 1, 1e9 * seconds, inverseFlops, 16.0 * n * n});
+                }
+            });
+        }
+    }
+
+    //The MatrixBatch kernels of every instruction set this CPU supports (batch_inverse_avx2 etc.) on 4096 3x3, 4x4
+    //and 8x8 matrices (systems of that many equations for solve), reported per matrix so that they compare with
+    //fixed_inverse and fixed_multiply
+    void runSmallBatches() {
+        const uint32_t count = 4096;
+        for(uint32_t n : {3u, 4u, 8u}) {
+            MatrixBatch<double> A(n, n, count);
+            MatrixBatch<double> B(n, n, count);
+            MatrixBatch<double> systems(n, n + 1, count);
+            for(uint32_t i = 0; i < count; i++) {
+                A.append(randomMatrix(n, n, gen));
+                B.append(randomMatrix(n, n, gen));
+                systems.append(randomMatrix(n, n + 1, gen));
+            }
+            MatrixBatch<double> results;
+            vector<double> determinants;
+            vector<uint8_t> singular;
+            for(RowKernelLevel level : {RowKernelLevel::Scalar, RowKernelLevel::Sse2, RowKernelLevel::Avx2,
+                                        RowKernelLevel::Avx512}) {
+                if(!rowKernelsSupported(level)) {
+                    continue;
+                }
+                const string suffix = string("_") + rowKernelsFor(level).name;
+                if(wanted("batch_inverse" + suffix)) {
+                    double seconds = timeIt([&]() {
+                        batchInverse(A, results, determinants, singular, level);
+                        opaque(results);
+                    }, options.minSeconds) / count;
+                    record(Result{"batch_inverse" + suffix, "square", n, n, 0, 1, 1e9 * seconds, 2.0 * n * n * n,
+                                  16.0 * n * n});
+                }
+                if(wanted("batch_det" + suffix)) {
+                    double seconds = timeIt([&]() {
+                        batchDeterminant(A, determinants, level);
+                        opaque(determinants);
+                    }, options.minSeconds) / count;
+                    record(Result{"batch_det" + suffix, "square", n, n, 0, 1, 1e9 * seconds, 2.0 / 3.0 * n * n * n,
+                                  8.0 * n * n + 8});
+                }
+                if(wanted("batch_solve" + suffix)) {
+                    double seconds = timeIt([&]() {
+                        batchSolve(systems, results, singular, level);
+                        opaque(results);
+                    }, options.minSeconds) / count;
+                    record(Result{"batch_solve" + suffix, "square", n, n + 1, 0, 1, 1e9 * seconds,
+                                  2.0 / 3.0 * n * n * n + 2.0 * n * n, 8.0 * n * (n + 2)});
+                }
+                if(wanted("batch_multiply" + suffix)) {
+                    double seconds = timeIt([&]() {
+                        batchMultiply(A, B, results, level);
+                        opaque(results);
+                    }, options.minSeconds) / count;
+                    record(Result{"batch_multiply" + suffix, "square", n, n, n, 1, 1e9 * seconds, 2.0 * n * n * n,
+                                  24.0 * n * n});
+                }
+            }
+        }
+    }
+
+    //The sparse kernels on the 9-point stencil of a 256 x 256 grid (65536 unknowns, about 590k nonzeros)
+    //sparse_lu is the ordering and factorization, the flops of spmm and sparse_lu are the ones their kernels count
+    void runSparse() {
+        const uint32_t side = 256;
+        const uint32_t n = side * side;
+        uniform_real_distribution<double> offDiagonal(-1.05, -0.95);
+        vector<SparseEntry<double>> entries;
+        for(uint32_t r = 0; r < side; r++) {
+            for(uint32_t c = 0; c < side; c++) {
+                for(uint32_t nr = r == 0 ? 0 : r - 1; nr <= min(r + 1, side - 1); nr++) {
+                    for(uint32_t nc = c == 0 ? 0 : c - 1; nc <= min(c + 1, side - 1); nc++) {
+                        const bool diagonal = nr == r && nc == c;
+                        entries.push_back({r * side + c, nr * side + nc, diagonal ? 8.5 : offDiagonal(gen)});
+                    }
+                }
+            }
+        }
+        const SparseMatrix<double> A(n, n, entries);
+        const double nonzeros = (double)A.nonzeros();
+        if(wanted("spmv")) {
+            vector<double> x(n, 1.0);
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() {
+                    vector<double> y = multiply(A, x);
+                    opaque(y);
+                }, options.minSeconds);
+                record(Result{"spmv", "grid9", n, n, 0, threads, 1e9 * seconds, 2 * nonzeros,
+                              12 * nonzeros + 16.0 * n});
+            });
+        }
+        if(wanted("spmm")) {
+            const uint64_t before = opCounters.flops;
+            multiply(A, A);
+            const double flops = (double)(opCounters.flops - before);
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() {
+                    SparseMatrix<double> product = multiply(A, A);
+                    opaque(product);
+                }, options.minSeconds);
+                record(Result{"spmm", "grid9", n, n, n, threads, 1e9 * seconds, flops, 24 * nonzeros});
+            });
+        }
+        if(wanted("sparse_lu")) {
+            const uint64_t before = opCounters.flops;
+            SparseLU<double> counted(A);
+            const double flops = (double)(opCounters.flops - before);
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() { SparseLU<double> lu(A); }, options.minSeconds);
+                record(Result{"sparse_lu", "grid9", n, n, 0, threads, 1e9 * seconds, flops,
+                              12.0 * (double)counted.factorNonzeros()});
+            });
+        }
+    }
+
+    //The tile algorithms on 2048 x 2048 matrices of 256 x 256 tiles (512 KB each) through a 16 MB cache, an eighth
+    //of one operand, so tiles go to disk and back (the page cache, in practice) as they would out of core
+    //The bytes are the tile reads and writes the cache counted, in a run of its own
+    void runTiled() {
+        const uint32_t n = 2048;
+        const uint32_t size = 256;
+        const double tileBytes = 8.0 * size * size;
+        const char *tmp = getenv("TMPDIR");
+        TileCache cache((size_t)16 << 20, tmp != nullptr && *tmp != '\0' ? tmp : "/tmp");
+        TiledMatrix<double> A = toTiled(randomMatrix(n, n, gen), size, cache);
+        Matrix<double> system = randomMatrix(n, n + 1, gen);
+        for(uint32_t r = 0; r < n; r++) {
+            system(r,r) += n; //diagonally dominant, so it is far from singular
+        }
+        TiledMatrix<double> S = toTiled(system, size, cache);
+        auto traffic = [&](function<void()> work) {
+            const uint64_t before = cache.getReads() + cache.getWrites();
+            work();
+            return tileBytes * (double)(cache.getReads() + cache.getWrites() - before);
+        };
+        if(wanted("tiled_multiply")) {
+            const double bytes = traffic([&]() { multiply(A, A); });
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() {
+                    TiledMatrix<double> product = multiply(A, A);
+                    opaque(product);
+                }, options.minSeconds);
+                record(Result{"tiled_multiply", "square", n, n, n, threads, 1e9 * seconds, 2.0 * n * n * n, bytes});
+            });
+        }
+        if(wanted("tiled_solve")) {
+            TiledMatrix<double> x;
+            const double bytes = traffic([&]() { solveTiled(S, x); });
+            sweepThreads([&](uint32_t threads) {
+                double seconds = timeIt([&]() { solveTiled(S, x); }, options.minSeconds);
+                record(Result{"tiled_solve", "square", n, n, 0, threads, 1e9 * seconds,
+                              2.0 / 3.0 * n * n * n + 2.0 * n * n, bytes});
+            });
+        }
+    }
+
+    //processCommands on a batch of 4096 independent 16 x 16 matrices with the All command, swept over threads
+    //Reported per batch, the flops are the LU, inverse and RREF of every matrix
+    void runBatch() {
+        if(!wanted("batch")) {
+            return;
+        }
+        const uint32_t count = 4096;
+        const uint32_t n = 16;
+        vector<Matrix<double>> inputs;
+        for(uint32_t m = 0; m < count; m++) {
+            inputs.push_back(randomMatrix(n, n, gen));
+        }
+        unique_ptr<LinearAlgebra<double>> linal;
+        sweepThreads([&](uint32_t threads) {
+            double seconds = timeWithSetup([&]() {
+                linal.reset(new LinearAlgebra<double>());
+                for(const Matrix<double> &input : inputs) {
+                    linal->addMatrix(input, "All");
+                }
+            }, [&]() { linal->processCommands(); }, options.minSeconds);
+            record(Result{"batch_all", "square", n, n, 0, threads, 1e9 * seconds,
+                          count * (2.0 * n * n * n + eliminationFlops(n, n, true)), 16.0 * count * n * n});
+        });
+    }
+
+    //REQUIRES: line holds "key": "value"
+    //EFFECTS: Returns value
+    static string jsonString(const string &line, const string &key) {
+        size_t at = line.find("\"" + key + "\": \"");
+        if(at == string::npos) {
+            return "";
+        }
+        at += key.size() + 5;
+        return line.substr(at, line.find('"', at) - at);
+    }
+
+    //REQUIRES: line holds "key": number
+    //EFFECTS: Returns number
+    static double jsonNumber(const string &line, const string &key) {
+        size_t at = line.find("\"" + key + "\": ");
+        return at == string::npos ? 0 : atof(line.c_str() + at + key.size() + 4);
+    }
+};
+
+void printUsage() {
+    cout << "Usage: linal_bench [options]\n";
+    cout << "  --min-size N       smallest n of the size sweep, default 8\n";
+    cout << "  --max-size N       largest n of the size sweep (powers of two), default 1024, up to 4096\n";
+    cout << "  --min-time S       seconds each measurement repeats for, default 0.2\n";
+    cout << "  --threads a,b,...  thread counts for the parallel kernels, default 1 and every power of two up to\n";
+    cout << "                     one per core\n";
+    cout << "  --filter NAME      only run cases whose name contains NAME (multiply, multiply_strassen,\n";
+    cout << "                     transpose, transpose_inplace,\n";
+    cout << "                     rowsub, rowdiv, rowscan (suffixed _scalar, _sse2, _avx2, _avx512, and\n";
+    cout << "                     _float_scalar etc.),\n";
+    cout << "                     lu, lu_float, solve_mixed, inverse, ref,\n";
+    cout << "                     rref, rowspace, colspace, nullspace, qr, parse, format,\n";
+    cout << "                     small_multiply, fixed_multiply, small_inverse, fixed_inverse, batch_inverse,\n";
+    cout << "                     batch_det, batch_solve, batch_multiply (suffixed like rowsub), batch,\n";
+    cout << "                     spmv, spmm, sparse_lu, tiled_multiply, tiled_solve)\n";
+    cout << "  --json FILE        write the results as JSON to FILE\n";
+    cout << "  --baseline FILE    compare against a JSON file from an earlier run, slower cases are marked\n";
+    cout << "  --tolerance F      fraction slower than the baseline that counts as a regression, default 0.05\n";
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+        if(i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if(arg == "--min-size") {
+            options.minSize = (uint32_t)max(1, atoi(value.c_str()));
+        }
+        else if(arg == "--max-size") {
+            options.maxSize = (uint32_t)max(1, atoi(value.c_str()));
+        }
+        else if(arg == "--min-time") {
+            options.minSeconds = atof(value.c_str());
+        }
+        else if(arg == "--threads") {
+            stringstream list(value);
+            string item;
+            while(getline(list, item, ',')) {
+                options.threads.push_back((uint32_t)max(1, atoi(item.c_str())));
+            }
+        }
+        else if(arg == "--filter") {
+            options.filter = value;
+        }
+        else if(arg == "--json") {
+            options.jsonFile = value;
+        }
+        else if(arg == "--baseline") {
+            options.baselineFile = value;
+        }
+        else if(arg == "--tolerance") {
+            options.tolerance = atof(value.c_str());
+        }
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if(options.threads.empty()) {
+        const uint32_t cores = max(1u, thread::hardware_concurrency());
+        for(uint32_t threads = 1; threads < cores; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(cores);
+    }
+
+    BenchSuite suite(options);
+    if(!options.baselineFile.empty()) {
+        suite.loadBaseline(options.baselineFile);
+    }
+    suite.run();
+    if(!options.jsonFile.empty()) {
+        suite.writeJson(options.jsonFile);
+    }
+    if(!options.baselineFile.empty()) {
+        uint32_t slower = suite.regressions();
+        cout << slower << " of " << suite.getResults().size() << " measurements are more than "
+             << setprecision(0) << options.tolerance * 100 << "% slower than the baseline\n";
+        return slower == 0 ? 0 : 2;
+    }
+}